@@ -107,7 +107,9 @@ void ASTC_Decoder::Decode(const unsigned char *source, unsigned char *dest,
                           int xblocks, int yblocks, int zblocks, bool isUnsignedByte)
 {
 #ifdef SWIFTSHADER_ENABLE_ASTC
-	build_quantization_mode_table();
+	// Images may be decoded concurrently, so the shared table is only built once.
+	static const bool quantizationModeTableBuilt = (build_quantization_mode_table(), true);
+	(void)quantizationModeTableBuilt;
 
 	astc_decode_mode decode_mode = isUnsignedByte ? DECODE_LDR : DECODE_HDR;
 
@@ -20,6 +20,7 @@
 #include "System/Debug.hpp"
 #include "System/Half.hpp"
 #include "System/Memory.hpp"
+#include "System/SwiftConfig.hpp"
 #include "Vulkan/VkImage.hpp"
 #include "Vulkan/VkImageView.hpp"
 
@@ -85,12 +86,19 @@ void Blitter::clear(const void *pixel, vk::Format format, vk::Image *dest, const
 		}
 	}
 
-	if(fastClear(pixel, format, dest, dstFormat, subresourceRange, renderArea))
+	bool quadLayout = dest->hasQuadLayout(aspect);
+	if(quadLayout && clearQuadLayout(pixel, format, dest, dstFormat, subresourceRange, renderArea))
+	{
+		return;
+	}
+
+	if(!quadLayout && fastClear(pixel, format, dest, dstFormat, subresourceRange, renderArea))
 	{
 		return;
 	}
 
 	State state(format, dstFormat, 1, dest->getSampleCount(), Options{ 0xF });
+	state.destQuadLayout = quadLayout;
 	auto blitRoutine = getBlitRoutine(state);
 	if(!blitRoutine)
 	{
@@ -324,6 +332,100 @@ bool Blitter::fastClear(const void *clearValue, vk::Format clearFormat, vk::Imag
 	return true;
 }
 
+bool Blitter::clearQuadLayout(const void *clearValue, vk::Format clearFormat, vk::Image *dest, const vk::Format &viewFormat, const VkImageSubresourceRange &subresourceRange, const VkRect2D *renderArea)
+{
+	VkImageAspectFlagBits aspect = static_cast<VkImageAspectFlagBits>(subresourceRange.aspectMask);
+
+	if(renderArea)
+	{
+		ASSERT(subresourceRange.levelCount == 1);
+		VkExtent3D extent = dest->getMipLevelExtent(aspect, subresourceRange.baseMipLevel);
+		if((renderArea->offset.x != 0) || (renderArea->offset.y != 0) ||
+		   (renderArea->extent.width != extent.width) || (renderArea->extent.height != extent.height))
+		{
+			// Partial clears use the blit routine's quad addressing.
+			return false;
+		}
+	}
+
+	// Every texel of the slice holds the same value, so only the padding to whole quads
+	// differs from a linear clear. Pack one texel and replicate it over entire slices.
+	uint8_t texel[16] = {};
+	int bytes = viewFormat.bytes();
+	if(bytes > static_cast<int>(sizeof(texel)))
+	{
+		return false;
+	}
+
+	State state(clearFormat, viewFormat, 1, 1, Options{ 0xF });
+	auto blitRoutine = getBlitRoutine(state);
+	if(!blitRoutine)
+	{
+		return false;
+	}
+
+	BlitData data = {
+		clearValue, texel,  // source, dest
+
+		assert_cast<uint32_t>(clearFormat.bytes()),  // sPitchB
+		assert_cast<uint32_t>(bytes),                // dPitchB
+		0,                                           // sSliceB (unused in clear operations)
+		assert_cast<uint32_t>(bytes),                // dSliceB
+
+		0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 0.0f,  // x0, y0, z0, w, h, d
+
+		0, 1,  // x0d, x1d
+		0, 1,  // y0d, y1d
+		0, 1,  // z0d, z1d
+
+		0, 0, 0,  // sWidth, sHeight, sDepth
+
+		false,  // filter3D
+	};
+
+	blitRoutine(&data);
+
+	uint32_t packed = 0;
+	memcpy(&packed, texel, std::min(bytes, 4));  // Little-endian
+
+	VkImageSubresource subres = {
+		subresourceRange.aspectMask,
+		subresourceRange.baseMipLevel,
+		subresourceRange.baseArrayLayer
+	};
+	uint32_t lastMipLevel = dest->getLastMipLevel(subresourceRange);
+	uint32_t lastLayer = dest->getLastLayerIndex(subresourceRange);
+
+	for(; subres.mipLevel <= lastMipLevel; subres.mipLevel++)
+	{
+		// Includes the padding to whole quads, and all samples.
+		size_t sliceBytes = dest->slicePitchBytes(aspect, subres.mipLevel) * dest->getSampleCount();
+
+		for(subres.arrayLayer = subresourceRange.baseArrayLayer; subres.arrayLayer <= lastLayer; subres.arrayLayer++)
+		{
+			uint8_t *slice = (uint8_t *)dest->getTexelPointer({ 0, 0, 0 }, subres);
+			ASSERT(slice + sliceBytes <= dest->end());
+
+			switch(bytes)
+			{
+			case 4: sw::clear((uint32_t *)slice, packed, sliceBytes / 4); break;
+			case 2: sw::clear((uint16_t *)slice, static_cast<uint16_t>(packed), sliceBytes / 2); break;
+			case 1: memset(slice, static_cast<uint8_t>(packed), sliceBytes); break;
+			default:
+				for(size_t offset = 0; offset < sliceBytes; offset += bytes)
+				{
+					memcpy(slice + offset, texel, bytes);
+				}
+				break;
+			}
+		}
+	}
+
+	dest->contentsChanged(subresourceRange);
+
+	return true;
+}
+
 Float4 Blitter::readFloat4(Pointer<Byte> element, const State &state)
 {
 	Float4 c(0.0f, 0.0f, 0.0f, 1.0f);
@@ -1658,6 +1760,8 @@ Float4 Blitter::sample(Pointer<Byte> &source, Float &x, Float &y, Float &z,
 
 Blitter::BlitRoutineType Blitter::generate(const State &state)
 {
+	ScopedPragma optimizationPasses(OptimizationPasses, static_cast<int>(getConfiguration().blitterOptimization));
+
 	BlitFunction function;
 	{
 		Pointer<Byte> blit(function.Arg<0>());
@@ -1722,11 +1826,20 @@ Blitter::BlitRoutineType Blitter::generate(const State &state)
 			{
 				Float y = state.clearOperation ? RValue<Float>(y0) : y0 + Float(j) * h;
 				Pointer<Byte> destLine = destSlice + j * dPitchB;
+				if(state.destQuadLayout)
+				{
+					// The two rows of each quad are interleaved per pair of texels.
+					destLine = destSlice + (j & ~1) * dPitchB + (j & 1) * (2 * dstBytes);
+				}
 
 				For(Int i = x0d, i < x1d, i++)
 				{
 					Float x = state.clearOperation ? RValue<Float>(x0) : x0 + Float(i) * w;
 					Pointer<Byte> d = destLine + i * dstBytes;
+					if(state.destQuadLayout)
+					{
+						d = destLine + (i + (i & ~1)) * dstBytes;
+					}
 
 					if(hasConstantColorI)
 					{
@@ -1878,6 +1991,8 @@ void Blitter::blit(const vk::Image *src, vk::Image *dst, VkImageBlit2KHR region,
 	                    (doFilter && ((x0 < 0.5f) || (y0 < 0.5f)));
 	state.filter3D = (region.srcOffsets[1].z - region.srcOffsets[0].z) !=
 	                 (region.dstOffsets[1].z - region.dstOffsets[0].z);
+	state.destQuadLayout = dst->hasQuadLayout(dstAspect);
+	ASSERT(!src->hasQuadLayout(srcAspect));
 
 	auto blitRoutine = getBlitRoutine(state);
 	if(!blitRoutine)
@@ -1971,12 +2086,31 @@ static void resolveDepth(const vk::ImageView *src, vk::ImageView *dst, const VkR
 	size_t formatSize = format.bytes();
 	// TODO(b/167558951) support other resolve modes.
 	ASSERT(depthResolveMode == VK_RESOLVE_MODE_SAMPLE_ZERO_BIT);
-	for(int y = 0; y < height; y++)
+	if(src->hasQuadLayout(VK_IMAGE_ASPECT_DEPTH_BIT) != dst->hasQuadLayout(VK_IMAGE_ASPECT_DEPTH_BIT))
 	{
-		memcpy(dest, source, formatSize * width);
+		for(int y = 0; y < height; y++)
+		{
+			for(int x = 0; x < width; x++)
+			{
+				memcpy(dst->getOffsetPointer({ x, y, 0 }, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0),
+				       src->getOffsetPointer({ x, y, 0 }, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0), formatSize);
+			}
+		}
+	}
+	else if(src->hasQuadLayout(VK_IMAGE_ASPECT_DEPTH_BIT))
+	{
+		// Rows of quads, including their padding.
+		memcpy(dest, source, pitch * sw::align<2>(height));
+	}
+	else
+	{
+		for(int y = 0; y < height; y++)
+		{
+			memcpy(dest, source, formatSize * width);
 
-		source += pitch;
-		dest += pitch;
+			source += pitch;
+			dest += pitch;
+		}
 	}
 
 	dst->contentsChanged(vk::Image::DIRECT_MEMORY_ACCESS);
@@ -2078,6 +2212,11 @@ static inline uint32_t averageByte4(uint32_t x, uint32_t y)
 
 bool Blitter::fastResolve(const vk::Image *src, vk::Image *dst, VkImageResolve2KHR region)
 {
+	if(dst->hasQuadLayout(VK_IMAGE_ASPECT_COLOR_BIT))
+	{
+		return false;
+	}
+
 	if(region.dstOffset != VkOffset3D{ 0, 0, 0 })
 	{
 		return false;
@@ -2238,6 +2377,8 @@ void Blitter::computeCubeCorner(Pointer<Byte> &layer, Int &x0, Int &x1, Int &y0,
 
 Blitter::CornerUpdateRoutineType Blitter::generateCornerUpdate(const State &state)
 {
+	ScopedPragma optimizationPasses(OptimizationPasses, static_cast<int>(getConfiguration().blitterOptimization));
+
 	// Reading and writing from/to the same image
 	ASSERT(state.sourceFormat == state.destFormat);
 	ASSERT(state.srcSamples == state.destSamples);
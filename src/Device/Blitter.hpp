@@ -96,6 +96,7 @@ class Blitter
 		int srcSamples = 0;
 		int destSamples = 0;
 		bool filter3D = false;
+		bool destQuadLayout = false;
 	};
 	friend std::hash<Blitter::State>;
 
@@ -160,6 +161,7 @@ private:
 	};
 
 	bool fastClear(const void *clearValue, vk::Format clearFormat, vk::Image *dest, const vk::Format &viewFormat, const VkImageSubresourceRange &subresourceRange, const VkRect2D *renderArea);
+	bool clearQuadLayout(const void *clearValue, vk::Format clearFormat, vk::Image *dest, const vk::Format &viewFormat, const VkImageSubresourceRange &subresourceRange, const VkRect2D *renderArea);
 	bool fastResolve(const vk::Image *src, vk::Image *dst, VkImageResolve2KHR region);
 
 	Float4 readFloat4(Pointer<Byte> element, const State &state);
@@ -209,6 +211,7 @@ struct hash<sw::Blitter::State>
 		hash = hash * 31 + state.srcSamples;
 		hash = hash * 31 + state.destSamples;
 		hash = hash * 31 + state.filter3D;
+		hash = hash * 31 + state.destQuadLayout;
 		return hash;
 	}
 };
@@ -17,7 +17,6 @@
 
 namespace sw {
 
-constexpr int OUTLINE_RESOLUTION = 8192;  // Maximum vertical resolution of the render target
 constexpr int MIPMAP_LEVELS = 15;
 constexpr int MAX_CLIP_DISTANCES = 8;
 constexpr int MAX_CULL_DISTANCES = 8;
@@ -26,7 +25,7 @@ constexpr int MAX_TEXEL_OFFSET = 7;
 constexpr int MAX_TEXTURE_LOD = MIPMAP_LEVELS - 2;  // Trilinear accesses lod+1
 constexpr int MAX_COLOR_BUFFERS = 8;
 constexpr int MAX_INTERFACE_COMPONENTS = 32 * 4;  // Must be multiple of 4 for 16-byte alignment.
-constexpr int MAX_FRAMEBUFFER_DIM = OUTLINE_RESOLUTION;
+constexpr int MAX_FRAMEBUFFER_DIM = 8192;
 constexpr int MAX_VIEWPORT_DIM = MAX_FRAMEBUFFER_DIM;
 
 }  // namespace sw
@@ -287,6 +287,23 @@ void IndexBuffer::getIndexBuffers(VkPrimitiveTopology topology, uint32_t count,
 	}
 }
 
+bool Attachments::hasColorBuffer(int location) const
+{
+	ASSERT((location >= 0) && (location < sw::MAX_COLOR_BUFFERS));
+
+	return colorBuffer[location] || (colorBufferFormat[location] != VK_FORMAT_UNDEFINED);
+}
+
+bool Attachments::hasDepthBuffer() const
+{
+	return depthBuffer || (depthBufferFormat != VK_FORMAT_UNDEFINED);
+}
+
+bool Attachments::hasStencilBuffer() const
+{
+	return stencilBuffer || (stencilBufferFormat != VK_FORMAT_UNDEFINED);
+}
+
 VkFormat Attachments::colorFormat(int location) const
 {
 	ASSERT((location >= 0) && (location < sw::MAX_COLOR_BUFFERS));
@@ -297,7 +314,7 @@ VkFormat Attachments::colorFormat(int location) const
 	}
 	else
 	{
-		return VK_FORMAT_UNDEFINED;
+		return colorBufferFormat[location];
 	}
 }
 
@@ -309,7 +326,49 @@ VkFormat Attachments::depthFormat() const
 	}
 	else
 	{
-		return VK_FORMAT_UNDEFINED;
+		return depthBufferFormat;
+	}
+}
+
+bool Attachments::colorQuadLayout(int location) const
+{
+	ASSERT((location >= 0) && (location < sw::MAX_COLOR_BUFFERS));
+
+	if(colorBuffer[location])
+	{
+		return colorBuffer[location]->hasQuadLayout(VK_IMAGE_ASPECT_COLOR_BIT);
+	}
+	else
+	{
+		// Color attachments are commonly presented or copied from, which requires linear rows.
+		return false;
+	}
+}
+
+bool Attachments::depthQuadLayout() const
+{
+	if(depthBuffer)
+	{
+		return depthBuffer->hasQuadLayout(VK_IMAGE_ASPECT_DEPTH_BIT);
+	}
+	else
+	{
+		// Assume the common case of a depth buffer which is only used as an attachment.
+		return depthBufferFormat != VK_FORMAT_UNDEFINED;
+	}
+}
+
+Format Attachments::colorImageFormat(int location) const
+{
+	ASSERT((location >= 0) && (location < sw::MAX_COLOR_BUFFERS));
+
+	if(colorBuffer[location])
+	{
+		return colorBuffer[location]->getFormat(VK_IMAGE_ASPECT_COLOR_BIT);
+	}
+	else
+	{
+		return colorBufferFormat[location];
 	}
 }
 
@@ -369,7 +428,8 @@ void Inputs::updateDescriptorSets(const DescriptorSet::Array &dso,
 	descriptorDynamicOffsets = ddo;
 }
 
-void Inputs::bindVertexInputs(int firstInstance)
+// Instance-rate attributes are offset by the vertex routine, for each batch's instance.
+void Inputs::bindVertexInputs()
 {
 	for(uint32_t i = 0; i < MAX_VERTEX_INPUT_BINDINGS; i++)
 	{
@@ -377,8 +437,7 @@ void Inputs::bindVertexInputs(int firstInstance)
 		if(attrib.format != VK_FORMAT_UNDEFINED)
 		{
 			const auto &vertexInput = vertexInputBindings[attrib.binding];
-			VkDeviceSize offset = attrib.offset + vertexInput.offset +
-			                      getInstanceStride(i) * firstInstance;
+			VkDeviceSize offset = attrib.offset + vertexInput.offset;
 			attrib.buffer = vertexInput.buffer ? vertexInput.buffer->getOffsetPointer(offset) : nullptr;
 
 			VkDeviceSize size = vertexInput.buffer ? vertexInput.buffer->getSize() : 0;
@@ -424,22 +483,6 @@ void Inputs::setVertexInputBinding(const VertexInputBinding bindings[], const Dy
 	}
 }
 
-void Inputs::advanceInstanceAttributes()
-{
-	for(uint32_t i = 0; i < vk::MAX_VERTEX_INPUT_BINDINGS; i++)
-	{
-		auto &attrib = stream[i];
-
-		VkDeviceSize instanceStride = getInstanceStride(i);
-		if((attrib.format != VK_FORMAT_UNDEFINED) && instanceStride && (instanceStride < attrib.robustnessSize))
-		{
-			// Under the casts: attrib.buffer += instanceStride
-			attrib.buffer = (const void *)((uintptr_t)attrib.buffer + instanceStride);
-			attrib.robustnessSize -= instanceStride;
-		}
-	}
-}
-
 VkDeviceSize Inputs::getVertexStride(uint32_t i) const
 {
 	auto &attrib = stream[i];
@@ -915,17 +958,17 @@ bool FragmentState::depthWriteActive(const Attachments &attachments) const
 
 bool FragmentState::depthTestActive(const Attachments &attachments) const
 {
-	return attachments.depthBuffer && depthTestEnable;
+	return attachments.hasDepthBuffer() && depthTestEnable;
 }
 
 bool FragmentState::stencilActive(const Attachments &attachments) const
 {
-	return attachments.stencilBuffer && stencilEnable;
+	return attachments.hasStencilBuffer() && stencilEnable;
 }
 
 bool FragmentState::depthBoundsTestActive(const Attachments &attachments) const
 {
-	return attachments.depthBuffer && depthBoundsTestEnable;
+	return attachments.hasDepthBuffer() && depthBoundsTestEnable;
 }
 
 void FragmentState::setDepthStencilState(const VkPipelineDepthStencilStateCreateInfo *depthStencilState)
@@ -1084,7 +1127,7 @@ BlendState FragmentOutputInterfaceState::getBlendState(int location, const Attac
 
 	if(activeBlendState.alphaBlendEnable)
 	{
-		vk::Format format = attachments.colorBuffer[location]->getFormat(VK_IMAGE_ASPECT_COLOR_BIT);
+		vk::Format format = attachments.colorImageFormat(location);
 
 		activeBlendState.sourceBlendFactor = blendFactor(state.blendOperation, state.sourceBlendFactor);
 		activeBlendState.destBlendFactor = blendFactor(state.blendOperation, state.destBlendFactor);
@@ -1109,7 +1152,7 @@ bool FragmentOutputInterfaceState::alphaBlendActive(int location, const Attachme
 	ASSERT((index >= 0) && (index < sw::MAX_COLOR_BUFFERS));
 	auto &state = blendState[index];
 
-	if(!attachments.colorBuffer[location] || !blendState[index].alphaBlendEnable)
+	if(!attachments.hasColorBuffer(location) || !blendState[index].alphaBlendEnable)
 	{
 		return false;
 	}
@@ -1119,7 +1162,7 @@ bool FragmentOutputInterfaceState::alphaBlendActive(int location, const Attachme
 		return false;
 	}
 
-	vk::Format format = attachments.colorBuffer[location]->getFormat(VK_IMAGE_ASPECT_COLOR_BIT);
+	vk::Format format = attachments.colorImageFormat(location);
 	bool colorBlend = blendOperation(state.blendOperation, state.sourceBlendFactor, state.destBlendFactor, format) != VK_BLEND_OP_SRC_EXT;
 	bool alphaBlend = blendOperation(state.blendOperationAlpha, state.sourceBlendFactorAlpha, state.destBlendFactorAlpha, format) != VK_BLEND_OP_SRC_EXT;
 
@@ -1274,12 +1317,12 @@ int FragmentOutputInterfaceState::colorWriteActive(int location, const Attachmen
 	ASSERT((index >= 0) && (index < sw::MAX_COLOR_BUFFERS));
 	auto &state = blendState[index];
 
-	if(!attachments.colorBuffer[location] || attachments.colorBuffer[location]->getFormat() == VK_FORMAT_UNDEFINED)
+	if(attachments.colorFormat(location) == VK_FORMAT_UNDEFINED)
 	{
 		return 0;
 	}
 
-	vk::Format format = attachments.colorBuffer[location]->getFormat(VK_IMAGE_ASPECT_COLOR_BIT);
+	vk::Format format = attachments.colorImageFormat(location);
 
 	if(blendOperation(state.blendOperation, state.sourceBlendFactor, state.destBlendFactor, format) == VK_BLEND_OP_DST_EXT &&
 	   blendOperation(state.blendOperationAlpha, state.sourceBlendFactorAlpha, state.destBlendFactorAlpha, format) == VK_BLEND_OP_DST_EXT)
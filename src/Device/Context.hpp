@@ -115,6 +115,12 @@ struct Attachments
 	ImageView *depthBuffer = nullptr;
 	ImageView *stencilBuffer = nullptr;
 
+	// Formats of the attachments for which no image view is bound. Used to compute
+	// routine state keys from the pipeline's rendering info, ahead of the first draw.
+	VkFormat colorBufferFormat[sw::MAX_COLOR_BUFFERS] = {};
+	VkFormat depthBufferFormat = VK_FORMAT_UNDEFINED;
+	VkFormat stencilBufferFormat = VK_FORMAT_UNDEFINED;
+
 	// VK_KHR_dynamic_rendering_local_read allows color locations to be mapped to the render
 	// pass attachments, but blend and other state is not affected by this map.  The image views
 	// placed in colorBuffer are indexed by "location" (i.e the decoration in the shader), and
@@ -123,8 +129,15 @@ struct Attachments
 	uint32_t indexToLocation[sw::MAX_COLOR_BUFFERS] = {};
 	uint32_t locationToIndex[sw::MAX_COLOR_BUFFERS] = {};
 
+	bool hasColorBuffer(int location) const;
+	bool hasDepthBuffer() const;
+	bool hasStencilBuffer() const;
+
 	VkFormat colorFormat(int location) const;
 	VkFormat depthFormat() const;
+	bool colorQuadLayout(int location) const;
+	bool depthQuadLayout() const;
+	Format colorImageFormat(int location) const;  // Format of the image, rather than of the view
 };
 
 struct DynamicState;
@@ -140,9 +153,8 @@ struct Inputs
 	inline const DescriptorSet::DynamicOffsets &getDescriptorDynamicOffsets() const { return descriptorDynamicOffsets; }
 	inline const sw::Stream &getStream(uint32_t i) const { return stream[i]; }
 
-	void bindVertexInputs(int firstInstance);
+	void bindVertexInputs();
 	void setVertexInputBinding(const VertexInputBinding vertexInputBindings[], const DynamicState &dynamicState);
-	void advanceInstanceAttributes();
 	VkDeviceSize getVertexStride(uint32_t i) const;
 	VkDeviceSize getInstanceStride(uint32_t i) const;
 
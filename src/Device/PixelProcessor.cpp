@@ -18,6 +18,7 @@
 #include "Pipeline/Constants.hpp"
 #include "Pipeline/PixelProgram.hpp"
 #include "System/Debug.hpp"
+#include "System/SwiftConfig.hpp"
 #include "Vulkan/VkImageView.hpp"
 #include "Vulkan/VkPipelineLayout.hpp"
 
@@ -48,11 +49,6 @@ bool PixelProcessor::State::operator==(const State &state) const
 	return *static_cast<const States *>(this) == static_cast<const States &>(state);
 }
 
-PixelProcessor::PixelProcessor()
-{
-	setRoutineCacheSize(1024);
-}
-
 void PixelProcessor::setBlendConstant(const float4 &blendConstant)
 {
 	for(int i = 0; i < 4; i++)
@@ -66,12 +62,12 @@ void PixelProcessor::setBlendConstant(const float4 &blendConstant)
 	}
 }
 
-void PixelProcessor::setRoutineCacheSize(int cacheSize)
+void PixelProcessor::setRoutineCache(RoutineCacheType *cache)
 {
-	routineCache = std::make_unique<RoutineCacheType>(clamp(cacheSize, 1, 65536));
+	routineCache = cache;
 }
 
-const PixelProcessor::State PixelProcessor::update(const vk::GraphicsState &pipelineState, const sw::SpirvShader *fragmentShader, const sw::SpirvShader *vertexShader, const vk::Attachments &attachments, bool occlusionEnabled) const
+const PixelProcessor::State PixelProcessor::update(const vk::GraphicsState &pipelineState, const sw::SpirvShader *fragmentShader, const sw::SpirvShader *vertexShader, const vk::Attachments &attachments, bool occlusionEnabled)
 {
 	const vk::VertexInputInterfaceState &vertexInputInterfaceState = pipelineState.getVertexInputInterfaceState();
 	const vk::PreRasterizationState &preRasterizationState = pipelineState.getPreRasterizationState();
@@ -107,6 +103,7 @@ const PixelProcessor::State PixelProcessor::update(const vk::GraphicsState &pipe
 	}
 
 	state.depthFormat = attachments.depthFormat();
+	state.depthQuadLayout = attachments.depthQuadLayout();
 	state.depthBoundsTestActive = fragmentState.depthBoundsTestActive(attachments);
 	state.minDepthBounds = fragmentState.getMinDepthBounds();
 	state.maxDepthBounds = fragmentState.getMaxDepthBounds();
@@ -136,12 +133,28 @@ const PixelProcessor::State PixelProcessor::update(const vk::GraphicsState &pipe
 		}
 	}
 
+	// Tiles can be rejected when fragments failing the depth test have no other effect,
+	// and the depth test can only pass for fragments on one side of the tile's depth bounds.
+	if(state.depthTestActive && !state.stencilActive)
+	{
+		bool monotonicCompare = state.depthCompareMode == VK_COMPARE_OP_LESS ||
+		                        state.depthCompareMode == VK_COMPARE_OP_LESS_OR_EQUAL ||
+		                        state.depthCompareMode == VK_COMPARE_OP_EQUAL ||
+		                        state.depthCompareMode == VK_COMPARE_OP_GREATER_OR_EQUAL ||
+		                        state.depthCompareMode == VK_COMPARE_OP_GREATER;
+		bool fragmentSideEffects = fragmentShader && (fragmentShader->containsImageWrite() || fragmentShader->containsBufferWrite());
+		bool depthReplacing = fragmentShader && fragmentShader->getExecutionModes().DepthReplacing;
+
+		state.hiZTestActive = monotonicCompare && !fragmentSideEffects && !depthReplacing;
+	}
+
 	state.occlusionEnabled = occlusionEnabled;
 
 	bool fragmentContainsDiscard = (fragmentShader && fragmentShader->getAnalysis().ContainsDiscard);
 	for(uint32_t location = 0; location < MAX_COLOR_BUFFERS; location++)
 	{
 		state.colorFormat[location] = attachments.colorFormat(location);
+		state.colorQuadLayout[location] = attachments.colorQuadLayout(location);
 
 		state.colorWriteMask |= fragmentOutputInterfaceState.colorWriteActive(location, attachments) << (4 * location);
 		state.blendState[location] = fragmentOutputInterfaceState.getBlendState(location, attachments, fragmentContainsDiscard);
@@ -186,23 +199,36 @@ const PixelProcessor::State PixelProcessor::update(const vk::GraphicsState &pipe
 	return state;
 }
 
+PixelProcessor::RoutineType PixelProcessor::routine(const State &state, const RoutineType &precompiled)
+{
+	return routineCache->getOrCreate(state, [&] {
+		return precompiled;
+	});
+}
+
 PixelProcessor::RoutineType PixelProcessor::routine(const State &state,
                                                     const vk::PipelineLayout *pipelineLayout,
                                                     const SpirvShader *pixelShader,
                                                     const vk::Attachments &attachments,
                                                     const vk::DescriptorSet::Bindings &descriptorSets)
 {
-	auto routine = routineCache->lookup(state);
+	return routineCache->getOrCreate(state, [&] {
+		return generate(state, pipelineLayout, pixelShader, attachments, descriptorSets);
+	});
+}
 
-	if(!routine)
-	{
-		QuadRasterizer *generator = new PixelProgram(state, pipelineLayout, pixelShader, attachments, descriptorSets);
-		generator->generate();
-		routine = (*generator)("PixelRoutine_%0.8X", state.shaderID);
-		delete generator;
+PixelProcessor::RoutineType PixelProcessor::generate(const State &state,
+                                                     const vk::PipelineLayout *pipelineLayout,
+                                                     const SpirvShader *pixelShader,
+                                                     const vk::Attachments &attachments,
+                                                     const vk::DescriptorSet::Bindings &descriptorSets)
+{
+	ScopedPragma optimizationPasses(OptimizationPasses, static_cast<int>(getConfiguration().pixelOptimization));
 
-		routineCache->add(state, routine);
-	}
+	QuadRasterizer *generator = new PixelProgram(state, pipelineLayout, pixelShader, attachments, descriptorSets);
+	generator->generate();
+	auto routine = (*generator)("PixelRoutine_%0.8X", state.shaderID);
+	delete generator;
 
 	return routine;
 }
@@ -28,7 +28,7 @@ struct DrawData;
 struct Primitive;
 class SpirvShader;
 
-using RasterizerFunction = FunctionT<void(const vk::Device *device, const Primitive *primitive, int count, int cluster, int clusterCount, DrawData *draw)>;
+using RasterizerFunction = FunctionT<void(const vk::Device *device, const Primitive *primitives, const int *primitiveIndices, int count, int cluster, int clusterCount, DrawData *draw)>;
 
 class PixelProcessor
 {
@@ -81,6 +81,7 @@ public:
 		StencilOpState backStencil;
 
 		bool depthTestActive;
+		bool hiZTestActive;  // Reject tiles whose depth the primitive can't pass
 		bool depthBoundsTestActive;
 		bool occlusionEnabled;
 		bool perspective;
@@ -89,6 +90,7 @@ public:
 
 		unsigned int colorWriteMask;
 		vk::Format colorFormat[MAX_COLOR_BUFFERS];
+		bool colorQuadLayout[MAX_COLOR_BUFFERS];
 		unsigned int multiSampleCount;
 		unsigned int multiSampleMask;
 		bool enableMultiSampling;
@@ -100,6 +102,7 @@ public:
 		float maxDepthBounds;
 		VkFrontFace frontFace;
 		vk::Format depthFormat;
+		bool depthQuadLayout;
 		bool depthBias;
 		bool depthClamp;
 
@@ -159,21 +162,25 @@ public:
 public:
 	using RoutineType = RasterizerFunction::RoutineType;
 
-	PixelProcessor();
-
 	void setBlendConstant(const float4 &blendConstant);
 
-	const State update(const vk::GraphicsState &pipelineState, const sw::SpirvShader *fragmentShader, const sw::SpirvShader *vertexShader, const vk::Attachments &attachments, bool occlusionEnabled) const;
+	static const State update(const vk::GraphicsState &pipelineState, const sw::SpirvShader *fragmentShader, const sw::SpirvShader *vertexShader, const vk::Attachments &attachments, bool occlusionEnabled);
 	RoutineType routine(const State &state, const vk::PipelineLayout *pipelineLayout,
 	                    const SpirvShader *pixelShader, const vk::Attachments &attachments, const vk::DescriptorSet::Bindings &descriptorSets);
-	void setRoutineCacheSize(int routineCacheSize);
+	static RoutineType generate(const State &state, const vk::PipelineLayout *pipelineLayout,
+	                            const SpirvShader *pixelShader, const vk::Attachments &attachments, const vk::DescriptorSet::Bindings &descriptorSets);
+
+	// Returns the cached routine for the state, or adds the precompiled one.
+	RoutineType routine(const State &state, const RoutineType &precompiled);
+
+	using RoutineCacheType = ConcurrentRoutineCache<State, RasterizerFunction::CFunctionType>;
+	void setRoutineCache(RoutineCacheType *cache);
 
 	// Other semi-constants
 	Factor factor;
 
 private:
-	using RoutineCacheType = RoutineCache<State, RasterizerFunction::CFunctionType>;
-	std::unique_ptr<RoutineCacheType> routineCache;
+	RoutineCacheType *routineCache = nullptr;
 };
 
 }  // namespace sw
@@ -39,6 +39,10 @@ struct Primitive
 	int yMin;
 	int yMax;
 
+	// Conservative horizontal extent, used for binning into screen tiles
+	int xMin;
+	int xMax;
+
 	float x0;
 	float y0;
 
@@ -62,11 +66,11 @@ struct Primitive
 		unsigned short right;
 	};
 
-	// The rasterizer adds a zero length span to the top and bottom of the polygon to allow
-	// for 2x2 pixel processing. We need an even number of spans to keep accesses aligned.
-	Span outlineUnderflow[2];
-	Span outline[OUTLINE_RESOLUTION];
-	Span outlineOverflow[2];
+	// Left and right edge of each row, starting at row DrawData::outlineFirstRow. The storage
+	// is owned by the batch and only covers the rows of the scissor rectangle. The rasterizer
+	// adds a zero length span to the top and bottom of the polygon to allow for 2x2 pixel
+	// processing, so one extra row is addressable on each side. Even rows are 8-byte aligned.
+	Span *outline;
 };
 
 }  // namespace sw
@@ -21,6 +21,8 @@
 #include "System/Math.hpp"
 #include "Vulkan/VkDevice.hpp"
 
+#include <cmath>
+
 namespace sw {
 
 QuadRasterizer::QuadRasterizer(const PixelProcessor::State &state, const SpirvShader *spirvShader)
@@ -38,25 +40,63 @@ void QuadRasterizer::generate()
 	constants = device + OFFSET(vk::Device, constants);
 	occlusion = 0;
 
+	// Position of this cluster's tiles within the repeating grid of tiles (see TileSizeLog2).
+	Int clusterCountLog2 = 31 - Ctlz(UInt(clusterCount), false);
+	Int columnsLog2 = (clusterCountLog2 + 1) >> 1;  // TileGridColumnsLog2()
+	Int columns = Int(1) << columnsLog2;
+	Int rows = clusterCount >> columnsLog2;
+	Int clusterX = cluster & (columns - 1);
+	Int clusterY = cluster >> columnsLog2;
+
+	Int index = 0;
+
 	Do
 	{
+		primitive = primitives + *Pointer<Int>(primitiveIndices + index * sizeof(int)) * Int(sizeof(Primitive) * state.multiSampleCount);
+
+		Int xMin = *Pointer<Int>(primitive + OFFSET(Primitive, xMin));
+		Int xMax = *Pointer<Int>(primitive + OFFSET(Primitive, xMax));
 		Int yMin = *Pointer<Int>(primitive + OFFSET(Primitive, yMin));
 		Int yMax = *Pointer<Int>(primitive + OFFSET(Primitive, yMax));
 
-		Int cluster2 = cluster + cluster;
-		yMin += clusterCount * 2 - 2 - cluster2;
-		yMin &= -clusterCount * 2;
-		yMin += cluster2;
+		// Visit the tiles owned by this cluster which overlap the primitive, one at a time.
+		Int tileY = yMin >> TileSizeLog2;
+		tileY += (clusterY - tileY) & (rows - 1);
 
-		If(yMin < yMax)
+		For(, (tileY << TileSizeLog2) < yMax, tileY += rows)
 		{
-			rasterize(yMin, yMax);
+			Int y0 = Max(tileY << TileSizeLog2, yMin & -2);
+			Int y1 = Min((tileY + 1) << TileSizeLog2, yMax);
+
+			Int tileX = xMin >> TileSizeLog2;
+			tileX += (clusterX - tileX) & (columns - 1);
+
+			For(, (tileX << TileSizeLog2) < xMax, tileX += columns)
+			{
+				Int x0 = tileX << TileSizeLog2;
+				Int x1 = (tileX + 1) << TileSizeLog2;
+
+				if(hiZActive())
+				{
+					Pointer<Byte> hiZTile = *Pointer<Pointer<Byte>>(data + OFFSET(DrawData, hiZBuffer)) +
+					                        (tileY * *Pointer<Int>(data + OFFSET(DrawData, hiZPitch)) + tileX) * Int(sizeof(HiZTile));
+
+					If(hiZTest(hiZTile, tileX, tileY))
+					{
+						rasterize(y0, y1, x0, x1);
+						hiZUpdate(hiZTile, tileX, tileY);
+					}
+				}
+				else
+				{
+					rasterize(y0, y1, x0, x1);
+				}
+			}
 		}
 
-		primitive += sizeof(Primitive) * state.multiSampleCount;
-		count--;
+		index++;
 	}
-	Until(count == 0);
+	Until(index == count);
 
 	if(state.occlusionEnabled)
 	{
@@ -68,13 +108,18 @@ void QuadRasterizer::generate()
 	Return();
 }
 
-void QuadRasterizer::rasterize(Int &yMin, Int &yMax)
+void QuadRasterizer::rasterize(Int &yMin, Int &yMax, Int &tileX0, Int &tileX1)
 {
 	Pointer<Byte> cBuffer[MAX_COLOR_BUFFERS];
 	Pointer<Byte> zBuffer;
 	Pointer<Byte> sBuffer;
+	Pointer<Byte> outline[4];
 
-	Int clusterCountLog2 = 31 - Ctlz(UInt(clusterCount), false);
+	for(unsigned int q = 0; q < state.multiSampleCount; q++)
+	{
+		outline[q] = *Pointer<Pointer<Byte>>(primitive + q * sizeof(Primitive) + OFFSET(Primitive, outline));
+		outline[q] -= *Pointer<Int>(data + OFFSET(DrawData, outlineFirstRow)) * Int(sizeof(Primitive::Span));  // Index by absolute row
+	}
 
 	for(int index = 0; index < MAX_COLOR_BUFFERS; index++)
 	{
@@ -98,30 +143,33 @@ void QuadRasterizer::rasterize(Int &yMin, Int &yMax)
 
 	Do
 	{
-		Int x0a = Int(*Pointer<Short>(primitive + OFFSET(Primitive, outline->left) + (y + 0) * sizeof(Primitive::Span)));
-		Int x0b = Int(*Pointer<Short>(primitive + OFFSET(Primitive, outline->left) + (y + 1) * sizeof(Primitive::Span)));
+		Int x0a = Int(*Pointer<Short>(outline[0] + OFFSET(Primitive::Span, left) + (y + 0) * sizeof(Primitive::Span)));
+		Int x0b = Int(*Pointer<Short>(outline[0] + OFFSET(Primitive::Span, left) + (y + 1) * sizeof(Primitive::Span)));
 		Int x0 = Min(x0a, x0b);
 
 		for(unsigned int q = 1; q < state.multiSampleCount; q++)
 		{
-			x0a = Int(*Pointer<Short>(primitive + q * sizeof(Primitive) + OFFSET(Primitive, outline->left) + (y + 0) * sizeof(Primitive::Span)));
-			x0b = Int(*Pointer<Short>(primitive + q * sizeof(Primitive) + OFFSET(Primitive, outline->left) + (y + 1) * sizeof(Primitive::Span)));
+			x0a = Int(*Pointer<Short>(outline[q] + OFFSET(Primitive::Span, left) + (y + 0) * sizeof(Primitive::Span)));
+			x0b = Int(*Pointer<Short>(outline[q] + OFFSET(Primitive::Span, left) + (y + 1) * sizeof(Primitive::Span)));
 			x0 = Min(x0, Min(x0a, x0b));
 		}
 
 		x0 &= 0xFFFFFFFE;
+		x0 = Max(x0, tileX0);
 
-		Int x1a = Int(*Pointer<Short>(primitive + OFFSET(Primitive, outline->right) + (y + 0) * sizeof(Primitive::Span)));
-		Int x1b = Int(*Pointer<Short>(primitive + OFFSET(Primitive, outline->right) + (y + 1) * sizeof(Primitive::Span)));
+		Int x1a = Int(*Pointer<Short>(outline[0] + OFFSET(Primitive::Span, right) + (y + 0) * sizeof(Primitive::Span)));
+		Int x1b = Int(*Pointer<Short>(outline[0] + OFFSET(Primitive::Span, right) + (y + 1) * sizeof(Primitive::Span)));
 		Int x1 = Max(x1a, x1b);
 
 		for(unsigned int q = 1; q < state.multiSampleCount; q++)
 		{
-			x1a = Int(*Pointer<Short>(primitive + q * sizeof(Primitive) + OFFSET(Primitive, outline->right) + (y + 0) * sizeof(Primitive::Span)));
-			x1b = Int(*Pointer<Short>(primitive + q * sizeof(Primitive) + OFFSET(Primitive, outline->right) + (y + 1) * sizeof(Primitive::Span)));
+			x1a = Int(*Pointer<Short>(outline[q] + OFFSET(Primitive::Span, right) + (y + 0) * sizeof(Primitive::Span)));
+			x1b = Int(*Pointer<Short>(outline[q] + OFFSET(Primitive::Span, right) + (y + 1) * sizeof(Primitive::Span)));
 			x1 = Max(x1, Max(x1a, x1b));
 		}
 
+		x1 = Min(x1, tileX1);
+
 		// Compute the y coordinate of each fragment in the SIMD group.
 		const auto yMorton = SIMD::Float([](int i) { return float(compactEvenBits(i >> 1)); });  // 0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 3, 3, 2, 2, 3, 3, ...
 		yFragment = SIMD::Float(Float(y)) + yMorton - SIMD::Float(*Pointer<Float>(primitive + OFFSET(Primitive, y0)));
@@ -183,7 +231,7 @@ void QuadRasterizer::rasterize(Int &yMin, Int &yMax)
 
 			for(unsigned int q = 0; q < state.multiSampleCount; q++)
 			{
-				xLeft[q] = *Pointer<Short4>(primitive + q * sizeof(Primitive) + OFFSET(Primitive, outline) + y * sizeof(Primitive::Span));
+				xLeft[q] = *Pointer<Short4>(outline[q] + y * sizeof(Primitive::Span));
 				xRight[q] = xLeft[q];
 
 				xLeft[q] = Swizzle(xLeft[q], 0x0022) - Short4(1, 2, 1, 2);
@@ -213,21 +261,21 @@ void QuadRasterizer::rasterize(Int &yMin, Int &yMax)
 		{
 			if(state.colorWriteActive(index))
 			{
-				cBuffer[index] += *Pointer<Int>(data + OFFSET(DrawData, colorPitchB[index])) << (1 + clusterCountLog2);  // FIXME: Precompute
+				cBuffer[index] += *Pointer<Int>(data + OFFSET(DrawData, colorPitchB[index])) << 1;
 			}
 		}
 
 		if(state.depthTestActive || state.depthBoundsTestActive)
 		{
-			zBuffer += *Pointer<Int>(data + OFFSET(DrawData, depthPitchB)) << (1 + clusterCountLog2);  // FIXME: Precompute
+			zBuffer += *Pointer<Int>(data + OFFSET(DrawData, depthPitchB)) << 1;
 		}
 
 		if(state.stencilActive)
 		{
-			sBuffer += *Pointer<Int>(data + OFFSET(DrawData, stencilPitchB)) << (1 + clusterCountLog2);  // FIXME: Precompute
+			sBuffer += *Pointer<Int>(data + OFFSET(DrawData, stencilPitchB)) << 1;
 		}
 
-		y += 2 * clusterCount;
+		y += 2;
 	}
 	Until(y >= yMax);
 }
@@ -249,6 +297,197 @@ SIMD::Float QuadRasterizer::interpolate(SIMD::Float &x, SIMD::Float &D, SIMD::Fl
 	return interpolant;
 }
 
+bool QuadRasterizer::hiZActive() const
+{
+	return state.hiZTestActive || state.depthWriteEnable;
+}
+
+// Returns false if none of the primitive's fragments within the tile can pass the depth test.
+Bool QuadRasterizer::hiZTest(const Pointer<Byte> &hiZTile, const Int &tileX, const Int &tileY)
+{
+	if(!state.hiZTestActive)
+	{
+		return true;
+	}
+
+	// Recompute the bounds if they are unknown, or if they were widened by a previous draw.
+	// Within a draw the loose bounds are kept, to compute them at most once per draw.
+	Int tileState = *Pointer<Int>(hiZTile + OFFSET(HiZTile, state));
+	If(tileState != HiZTile::Exact && tileState != *Pointer<Int>(data + OFFSET(DrawData, hiZDrawID)))
+	{
+		Float tileMinZ;
+		Float tileMaxZ;
+		tileDepthBounds(tileX, tileY, tileMinZ, tileMaxZ);
+
+		*Pointer<Float>(hiZTile + OFFSET(HiZTile, minZ)) = tileMinZ;
+		*Pointer<Float>(hiZTile + OFFSET(HiZTile, maxZ)) = tileMaxZ;
+		*Pointer<Int>(hiZTile + OFFSET(HiZTile, state)) = HiZTile::Exact;
+	}
+
+	Float minZ = *Pointer<Float>(hiZTile + OFFSET(HiZTile, minZ));
+	Float maxZ = *Pointer<Float>(hiZTile + OFFSET(HiZTile, maxZ));
+
+	Float zMin;
+	Float zMax;
+	primitiveDepthBounds(tileX, tileY, zMin, zMax);
+
+	// Negated comparisons to pass NaN, like the per-fragment depth test.
+	switch(state.depthCompareMode)
+	{
+	case VK_COMPARE_OP_LESS:
+		return !(maxZ <= zMin);
+	case VK_COMPARE_OP_LESS_OR_EQUAL:
+		return !(maxZ < zMin);
+	case VK_COMPARE_OP_EQUAL:
+		return !(maxZ < zMin) && !(zMax < minZ);
+	case VK_COMPARE_OP_GREATER_OR_EQUAL:
+		return !(zMax < minZ);
+	case VK_COMPARE_OP_GREATER:
+		return !(zMax <= minZ);
+	default:
+		UNSUPPORTED("VkCompareOp: %d", int(state.depthCompareMode));
+		return true;
+	}
+}
+
+// Keeps the depth bounds of the tile valid after the primitive was rasterized.
+void QuadRasterizer::hiZUpdate(const Pointer<Byte> &hiZTile, const Int &tileX, const Int &tileY)
+{
+	if(!state.depthWriteEnable || state.depthCompareMode == VK_COMPARE_OP_NEVER || state.depthCompareMode == VK_COMPARE_OP_EQUAL)
+	{
+		return;  // Depth values are unchanged.
+	}
+
+	if(spirvShader && spirvShader->getExecutionModes().DepthReplacing)
+	{
+		*Pointer<Int>(hiZTile + OFFSET(HiZTile, state)) = HiZTile::Unknown;
+		return;
+	}
+
+	// The written depth lies within the primitive's bounds, so widening the
+	// tile's bounds to include them keeps them valid, if possibly loose.
+	Int tileState = *Pointer<Int>(hiZTile + OFFSET(HiZTile, state));
+	If(tileState != HiZTile::Unknown)
+	{
+		Float zMin;
+		Float zMax;
+		primitiveDepthBounds(tileX, tileY, zMin, zMax);
+
+		Pointer<Float> minZ = hiZTile + OFFSET(HiZTile, minZ);
+		Pointer<Float> maxZ = hiZTile + OFFSET(HiZTile, maxZ);
+		*minZ = Min(*minZ, zMin);
+		*maxZ = Max(*maxZ, zMax);
+		*Pointer<Int>(hiZTile + OFFSET(HiZTile, state)) = *Pointer<Int>(data + OFFSET(DrawData, hiZDrawID));
+	}
+}
+
+// Computes the depth range of the primitive's plane over the tile. The tile is widened
+// by a pixel on each side to account for the sample locations.
+void QuadRasterizer::primitiveDepthBounds(const Int &tileX, const Int &tileY, Float &zMin, Float &zMax)
+{
+	Float A = *Pointer<Float>(primitive + OFFSET(Primitive, z.A));
+	Float B = *Pointer<Float>(primitive + OFFSET(Primitive, z.B));
+	Float C = *Pointer<Float>(primitive + OFFSET(Primitive, z.C));
+	Float x0 = Float(tileX << TileSizeLog2) - *Pointer<Float>(primitive + OFFSET(Primitive, x0));
+	Float y0 = Float(tileY << TileSizeLog2) - *Pointer<Float>(primitive + OFFSET(Primitive, y0));
+	Float Ax0 = A * (x0 - 1.0f);
+	Float Ax1 = A * (x0 + float(1 << TileSizeLog2));
+	Float By0 = B * (y0 - 1.0f);
+	Float By1 = B * (y0 + float(1 << TileSizeLog2));
+
+	zMin = C + Min(Ax0, Ax1) + Min(By0, By1);
+	zMax = C + Max(Ax0, Ax1) + Max(By0, By1);
+
+	// Tolerate the rounding differences with the per-fragment interpolation.
+	Float tolerance = (Abs(C) + Max(Abs(Ax0), Abs(Ax1)) + Max(Abs(By0), Abs(By1)) + 1.0f) * 1.0e-5f;
+	zMin -= tolerance;
+	zMax += tolerance;
+
+	if(state.depthBias)
+	{
+		Float zBias = *Pointer<Float>(primitive + OFFSET(Primitive, zBias));
+		zMin += zBias;
+		zMax += zBias;
+	}
+
+	if(state.depthClamp)
+	{
+		zMin = Min(Max(zMin, state.minDepthClamp), state.maxDepthClamp);
+		zMax = Min(Max(zMax, state.minDepthClamp), state.maxDepthClamp);
+	}
+
+	if(state.depthFormat == VK_FORMAT_D16_UNORM)
+	{
+		zMin = Min(Max(Round(zMin * 65535.0f), 0.0f), 65535.0f);
+		zMax = Min(Max(Round(zMax * 65535.0f), 0.0f), 65535.0f);
+	}
+}
+
+// Computes the smallest and largest depth stored in the tile.
+void QuadRasterizer::tileDepthBounds(const Int &tileX, const Int &tileY, Float &minZ, Float &maxZ)
+{
+	Pointer<Byte> buffer = *Pointer<Pointer<Byte>>(data + OFFSET(DrawData, depthBuffer));
+	Int pitch = *Pointer<Int>(data + OFFSET(DrawData, depthPitchB));
+	Int slice = *Pointer<Int>(data + OFFSET(DrawData, depthSliceB));
+
+	Int x0 = tileX << TileSizeLog2;
+	Int y0 = tileY << TileSizeLog2;
+	Int x1 = Min(x0 + (1 << TileSizeLog2), *Pointer<Int>(data + OFFSET(DrawData, hiZWidth)));
+	Int y1 = Min(y0 + (1 << TileSizeLog2), *Pointer<Int>(data + OFFSET(DrawData, hiZHeight)));
+
+	minZ = INFINITY;
+	maxZ = -INFINITY;
+
+	for(unsigned int q = 0; q < state.multiSampleCount; q++)
+	{
+		For(Int y = y0, y < y1, y++)
+		{
+			Pointer<Byte> row = buffer + q * slice;
+			if(state.depthQuadLayout)
+			{
+				row += (y & -2) * pitch;
+			}
+			else
+			{
+				row += y * pitch;
+			}
+
+			For(Int x = x0, x < x1, x++)
+			{
+				Int texel = x;
+				if(state.depthQuadLayout)
+				{
+					texel = (x & -2) * 2 + (y & 1) * 2 + (x & 1);
+				}
+
+				Float zLow;
+				Float zHigh;
+
+				switch(state.depthFormat)
+				{
+				case VK_FORMAT_D16_UNORM:
+					zLow = Float(Int(*Pointer<UShort>(row + 2 * texel)));
+					zHigh = zLow;
+					break;
+				case VK_FORMAT_D32_SFLOAT:
+				case VK_FORMAT_D32_SFLOAT_S8_UINT:
+					zLow = *Pointer<Float>(row + 4 * texel);
+					zHigh = zLow;
+					// NaN passes the depth test, so it mustn't narrow either bound.
+					zLow = IfThenElse(zLow == zLow, zLow, Float(-INFINITY));
+					zHigh = IfThenElse(zHigh == zHigh, zHigh, Float(INFINITY));
+					break;
+				default:
+					UNSUPPORTED("Depth format: %d", int(state.depthFormat));
+				}
+
+				minZ = Min(minZ, zLow);
+				maxZ = Max(maxZ, zHigh);
+			}
+		}
+	}
+}
+
 bool QuadRasterizer::interpolateZ() const
 {
 	return state.depthTestActive || (spirvShader && spirvShader->hasBuiltinInput(spv::BuiltInFragCoord));
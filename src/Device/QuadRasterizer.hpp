@@ -58,7 +58,13 @@ protected:
 	const SpirvShader *const spirvShader;
 
 private:
-	void rasterize(Int &yMin, Int &yMax);
+	void rasterize(Int &yMin, Int &yMax, Int &tileX0, Int &tileX1);
+
+	bool hiZActive() const;
+	Bool hiZTest(const Pointer<Byte> &hiZTile, const Int &tileX, const Int &tileY);
+	void hiZUpdate(const Pointer<Byte> &hiZTile, const Int &tileX, const Int &tileY);
+	void primitiveDepthBounds(const Int &tileX, const Int &tileY, Float &zMin, Float &zMax);
+	void tileDepthBounds(const Int &tileX, const Int &tileY, Float &minZ, Float &maxZ);
 };
 
 }  // namespace sw
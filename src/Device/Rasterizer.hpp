@@ -25,17 +25,20 @@ class Rasterizer : public RasterizerFunction
 public:
 	Rasterizer()
 	    : device(Arg<0>())
-	    , primitive(Arg<1>())
-	    , count(Arg<2>())
-	    , cluster(Arg<3>())
-	    , clusterCount(Arg<4>())
-	    , data(Arg<5>())
+	    , primitives(Arg<1>())
+	    , primitiveIndices(Arg<2>())
+	    , count(Arg<3>())
+	    , cluster(Arg<4>())
+	    , clusterCount(Arg<5>())
+	    , data(Arg<6>())
 	{}
 	virtual ~Rasterizer() {}
 
 protected:
 	Pointer<Byte> device;
-	Pointer<Byte> primitive;
+	Pointer<Byte> primitives;
+	Pointer<Byte> primitiveIndices;
+	Pointer<Byte> primitive;  // Primitive currently being rasterized
 	Int count;
 	Int cluster;
 	Int clusterCount;
@@ -25,6 +25,7 @@
 #include "System/Half.hpp"
 #include "System/Math.hpp"
 #include "System/Memory.hpp"
+#include "System/SwiftConfig.hpp"
 #include "System/Timer.hpp"
 #include "Vulkan/VkConfig.hpp"
 #include "Vulkan/VkDescriptorSet.hpp"
@@ -38,6 +39,8 @@
 #include "marl/defer.h"
 #include "marl/trace.h"
 
+#include <algorithm>
+
 #undef max
 
 #ifndef NDEBUG
@@ -155,12 +158,75 @@ DrawCall::~DrawCall()
 	sw::freeMemory(data);
 }
 
+std::shared_ptr<PrecompiledRoutines> PrecompiledRoutines::Compile(vk::Device *device, const vk::GraphicsPipeline *pipeline, const vk::Attachments &attachments)
+{
+	MARL_SCOPED_EVENT("PrecompiledRoutines::Compile");
+
+	const vk::GraphicsState &pipelineState = pipeline->getState();
+	const vk::PreRasterizationState &preRasterizationState = pipelineState.getPreRasterizationState();
+
+	const sw::SpirvShader *fragmentShader = pipeline->getShader(VK_SHADER_STAGE_FRAGMENT_BIT).get();
+	const sw::SpirvShader *vertexShader = pipeline->getShader(VK_SHADER_STAGE_VERTEX_BIT).get();
+
+	// The descriptor sets are only accessed through DrawData when the routines run.
+	const vk::DescriptorSet::Bindings descriptorSets = {};
+
+	RoutineCaches *routineCaches = device->getRoutineCaches();
+	auto routines = std::make_shared<PrecompiledRoutines>();
+
+	routines->vertexState = VertexProcessor::update(pipelineState, vertexShader, pipeline->getInputs());
+	routines->vertexRoutine = routineCaches->vertex.getOrCreate(routines->vertexState, [&] {
+		return VertexProcessor::generate(routines->vertexState, preRasterizationState.getPipelineLayout(), vertexShader, descriptorSets);
+	});
+
+	if(!preRasterizationState.hasRasterizerDiscard())
+	{
+		const vk::FragmentState &fragmentState = pipelineState.getFragmentState();
+
+		routines->setupState = SetupProcessor::update(pipelineState, fragmentShader, vertexShader, attachments);
+		routines->setupRoutine = routineCaches->setup.getOrCreate(routines->setupState, [&] {
+			return SetupProcessor::generate(routines->setupState);
+		});
+
+		routines->pixelState = PixelProcessor::update(pipelineState, fragmentShader, vertexShader, attachments, false);
+		routines->pixelRoutine = routineCaches->pixel.getOrCreate(routines->pixelState, [&] {
+			return PixelProcessor::generate(routines->pixelState, fragmentState.getPipelineLayout(), fragmentShader, attachments, descriptorSets);
+		});
+	}
+
+	return routines;
+}
+
+namespace {
+
+int workerThreadCount(const vk::Device *device)
+{
+	return std::max(device->getScheduler()->config().workerThread.count, 1);
+}
+
+int clusterCountFor(int workerCount)
+{
+	int clusterCount = MinClusterCount;
+	while(clusterCount < workerCount && clusterCount < MaxClusterCount)
+	{
+		clusterCount <<= 1;
+	}
+
+	return clusterCount;
+}
+
+}  // anonymous namespace
+
 Renderer::Renderer(vk::Device *device)
-    : device(device)
+    : clusterCount(clusterCountFor(workerThreadCount(device)))
+    , batchDataPool(&device->getBatchDataPool()->pool)
+    , clusterQueues(clusterCount)
+    , device(device)
 {
-	vertexProcessor.setRoutineCacheSize(1024);
-	pixelProcessor.setRoutineCacheSize(1024);
-	setupProcessor.setRoutineCacheSize(1024);
+	RoutineCaches *routineCaches = device->getRoutineCaches();
+	vertexProcessor.setRoutineCache(&routineCaches->vertex);
+	pixelProcessor.setRoutineCache(&routineCaches->pixel);
+	setupProcessor.setRoutineCache(&routineCaches->setup);
 }
 
 Renderer::~Renderer()
@@ -181,10 +247,10 @@ void Renderer::operator delete(void *mem)
 }
 
 void Renderer::draw(const vk::GraphicsPipeline *pipeline, const vk::DynamicState &dynamicState, unsigned int count, int baseVertex,
-                    CountedEvent *events, int instanceID, int layer, void *indexBuffer, const VkRect2D &renderArea,
+                    CountedEvent *events, int firstInstance, unsigned int instanceCount, int layer, void *indexBuffer, const VkRect2D &renderArea,
                     const vk::Pipeline::PushConstantStorage &pushConstants, bool update)
 {
-	if(count == 0) { return; }
+	if(count == 0 || instanceCount == 0) { return; }
 
 	auto id = nextDrawID++;
 	MARL_SCOPED_EVENT("draw %d", id);
@@ -231,16 +297,39 @@ void Renderer::draw(const vk::GraphicsPipeline *pipeline, const vk::DynamicState
 
 		const vk::Attachments attachments = pipeline->getAttachments();
 
+		const PrecompiledRoutines *precompiled = pipeline->getPrecompiledRoutines();
+
 		vertexState = vertexProcessor.update(pipelineState, vertexShader, inputs);
-		vertexRoutine = vertexProcessor.routine(vertexState, preRasterizationState.getPipelineLayout(), vertexShader, inputs.getDescriptorSets());
+		if(precompiled && precompiled->vertexRoutine && (vertexState == precompiled->vertexState))
+		{
+			vertexRoutine = vertexProcessor.routine(vertexState, precompiled->vertexRoutine);
+		}
+		else
+		{
+			vertexRoutine = vertexProcessor.routine(vertexState, preRasterizationState.getPipelineLayout(), vertexShader, inputs.getDescriptorSets());
+		}
 
 		if(!hasRasterizerDiscard)
 		{
 			setupState = setupProcessor.update(pipelineState, fragmentShader, vertexShader, attachments);
-			setupRoutine = setupProcessor.routine(setupState);
+			if(precompiled && precompiled->setupRoutine && (setupState == precompiled->setupState))
+			{
+				setupRoutine = setupProcessor.routine(setupState, precompiled->setupRoutine);
+			}
+			else
+			{
+				setupRoutine = setupProcessor.routine(setupState);
+			}
 
 			pixelState = pixelProcessor.update(pipelineState, fragmentShader, vertexShader, attachments, hasOcclusionQuery());
-			pixelRoutine = pixelProcessor.routine(pixelState, fragmentState->getPipelineLayout(), fragmentShader, attachments, inputs.getDescriptorSets());
+			if(precompiled && precompiled->pixelRoutine && (pixelState == precompiled->pixelState))
+			{
+				pixelRoutine = pixelProcessor.routine(pixelState, precompiled->pixelRoutine);
+			}
+			else
+			{
+				pixelRoutine = pixelProcessor.routine(pixelState, fragmentState->getPipelineLayout(), fragmentShader, attachments, inputs.getDescriptorSets());
+			}
 		}
 	}
 
@@ -256,10 +345,13 @@ void Renderer::draw(const vk::GraphicsPipeline *pipeline, const vk::DynamicState
 
 	DrawData *data = draw->data;
 	draw->occlusionQuery = occlusionQuery;
-	draw->batchDataPool = &batchDataPool;
+	draw->batchDataPool = batchDataPool;
+	draw->clusterCount = clusterCount;
 	draw->numPrimitives = count;
 	draw->numPrimitivesPerBatch = numPrimitivesPerBatch;
-	draw->numBatches = (count + draw->numPrimitivesPerBatch - 1) / draw->numPrimitivesPerBatch;
+	draw->numBatchesPerInstance = (count + draw->numPrimitivesPerBatch - 1) / draw->numPrimitivesPerBatch;
+	draw->numBatches = draw->numBatchesPerInstance * instanceCount;
+	draw->firstInstance = firstInstance;
 	draw->topology = vertexInputInterfaceState.getTopology();
 	draw->provokingVertexMode = preRasterizationState.getProvokingVertexMode();
 	draw->lineRasterizationMode = preRasterizationState.getLineRasterizationMode();
@@ -279,16 +371,18 @@ void Renderer::draw(const vk::GraphicsPipeline *pipeline, const vk::DynamicState
 		data->input[i] = stream.buffer;
 		data->robustnessSize[i] = stream.robustnessSize;
 		data->stride[i] = inputs.getVertexStride(i);
+		data->instanceStride[i] = inputs.getInstanceStride(i);
 	}
 
 	data->indices = indexBuffer;
 	data->layer = layer;
-	data->instanceID = instanceID;
 	data->baseVertex = baseVertex;
 	draw->indexType = indexBuffer ? pipeline->getIndexBuffer().getIndexType() : VK_INDEX_TYPE_UINT16;
 
 	draw->vertexRoutine = vertexRoutine;
 
+	trackDraw(draw.get(), pipeline, hasRasterizerDiscard ? nullptr : fragmentState->getPipelineLayout());
+
 	vk::DescriptorSet::PrepareForSampling(draw->descriptorSetObjects, draw->preRasterizationPipelineLayout, device);
 
 	// Viewport
@@ -336,6 +430,10 @@ void Renderer::draw(const vk::GraphicsPipeline *pipeline, const vk::DynamicState
 		data->scissorX1 = clamp<int>(scissor.offset.x + scissor.extent.width, x0, x1);
 		data->scissorY0 = clamp<int>(scissor.offset.y, y0, y1);
 		data->scissorY1 = clamp<int>(scissor.offset.y + scissor.extent.height, y0, y1);
+
+		// Outlines only have to cover the rows of the scissor rectangle, plus the
+		// zero length spans above and below the polygon. Keep even rows 8-byte aligned.
+		data->outlineFirstRow = (data->scissorY0 & ~1) - 2;
 	}
 
 	if(!hasRasterizerDiscard)
@@ -410,7 +508,7 @@ void Renderer::draw(const vk::GraphicsPipeline *pipeline, const vk::DynamicState
 
 		if(pixelState.occlusionEnabled)
 		{
-			for(int cluster = 0; cluster < MaxClusterCount; cluster++)
+			for(int cluster = 0; cluster < clusterCount; cluster++)
 			{
 				data->occlusion[cluster] = 0;
 			}
@@ -461,6 +559,8 @@ void Renderer::draw(const vk::GraphicsPipeline *pipeline, const vk::DynamicState
 				data->depthBuffer = (float *)attachments.depthBuffer->getOffsetPointer({ 0, 0, 0 }, VK_IMAGE_ASPECT_DEPTH_BIT, 0, data->layer);
 				data->depthPitchB = attachments.depthBuffer->rowPitchBytes(VK_IMAGE_ASPECT_DEPTH_BIT, 0);
 				data->depthSliceB = attachments.depthBuffer->slicePitchBytes(VK_IMAGE_ASPECT_DEPTH_BIT, 0);
+
+				setupHiZ(attachments.depthBuffer, data, id);
 			}
 
 			if(draw->stencilBuffer)
@@ -484,7 +584,136 @@ void Renderer::draw(const vk::GraphicsPipeline *pipeline, const vk::DynamicState
 
 	draw->events = events;
 
-	DrawCall::run(device, draw, &drawTickets, clusterQueues);
+	DrawCall::run(device, draw, &drawTickets, clusterQueues.data());
+}
+
+void Renderer::trackDraw(DrawCall *draw, const vk::GraphicsPipeline *pipeline, const vk::PipelineLayout *fragmentPipelineLayout)
+{
+	trackedDraws.erase(std::remove_if(trackedDraws.begin(), trackedDraws.end(),
+	                                  [](const TrackedDraw &tracked) { return tracked.completed->isSignalled(); }),
+	                   trackedDraws.end());
+
+	// Barriers recorded before all the remaining draws no longer make anything visible.
+	int oldestEpoch = barrierEpoch;
+	for(auto &prior : trackedDraws)
+	{
+		oldestEpoch = std::min(oldestEpoch, prior.epoch);
+	}
+	while(!barriers.empty() && (barriers.front().epoch < oldestEpoch))
+	{
+		barriers.pop_front();
+	}
+
+	TrackedDraw tracked;
+	tracked.epoch = barrierEpoch;
+	tracked.completed = std::make_shared<marl::Event>(marl::Event::Mode::Manual);
+	tracked.writesMemory = pipeline->preRasterizationContainsImageWrite() ||
+	                       pipeline->fragmentContainsImageWrite() ||
+	                       pipeline->containsBufferWrite();
+	tracked.descriptorSetObjects = draw->descriptorSetObjects;
+	tracked.preRasterizationPipelineLayout = draw->preRasterizationPipelineLayout;
+	tracked.fragmentPipelineLayout = fragmentPipelineLayout;
+
+	if(fragmentPipelineLayout)  // Rasterization enabled
+	{
+		const vk::Attachments &attachments = pipeline->getAttachments();
+		for(auto *colorBuffer : attachments.colorBuffer)
+		{
+			if(colorBuffer)
+			{
+				tracked.attachments.push_back(colorBuffer->getImage());
+			}
+		}
+		if(attachments.depthBuffer)
+		{
+			tracked.attachments.push_back(attachments.depthBuffer->getImage());
+		}
+		if(attachments.stencilBuffer)
+		{
+			tracked.attachments.push_back(attachments.stencilBuffer->getImage());
+		}
+	}
+
+	// Only draws recorded before a barrier have to complete before this one starts.
+	for(auto &prior : trackedDraws)
+	{
+		if((prior.epoch < barrierEpoch) && dependsOn(tracked, prior))
+		{
+			MARL_SCOPED_EVENT("wait for draw dependency");
+			prior.completed->wait();
+		}
+	}
+
+	draw->completed = tracked.completed;
+	trackedDraws.push_back(std::move(tracked));
+}
+
+bool Renderer::dependsOn(TrackedDraw &draw, TrackedDraw &prior) const
+{
+	if(prior.completed->isSignalled())
+	{
+		return false;
+	}
+
+	// Writes other than to attachments can't be attributed to images cheaply.
+	if(draw.writesMemory || prior.writesMemory)
+	{
+		return true;
+	}
+
+	auto contains = [](const std::vector<const vk::Image *> &images, const vk::Image *image) {
+		return std::find(images.begin(), images.end(), image) != images.end();
+	};
+
+	// Reads of the prior draw's attachments. Only ordered when a subsequent barrier made them visible.
+	for(auto *image : prior.attachments)
+	{
+		if(isVisible(image, prior.epoch) && contains(draw.getDescriptorImages(), image))
+		{
+			return true;
+		}
+	}
+
+	// Attachment writes to images the prior draw reads. Writes to the same attachments
+	// are already ordered per cluster by the cluster tickets.
+	for(auto *image : draw.attachments)
+	{
+		if(contains(prior.getDescriptorImages(), image))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool Renderer::isVisible(const vk::Image *image, int epoch) const
+{
+	for(auto &barrier : barriers)
+	{
+		if((barrier.epoch >= epoch) &&
+		   (barrier.allImages || (std::find(barrier.images.begin(), barrier.images.end(), image) != barrier.images.end())))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+const std::vector<const vk::Image *> &Renderer::TrackedDraw::getDescriptorImages()
+{
+	if(!descriptorImagesCollected)
+	{
+		vk::DescriptorSet::GetImages(descriptorSetObjects, preRasterizationPipelineLayout, descriptorImages);
+		if(fragmentPipelineLayout && (fragmentPipelineLayout != preRasterizationPipelineLayout))
+		{
+			vk::DescriptorSet::GetImages(descriptorSetObjects, fragmentPipelineLayout, descriptorImages);
+		}
+		descriptorImagesCollected = true;
+	}
+
+	return descriptorImages;
 }
 
 void DrawCall::setup()
@@ -521,7 +750,7 @@ void DrawCall::teardown(vk::Device *device)
 	{
 		if(occlusionQuery != nullptr)
 		{
-			for(int cluster = 0; cluster < MaxClusterCount; cluster++)
+			for(int cluster = 0; cluster < clusterCount; cluster++)
 			{
 				occlusionQuery->add(data->occlusion[cluster]);
 			}
@@ -544,15 +773,20 @@ void DrawCall::teardown(vk::Device *device)
 			vk::DescriptorSet::ContentsChanged(descriptorSetObjects, fragmentPipelineLayout, device);
 		}
 	}
+
+	completed->signal();
+	completed = nullptr;
 }
 
-void DrawCall::run(vk::Device *device, const marl::Loan<DrawCall> &draw, marl::Ticket::Queue *tickets, marl::Ticket::Queue clusterQueues[MaxClusterCount])
+void DrawCall::run(vk::Device *device, const marl::Loan<DrawCall> &draw, marl::Ticket::Queue *tickets, marl::Ticket::Queue *clusterQueues)
 {
 	draw->setup();
 
 	const auto numPrimitives = draw->numPrimitives;
 	const auto numPrimitivesPerBatch = draw->numPrimitivesPerBatch;
+	const auto numBatchesPerInstance = draw->numBatchesPerInstance;
 	const auto numBatches = draw->numBatches;
+	const int clusterCount = draw->clusterCount;
 
 	auto ticket = tickets->take();
 	auto finally = marl::make_shared_finally([device, draw, ticket] {
@@ -561,41 +795,94 @@ void DrawCall::run(vk::Device *device, const marl::Loan<DrawCall> &draw, marl::T
 		ticket.done();
 	});
 
-	for(unsigned int batchId = 0; batchId < numBatches; batchId++)
+	// Indexed meshes typically reference each vertex several times, often far
+	// apart in the index buffer, which the direct mapped vertex cache handles
+	// poorly. Shade each of their unique vertices exactly once instead, across
+	// groups of consecutive batches processed by the same task.
+	static_assert(MinBatchCount > vk::QUEUE_COUNT_PER_FAMILY * (BatchGroup::MaxBatchCount - 1),
+	              "Queues borrowing the batches of a group must not exhaust the shared pool");
+	const bool deduplicate = draw->data->indices && (draw->topology != VK_PRIMITIVE_TOPOLOGY_POINT_LIST) &&
+	                         sw::getConfiguration().vertexDeduplication;
+	const unsigned int numBatchesPerGroup = deduplicate ? BatchGroup::MaxBatchCount : 1;
+
+	for(unsigned int groupId = 0; groupId < numBatches;)
 	{
-		auto batch = draw->batchDataPool->borrow();
-		batch->id = batchId;
-		batch->firstPrimitive = batch->id * numPrimitivesPerBatch;
-		batch->numPrimitives = std::min(batch->firstPrimitive + numPrimitivesPerBatch, numPrimitives) - batch->firstPrimitive;
+		// Groups don't span instances, whose vertices are shaded separately.
+		const unsigned int instanceEnd = (groupId / numBatchesPerInstance + 1) * numBatchesPerInstance;
+		const unsigned int groupEnd = std::min(groupId + numBatchesPerGroup, instanceEnd);
 
-		for(int cluster = 0; cluster < MaxClusterCount; cluster++)
+		std::array<marl::Loan<BatchData>, BatchGroup::MaxBatchCount> batches;
+		for(unsigned int batchId = groupId; batchId < groupEnd; batchId++)
 		{
-			batch->clusterTickets[cluster] = std::move(clusterQueues[cluster].take());
-		}
+			auto batch = draw->batchDataPool->borrow();
+			batch->id = batchId;
+			batch->instance = batchId / numBatchesPerInstance;
+			batch->firstPrimitive = (batchId % numBatchesPerInstance) * numPrimitivesPerBatch;
+			batch->numPrimitives = std::min(batch->firstPrimitive + numPrimitivesPerBatch, numPrimitives) - batch->firstPrimitive;
 
-		marl::schedule([device, draw, batch, finally] {
-			processVertices(device, draw.get(), batch.get());
+			if(batch->clusterTickets.size() != size_t(clusterCount))
+			{
+				batch->clusterTickets.resize(clusterCount);
+				batch->clusterPrimitives.resize(clusterCount * MaxBatchSize);
+				batch->clusterPrimitiveCount.resize(clusterCount);
+			}
 
-			if(!draw->data->rasterizerDiscard)
+			for(int cluster = 0; cluster < clusterCount; cluster++)
 			{
-				processPrimitives(device, draw.get(), batch.get());
+				batch->clusterTickets[cluster] = std::move(clusterQueues[cluster].take());
+			}
 
-				if(batch->numVisible > 0)
-				{
-					processPixels(device, draw, batch, finally);
-					return;
-				}
+			batches[batchId - groupId] = std::move(batch);
+		}
+
+		const unsigned int batchCount = groupEnd - groupId;
+		marl::schedule([device, draw, batches, batchCount, deduplicate, finally] {
+			if(!deduplicate)
+			{
+				processBatch(device, draw, batches[0], nullptr, finally);
+				return;
 			}
 
-			for(int cluster = 0; cluster < MaxClusterCount; cluster++)
+			BatchGroup group;
+			unsigned int vertexCount = 0;
+			for(unsigned int i = 0; i < batchCount; i++)
 			{
-				batch->clusterTickets[cluster].done();
+				vertexCount += batches[i]->numPrimitives * 3;
+			}
+			group.reset(vertexCount);
+
+			for(unsigned int i = 0; i < batchCount; i++)
+			{
+				processBatch(device, draw, batches[i], &group, finally);
 			}
 		});
+
+		groupId = groupEnd;
 	}
 }
 
-void DrawCall::processVertices(vk::Device *device, DrawCall *draw, BatchData *batch)
+void DrawCall::processBatch(vk::Device *device, const marl::Loan<DrawCall> &draw, const marl::Loan<BatchData> &batch, BatchGroup *group, const std::shared_ptr<marl::Finally> &finally)
+{
+	processVertices(device, draw.get(), batch.get(), group);
+
+	if(!draw->data->rasterizerDiscard)
+	{
+		processPrimitives(device, draw.get(), batch.get());
+
+		if(batch->numVisible > 0)
+		{
+			processPixels(device, draw, batch, finally);
+			return;
+		}
+	}
+
+	for(int cluster = 0; cluster < draw->clusterCount; cluster++)
+	{
+		batch->clusterTickets[cluster].done();
+	}
+}
+
+void DrawCall::processVertices(vk::Device *device, DrawCall *draw, BatchData *batch, BatchGroup *group)
 {
 	MARL_SCOPED_EVENT("VERTEX draw %d, batch %d", draw->id, batch->id);
 
@@ -616,10 +903,15 @@ void DrawCall::processVertices(vk::Device *device, DrawCall *draw, BatchData *ba
 	vertexTask.primitiveStart = batch->firstPrimitive;
 	// We're only using batch compaction for points, not lines
 	vertexTask.vertexCount = batch->numPrimitives * ((draw->topology == VK_PRIMITIVE_TOPOLOGY_POINT_LIST) ? 1 : 3);
-	if(vertexTask.vertexCache.drawCall != draw->id)
+	vertexTask.instanceID = draw->firstInstance + batch->instance;
+	vertexTask.deduplicated = group && deduplicateVertices(&triangleIndices[0][0], vertexTask.vertexCount, batch, group);
+
+	if(!vertexTask.deduplicated &&
+	   (vertexTask.vertexCache.drawCall != draw->id || vertexTask.vertexCache.instanceID != vertexTask.instanceID))
 	{
 		vertexTask.vertexCache.clear();
 		vertexTask.vertexCache.drawCall = draw->id;
+		vertexTask.vertexCache.instanceID = vertexTask.instanceID;
 	}
 
 	draw->vertexRoutine(device, &batch->triangles.front().v0, &triangleIndices[0][0], &vertexTask, draw->data);
@@ -628,6 +920,19 @@ void DrawCall::processVertices(vk::Device *device, DrawCall *draw, BatchData *ba
 void DrawCall::processPrimitives(vk::Device *device, DrawCall *draw, BatchData *batch)
 {
 	MARL_SCOPED_EVENT("PRIMITIVES draw %d batch %d", draw->id, batch->id);
+
+	const int firstRow = draw->data->outlineFirstRow;
+	const int rowCount = ((draw->data->scissorY1 + 2 - firstRow) + 1) & ~1;
+	if(batch->outlines.size() < size_t(MaxBatchSize * rowCount))
+	{
+		batch->outlines.resize(MaxBatchSize * rowCount);
+	}
+
+	for(int i = 0; i < MaxBatchSize; i++)
+	{
+		batch->primitives[i].outline = batch->outlines.data() + i * rowCount;
+	}
+
 	auto triangles = &batch->triangles[0];
 	auto primitives = &batch->primitives[0];
 	batch->numVisible = draw->setupPrimitives(device, triangles, primitives, draw, batch->numPrimitives);
@@ -646,19 +951,71 @@ void DrawCall::processPixels(vk::Device *device, const marl::Loan<DrawCall> &dra
 		marl::Loan<BatchData> batch;
 		std::shared_ptr<marl::Finally> finally;
 	};
+	binPrimitives(draw.get(), batch.get());
+
 	auto data = std::make_shared<Data>(draw, batch, finally);
-	for(int cluster = 0; cluster < MaxClusterCount; cluster++)
+	for(int cluster = 0; cluster < draw->clusterCount; cluster++)
 	{
+		if(batch->clusterPrimitiveCount[cluster] == 0)
+		{
+			batch->clusterTickets[cluster].done();
+			continue;
+		}
+
 		batch->clusterTickets[cluster].onCall([device, data, cluster] {
 			auto &draw = data->draw;
 			auto &batch = data->batch;
 			MARL_SCOPED_EVENT("PIXEL draw %d, batch %d, cluster %d", draw->id, batch->id, cluster);
-			draw->pixelRoutine(device, &batch->primitives.front(), batch->numVisible, cluster, MaxClusterCount, draw->data);
+			draw->pixelRoutine(device, &batch->primitives.front(), &batch->clusterPrimitives[cluster * MaxBatchSize], batch->clusterPrimitiveCount[cluster], cluster, draw->clusterCount, draw->data);
 			batch->clusterTickets[cluster].done();
 		});
 	}
 }
 
+void DrawCall::binPrimitives(DrawCall *draw, BatchData *batch)
+{
+	MARL_SCOPED_EVENT("BINNING draw %d, batch %d", draw->id, batch->id);
+
+	const int clusterCount = draw->clusterCount;
+	ASSERT(isPow2(clusterCount) && clusterCount <= MaxClusterCount);
+	const int columnsLog2 = TileGridColumnsLog2(log2i(clusterCount));
+	const int columns = 1 << columnsLog2;
+	const int rows = clusterCount >> columnsLog2;
+
+	int *clusterPrimitiveCount = batch->clusterPrimitiveCount.data();
+	for(int cluster = 0; cluster < clusterCount; cluster++)
+	{
+		clusterPrimitiveCount[cluster] = 0;
+	}
+
+	const int ms = draw->setupState.multiSampleCount;
+
+	for(int i = 0; i < batch->numVisible; i++)
+	{
+		const Primitive &primitive = batch->primitives[i * ms];
+
+		if(primitive.xMin >= primitive.xMax || primitive.yMin >= primitive.yMax)
+		{
+			continue;
+		}
+
+		int tx0 = primitive.xMin >> TileSizeLog2;
+		int ty0 = primitive.yMin >> TileSizeLog2;
+		int tx1 = std::min((primitive.xMax - 1) >> TileSizeLog2, tx0 + columns - 1);
+		int ty1 = std::min((primitive.yMax - 1) >> TileSizeLog2, ty0 + rows - 1);
+
+		// The tile range is clamped to the grid, so each tile maps to a distinct cluster.
+		for(int ty = ty0; ty <= ty1; ty++)
+		{
+			for(int tx = tx0; tx <= tx1; tx++)
+			{
+				int cluster = (tx & (columns - 1)) + ((ty & (rows - 1)) << columnsLog2);
+				batch->clusterPrimitives[cluster * MaxBatchSize + clusterPrimitiveCount[cluster]++] = i;
+			}
+		}
+	}
+}
+
 void Renderer::synchronize()
 {
 	MARL_SCOPED_EVENT("synchronize");
@@ -666,6 +1023,93 @@ void Renderer::synchronize()
 	ticket.wait();
 	device->updateSamplingRoutineSnapshotCache();
 	ticket.done();
+
+	trackedDraws.clear();
+	barriers.clear();
+}
+
+void Renderer::onDrawsComplete(std::function<void()> &&callback)
+{
+	// The ticket is called once all prior draw tickets are done.
+	auto ticket = drawTickets.take();
+	ticket.onCall([ticket, callback = std::move(callback)] {
+		callback();
+		ticket.done();
+	});
+}
+
+void Renderer::waitForDraws(const std::vector<const vk::Image *> &images)
+{
+	auto contains = [](const std::vector<const vk::Image *> &images, const vk::Image *image) {
+		return std::find(images.begin(), images.end(), image) != images.end();
+	};
+
+	// Draws issued before the last synchronize() have completed, and the others are all tracked.
+	for(auto &draw : trackedDraws)
+	{
+		if(draw.completed->isSignalled())
+		{
+			continue;
+		}
+
+		bool accessesImages = draw.writesMemory;
+		for(auto *image : images)
+		{
+			accessesImages = accessesImages || contains(draw.attachments, image) || contains(draw.getDescriptorImages(), image);
+		}
+
+		if(accessesImages)
+		{
+			MARL_SCOPED_EVENT("wait for draw accessing image");
+			draw.completed->wait();
+		}
+	}
+}
+
+void Renderer::barrier(bool allImages, const vk::Image *const *images, uint32_t imageCount)
+{
+	// Without tracked draws there's nothing for the barrier to make visible.
+	if(!trackedDraws.empty())
+	{
+		barriers.push_back({ barrierEpoch, allImages, std::vector<const vk::Image *>(images, images + imageCount) });
+	}
+
+	barrierEpoch++;
+}
+
+void Renderer::resetHiZ()
+{
+	if(hiZBuffers.empty())
+	{
+		return;
+	}
+
+	// Draws in flight reference the tiles, so release them once the draws are done.
+	auto retired = std::make_shared<decltype(hiZBuffers)>(std::move(hiZBuffers));
+	hiZBuffers.clear();
+	onDrawsComplete([retired] {});
+}
+
+void Renderer::setupHiZ(const vk::ImageView *depthBuffer, DrawData *data, int drawID)
+{
+	const VkImageSubresourceRange &range = depthBuffer->getSubresourceRange();
+	VkExtent2D extent = depthBuffer->getMipLevelExtent(0, VK_IMAGE_ASPECT_DEPTH_BIT);
+	int columns = (extent.width + (1 << TileSizeLog2) - 1) >> TileSizeLog2;
+	int rows = (extent.height + (1 << TileSizeLog2) - 1) >> TileSizeLog2;
+
+	// Depth attachments are only modified by draws until the next resetHiZ(), so the
+	// tiles remain valid across draws. They start out unknown to be computed on first use.
+	auto &tiles = hiZBuffers[{ depthBuffer->getImage(), range.baseMipLevel, range.baseArrayLayer + data->layer }];
+	if(tiles.empty())
+	{
+		tiles.resize(columns * rows, HiZTile{ 0.0f, 0.0f, HiZTile::Unknown });
+	}
+
+	data->hiZBuffer = tiles.data();
+	data->hiZPitch = columns;
+	data->hiZWidth = extent.width;
+	data->hiZHeight = extent.height;
+	data->hiZDrawID = (drawID & 0x3FFFFFFF) + 1;  // Positive, to distinguish from Exact and Unknown
 }
 
 void DrawCall::processPrimitiveVertices(
@@ -722,6 +1166,124 @@ void DrawCall::processPrimitiveVertices(
 	}
 }
 
+void DrawCall::BatchGroup::reset(unsigned int vertexCount)
+{
+	ASSERT(vertexCount <= MaxBatchCount * MaxBatchSize * 3);
+
+	batchCount = 0;
+	tableMask = ceilPow2(std::max(2 * vertexCount, 16u)) - 1;
+	memset(values, 0, (tableMask + 1) * sizeof(values[0]));
+}
+
+bool DrawCall::deduplicateVertices(unsigned int *indices, unsigned int vertexCount, BatchData *batch, BatchGroup *group)
+{
+	MARL_SCOPED_EVENT("deduplicateVertices");
+
+	constexpr unsigned int MaxVertexCount = MaxBatchSize * 3;
+	ASSERT(vertexCount <= MaxVertexCount);
+	ASSERT(group->batchCount < BatchGroup::MaxBatchCount);
+
+	const unsigned int groupSize = 4;       // Vertex routines shade groups of four vertices
+	const uint32_t sharedVertex = 0x4000;  // Identifies vertices shaded by a previous batch
+	const uint32_t current = group->batchCount;
+
+	if(batch->uniqueIndices.empty())
+	{
+		// Padded with one extra group, for the last group of unique vertices.
+		batch->uniqueIndices.resize(MaxVertexCount + groupSize);
+		batch->shadedVertices.resize(MaxVertexCount + groupSize);
+	}
+
+	uint32_t *uniqueIndices = batch->uniqueIndices.data();
+	unsigned int uniqueCount = 0;
+	const Vertex *sharedVertices[MaxVertexCount];
+	unsigned int sharedCount = 0;
+	uint16_t identifiers[MaxVertexCount];
+
+	for(unsigned int i = 0; i < vertexCount; i++)
+	{
+		uint32_t index = indices[i];
+		unsigned int entry = ((index * 0x9E3779B1u) >> 16) & group->tableMask;
+
+		while(group->values[entry] != 0 && group->keys[entry] != index)
+		{
+			entry = (entry + 1) & group->tableMask;
+		}
+
+		uint32_t value = group->values[entry];
+		uint32_t owner = value >> 16;
+
+		if(value != 0 && owner == current)
+		{
+			identifiers[i] = (value & 0xFFFF) - 1;
+			continue;
+		}
+
+		uint32_t identifier = 0;
+		if(value != 0 && group->deduplicated[owner])
+		{
+			// Shaded by a previous batch of the group. Later references resolve to this batch's copy.
+			uint32_t slot = (value & 0xFFFF) - 1;
+			if(slot & sharedVertex)
+			{
+				slot = group->uniqueCount[owner] + groupSize + (slot & ~sharedVertex);
+			}
+
+			sharedVertices[sharedCount] = &group->batches[owner]->shadedVertices[slot];
+			identifier = sharedVertex | sharedCount++;
+		}
+		else
+		{
+			// Not seen yet, or left in the vertex cache of a batch which wasn't deduplicated.
+			uniqueIndices[uniqueCount] = index;
+			identifier = uniqueCount++;
+		}
+
+		group->keys[entry] = index;
+		group->values[entry] = (current << 16) | (identifier + 1);
+		identifiers[i] = static_cast<uint16_t>(identifier);
+	}
+
+	group->batches[current] = batch;
+	group->uniqueCount[current] = uniqueCount;
+	group->deduplicated[current] = (uniqueCount != vertexCount);
+	group->batchCount++;
+
+	// Without any reuse the vertex cache shades just as few vertices, and may
+	// still hit the entries left by the previous batch which used it.
+	if(!group->deduplicated[current])
+	{
+		return false;
+	}
+
+	if(uniqueCount > 0)
+	{
+		// Repeat the last index to allow for SIMD width overrun.
+		for(unsigned int i = uniqueCount; i < uniqueCount + groupSize; i++)
+		{
+			uniqueIndices[i] = uniqueIndices[uniqueCount - 1];
+		}
+	}
+
+	Vertex *shadedVertices = batch->shadedVertices.data();
+	for(unsigned int i = 0; i < sharedCount; i++)
+	{
+		shadedVertices[uniqueCount + groupSize + i] = *sharedVertices[i];
+	}
+
+	for(unsigned int i = 0; i < vertexCount; i++)
+	{
+		indices[i] = (identifiers[i] & sharedVertex) ? uniqueCount + groupSize + (identifiers[i] & ~sharedVertex) : identifiers[i];
+	}
+
+	auto &vertexTask = batch->vertexTask;
+	vertexTask.uniqueCount = uniqueCount;
+	vertexTask.uniqueIndices = uniqueIndices;
+	vertexTask.shadedVertices = shadedVertices;
+
+	return true;
+}
+
 int DrawCall::setupSolidTriangles(vk::Device *device, Triangle *triangles, Primitive *primitives, const DrawCall *drawCall, int count)
 {
 	auto &state = drawCall->setupState;
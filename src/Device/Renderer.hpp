@@ -19,19 +19,28 @@
 #include "Primitive.hpp"
 #include "SetupProcessor.hpp"
 #include "VertexProcessor.hpp"
+#include "System/Synchronization.hpp"
 #include "Vulkan/VkDescriptorSet.hpp"
 #include "Vulkan/VkPipeline.hpp"
 
+#include "marl/event.h"
 #include "marl/finally.h"
 #include "marl/pool.h"
 #include "marl/ticket.h"
 
 #include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
 
 namespace vk {
 
 class DescriptorSet;
 class Device;
+class Image;
 class Query;
 class PipelineLayout;
 
@@ -48,10 +57,38 @@ class Resource;
 struct Constants;
 
 static constexpr int MaxBatchSize = 128;
-static constexpr int MaxBatchCount = 16;
-static constexpr int MaxClusterCount = 16;
+static constexpr int MinBatchCount = 16;
+static constexpr int MinClusterCount = 16;
+static constexpr int MaxClusterCount = 128;
 static constexpr int MaxDrawCount = 16;
 
+// The framebuffer is divided into square tiles of (1 << TileSizeLog2) pixels wide.
+// Tiles are assigned to clusters in a repeating grid of clusterCount tiles, so that
+// each cluster owns disjoint framebuffer memory. The grid is as square as possible.
+static constexpr int TileSizeLog2 = 5;
+
+// Returns the base-2 logarithm of the number of tile columns in the cluster grid.
+// clusterCount must be a power of two.
+constexpr int TileGridColumnsLog2(int clusterCountLog2)
+{
+	return (clusterCountLog2 + 1) >> 1;
+}
+
+// Coarse depth information of one framebuffer tile, for rejecting primitives
+// which fail the depth test against all of its contents (hierarchical Z).
+struct HiZTile
+{
+	static constexpr int Exact = 0;
+	static constexpr int Unknown = -1;  // The bounds must be recomputed.
+	                                    // Positive values are the hiZDrawID of the last draw which
+	                                    // wrote depth to the tile. The bounds were widened to include
+	                                    // the written depth, so they remain valid but may be loose.
+
+	float minZ;  // Smallest depth of the tile, in depth buffer units (the D16 integer value, or the float)
+	float maxZ;  // Largest depth of the tile, in depth buffer units
+	int state;
+};
+
 using TriangleBatch = std::array<Triangle, MaxBatchSize>;
 using PrimitiveBatch = std::array<Primitive, MaxBatchSize>;
 
@@ -63,9 +100,9 @@ struct DrawData
 	const void *input[MAX_INTERFACE_COMPONENTS / 4];
 	unsigned int robustnessSize[MAX_INTERFACE_COMPONENTS / 4];
 	unsigned int stride[MAX_INTERFACE_COMPONENTS / 4];
+	unsigned int instanceStride[MAX_INTERFACE_COMPONENTS / 4];
 	const void *indices;
 
-	int instanceID;
 	int baseVertex;
 	float lineWidth;
 	int layer;
@@ -93,6 +130,11 @@ struct DrawData
 	float *depthBuffer;
 	int depthPitchB;
 	int depthSliceB;
+	HiZTile *hiZBuffer;
+	int hiZPitch;  // In tiles
+	int hiZWidth;
+	int hiZHeight;
+	int hiZDrawID;
 	unsigned char *stencilBuffer;
 	int stencilPitchB;
 	int stencilSliceB;
@@ -101,6 +143,7 @@ struct DrawData
 	int scissorX1;
 	int scissorY0;
 	int scissorY1;
+	int outlineFirstRow;  // Row of the first span in each primitive's outline storage
 
 	float a2c0;
 	float a2c1;
@@ -116,16 +159,51 @@ struct DrawCall
 {
 	struct BatchData
 	{
-		using Pool = marl::BoundedPool<BatchData, MaxBatchCount, marl::PoolPolicy::Preserve>;
+		using Pool = BlockingPool<BatchData>;
 
 		TriangleBatch triangles;
 		PrimitiveBatch primitives;
+		std::vector<Primitive::Span> outlines;  // Storage for the primitives' outlines
 		VertexTask vertexTask;
 		unsigned int id;
+		unsigned int instance;  // Relative to the draw's first instance
 		unsigned int firstPrimitive;
 		unsigned int numPrimitives;
 		int numVisible;
-		marl::Ticket clusterTickets[MaxClusterCount];
+		std::vector<marl::Ticket> clusterTickets;
+
+		// Storage for the unique vertices of deduplicated batches, followed by
+		// the vertices they share with the previous batches of their group.
+		std::vector<uint32_t> uniqueIndices;
+		std::vector<Vertex> shadedVertices;
+
+		// Indices of the visible primitives overlapping each cluster's tiles,
+		// MaxBatchSize entries per cluster.
+		std::vector<int> clusterPrimitives;
+		std::vector<int> clusterPrimitiveCount;
+	};
+
+	// Consecutive batches of an instance processed in order by a single task, so
+	// that the vertices they share are shaded once. Maps the vertex indices
+	// seen so far to the batch and slot of their shaded vertex.
+	struct BatchGroup
+	{
+		static constexpr unsigned int MaxBatchCount = 4;
+
+		void reset(unsigned int vertexCount);
+
+		unsigned int batchCount;
+		BatchData *batches[MaxBatchCount];
+		bool deduplicated[MaxBatchCount];
+		unsigned int uniqueCount[MaxBatchCount];
+
+		// Open addressing hash table, sized to keep the load factor at or below
+		// one half. Values are the batch in the upper 16 bits, and the vertex
+		// identifier within that batch plus one in the lower 16 bits. Zero
+		// denotes an empty entry.
+		unsigned int tableMask;
+		uint32_t keys[4 * MaxBatchCount * MaxBatchSize * 3];  // Rounding up to a power of two can double the size
+		uint32_t values[4 * MaxBatchCount * MaxBatchSize * 3];
 	};
 
 	using Pool = marl::BoundedPool<DrawCall, MaxDrawCount, marl::PoolPolicy::Preserve>;
@@ -134,9 +212,11 @@ struct DrawCall
 	DrawCall();
 	~DrawCall();
 
-	static void run(vk::Device *device, const marl::Loan<DrawCall> &draw, marl::Ticket::Queue *tickets, marl::Ticket::Queue clusterQueues[MaxClusterCount]);
-	static void processVertices(vk::Device *device, DrawCall *draw, BatchData *batch);
+	static void run(vk::Device *device, const marl::Loan<DrawCall> &draw, marl::Ticket::Queue *tickets, marl::Ticket::Queue *clusterQueues);
+	static void processBatch(vk::Device *device, const marl::Loan<DrawCall> &draw, const marl::Loan<BatchData> &batch, BatchGroup *group, const std::shared_ptr<marl::Finally> &finally);
+	static void processVertices(vk::Device *device, DrawCall *draw, BatchData *batch, BatchGroup *group);
 	static void processPrimitives(vk::Device *device, DrawCall *draw, BatchData *batch);
+	static void binPrimitives(DrawCall *draw, BatchData *batch);
 	static void processPixels(vk::Device *device, const marl::Loan<DrawCall> &draw, const marl::Loan<BatchData> &batch, const std::shared_ptr<marl::Finally> &finally);
 	void setup();
 	void teardown(vk::Device *device);
@@ -144,9 +224,12 @@ struct DrawCall
 	int id;
 
 	BatchData::Pool *batchDataPool;
-	unsigned int numPrimitives;
+	int clusterCount;
+	unsigned int numPrimitives;  // Per instance
 	unsigned int numPrimitivesPerBatch;
-	unsigned int numBatches;
+	unsigned int numBatchesPerInstance;
+	unsigned int numBatches;  // For all instances
+	int firstInstance;
 
 	VkPrimitiveTopology topology;
 	VkProvokingVertexModeEXT provokingVertexMode;
@@ -172,6 +255,7 @@ struct DrawCall
 	const vk::PipelineLayout *preRasterizationPipelineLayout;
 	const vk::PipelineLayout *fragmentPipelineLayout;
 	sw::CountedEvent *events;
+	std::shared_ptr<marl::Event> completed;  // Signalled once the draw has been torn down
 
 	vk::Query *occlusionQuery;
 
@@ -185,6 +269,7 @@ struct DrawCall
 	    unsigned int triangleCount,
 	    VkPrimitiveTopology topology,
 	    VkProvokingVertexModeEXT provokingVertexMode);
+	static bool deduplicateVertices(unsigned int *indices, unsigned int vertexCount, BatchData *batch, BatchGroup *group);
 
 	static int setupSolidTriangles(vk::Device *device, Triangle *triangles, Primitive *primitives, const DrawCall *drawCall, int count);
 	static int setupWireframeTriangles(vk::Device *device, Triangle *triangles, Primitive *primitives, const DrawCall *drawCall, int count);
@@ -196,6 +281,52 @@ struct DrawCall
 	static bool setupPoint(vk::Device *device, Primitive &primitive, Triangle &triangle, const DrawCall &draw);
 };
 
+// Routines compiled when a graphics pipeline is created, for the state keys
+// determined by its static state. They're obtained from the device's routine
+// caches, so pipelines with identical keys share them. Draws with matching
+// keys still look them up in the caches, to get them tiered up, and add them
+// back if they were evicted.
+struct PrecompiledRoutines
+{
+	// Attachments provides the formats of the pipeline's rendering info.
+	static std::shared_ptr<PrecompiledRoutines> Compile(vk::Device *device, const vk::GraphicsPipeline *pipeline, const vk::Attachments &attachments);
+
+	VertexProcessor::State vertexState;
+	SetupProcessor::State setupState;
+	PixelProcessor::State pixelState;
+
+	VertexProcessor::RoutineType vertexRoutine;
+	SetupProcessor::RoutineType setupRoutine;
+	PixelProcessor::RoutineType pixelRoutine;  // Without occlusion queries
+};
+
+// Routines of the graphics pipeline stages, shared by the Renderers of all
+// queues of a device. Each cache retains up to 'budget' bytes of routines.
+// Routines used 'tierUpThreshold' times by any of the queues get reoptimized.
+struct RoutineCaches
+{
+	RoutineCaches(size_t budget, uint32_t tierUpThreshold)
+	    : vertex(budget, tierUpThreshold)
+	    , setup(budget, tierUpThreshold)
+	    , pixel(budget, tierUpThreshold)
+	{}
+
+	VertexProcessor::RoutineCacheType vertex;
+	SetupProcessor::RoutineCacheType setup;
+	PixelProcessor::RoutineCacheType pixel;
+};
+
+// BatchDataPool holds the batches in flight for all queues of a device, so that
+// its memory doesn't grow with the number of queues.
+struct BatchDataPool
+{
+	BatchDataPool(int workerThreadCount)
+	    : pool(std::max(MinBatchCount, workerThreadCount))
+	{}
+
+	DrawCall::BatchData::Pool pool;
+};
+
 class alignas(16) Renderer
 {
 public:
@@ -209,7 +340,7 @@ public:
 	bool hasOcclusionQuery() const { return occlusionQuery != nullptr; }
 
 	void draw(const vk::GraphicsPipeline *pipeline, const vk::DynamicState &dynamicState, unsigned int count, int baseVertex,
-	          CountedEvent *events, int instanceID, int layer, void *indexBuffer, const VkRect2D &renderArea,
+	          CountedEvent *events, int firstInstance, unsigned int instanceCount, int layer, void *indexBuffer, const VkRect2D &renderArea,
 	          const vk::Pipeline::PushConstantStorage &pushConstants, bool update = true);
 
 	void addQuery(vk::Query *query);
@@ -217,15 +348,74 @@ public:
 
 	void synchronize();
 
+	// Calls 'callback' on a worker thread once all draws issued so far have
+	// completed, without waiting for them.
+	void onDrawsComplete(std::function<void()> &&callback);
+
+	// Waits for the draws which may still access the given images, through
+	// attachments, descriptors, or memory writes which can't be attributed.
+	void waitForDraws(const std::vector<const vk::Image *> &images);
+
+	// Orders subsequent draws after the prior draws they depend on, without
+	// waiting for unrelated ones. 'images' are the images whose memory the
+	// barrier makes visible; 'allImages' is set for global memory barriers.
+	void barrier(bool allImages, const vk::Image *const *images, uint32_t imageCount);
+
+	// Discards the coarse depth information of all depth attachments. Must be
+	// called before depth attachments are modified by anything other than
+	// draws, or used by a subsequent render pass instance. Draws still in
+	// flight keep using the discarded information until they complete.
+	void resetHiZ();
+
 private:
+	// A draw which may still be in flight, kept to resolve dependencies across barriers.
+	struct TrackedDraw
+	{
+		const std::vector<const vk::Image *> &getDescriptorImages();
+
+		int epoch;  // Number of barriers recorded before the draw
+		std::shared_ptr<marl::Event> completed;
+		bool writesMemory;  // Through storage buffers or images, other than attachments
+		std::vector<const vk::Image *> attachments;
+		vk::DescriptorSet::Array descriptorSetObjects;
+		const vk::PipelineLayout *preRasterizationPipelineLayout;
+		const vk::PipelineLayout *fragmentPipelineLayout;
+		bool descriptorImagesCollected = false;
+		std::vector<const vk::Image *> descriptorImages;
+	};
+
+	void trackDraw(DrawCall *draw, const vk::GraphicsPipeline *pipeline, const vk::PipelineLayout *fragmentPipelineLayout);
+	bool dependsOn(TrackedDraw &draw, TrackedDraw &prior) const;
+	bool isVisible(const vk::Image *image, int epoch) const;
+	void setupHiZ(const vk::ImageView *depthBuffer, DrawData *data, int drawID);
+
+	// Number of clusters the framebuffer tiles are distributed over. A power
+	// of two, chosen from the number of scheduler worker threads.
+	const int clusterCount;
+
 	DrawCall::Pool drawCallPool;
-	DrawCall::BatchData::Pool batchDataPool;
+	DrawCall::BatchData::Pool *const batchDataPool;  // Shared by the device's queues
 
 	std::atomic<int> nextDrawID = { 0 };
 
 	vk::Query *occlusionQuery = nullptr;
 	marl::Ticket::Queue drawTickets;
-	marl::Ticket::Queue clusterQueues[MaxClusterCount];
+	std::vector<marl::Ticket::Queue> clusterQueues;
+
+	// Images made visible by a barrier to the draws recorded before it.
+	struct Barrier
+	{
+		int epoch;  // Number of barriers recorded before this one
+		bool allImages;
+		std::vector<const vk::Image *> images;
+	};
+
+	std::deque<TrackedDraw> trackedDraws;
+	std::deque<Barrier> barriers;  // Recorded after the oldest tracked draw
+	int barrierEpoch = 0;
+
+	// Tiles of each depth attachment subresource (image, mip level, layer) drawn to since the last resetHiZ().
+	std::map<std::tuple<const vk::Image *, uint32_t, uint32_t>, std::vector<HiZTile>> hiZBuffers;
 
 	VertexProcessor vertexProcessor;
 	PixelProcessor pixelProcessor;
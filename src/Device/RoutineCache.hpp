@@ -15,10 +15,22 @@
 #ifndef sw_RoutineCache_hpp
 #define sw_RoutineCache_hpp
 
+#include "System/EpochReclamation.hpp"
 #include "System/LRUCache.hpp"
 
 #include "Reactor/Reactor.hpp"
 
+#include "marl/event.h"
+#include "marl/mutex.h"
+#include "marl/scheduler.h"
+#include "marl/tsa.h"
+#include "marl/waitgroup.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+
 namespace sw {
 
 using namespace rr;
@@ -26,6 +38,314 @@ using namespace rr;
 template<class State, class FunctionType>
 using RoutineCache = LRUCache<State, RoutineT<FunctionType>>;
 
+// RoutineTierUp implements tiered compilation of routines. Routines are first
+// generated without optimizations, which keeps draw call latency low. Once a
+// routine has been used 'threshold' times it gets reoptimized at O3 by a
+// background task. The use counts are kept by the routine cache.
+template<class FunctionType>
+class RoutineTierUp
+{
+public:
+	using RoutineType = RoutineT<FunctionType>;
+
+	// A threshold of 0 disables tiered compilation.
+	RoutineTierUp(uint32_t threshold)
+	    : threshold(Caps::reoptimizationSupported() ? threshold : 0)
+	{}
+
+	// Waits for the routines being reoptimized.
+	~RoutineTierUp() { reoptimizing.wait(); }
+
+	bool enabled() const { return threshold > 0; }
+	uint32_t getThreshold() const { return threshold; }
+
+	// Calls generator() to produce the baseline routine.
+	template<typename Generator>
+	RoutineType generate(Generator &&generator)
+	{
+		if(!enabled())
+		{
+			return generator();
+		}
+
+		ScopedPragma optimizationLevel(OptimizationLevel, 0);
+		ScopedPragma tieredCompilation(TieredCompilation, true);
+
+		return generator();
+	}
+
+	// Reoptimizes the routine on a background task, which passes the optimized
+	// routine to publish() if it could be produced.
+	template<typename Publish>
+	void reoptimize(const RoutineType &routine, Publish &&publish)
+	{
+		auto baseline = routine.getRoutine();
+
+		reoptimizing.add(1);
+		marl::schedule([this, baseline, publish] {
+			ScopedPragma optimizationLevel(OptimizationLevel, 3);
+			if(auto optimized = baseline->reoptimize())
+			{
+				publish(RoutineType(optimized));
+			}
+
+			reoptimizing.done();
+		});
+	}
+
+private:
+	const uint32_t threshold;
+	marl::WaitGroup reoptimizing;
+};
+
+// ConcurrentRoutineCache is a routine cache which can be shared by all queues
+// of a device. States are distributed over shards, which each publish an
+// immutable snapshot of their routines. Lookups only read the snapshot within
+// an EpochGuard, so they don't take any lock, or modify any reference count
+// shared with other threads. Adding a routine copies its shard's snapshot,
+// which is cheap compared to generating the routine, and the previous snapshot
+// is deleted once no lookup can still read it. When the memory used by a
+// shard's routines exceeds its part of the budget, the least recently used
+// ones are evicted. getOrCreate() ensures each routine is only generated once,
+// even when several queues miss on the same state at the same time.
+//
+// Routines are generated for tiered compilation. Each entry counts its uses
+// with relaxed atomics, and the lookup which reaches the threshold schedules
+// the reoptimization. The optimized routine then replaces the entry.
+template<class State, class FunctionType>
+class ConcurrentRoutineCache
+{
+public:
+	using RoutineType = RoutineT<FunctionType>;
+
+	struct Statistics
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t insertions = 0;
+		uint64_t evictions = 0;
+		uint64_t evictedBytes = 0;
+		size_t entries = 0;
+		size_t bytes = 0;
+	};
+
+	// 'budget' is the number of bytes of routine memory retained by the cache.
+	// A 'tierUpThreshold' of 0 disables tiered compilation.
+	ConcurrentRoutineCache(size_t budget, uint32_t tierUpThreshold)
+	    : shardBudget(std::max(budget / ShardCount, size_t(1)))
+	    , tierUp(tierUpThreshold)
+	{}
+
+	~ConcurrentRoutineCache()
+	{
+		for(auto &shard : shards)
+		{
+			delete shard.snapshot.load();
+		}
+	}
+
+	RoutineType lookup(const State &state)
+	{
+		Shard &shard = getShard(state);
+
+		EpochGuard guard;
+		const Snapshot *snapshot = shard.snapshot.load();
+
+		auto it = snapshot->find(state);
+		if(it == snapshot->end())
+		{
+			shard.misses.fetch_add(1, std::memory_order_relaxed);
+			return {};
+		}
+
+		Entry &entry = *it->second;
+
+		// The hit count serves as the shard's clock for recency.
+		uint64_t time = shard.hits.fetch_add(1, std::memory_order_relaxed) + 1;
+		entry.lastUse.store(time, std::memory_order_relaxed);
+
+		if(entry.uses.load(std::memory_order_relaxed) < tierUp.getThreshold())
+		{
+			if(entry.uses.fetch_add(1, std::memory_order_relaxed) + 1 == tierUp.getThreshold())
+			{
+				tierUp.reoptimize(entry.routine, [this, state](const RoutineType &optimized) {
+					Shard &shard = getShard(state);
+
+					marl::lock lock(shard.mutex);
+					insert(shard, state, optimized, tierUp.getThreshold());
+				});
+			}
+		}
+
+		return entry.routine;
+	}
+
+	// Returns the routine for the given state. If another thread is already
+	// creating it, that routine is waited for. Otherwise createRoutine() is
+	// called without holding any lock, and the routine it returns is added.
+	template<typename Function>
+	RoutineType getOrCreate(const State &state, Function &&createRoutine)
+	{
+		if(auto routine = lookup(state))
+		{
+			return routine;
+		}
+
+		Shard &shard = getShard(state);
+		std::shared_ptr<InFlight> inFlight;
+		bool creator = false;
+		{
+			marl::lock lock(shard.mutex);
+
+			// Another thread may have added it since the lookup.
+			const Snapshot *snapshot = shard.snapshot.load();
+			auto it = snapshot->find(state);
+			if(it != snapshot->end())
+			{
+				return it->second->routine;
+			}
+
+			auto &pending = shard.inFlight[state];
+			if(!pending)
+			{
+				pending = std::make_shared<InFlight>();
+				creator = true;
+			}
+			inFlight = pending;
+		}
+
+		if(!creator)
+		{
+			inFlight->created.wait();
+			return inFlight->routine;
+		}
+
+		inFlight->routine = tierUp.generate(std::forward<Function>(createRoutine));
+
+		{
+			marl::lock lock(shard.mutex);
+			insert(shard, state, inFlight->routine, 0);
+			shard.inFlight.erase(state);
+		}
+
+		inFlight->created.signal();
+
+		return inFlight->routine;
+	}
+
+	Statistics getStatistics()
+	{
+		Statistics statistics;
+		for(auto &shard : shards)
+		{
+			statistics.hits += shard.hits.load(std::memory_order_relaxed);
+			statistics.misses += shard.misses.load(std::memory_order_relaxed);
+
+			marl::lock lock(shard.mutex);
+			statistics.insertions += shard.insertions;
+			statistics.evictions += shard.evictions;
+			statistics.evictedBytes += shard.evictedBytes;
+			statistics.entries += shard.snapshot.load()->size();
+			statistics.bytes += shard.bytes;
+		}
+
+		return statistics;
+	}
+
+private:
+	static constexpr size_t ShardCount = 16;
+
+	// Charged for routines which don't report their memory usage.
+	static constexpr size_t MinRoutineSize = 4096;
+
+	struct Entry
+	{
+		Entry(const RoutineType &routine, uint64_t lastUse, uint32_t uses)
+		    : routine(routine)
+		    , size(std::max(routine.getRoutine() ? routine.getRoutine()->getMemoryUsage() : 0, MinRoutineSize))
+		    , lastUse(lastUse)
+		    , uses(uses)
+		{}
+
+		const RoutineType routine;
+		const size_t size;
+		std::atomic<uint64_t> lastUse;
+		std::atomic<uint32_t> uses;  // Saturates at the tier-up threshold
+	};
+
+	struct InFlight
+	{
+		marl::Event created{ marl::Event::Mode::Manual };
+		RoutineType routine;
+	};
+
+	using Snapshot = std::unordered_map<State, std::shared_ptr<Entry>>;
+
+	struct Shard
+	{
+		// Replaced as a whole by writers, and read within an EpochGuard.
+		std::atomic<const Snapshot *> snapshot = { new Snapshot() };
+
+		std::atomic<uint64_t> hits = { 0 };
+		std::atomic<uint64_t> misses = { 0 };
+
+		marl::mutex mutex;
+		size_t bytes GUARDED_BY(mutex) = 0;
+		uint64_t insertions GUARDED_BY(mutex) = 0;
+		uint64_t evictions GUARDED_BY(mutex) = 0;
+		uint64_t evictedBytes GUARDED_BY(mutex) = 0;
+		std::unordered_map<State, std::shared_ptr<InFlight>> inFlight GUARDED_BY(mutex);
+		RetiredList<Snapshot> retired GUARDED_BY(mutex);
+	};
+
+	// Adds the routine for the given state, replacing any existing one.
+	void insert(Shard &shard, const State &state, const RoutineType &routine, uint32_t uses) REQUIRES(shard.mutex)
+	{
+		auto entry = std::make_shared<Entry>(routine, shard.hits.load(std::memory_order_relaxed), uses);
+		auto snapshot = std::make_unique<Snapshot>(*shard.snapshot.load());
+
+		auto &slot = (*snapshot)[state];
+		if(slot)
+		{
+			shard.bytes -= slot->size;
+		}
+		slot = entry;
+		shard.bytes += entry->size;
+		shard.insertions++;
+
+		while(shard.bytes > shardBudget && snapshot->size() > 1)
+		{
+			auto oldest = snapshot->end();
+			for(auto it = snapshot->begin(); it != snapshot->end(); ++it)
+			{
+				if(it->second != entry &&
+				   (oldest == snapshot->end() || it->second->lastUse < oldest->second->lastUse))
+				{
+					oldest = it;
+				}
+			}
+
+			shard.bytes -= oldest->second->size;
+			shard.evictions++;
+			shard.evictedBytes += oldest->second->size;
+			snapshot->erase(oldest);
+		}
+
+		shard.retired.retire(shard.snapshot.exchange(snapshot.release()));
+	}
+
+	Shard &getShard(const State &state)
+	{
+		return shards[std::hash<State>()(state) % ShardCount];
+	}
+
+	const size_t shardBudget;
+	Shard shards[ShardCount];
+
+	// Destroyed first, so the routines being reoptimized can still be added.
+	RoutineTierUp<FunctionType> tierUp;
+};
+
 }  // namespace sw
 
 #endif  // sw_RoutineCache_hpp
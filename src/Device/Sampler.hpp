@@ -88,6 +88,7 @@ struct Sampler
 {
 	VkImageViewType textureType;
 	vk::Format textureFormat;
+	vk::Format compressedFormat;  // Block format decoded by the sampler, or VK_FORMAT_UNDEFINED
 	FilterType textureFilter;
 	AddressingMode addressingModeU;
 	AddressingMode addressingModeV;
@@ -101,6 +102,7 @@ struct Sampler
 	VkBorderColor border;
 	VkClearColorValue customBorder;
 	bool unnormalizedCoordinates;
+	bool quadLayout;  // 2x2 quads of texels are stored contiguously, see vk::Image::hasQuadLayout()
 
 	VkSamplerYcbcrModelConversion ycbcrModel;
 	bool studioSwing;    // Narrow range
@@ -21,6 +21,7 @@
 #include "Pipeline/SetupRoutine.hpp"
 #include "Pipeline/SpirvShader.hpp"
 #include "System/Debug.hpp"
+#include "System/SwiftConfig.hpp"
 #include "Vulkan/VkImageView.hpp"
 
 #include <cstring>
@@ -50,12 +51,7 @@ bool SetupProcessor::State::operator==(const State &state) const
 	return *static_cast<const States *>(this) == static_cast<const States &>(state);
 }
 
-SetupProcessor::SetupProcessor()
-{
-	setRoutineCacheSize(1024);
-}
-
-SetupProcessor::State SetupProcessor::update(const vk::GraphicsState &pipelineState, const sw::SpirvShader *fragmentShader, const sw::SpirvShader *vertexShader, const vk::Attachments &attachments) const
+SetupProcessor::State SetupProcessor::update(const vk::GraphicsState &pipelineState, const sw::SpirvShader *fragmentShader, const sw::SpirvShader *vertexShader, const vk::Attachments &attachments)
 {
 	const vk::VertexInputInterfaceState &vertexInputInterfaceState = pipelineState.getVertexInputInterfaceState();
 	const vk::PreRasterizationState &preRasterizationState = pipelineState.getPreRasterizationState();
@@ -71,7 +67,7 @@ SetupProcessor::State SetupProcessor::update(const vk::GraphicsState &pipelineSt
 	state.isDrawPoint = vertexInputInterfaceState.isDrawPoint(true, polygonMode);
 	state.isDrawLine = vertexInputInterfaceState.isDrawLine(true, polygonMode);
 	state.isDrawTriangle = vertexInputInterfaceState.isDrawTriangle(true, polygonMode);
-	state.fixedPointDepthBuffer = attachments.depthBuffer && !attachments.depthBuffer->getFormat(VK_IMAGE_ASPECT_DEPTH_BIT).isFloatFormat();
+	state.fixedPointDepthBuffer = attachments.hasDepthBuffer() && !vk::Format(attachments.depthFormat()).getAspectFormat(VK_IMAGE_ASPECT_DEPTH_BIT).isFloatFormat();
 	state.applyConstantDepthBias = vertexInputInterfaceState.isDrawTriangle(false, polygonMode) && (preRasterizationState.getConstantDepthBias() != 0.0f);
 	state.applySlopeDepthBias = vertexInputInterfaceState.isDrawTriangle(false, polygonMode) && (preRasterizationState.getSlopeDepthBias() != 0.0f);
 	state.applyDepthBiasClamp = vertexInputInterfaceState.isDrawTriangle(false, polygonMode) && (preRasterizationState.getDepthBiasClamp() != 0.0f);
@@ -102,26 +98,33 @@ SetupProcessor::State SetupProcessor::update(const vk::GraphicsState &pipelineSt
 	return state;
 }
 
-SetupProcessor::RoutineType SetupProcessor::routine(const State &state)
+SetupProcessor::RoutineType SetupProcessor::routine(const State &state, const RoutineType &precompiled)
 {
-	auto routine = routineCache->lookup(state);
+	return routineCache->getOrCreate(state, [&] {
+		return precompiled;
+	});
+}
 
-	if(!routine)
-	{
-		SetupRoutine *generator = new SetupRoutine(state);
-		generator->generate();
-		routine = generator->getRoutine();
-		delete generator;
+SetupProcessor::RoutineType SetupProcessor::routine(const State &state)
+{
+	return routineCache->getOrCreate(state, [&] {
+		return generate(state);
+	});
+}
 
-		routineCache->add(state, routine);
-	}
+SetupProcessor::RoutineType SetupProcessor::generate(const State &state)
+{
+	SetupRoutine *generator = new SetupRoutine(state);
+	generator->generate();
+	auto routine = generator->getRoutine();
+	delete generator;
 
 	return routine;
 }
 
-void SetupProcessor::setRoutineCacheSize(int cacheSize)
+void SetupProcessor::setRoutineCache(RoutineCacheType *cache)
 {
-	routineCache = std::make_unique<RoutineCacheType>(clamp(cacheSize, 1, 65536));
+	routineCache = cache;
 }
 
 }  // namespace sw
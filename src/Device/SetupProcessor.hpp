@@ -71,16 +71,18 @@ public:
 
 	using RoutineType = SetupFunction::RoutineType;
 
-	SetupProcessor();
-
-	State update(const vk::GraphicsState &pipelineState, const sw::SpirvShader *fragmentShader, const sw::SpirvShader *vertexShader, const vk::Attachments &attachments) const;
+	static State update(const vk::GraphicsState &pipelineState, const sw::SpirvShader *fragmentShader, const sw::SpirvShader *vertexShader, const vk::Attachments &attachments);
 	RoutineType routine(const State &state);
+	static RoutineType generate(const State &state);
+
+	// Returns the cached routine for the state, or adds the precompiled one.
+	RoutineType routine(const State &state, const RoutineType &precompiled);
 
-	void setRoutineCacheSize(int cacheSize);
+	using RoutineCacheType = ConcurrentRoutineCache<State, SetupFunction::CFunctionType>;
+	void setRoutineCache(RoutineCacheType *cache);
 
 private:
-	using RoutineCacheType = RoutineCache<State, SetupFunction::CFunctionType>;
-	std::unique_ptr<RoutineCacheType> routineCache;
+	RoutineCacheType *routineCache = nullptr;
 };
 
 }  // namespace sw
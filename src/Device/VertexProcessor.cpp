@@ -17,6 +17,7 @@
 #include "Pipeline/Constants.hpp"
 #include "Pipeline/VertexProgram.hpp"
 #include "System/Debug.hpp"
+#include "System/SwiftConfig.hpp"
 #include "System/Math.hpp"
 #include "Vulkan/VkPipelineLayout.hpp"
 
@@ -55,14 +56,9 @@ bool VertexProcessor::State::operator==(const State &state) const
 	return *static_cast<const States *>(this) == static_cast<const States &>(state);
 }
 
-VertexProcessor::VertexProcessor()
+void VertexProcessor::setRoutineCache(RoutineCacheType *cache)
 {
-	setRoutineCacheSize(1024);
-}
-
-void VertexProcessor::setRoutineCacheSize(int cacheSize)
-{
-	routineCache = std::make_unique<RoutineCacheType>(clamp(cacheSize, 1, 65536));
+	routineCache = cache;
 }
 
 const VertexProcessor::State VertexProcessor::update(const vk::GraphicsState &pipelineState, const sw::SpirvShader *vertexShader, const vk::Inputs &inputs)
@@ -92,22 +88,34 @@ const VertexProcessor::State VertexProcessor::update(const vk::GraphicsState &pi
 	return state;
 }
 
+VertexProcessor::RoutineType VertexProcessor::routine(const State &state, const RoutineType &precompiled)
+{
+	return routineCache->getOrCreate(state, [&] {
+		return precompiled;
+	});
+}
+
 VertexProcessor::RoutineType VertexProcessor::routine(const State &state,
                                                       const vk::PipelineLayout *pipelineLayout,
                                                       const SpirvShader *vertexShader,
                                                       const vk::DescriptorSet::Bindings &descriptorSets)
 {
-	auto routine = routineCache->lookup(state);
+	return routineCache->getOrCreate(state, [&] {
+		return generate(state, pipelineLayout, vertexShader, descriptorSets);
+	});
+}
 
-	if(!routine)  // Create one
-	{
-		VertexRoutine *generator = new VertexProgram(state, pipelineLayout, vertexShader, descriptorSets);
-		generator->generate();
-		routine = (*generator)("VertexRoutine_%0.8X", state.shaderID);
-		delete generator;
+VertexProcessor::RoutineType VertexProcessor::generate(const State &state,
+                                                       const vk::PipelineLayout *pipelineLayout,
+                                                       const SpirvShader *vertexShader,
+                                                       const vk::DescriptorSet::Bindings &descriptorSets)
+{
+	ScopedPragma optimizationPasses(OptimizationPasses, static_cast<int>(getConfiguration().vertexOptimization));
 
-		routineCache->add(state, routine);
-	}
+	VertexRoutine *generator = new VertexProgram(state, pipelineLayout, vertexShader, descriptorSets);
+	generator->generate();
+	auto routine = (*generator)("VertexRoutine_%0.8X", state.shaderID);
+	delete generator;
 
 	return routine;
 }
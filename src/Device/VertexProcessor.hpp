@@ -38,17 +38,29 @@ struct VertexCache
 	Vertex vertex[SIZE];
 	uint32_t tag[SIZE];
 
-	// Identifier of the draw call for the cache data. If this cache is
-	// used with a different draw call, then the cache should be invalidated
-	// before use.
+	// Identifier of the draw call and instance for the cache data. If this
+	// cache is used with a different draw call or instance, then the cache
+	// should be invalidated before use.
 	int drawCall = -1;
+	int instanceID = 0;
 };
 
 struct VertexTask
 {
 	unsigned int vertexCount;
 	unsigned int primitiveStart;
+	int instanceID;  // Value of the InstanceIndex built-in
 	VertexCache vertexCache;
+
+	// When set, the batch's vertex indices were deduplicated. Each of the
+	// uniqueCount vertices in uniqueIndices (padded to the SIMD width) is
+	// shaded once into the start of shadedVertices, and the batch holds
+	// indices into that array instead of vertex indices. Vertices shaded by
+	// previous batches follow the padding. The vertex cache is not used.
+	bool deduplicated;
+	unsigned int uniqueCount;
+	const uint32_t *uniqueIndices;
+	Vertex *shadedVertices;
 };
 
 using VertexRoutineFunction = FunctionT<void(const vk::Device *device, Vertex *output, unsigned int *batch, VertexTask *vertextask, DrawData *draw)>;
@@ -94,17 +106,20 @@ public:
 
 	using RoutineType = VertexRoutineFunction::RoutineType;
 
-	VertexProcessor();
-
-	const State update(const vk::GraphicsState &pipelineState, const sw::SpirvShader *vertexShader, const vk::Inputs &inputs);
+	static const State update(const vk::GraphicsState &pipelineState, const sw::SpirvShader *vertexShader, const vk::Inputs &inputs);
 	RoutineType routine(const State &state, const vk::PipelineLayout *pipelineLayout,
 	                    const SpirvShader *vertexShader, const vk::DescriptorSet::Bindings &descriptorSets);
+	static RoutineType generate(const State &state, const vk::PipelineLayout *pipelineLayout,
+	                            const SpirvShader *vertexShader, const vk::DescriptorSet::Bindings &descriptorSets);
+
+	// Returns the cached routine for the state, or adds the precompiled one.
+	RoutineType routine(const State &state, const RoutineType &precompiled);
 
-	void setRoutineCacheSize(int cacheSize);
+	using RoutineCacheType = ConcurrentRoutineCache<State, VertexRoutineFunction::CFunctionType>;
+	void setRoutineCache(RoutineCacheType *cache);
 
 private:
-	using RoutineCacheType = RoutineCache<State, VertexRoutineFunction::CFunctionType>;
-	std::unique_ptr<RoutineCacheType> routineCache;
+	RoutineCacheType *routineCache = nullptr;
 };
 
 }  // namespace sw
@@ -16,15 +16,40 @@
 
 #include "Constants.hpp"
 #include "System/Debug.hpp"
+#include "System/SwiftConfig.hpp"
+#include "System/WorkgroupOrder.hpp"
 #include "Vulkan/VkDevice.hpp"
 #include "Vulkan/VkPipelineLayout.hpp"
 
 #include "marl/defer.h"
+#include "marl/scheduler.h"
 #include "marl/trace.h"
 #include "marl/waitgroup.h"
 
+#include <algorithm>
 #include <queue>
 
+namespace {
+
+int getSIMDWidth(const sw::SpirvShader &shader)
+{
+	// Image instructions and subgroup operations are only implemented for 4-wide
+	// SIMD, which is also the subgroup size advertised by the device.
+	const auto &analysis = shader.getAnalysis();
+	if(analysis.ContainsImageInstructions || analysis.ContainsGroupOperations ||
+	   shader.getUsedCapabilities().GroupNonUniform)
+	{
+		return 4;
+	}
+
+	int maxWidth = rr::Caps::maxSIMDWidth();
+	int width = static_cast<int>(sw::getConfiguration().simdWidth);
+
+	return (width == 0) ? maxWidth : std::min(width, maxWidth);
+}
+
+}  // anonymous namespace
+
 namespace sw {
 
 ComputeProgram::ComputeProgram(vk::Device *device, std::shared_ptr<SpirvShader> shader, const vk::PipelineLayout *pipelineLayout, const vk::DescriptorSet::Bindings &descriptorSets)
@@ -32,6 +57,7 @@ ComputeProgram::ComputeProgram(vk::Device *device, std::shared_ptr<SpirvShader>
     , shader(shader)
     , pipelineLayout(pipelineLayout)
     , descriptorSets(descriptorSets)
+    , simdWidth(getSIMDWidth(*shader))
 {
 }
 
@@ -39,10 +65,38 @@ ComputeProgram::~ComputeProgram()
 {
 }
 
+std::unique_ptr<ComputeProgram::WorkerState> ComputeProgram::acquireWorkerState()
+{
+	{
+		marl::lock lock(workerStatesMutex);
+		if(!workerStates.empty())
+		{
+			auto state = std::move(workerStates.back());
+			workerStates.pop_back();
+			return state;
+		}
+	}
+
+	auto state = std::make_unique<WorkerState>();
+	state->workgroupMemory.resize(shader->workgroupMemory.size());
+
+	return state;
+}
+
+void ComputeProgram::releaseWorkerState(std::unique_ptr<WorkerState> state)
+{
+	ASSERT(state->coroutines.empty());
+
+	marl::lock lock(workerStatesMutex);
+	workerStates.push_back(std::move(state));
+}
+
 void ComputeProgram::generate()
 {
 	MARL_SCOPED_EVENT("ComputeProgram::generate");
 
+	SIMD::ScopedWidth scopedWidth(simdWidth);
+
 	SpirvRoutine routine(pipelineLayout);
 	shader->emitProlog(&routine);
 	emit(&routine);
@@ -175,8 +229,7 @@ void ComputeProgram::emit(SpirvRoutine *routine)
 	{
 		auto subgroupIndex = firstSubgroup + i;
 
-		// TODO: Replace SIMD::Int(0, 1, 2, 3) with SIMD-width equivalent
-		auto localInvocationIndex = SIMD::Int(subgroupIndex * SIMD::Width) + SIMD::Int(0, 1, 2, 3);
+		auto localInvocationIndex = SIMD::Int(subgroupIndex * SIMD::Width) + SIMD::Int([](int i) { return i; });
 
 		// Disable lanes where (invocationIDs >= invocationsPerWorkgroup)
 		auto activeLaneMask = CmpLT(localInvocationIndex, SIMD::Int(invocationsPerWorkgroup));
@@ -199,7 +252,7 @@ void ComputeProgram::run(
 	uint32_t workgroupSizeY = shader->getWorkgroupSizeY();
 	uint32_t workgroupSizeZ = shader->getWorkgroupSizeZ();
 
-	auto invocationsPerSubgroup = SIMD::Width;
+	auto invocationsPerSubgroup = simdWidth;
 	auto invocationsPerWorkgroup = workgroupSizeX * workgroupSizeY * workgroupSizeZ;
 	auto subgroupsPerWorkgroup = (invocationsPerWorkgroup + invocationsPerSubgroup - 1) / invocationsPerSubgroup;
 
@@ -217,34 +270,70 @@ void ComputeProgram::run(
 	data.subgroupsPerWorkgroup = subgroupsPerWorkgroup;
 	data.pushConstants = pushConstants;
 
-	marl::WaitGroup wg;
-	const uint32_t batchCount = 16;
+	// Each task starts with a contiguous range of workgroups in Morton order,
+	// so that neighbouring workgroups execute on the same thread. Tasks which
+	// run out of work steal from the others.
+	WorkgroupOrder order(groupCountX, groupCountY, groupCountZ);
+	uint32_t indexCount = order.count();
+	uint32_t workerCount = std::max(device->getScheduler()->config().workerThread.count, 1);
+	uint32_t taskCount = std::min(workerCount, indexCount);
 
-	auto groupCount = groupCountX * groupCountY * groupCountZ;
+	std::vector<IndexRange> ranges(taskCount);
+	for(uint32_t taskID = 0; taskID < taskCount; taskID++)
+	{
+		uint64_t begin = static_cast<uint64_t>(indexCount) * taskID / taskCount;
+		uint64_t end = static_cast<uint64_t>(indexCount) * (taskID + 1) / taskCount;
+		ranges[taskID].reset(static_cast<uint32_t>(begin), static_cast<uint32_t>(end));
+	}
 
-	for(uint32_t batchID = 0; batchID < batchCount && batchID < groupCount; batchID++)
+	marl::WaitGroup wg;
+	for(uint32_t taskID = 0; taskID < taskCount; taskID++)
 	{
 		wg.add(1);
-		marl::schedule([=, &data] {
+		marl::schedule([=, &data, &order, &ranges] {
 			defer(wg.done());
-			std::vector<uint8_t> workgroupMemory(shader->workgroupMemory.size());
 
-			for(uint32_t groupIndex = batchID; groupIndex < groupCount; groupIndex += batchCount)
+			auto state = acquireWorkerState();
+			defer(releaseWorkerState(std::move(state)));
+
+			IndexRange &range = ranges[taskID];
+
+			for(;;)
 			{
-				auto modulo = groupIndex;
-				auto groupOffsetZ = modulo / (groupCountX * groupCountY);
-				modulo -= groupOffsetZ * (groupCountX * groupCountY);
-				auto groupOffsetY = modulo / groupCountX;
-				modulo -= groupOffsetY * groupCountX;
-				auto groupOffsetX = modulo;
-
-				auto groupZ = baseGroupZ + groupOffsetZ;
-				auto groupY = baseGroupY + groupOffsetY;
-				auto groupX = baseGroupX + groupOffsetX;
+				uint32_t index = 0;
+				if(!range.pop(index))
+				{
+					bool stolen = false;
+					for(uint32_t i = 1; i < taskCount && !stolen; i++)
+					{
+						uint32_t begin = 0;
+						uint32_t end = 0;
+						if(ranges[(taskID + i) % taskCount].steal(begin, end))
+						{
+							range.reset(begin, end);
+							stolen = true;
+						}
+					}
+
+					if(!stolen || !range.pop(index))
+					{
+						break;
+					}
+				}
+
+				uint32_t groupOffset[3];
+				if(!order.offset(index, groupOffset))
+				{
+					continue;
+				}
+
+				auto groupZ = baseGroupZ + groupOffset[2];
+				auto groupY = baseGroupY + groupOffset[1];
+				auto groupX = baseGroupX + groupOffset[0];
 				MARL_SCOPED_EVENT("groupX: %d, groupY: %d, groupZ: %d", groupX, groupY, groupZ);
 
-				using Coroutine = std::unique_ptr<rr::Stream<SpirvEmitter::YieldResult>>;
-				std::queue<Coroutine> coroutines;
+				auto &coroutines = state->coroutines;
+				void *workgroupMemory = state->workgroupMemory.data();
 
 				if(shader->getAnalysis().ContainsControlBarriers)
 				{
@@ -253,13 +342,13 @@ void ComputeProgram::run(
 					// together.
 					for(uint32_t subgroupIndex = 0; subgroupIndex < subgroupsPerWorkgroup; subgroupIndex++)
 					{
-						auto coroutine = (*this)(device, &data, groupX, groupY, groupZ, workgroupMemory.data(), subgroupIndex, 1);
+						auto coroutine = (*this)(device, &data, groupX, groupY, groupZ, workgroupMemory, subgroupIndex, 1);
 						coroutines.push(std::move(coroutine));
 					}
 				}
 				else
 				{
-					auto coroutine = (*this)(device, &data, groupX, groupY, groupZ, workgroupMemory.data(), 0, subgroupsPerWorkgroup);
+					auto coroutine = (*this)(device, &data, groupX, groupY, groupZ, workgroupMemory, 0, subgroupsPerWorkgroup);
 					coroutines.push(std::move(coroutine));
 				}
 
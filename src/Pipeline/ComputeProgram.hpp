@@ -21,7 +21,13 @@
 #include "Vulkan/VkDescriptorSet.hpp"
 #include "Vulkan/VkPipeline.hpp"
 
+#include "marl/mutex.h"
+#include "marl/tsa.h"
+
 #include <functional>
+#include <memory>
+#include <queue>
+#include <vector>
 
 namespace vk {
 class Device;
@@ -80,10 +86,26 @@ protected:
 		vk::Pipeline::PushConstantStorage pushConstants;
 	};
 
+	// Per-task state reused across workgroups and dispatches.
+	struct WorkerState
+	{
+		using Coroutine = std::unique_ptr<rr::Stream<SpirvEmitter::YieldResult>>;
+
+		std::vector<uint8_t> workgroupMemory;
+		std::queue<Coroutine> coroutines;
+	};
+
+	std::unique_ptr<WorkerState> acquireWorkerState();
+	void releaseWorkerState(std::unique_ptr<WorkerState> state);
+
 	vk::Device *const device;
 	const std::shared_ptr<SpirvShader> shader;
 	const vk::PipelineLayout *const pipelineLayout;  // Reference held by vk::Pipeline
 	const vk::DescriptorSet::Bindings &descriptorSets;
+	const int simdWidth;  // SIMD::Width of the generated routine
+
+	marl::mutex workerStatesMutex;
+	std::vector<std::unique_ptr<WorkerState>> workerStates GUARDED_BY(workerStatesMutex);
 };
 
 }  // namespace sw
@@ -424,17 +424,31 @@ void PixelRoutine::stencilTest(Byte8 &value, VkCompareOp stencilCompareMode, boo
 	}
 }
 
-SIMD::Float PixelRoutine::readDepth32F(const Pointer<Byte> &zBuffer, int q, const Int &x) const
+// Returns the address of the depth quad at x of the current row pair, for sample q.
+Pointer<Byte> PixelRoutine::depthQuad(const Pointer<Byte> &zBuffer, int q, const Int &x, int bytes) const
 {
-	ASSERT(SIMD::Width == 4);
-	Pointer<Byte> buffer = zBuffer + 4 * x;
-	Int pitch = *Pointer<Int>(data + OFFSET(DrawData, depthPitchB));
+	// With the quad layout, each quad's texels of both rows are contiguous.
+	Pointer<Byte> buffer = zBuffer + (state.depthQuadLayout ? 2 * bytes : bytes) * x;
 
 	if(q > 0)
 	{
 		buffer += q * *Pointer<Int>(data + OFFSET(DrawData, depthSliceB));
 	}
 
+	return buffer;
+}
+
+SIMD::Float PixelRoutine::readDepth32F(const Pointer<Byte> &zBuffer, int q, const Int &x) const
+{
+	ASSERT(SIMD::Width == 4);
+	Pointer<Byte> buffer = depthQuad(zBuffer, q, x, 4);
+
+	if(state.depthQuadLayout)
+	{
+		return SIMD::Float(*Pointer<Float4>(buffer, 4));
+	}
+
+	Int pitch = *Pointer<Int>(data + OFFSET(DrawData, depthPitchB));
 	Float4 zValue = Float4(*Pointer<Float2>(buffer), *Pointer<Float2>(buffer + pitch));
 	return SIMD::Float(zValue);
 }
@@ -442,17 +456,19 @@ SIMD::Float PixelRoutine::readDepth32F(const Pointer<Byte> &zBuffer, int q, cons
 SIMD::Float PixelRoutine::readDepth16(const Pointer<Byte> &zBuffer, int q, const Int &x) const
 {
 	ASSERT(SIMD::Width == 4);
-	Pointer<Byte> buffer = zBuffer + 2 * x;
-	Int pitch = *Pointer<Int>(data + OFFSET(DrawData, depthPitchB));
+	Pointer<Byte> buffer = depthQuad(zBuffer, q, x, 2);
 
-	if(q > 0)
+	UShort4 zValue16;
+	if(state.depthQuadLayout)
 	{
-		buffer += q * *Pointer<Int>(data + OFFSET(DrawData, depthSliceB));
+		zValue16 = *Pointer<UShort4>(buffer, 2);
+	}
+	else
+	{
+		Int pitch = *Pointer<Int>(data + OFFSET(DrawData, depthPitchB));
+		zValue16 = As<UShort4>(Insert(As<Int2>(zValue16), *Pointer<Int>(buffer), 0));
+		zValue16 = As<UShort4>(Insert(As<Int2>(zValue16), *Pointer<Int>(buffer + pitch), 1));
 	}
-
-	UShort4 zValue16;
-	zValue16 = As<UShort4>(Insert(As<Int2>(zValue16), *Pointer<Int>(buffer), 0));
-	zValue16 = As<UShort4>(Insert(As<Int2>(zValue16), *Pointer<Int>(buffer + pitch), 1));
 	Float4 zValue = Float4(zValue16);
 	return SIMD::Float(zValue);
 }
@@ -551,20 +567,22 @@ Bool PixelRoutine::depthTest(const Pointer<Byte> &zBuffer, int q, const Int &x,
 
 Int4 PixelRoutine::depthBoundsTest16(const Pointer<Byte> &zBuffer, int q, const Int &x)
 {
-	Pointer<Byte> buffer = zBuffer + 2 * x;
-	Int pitch = *Pointer<Int>(data + OFFSET(DrawData, depthPitchB));
-
-	if(q > 0)
-	{
-		buffer += q * *Pointer<Int>(data + OFFSET(DrawData, depthSliceB));
-	}
+	Pointer<Byte> buffer = depthQuad(zBuffer, q, x, 2);
 
 	Float4 minDepthBound(state.minDepthBounds);
 	Float4 maxDepthBound(state.maxDepthBounds);
 
 	Int2 z;
-	z = Insert(z, *Pointer<Int>(buffer), 0);
-	z = Insert(z, *Pointer<Int>(buffer + pitch), 1);
+	if(state.depthQuadLayout)
+	{
+		z = *Pointer<Int2>(buffer, 2);
+	}
+	else
+	{
+		Int pitch = *Pointer<Int>(data + OFFSET(DrawData, depthPitchB));
+		z = Insert(z, *Pointer<Int>(buffer), 0);
+		z = Insert(z, *Pointer<Int>(buffer + pitch), 1);
+	}
 
 	Float4 zValue = Float4(As<UShort4>(z)) * (1.0f / 0xFFFF);
 	return Int4(CmpLE(minDepthBound, zValue) & CmpLE(zValue, maxDepthBound));
@@ -572,15 +590,18 @@ Int4 PixelRoutine::depthBoundsTest16(const Pointer<Byte> &zBuffer, int q, const
 
 Int4 PixelRoutine::depthBoundsTest32F(const Pointer<Byte> &zBuffer, int q, const Int &x)
 {
-	Pointer<Byte> buffer = zBuffer + 4 * x;
-	Int pitch = *Pointer<Int>(data + OFFSET(DrawData, depthPitchB));
+	Pointer<Byte> buffer = depthQuad(zBuffer, q, x, 4);
 
-	if(q > 0)
+	Float4 zValue;
+	if(state.depthQuadLayout)
 	{
-		buffer += q * *Pointer<Int>(data + OFFSET(DrawData, depthSliceB));
+		zValue = *Pointer<Float4>(buffer, 4);
+	}
+	else
+	{
+		Int pitch = *Pointer<Int>(data + OFFSET(DrawData, depthPitchB));
+		zValue = Float4(*Pointer<Float2>(buffer), *Pointer<Float2>(buffer + pitch));
 	}
-
-	Float4 zValue = Float4(*Pointer<Float2>(buffer), *Pointer<Float2>(buffer + pitch));
 	return Int4(CmpLE(state.minDepthBounds, zValue) & CmpLE(zValue, state.maxDepthBounds));
 }
 
@@ -637,55 +658,73 @@ void PixelRoutine::writeDepth32F(Pointer<Byte> &zBuffer, int q, const Int &x, co
 {
 	Float4 Z = z;
 
-	Pointer<Byte> buffer = zBuffer + 4 * x;
+	Pointer<Byte> buffer = depthQuad(zBuffer, q, x, 4);
 	Int pitch = *Pointer<Int>(data + OFFSET(DrawData, depthPitchB));
 
-	if(q > 0)
-	{
-		buffer += q * *Pointer<Int>(data + OFFSET(DrawData, depthSliceB));
-	}
-
 	Float4 zValue;
 
 	if(state.depthCompareMode != VK_COMPARE_OP_NEVER || (state.depthCompareMode != VK_COMPARE_OP_ALWAYS && !state.depthWriteEnable))
 	{
-		zValue = Float4(*Pointer<Float2>(buffer), *Pointer<Float2>(buffer + pitch));
+		if(state.depthQuadLayout)
+		{
+			zValue = *Pointer<Float4>(buffer, 4);
+		}
+		else
+		{
+			zValue = Float4(*Pointer<Float2>(buffer), *Pointer<Float2>(buffer + pitch));
+		}
 	}
 
 	Z = As<Float4>(As<Int4>(Z) & *Pointer<Int4>(constants + OFFSET(Constants, maskD4X) + zMask * 16, 16));
 	zValue = As<Float4>(As<Int4>(zValue) & *Pointer<Int4>(constants + OFFSET(Constants, invMaskD4X) + zMask * 16, 16));
 	Z = As<Float4>(As<Int4>(Z) | As<Int4>(zValue));
 
-	*Pointer<Float2>(buffer) = Float2(Z.xy);
-	*Pointer<Float2>(buffer + pitch) = Float2(Z.zw);
+	if(state.depthQuadLayout)
+	{
+		*Pointer<Float4>(buffer, 4) = Z;
+	}
+	else
+	{
+		*Pointer<Float2>(buffer) = Float2(Z.xy);
+		*Pointer<Float2>(buffer + pitch) = Float2(Z.zw);
+	}
 }
 
 void PixelRoutine::writeDepth16(Pointer<Byte> &zBuffer, int q, const Int &x, const Float4 &z, const Int &zMask)
 {
 	Short4 Z = UShort4(Round(z * 0xFFFF), true);
 
-	Pointer<Byte> buffer = zBuffer + 2 * x;
+	Pointer<Byte> buffer = depthQuad(zBuffer, q, x, 2);
 	Int pitch = *Pointer<Int>(data + OFFSET(DrawData, depthPitchB));
 
-	if(q > 0)
-	{
-		buffer += q * *Pointer<Int>(data + OFFSET(DrawData, depthSliceB));
-	}
-
 	Short4 zValue;
 
 	if(state.depthCompareMode != VK_COMPARE_OP_NEVER || (state.depthCompareMode != VK_COMPARE_OP_ALWAYS && !state.depthWriteEnable))
 	{
-		zValue = As<Short4>(Insert(As<Int2>(zValue), *Pointer<Int>(buffer), 0));
-		zValue = As<Short4>(Insert(As<Int2>(zValue), *Pointer<Int>(buffer + pitch), 1));
+		if(state.depthQuadLayout)
+		{
+			zValue = *Pointer<Short4>(buffer, 2);
+		}
+		else
+		{
+			zValue = As<Short4>(Insert(As<Int2>(zValue), *Pointer<Int>(buffer), 0));
+			zValue = As<Short4>(Insert(As<Int2>(zValue), *Pointer<Int>(buffer + pitch), 1));
+		}
 	}
 
 	Z = Z & *Pointer<Short4>(constants + OFFSET(Constants, maskW4Q) + zMask * 8, 8);
 	zValue = zValue & *Pointer<Short4>(constants + OFFSET(Constants, invMaskW4Q) + zMask * 8, 8);
 	Z = Z | zValue;
 
-	*Pointer<Int>(buffer) = Extract(As<Int2>(Z), 0);
-	*Pointer<Int>(buffer + pitch) = Extract(As<Int2>(Z), 1);
+	if(state.depthQuadLayout)
+	{
+		*Pointer<Short4>(buffer, 2) = Z;
+	}
+	else
+	{
+		*Pointer<Int>(buffer) = Extract(As<Int2>(Z), 0);
+		*Pointer<Int>(buffer + pitch) = Extract(As<Int2>(Z), 1);
+	}
 }
 
 void PixelRoutine::writeDepth(Pointer<Byte> &zBuffer, const Int &x, const Int zMask[4], const SampleSet &samples)
@@ -882,6 +921,22 @@ bool PixelRoutine::isSRGB(int index) const
 	return vk::Format(state.colorFormat[index]).isSRGBformat();
 }
 
+// Returns the distance from the first row of a quad to the second. The texels of quads in
+// color buffers with the quad layout are contiguous, so the buffer is offset by x texels
+// once more for the per-format code to address them as if they were in consecutive rows.
+Int PixelRoutine::colorPitchB(int index, const Int &x, Pointer<Byte> &buffer) const
+{
+	if(state.colorQuadLayout[index])
+	{
+		int bytes = vk::Format(state.colorFormat[index]).bytes();
+		buffer += bytes * x;
+
+		return Int(2 * bytes);
+	}
+
+	return *Pointer<Int>(data + OFFSET(DrawData, colorPitchB[index]));
+}
+
 void PixelRoutine::readPixel(int index, const Pointer<Byte> &cBuffer, const Int &x, Vector4s &pixel)
 {
 	Short4 c01;
@@ -889,7 +944,7 @@ void PixelRoutine::readPixel(int index, const Pointer<Byte> &cBuffer, const Int
 	Pointer<Byte> buffer = cBuffer;
 	Pointer<Byte> buffer2;
 
-	Int pitchB = *Pointer<Int>(data + OFFSET(DrawData, colorPitchB[index]));
+	Int pitchB = colorPitchB(index, x, buffer);
 
 	vk::Format format = state.colorFormat[index];
 	switch(format)
@@ -1153,7 +1208,7 @@ void PixelRoutine::readPixel(int index, const Pointer<Byte> &cBuffer, const Int
 			Int4 v = Int4(0);
 			v = Insert(v, *Pointer<Int>(buffer + 4 * x), 0);
 			v = Insert(v, *Pointer<Int>(buffer + 4 * x + 4), 1);
-			buffer += *Pointer<Int>(data + OFFSET(DrawData, colorPitchB[index]));
+			buffer += pitchB;
 			v = Insert(v, *Pointer<Int>(buffer + 4 * x), 2);
 			v = Insert(v, *Pointer<Int>(buffer + 4 * x + 4), 3);
 
@@ -1637,7 +1692,7 @@ SIMD::Float4 PixelRoutine::alphaBlend(int index, const Pointer<Byte> &cBuffer, c
 	ASSERT(format.supportsColorAttachmentBlend());
 
 	Pointer<Byte> buffer = cBuffer;
-	Int pitchB = *Pointer<Int>(data + OFFSET(DrawData, colorPitchB[index]));
+	Int pitchB = colorPitchB(index, x, buffer);
 
 	// texelColor holds four texel color values.
 	// Note: Despite the type being Vector4f, the colors may be stored as
@@ -2135,7 +2190,7 @@ void PixelRoutine::writeColor(int index, const Pointer<Byte> &cBuffer, const Int
 	}
 
 	Pointer<Byte> buffer = cBuffer;
-	Int pitchB = *Pointer<Int>(data + OFFSET(DrawData, colorPitchB[index]));
+	Int pitchB = colorPitchB(index, x, buffer);
 	Float4 value;
 
 	switch(format)
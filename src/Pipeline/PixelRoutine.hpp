@@ -73,6 +73,7 @@ private:
 	void depthBoundsTest(const Pointer<Byte> &zBuffer, int q, const Int &x, Int &zMask, Int &cMask);
 
 	void readPixel(int index, const Pointer<Byte> &cBuffer, const Int &x, Vector4s &pixel);
+	Int colorPitchB(int index, const Int &x, Pointer<Byte> &buffer) const;
 	enum BlendFactorModifier
 	{
 		None,
@@ -101,6 +102,7 @@ private:
 	void writeDepth(Pointer<Byte> &zBuffer, const Int &x, const Int zMask[4], const SampleSet &samples);
 	void occlusionSampleCount(const Int zMask[4], const Int sMask[4], const SampleSet &samples);
 
+	Pointer<Byte> depthQuad(const Pointer<Byte> &zBuffer, int q, const Int &x, int bytes) const;
 	SIMD::Float readDepth32F(const Pointer<Byte> &zBuffer, int q, const Int &x) const;
 	SIMD::Float readDepth16(const Pointer<Byte> &zBuffer, int q, const Int &x) const;
 
@@ -173,7 +173,8 @@ Vector4f SamplerCore::sampleTexture128(Pointer<Byte> &texture, Float4 uvwa[4], c
 	bool force32BitFiltering = state.highPrecisionFiltering && !isYcbcrFormat() && (state.textureFilter != FILTER_POINT);
 	bool use32BitFiltering = hasFloatTexture() || hasUnnormalizedIntegerTexture() || force32BitFiltering ||
 	                         state.isCube() || state.unnormalizedCoordinates || state.compareEnable ||
-	                         borderModeActive() || (function == Gather) || (function == Fetch);
+	                         borderModeActive() || (function == Gather) || (function == Fetch) ||
+	                         hasBlockCompressedFormat();
 	int numComponents = (function == Gather) ? 4 : textureComponentCount();
 
 	if(use32BitFiltering)
@@ -1169,8 +1170,14 @@ Vector4f SamplerCore::sampleFloat2D(Pointer<Byte> &texture, Float4 &u, Float4 &v
 	address(u, x0, x1, fu, mipmap, filter, OFFSET(Mipmap, width), state.addressingModeU);
 	address(v, y0, y1, fv, mipmap, filter, OFFSET(Mipmap, height), state.addressingModeV);
 
+	// Block-compressed texels and the quad layout are located from their coordinates rather than a linear index.
+	bool linearIndex = !hasBlockCompressedFormat() && !state.quadLayout;
+
 	Int4 pitchP = As<Int4>(*Pointer<UInt4>(mipmap + OFFSET(Mipmap, pitchP), 16));
-	y0 *= pitchP;
+	if(linearIndex)
+	{
+		y0 *= pitchP;
+	}
 
 	Int4 z;
 	if(state.isCube() || state.isArrayed())
@@ -1200,7 +1207,10 @@ Vector4f SamplerCore::sampleFloat2D(Pointer<Byte> &texture, Float4 &u, Float4 &v
 	}
 	else
 	{
-		y1 *= pitchP;
+		if(linearIndex)
+		{
+			y1 *= pitchP;
+		}
 
 		Vector4f c00 = sampleTexel(x0, y0, z, dRef, sample, mipmap, buffer);
 		Vector4f c10 = sampleTexel(x1, y0, z, dRef, sample, mipmap, buffer);
@@ -1599,12 +1609,19 @@ void SamplerCore::computeIndices(UInt index[4], Short4 uuuu, Short4 vvvv, Short4
 	{
 		vvvv = MulHigh(As<UShort4>(vvvv), UShort4(*Pointer<UInt4>(mipmap + OFFSET(Mipmap, height))));
 
-		Short4 uv0uv1 = As<Short4>(UnpackLow(uuuu, vvvv));
-		Short4 uv2uv3 = As<Short4>(UnpackHigh(uuuu, vvvv));
-		Int2 i01 = MulAdd(uv0uv1, *Pointer<Short4>(mipmap + OFFSET(Mipmap, onePitchP)));
-		Int2 i23 = MulAdd(uv2uv3, *Pointer<Short4>(mipmap + OFFSET(Mipmap, onePitchP)));
+		if(state.quadLayout)
+		{
+			indices = computeQuadLayoutIndices(Int4(As<UShort4>(uuuu)), Int4(As<UShort4>(vvvv)), mipmap);
+		}
+		else
+		{
+			Short4 uv0uv1 = As<Short4>(UnpackLow(uuuu, vvvv));
+			Short4 uv2uv3 = As<Short4>(UnpackHigh(uuuu, vvvv));
+			Int2 i01 = MulAdd(uv0uv1, *Pointer<Short4>(mipmap + OFFSET(Mipmap, onePitchP)));
+			Int2 i23 = MulAdd(uv2uv3, *Pointer<Short4>(mipmap + OFFSET(Mipmap, onePitchP)));
 
-		indices = UInt4(As<UInt2>(i01), As<UInt2>(i23));
+			indices = UInt4(As<UInt2>(i01), As<UInt2>(i23));
+		}
 	}
 
 	if(state.is3D())
@@ -1645,7 +1662,12 @@ void SamplerCore::computeIndices(UInt index[4], Int4 uuuu, Int4 vvvv, Int4 wwww,
 {
 	UInt4 indices = uuuu;
 
-	if(state.is2D() || state.is3D() || state.isCube())
+	if(state.quadLayout)
+	{
+		// vvvv is not premultiplied by the pitch.
+		indices = computeQuadLayoutIndices(uuuu, vvvv, mipmap);
+	}
+	else if(state.is2D() || state.is3D() || state.isCube())
 	{
 		indices += As<UInt4>(vvvv);
 	}
@@ -1674,6 +1696,17 @@ void SamplerCore::computeIndices(UInt index[4], Int4 uuuu, Int4 vvvv, Int4 wwww,
 	}
 }
 
+// Images with the quad layout store the texels of each 2x2 quad contiguously, with the
+// quads of each pair of rows in turn. See vk::Image::texelOffsetBytesInStorage().
+UInt4 SamplerCore::computeQuadLayoutIndices(const Int4 &uuuu, const Int4 &vvvv, const Pointer<Byte> &mipmap)
+{
+	ASSERT(state.is2D());
+
+	Int4 pitchP = *Pointer<Int4>(mipmap + OFFSET(Mipmap, pitchP), 16);
+
+	return As<UInt4>((vvvv & Int4(~1)) * pitchP + ((vvvv & Int4(1)) << 1) + (uuuu & Int4(~1)) + uuuu);
+}
+
 Vector4s SamplerCore::sampleTexel(UInt index[4], Pointer<Byte> buffer)
 {
 	Vector4s c;
@@ -2101,7 +2134,10 @@ Vector4f SamplerCore::sampleTexel(Int4 &uuuu, Int4 &vvvv, Int4 &wwww, const Floa
 	}
 
 	UInt index[4];
-	computeIndices(index, uuuu, vvvv, wwww, sample, valid, mipmap);
+	if(!hasBlockCompressedFormat())
+	{
+		computeIndices(index, uuuu, vvvv, wwww, sample, valid, mipmap);
+	}
 
 	Vector4f c;
 
@@ -2213,7 +2249,7 @@ Vector4f SamplerCore::sampleTexel(Int4 &uuuu, Int4 &vvvv, Int4 &wwww, const Floa
 	{
 		ASSERT(!isYcbcrFormat());
 
-		Vector4s cs = sampleTexel(index, buffer);
+		Vector4s cs = hasBlockCompressedFormat() ? sampleBlockTexel(uuuu, vvvv, wwww, valid, mipmap, buffer) : sampleTexel(index, buffer);
 
 		bool isInteger = state.textureFormat.isUnnormalizedInteger();
 		int componentCount = textureComponentCount();
@@ -2284,6 +2320,180 @@ Vector4f SamplerCore::sampleTexel(Int4 &uuuu, Int4 &vvvv, Int4 &wwww, const Floa
 	return c;
 }
 
+Vector4s SamplerCore::sampleBlockTexel(Int4 x, Int4 y, Int4 z, const Int4 &valid, const Pointer<Byte> &mipmap, Pointer<Byte> buffer)
+{
+	ASSERT(state.is2D());
+
+	if(borderModeActive())
+	{
+		// Texels out of range are still sampled before being replaced
+		// with the border color, so sample them from the first block.
+		x &= valid;
+		y &= valid;
+		z &= valid;
+	}
+
+	// The pitches of block-compressed mipmaps are in blocks.
+	Int4 block = (y >> 2) * *Pointer<Int4>(mipmap + OFFSET(Mipmap, pitchP), 16) + (x >> 2);
+
+	if(state.isArrayed())
+	{
+		block += z;
+	}
+
+	UInt4 texel = As<UInt4>((x & Int4(3)) | ((y & Int4(3)) << 2));  // Index within the 4x4 block
+
+	// Load the blocks as 32-bit words. 8-byte blocks only fill the first two.
+	int blockBytes = static_cast<int>(state.compressedFormat.bytesPerBlock());
+	UInt4 word[4];
+
+	for(int i = 0; i < 4; i++)
+	{
+		Pointer<Byte> data = buffer + Extract(block, i) * Int(blockBytes);
+
+		for(int j = 0; j < blockBytes / 4; j++)
+		{
+			word[j] = Insert(word[j], *Pointer<UInt>(data + 4 * j), i);
+		}
+	}
+
+	Vector4i color;
+
+	switch(state.compressedFormat)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		color = decodeColorBlock(word[0], word[1], texel, false, false);
+		break;
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		color = decodeColorBlock(word[0], word[1], texel, true, false);
+		break;
+	case VK_FORMAT_BC2_UNORM_BLOCK:
+	case VK_FORMAT_BC2_SRGB_BLOCK:
+		{
+			color = decodeColorBlock(word[2], word[3], texel, false, true);
+
+			// Explicit 4-bit alpha, eight texels per word.
+			UInt4 firstHalf = CmpLT(texel, UInt4(8));
+			UInt4 alpha = (word[0] & firstHalf) | (word[1] & ~firstHalf);
+			alpha = (alpha >> ((texel & UInt4(7)) << 2)) & UInt4(0xF);
+			color.w = As<Int4>(alpha | (alpha << 4));
+		}
+		break;
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+		color = decodeColorBlock(word[2], word[3], texel, false, true);
+		color.w = decodeChannelBlock(word[0], word[1], texel);
+		break;
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+		color.x = decodeChannelBlock(word[0], word[1], texel);
+		break;
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+		color.x = decodeChannelBlock(word[0], word[1], texel);
+		color.y = decodeChannelBlock(word[2], word[3], texel);
+		break;
+	default:
+		UNSUPPORTED("Format %d", VkFormat(state.compressedFormat));
+	}
+
+	Vector4s c;
+
+	for(int i = 0; i < textureComponentCount(); i++)
+	{
+		// 8-bit components are represented with 0xFF00 as 1.0, like uncompressed texels.
+		c[i] = Short4(color[i] << 8);
+
+		if(state.textureFormat.isSRGBformat() && isRGBComponent(i))
+		{
+			sRGBtoLinearFF00(c[i]);
+		}
+	}
+
+	return c;
+}
+
+// Decodes the BC1 color block, or the color half of a BC2 or BC3 block, into 8-bit RGBA.
+Vector4i SamplerCore::decodeColorBlock(const UInt4 &endpoints, const UInt4 &indices, const UInt4 &texel, bool hasAlpha, bool separateAlpha)
+{
+	Int4 c0 = As<Int4>(endpoints & UInt4(0xFFFF));
+	Int4 c1 = As<Int4>(endpoints >> 16);
+
+	Int4 index = As<Int4>((indices >> (texel << 1)) & UInt4(3));
+	Int4 select0 = CmpEQ(index, Int4(0));
+	Int4 select1 = CmpEQ(index, Int4(1));
+	Int4 select2 = CmpEQ(index, Int4(2));
+	Int4 select3 = CmpEQ(index, Int4(3));
+
+	// Blocks without separate alpha use three colors and black when c0 <= c1.
+	Int4 fourColors = Int4(-1);
+
+	if(!separateAlpha)
+	{
+		fourColors = CmpGT(c0, c1);
+	}
+
+	Vector4i color;
+
+	for(int i = 0; i < 3; i++)
+	{
+		// Red, green and blue occupy 5, 6 and 5 bits, from the top.
+		const int shift = (i == 0) ? 11 : (i == 1) ? 5 : 0;
+		const int bits = (i == 1) ? 6 : 5;
+		const int mask = (1 << bits) - 1;
+
+		Int4 e0 = (c0 >> shift) & Int4(mask);
+		Int4 e1 = (c1 >> shift) & Int4(mask);
+		e0 = (e0 << (8 - bits)) | (e0 >> (2 * bits - 8));
+		e1 = (e1 << (8 - bits)) | (e1 >> (2 * bits - 8));
+
+		// Divisions by 3 are performed as a multiplication and shift, which is exact for these ranges.
+		Int4 c2 = (((((e0 << 1) + e1) * Int4(21846)) >> 16) & fourColors) | (((e0 + e1) >> 1) & ~fourColors);
+		Int4 c3 = ((((e1 << 1) + e0) * Int4(21846)) >> 16) & fourColors;
+
+		color[i] = (e0 & select0) | (e1 & select1) | (c2 & select2) | (c3 & select3);
+	}
+
+	color.w = Int4(0xFF);
+
+	if(hasAlpha)
+	{
+		color.w &= ~(select3 & ~fourColors);
+	}
+
+	return color;
+}
+
+// Decodes a BC4 block, or a channel of a BC3 or BC5 block, into 8-bit unsigned values.
+Int4 SamplerCore::decodeChannelBlock(const UInt4 &low, const UInt4 &high, const UInt4 &texel)
+{
+	Int4 r0 = As<Int4>(low & UInt4(0xFF));
+	Int4 r1 = As<Int4>((low >> 8) & UInt4(0xFF));
+
+	// The 3-bit indices of the first and last eight texels each take 24 bits.
+	UInt4 firstHalf = CmpLT(texel, UInt4(8));
+	UInt4 indices = (((low >> 16) | (high << 16)) & firstHalf) | ((high >> 8) & ~firstHalf);
+	Int4 index = As<Int4>((indices >> ((texel & UInt4(7)) * UInt4(3))) & UInt4(7));
+
+	// Blocks interpolate eight values when r0 > r1, or six values plus 0 and 255 otherwise.
+	Int4 eightValues = CmpGT(r0, r1);
+	Int4 weight = index - Int4(1);
+
+	// Divisions by 7 and 5 are performed as a multiplication and shift, which is exact for these ranges.
+	Int4 value7 = (((Int4(7) - weight) * r0 + weight * r1) * Int4(9363)) >> 16;
+	Int4 value5 = (((Int4(5) - weight) * r0 + weight * r1) * Int4(13108)) >> 16;
+	Int4 value = (value7 & eightValues) | (value5 & ~eightValues);
+
+	Int4 extreme = CmpGT(index, Int4(5)) & ~eightValues;
+	value = (value & ~extreme) | (CmpEQ(index, Int4(7)) & extreme & Int4(0xFF));
+
+	Int4 select0 = CmpEQ(index, Int4(0));
+	Int4 select1 = CmpEQ(index, Int4(1));
+	value = (value & ~(select0 | select1)) | (r0 & select0) | (r1 & select1);
+
+	return value;
+}
+
 Vector4f SamplerCore::replaceBorderTexel(const Vector4f &c, Int4 valid)
 {
 	Vector4i border;
@@ -2726,6 +2936,11 @@ bool SamplerCore::isYcbcrFormat() const
 	return state.textureFormat.isYcbcrFormat();
 }
 
+bool SamplerCore::hasBlockCompressedFormat() const
+{
+	return state.compressedFormat != VK_FORMAT_UNDEFINED;
+}
+
 bool SamplerCore::isRGBComponent(int component) const
 {
 	return state.textureFormat.isRGBComponent(component);
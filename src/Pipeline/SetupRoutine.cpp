@@ -144,7 +144,9 @@ void SetupRoutine::generate()
 			Until(i >= n);
 		}
 
-		// Vertical range
+		// Horizontal and vertical range
+		Int xMin = X[0];
+		Int xMax = X[0];
 		Int yMin = Y[0];
 		Int yMax = Y[0];
 
@@ -152,6 +154,8 @@ void SetupRoutine::generate()
 
 		Do
 		{
+			xMin = Min(X[i], xMin);
+			xMax = Max(X[i], xMax);
 			yMin = Min(Y[i], yMin);
 			yMax = Max(Y[i], yMax);
 
@@ -208,8 +212,10 @@ void SetupRoutine::generate()
 			}
 			Until(i >= n);
 
-			Pointer<Byte> leftEdge = Pointer<Byte>(primitive + OFFSET(Primitive, outline->left)) + q * sizeof(Primitive);
-			Pointer<Byte> rightEdge = Pointer<Byte>(primitive + OFFSET(Primitive, outline->right)) + q * sizeof(Primitive);
+			Pointer<Byte> outline = *Pointer<Pointer<Byte>>(primitive + q * sizeof(Primitive) + OFFSET(Primitive, outline));
+			outline -= *Pointer<Int>(data + OFFSET(DrawData, outlineFirstRow)) * Int(sizeof(Primitive::Span));  // Index by absolute row
+			Pointer<Byte> leftEdge = outline + OFFSET(Primitive::Span, left);
+			Pointer<Byte> rightEdge = outline + OFFSET(Primitive::Span, right);
 
 			if(state.enableMultiSampling)
 			{
@@ -267,6 +273,13 @@ void SetupRoutine::generate()
 		*Pointer<Int>(primitive + OFFSET(Primitive, yMin)) = yMin;
 		*Pointer<Int>(primitive + OFFSET(Primitive, yMax)) = yMax;
 
+		// The horizontal range is only used for binning primitives into screen tiles,
+		// so it is rounded outward to also cover the multisample locations.
+		xMin = Max((xMin >> subPixB) - 1, *Pointer<Int>(data + OFFSET(DrawData, scissorX0)));
+		xMax = Min((xMax >> subPixB) + 2, *Pointer<Int>(data + OFFSET(DrawData, scissorX1)));
+		*Pointer<Int>(primitive + OFFSET(Primitive, xMin)) = xMin;
+		*Pointer<Int>(primitive + OFFSET(Primitive, xMax)) = xMax;
+
 		// Sort by minimum y
 		if(triangle)
 		{
@@ -571,8 +584,10 @@ void SetupRoutine::edge(Pointer<Byte> &primitive, Pointer<Byte> &data, const Int
 			Int xMin = *Pointer<Int>(data + OFFSET(DrawData, scissorX0));
 			Int xMax = *Pointer<Int>(data + OFFSET(DrawData, scissorX1));
 
-			Pointer<Byte> leftEdge = primitive + q * sizeof(Primitive) + OFFSET(Primitive, outline->left);
-			Pointer<Byte> rightEdge = primitive + q * sizeof(Primitive) + OFFSET(Primitive, outline->right);
+			Pointer<Byte> outline = *Pointer<Pointer<Byte>>(primitive + q * sizeof(Primitive) + OFFSET(Primitive, outline));
+			outline -= *Pointer<Int>(data + OFFSET(DrawData, outlineFirstRow)) * Int(sizeof(Primitive::Span));  // Index by absolute row
+			Pointer<Byte> leftEdge = outline + OFFSET(Primitive::Span, left);
+			Pointer<Byte> rightEdge = outline + OFFSET(Primitive::Span, right);
 			Pointer<Byte> edge = IfThenElse(swap, rightEdge, leftEdge);
 
 			// Deltas
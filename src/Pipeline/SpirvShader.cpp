@@ -677,6 +677,13 @@ Spirv::Spirv(
 		case spv::OpDPdyFine:
 		case spv::OpFwidthFine:
 		case spv::OpAtomicLoad:
+		case spv::OpPhi:
+		case spv::OpArrayLength:
+		case spv::OpIsHelperInvocationEXT:
+			// Instructions that yield an intermediate value or divergent pointer
+			DefineResult(insn);
+			break;
+
 		case spv::OpAtomicIAdd:
 		case spv::OpAtomicISub:
 		case spv::OpAtomicSMin:
@@ -690,7 +697,10 @@ Spirv::Spirv(
 		case spv::OpAtomicIDecrement:
 		case spv::OpAtomicExchange:
 		case spv::OpAtomicCompareExchange:
-		case spv::OpPhi:
+			DefineResult(insn);
+			AnalyzeMemoryWrite(insn.word(3));
+			break;
+
 		case spv::OpImageSampleImplicitLod:
 		case spv::OpImageSampleExplicitLod:
 		case spv::OpImageSampleDrefImplicitLod:
@@ -709,6 +719,10 @@ Spirv::Spirv(
 		case spv::OpImageQuerySamples:
 		case spv::OpImageRead:
 		case spv::OpImageTexelPointer:
+			analysis.ContainsImageInstructions = true;
+			DefineResult(insn);
+			break;
+
 		case spv::OpGroupNonUniformElect:
 		case spv::OpGroupNonUniformAll:
 		case spv::OpGroupNonUniformAny:
@@ -743,9 +757,7 @@ Spirv::Spirv(
 		case spv::OpGroupNonUniformLogicalAnd:
 		case spv::OpGroupNonUniformLogicalOr:
 		case spv::OpGroupNonUniformLogicalXor:
-		case spv::OpArrayLength:
-		case spv::OpIsHelperInvocationEXT:
-			// Instructions that yield an intermediate value or divergent pointer
+			analysis.ContainsGroupOperations = true;
 			DefineResult(insn);
 			break;
 
@@ -769,11 +781,15 @@ Spirv::Spirv(
 		case spv::OpStore:
 		case spv::OpAtomicStore:
 		case spv::OpCopyMemory:
+			AnalyzeMemoryWrite(insn.word(1));
+			break;
+
 		case spv::OpMemoryBarrier:
 			// Don't need to do anything during analysis pass
 			break;
 
 		case spv::OpImageWrite:
+			analysis.ContainsImageInstructions = true;
 			analysis.ContainsImageWrite = true;
 			break;
 
@@ -1674,6 +1690,31 @@ void Spirv::ApplyDecorationsForIdMember(Decorations *d, Type::ID id, uint32_t me
 	}
 }
 
+void Spirv::AnalyzeMemoryWrite(Object::ID pointerId)
+{
+	auto it = defs.find(pointerId);
+	if(it == defs.end())
+	{
+		// Pointers of unknown origin may alias any buffer.
+		analysis.ContainsBufferWrite = true;
+		return;
+	}
+
+	switch(getType(it->second).storageClass)
+	{
+	case spv::StorageClassUniform:  // BufferBlock decorated storage buffers
+	case spv::StorageClassStorageBuffer:
+	case spv::StorageClassPhysicalStorageBuffer:
+		analysis.ContainsBufferWrite = true;
+		break;
+	case spv::StorageClassImage:  // Atomics through OpImageTexelPointer
+		analysis.ContainsImageWrite = true;
+		break;
+	default:
+		break;
+	}
+}
+
 void Spirv::DefineResult(const InsnIterator &insn)
 {
 	Type::ID typeId = insn.word(1);
@@ -2875,14 +2916,16 @@ SpirvRoutine::SpirvRoutine(const vk::PipelineLayout *pipelineLayout)
 
 void SpirvRoutine::setImmutableInputBuiltins(const SpirvShader *shader)
 {
+	const int laneBits = (1 << SIMD::Width) - 1;
+
 	setInputBuiltin(shader, spv::BuiltInSubgroupLocalInvocationId, [&](const Spirv::BuiltinMapping &builtin, Array<SIMD::Float> &value) {
 		ASSERT(builtin.SizeInComponents == 1);
-		value[builtin.FirstComponent] = As<SIMD::Float>(SIMD::Int(0, 1, 2, 3));
+		value[builtin.FirstComponent] = As<SIMD::Float>(SIMD::Int([](int i) { return i; }));
 	});
 
 	setInputBuiltin(shader, spv::BuiltInSubgroupEqMask, [&](const Spirv::BuiltinMapping &builtin, Array<SIMD::Float> &value) {
 		ASSERT(builtin.SizeInComponents == 4);
-		value[builtin.FirstComponent + 0] = As<SIMD::Float>(SIMD::Int(1, 2, 4, 8));
+		value[builtin.FirstComponent + 0] = As<SIMD::Float>(SIMD::Int([](int i) { return 1 << i; }));
 		value[builtin.FirstComponent + 1] = As<SIMD::Float>(SIMD::Int(0, 0, 0, 0));
 		value[builtin.FirstComponent + 2] = As<SIMD::Float>(SIMD::Int(0, 0, 0, 0));
 		value[builtin.FirstComponent + 3] = As<SIMD::Float>(SIMD::Int(0, 0, 0, 0));
@@ -2890,7 +2933,7 @@ void SpirvRoutine::setImmutableInputBuiltins(const SpirvShader *shader)
 
 	setInputBuiltin(shader, spv::BuiltInSubgroupGeMask, [&](const Spirv::BuiltinMapping &builtin, Array<SIMD::Float> &value) {
 		ASSERT(builtin.SizeInComponents == 4);
-		value[builtin.FirstComponent + 0] = As<SIMD::Float>(SIMD::Int(15, 14, 12, 8));
+		value[builtin.FirstComponent + 0] = As<SIMD::Float>(SIMD::Int([&](int i) { return laneBits & ~((1 << i) - 1); }));
 		value[builtin.FirstComponent + 1] = As<SIMD::Float>(SIMD::Int(0, 0, 0, 0));
 		value[builtin.FirstComponent + 2] = As<SIMD::Float>(SIMD::Int(0, 0, 0, 0));
 		value[builtin.FirstComponent + 3] = As<SIMD::Float>(SIMD::Int(0, 0, 0, 0));
@@ -2898,7 +2941,7 @@ void SpirvRoutine::setImmutableInputBuiltins(const SpirvShader *shader)
 
 	setInputBuiltin(shader, spv::BuiltInSubgroupGtMask, [&](const Spirv::BuiltinMapping &builtin, Array<SIMD::Float> &value) {
 		ASSERT(builtin.SizeInComponents == 4);
-		value[builtin.FirstComponent + 0] = As<SIMD::Float>(SIMD::Int(14, 12, 8, 0));
+		value[builtin.FirstComponent + 0] = As<SIMD::Float>(SIMD::Int([&](int i) { return laneBits & ~((2 << i) - 1); }));
 		value[builtin.FirstComponent + 1] = As<SIMD::Float>(SIMD::Int(0, 0, 0, 0));
 		value[builtin.FirstComponent + 2] = As<SIMD::Float>(SIMD::Int(0, 0, 0, 0));
 		value[builtin.FirstComponent + 3] = As<SIMD::Float>(SIMD::Int(0, 0, 0, 0));
@@ -2906,7 +2949,7 @@ void SpirvRoutine::setImmutableInputBuiltins(const SpirvShader *shader)
 
 	setInputBuiltin(shader, spv::BuiltInSubgroupLeMask, [&](const Spirv::BuiltinMapping &builtin, Array<SIMD::Float> &value) {
 		ASSERT(builtin.SizeInComponents == 4);
-		value[builtin.FirstComponent + 0] = As<SIMD::Float>(SIMD::Int(1, 3, 7, 15));
+		value[builtin.FirstComponent + 0] = As<SIMD::Float>(SIMD::Int([](int i) { return (2 << i) - 1; }));
 		value[builtin.FirstComponent + 1] = As<SIMD::Float>(SIMD::Int(0, 0, 0, 0));
 		value[builtin.FirstComponent + 2] = As<SIMD::Float>(SIMD::Int(0, 0, 0, 0));
 		value[builtin.FirstComponent + 3] = As<SIMD::Float>(SIMD::Int(0, 0, 0, 0));
@@ -2914,7 +2957,7 @@ void SpirvRoutine::setImmutableInputBuiltins(const SpirvShader *shader)
 
 	setInputBuiltin(shader, spv::BuiltInSubgroupLtMask, [&](const Spirv::BuiltinMapping &builtin, Array<SIMD::Float> &value) {
 		ASSERT(builtin.SizeInComponents == 4);
-		value[builtin.FirstComponent + 0] = As<SIMD::Float>(SIMD::Int(0, 1, 3, 7));
+		value[builtin.FirstComponent + 0] = As<SIMD::Float>(SIMD::Int([](int i) { return (1 << i) - 1; }));
 		value[builtin.FirstComponent + 1] = As<SIMD::Float>(SIMD::Int(0, 0, 0, 0));
 		value[builtin.FirstComponent + 2] = As<SIMD::Float>(SIMD::Int(0, 0, 0, 0));
 		value[builtin.FirstComponent + 3] = As<SIMD::Float>(SIMD::Int(0, 0, 0, 0));
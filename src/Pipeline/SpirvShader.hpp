@@ -565,10 +565,14 @@ public:
 		bool NeedsCentroid : 1;
 		bool ContainsSampleQualifier : 1;
 		bool ContainsImageWrite : 1;
+		bool ContainsBufferWrite : 1;        // Stores or atomics through storage buffer pointers
+		bool ContainsImageInstructions : 1;  // Image sampling, fetches, queries, reads, or writes
+		bool ContainsGroupOperations : 1;    // OpGroupNonUniform* instructions
 	};
 
 	const Analysis &getAnalysis() const { return analysis; }
 	bool containsImageWrite() const { return analysis.ContainsImageWrite; }
+	bool containsBufferWrite() const { return analysis.ContainsBufferWrite; }
 
 	bool coverageModified() const
 	{
@@ -859,6 +863,9 @@ public:
 	// Creates an Object for the instruction's result in 'defs'.
 	void DefineResult(const InsnIterator &insn);
 
+	// Records a store or atomic through the pointer in the analysis flags.
+	void AnalyzeMemoryWrite(Object::ID pointerId);
+
 	using InterfaceVisitor = std::function<void(Decorations const, AttribType)>;
 
 	void VisitInterface(Object::ID id, const InterfaceVisitor &v) const;
@@ -1050,6 +1057,11 @@ public:
 	                 const vk::DescriptorSet::Bindings &descriptorSets,
 	                 unsigned int multiSampleCount);
 
+	// Creates the sampling routines the image view and sampler are likely to
+	// be used with, on the device's scheduler. A samplerId of 0 denotes the
+	// absence of a sampler.
+	static void prewarmImageSamplers(vk::Device *device, uint32_t imageViewId, uint32_t samplerId, bool storageImage);
+
 	// Helper for calling rr::Yield with result cast to an rr::Int.
 	enum class YieldResult
 	{
@@ -1556,6 +1568,7 @@ private:
 
 	using ImageSampler = void(void *texture, void *uvsIn, void *texelOut, void *constants);
 	static ImageSampler *getImageSampler(const vk::Device *device, uint32_t signature, uint32_t samplerId, uint32_t imageViewId);
+	static std::shared_ptr<rr::Routine> createSamplingRoutine(uint32_t signature, const vk::SamplerState *vkSamplerState, uint32_t imageViewId);
 	static std::shared_ptr<rr::Routine> emitSamplerRoutine(ImageInstructionSignature instruction, const Sampler &samplerState);
 	static std::shared_ptr<rr::Routine> emitWriteRoutine(ImageInstructionSignature instruction, const Sampler &samplerState);
 
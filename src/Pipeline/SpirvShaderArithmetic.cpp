@@ -626,8 +626,7 @@ SIMD::Int SpirvEmitter::SDot(unsigned numComponents, const Operand &x, const Ope
 
 	if(numComponents == 1)  // 4x8bit packed
 	{
-		numComponents = 4;
-		for(auto i = 0u; i < numComponents; i++)
+		for(int i = 0; i < SIMD::Width; i++)
 		{
 			Int4 xs(As<SByte4>(Extract(x.Int(0), i)));
 			Int4 ys(As<SByte4>(Extract(y.Int(0), i)));
@@ -662,8 +661,7 @@ SIMD::UInt SpirvEmitter::UDot(unsigned numComponents, const Operand &x, const Op
 
 	if(numComponents == 1)  // 4x8bit packed
 	{
-		numComponents = 4;
-		for(auto i = 0u; i < numComponents; i++)
+		for(int i = 0; i < SIMD::Width; i++)
 		{
 			Int4 xs(As<Byte4>(Extract(x.Int(0), i)));
 			Int4 ys(As<Byte4>(Extract(y.Int(0), i)));
@@ -698,8 +696,7 @@ SIMD::Int SpirvEmitter::SUDot(unsigned numComponents, const Operand &x, const Op
 
 	if(numComponents == 1)  // 4x8bit packed
 	{
-		numComponents = 4;
-		for(auto i = 0u; i < numComponents; i++)
+		for(int i = 0; i < SIMD::Width; i++)
 		{
 			Int4 xs(As<SByte4>(Extract(x.Int(0), i)));
 			Int4 ys(As<Byte4>(Extract(y.Int(0), i)));
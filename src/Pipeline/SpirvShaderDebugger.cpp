@@ -48,7 +48,8 @@
 namespace sw {
 namespace SIMD {
 
-// PerLane is a SIMD vector that holds N vectors of width SIMD::Width.
+// PerLane is a SIMD vector that holds N vectors of width SIMD::Width, in storage
+// sized for SIMD::MaxWidth lanes.
 // PerLane operator[] returns the elements of a single lane (a transpose of the
 // storage arrays).
 template<typename T, int N = 1>
@@ -63,14 +64,14 @@ struct PerLane
 		}
 		return out;
 	}
-	std::array<sw::vec<T, Width>, N> elements;
+	std::array<sw::vec<T, MaxWidth>, N> elements;
 };
 
 template<typename T>
 struct PerLane<T, 1>
 {
 	const T &operator[](int lane) const { return data[lane]; }
-	std::array<T, Width> data;
+	std::array<T, MaxWidth> data;
 };
 
 using uint_t = PerLane<unsigned int>;
@@ -181,6 +182,9 @@ template<> struct ReactorTypeSize<rr::Int>    { static constexpr const int value
 template<> struct ReactorTypeSize<rr::Float>  { static constexpr const int value = 4; };
 template<> struct ReactorTypeSize<rr::Int4>   { static constexpr const int value = 16; };
 template<> struct ReactorTypeSize<rr::Float4> { static constexpr const int value = 16; };
+// SIMD vectors are stored with the lane stride of sw::SIMD::PerLane.
+template<> struct ReactorTypeSize<rr::SIMD::Int>   { static constexpr const int value = 4 * rr::SIMD::MaxWidth; };
+template<> struct ReactorTypeSize<rr::SIMD::Float> { static constexpr const int value = 4 * rr::SIMD::MaxWidth; };
 // clang-format on
 
 // store() emits a store instruction to copy val into ptr.
@@ -1059,8 +1063,8 @@ struct SpirvShader::Impl::Debugger : public vk::dbg::ClientEventListener
 		// The address for a given SIMD lane is the base + offsets[lane].
 		struct Pointer
 		{
-			uint8_t *base;                      // Common base address for all SIMD lanes.
-			uint32_t offsets[sw::SIMD::Width];  // Per lane offsets.
+			uint8_t *base;                         // Common base address for all SIMD lanes.
+			uint32_t offsets[sw::SIMD::MaxWidth];  // Per lane offsets. Only the first SIMD::Width are stored.
 		};
 
 		// Memory is returned by get().
@@ -1326,7 +1330,7 @@ private:
 		void trap(int index, State *state);
 
 	private:
-		using PerLaneVariables = std::array<std::shared_ptr<vk::dbg::VariableContainer>, sw::SIMD::Width>;
+		using PerLaneVariables = std::array<std::shared_ptr<vk::dbg::VariableContainer>, sw::SIMD::MaxWidth>;
 
 		struct StackEntry
 		{
@@ -2005,8 +2009,9 @@ SpirvShader::Impl::Debugger::Shadow::Memory::operator void *()
 SpirvShader::Impl::Debugger::Shadow::Memory
 SpirvShader::Impl::Debugger::Shadow::Memory::dref(int lane) const
 {
-	auto ptr = *reinterpret_cast<Pointer *>(addr);
-	return Memory{ ptr.base + ptr.offsets[lane] };
+	// Only SIMD::Width offsets are stored in the shadow memory, so the Pointer mustn't be copied.
+	auto ptr = reinterpret_cast<const Pointer *>(addr);
+	return Memory{ ptr->base + ptr->offsets[lane] };
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -2141,7 +2146,7 @@ SpirvShader::Impl::Debugger::State::~State()
 void SpirvShader::Impl::Debugger::State::trap(int index)
 {
 	if(std::all_of(globals.activeLaneMask.data.begin(),
-	               globals.activeLaneMask.data.end(),
+	               globals.activeLaneMask.data.begin() + sw::SIMD::Width,
 	               [](auto v) { return v == 0; }))
 	{
 		// Don't trap if no lanes are active.
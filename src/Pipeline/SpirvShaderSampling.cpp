@@ -18,6 +18,7 @@
 #include "Device/Config.hpp"
 #include "System/Debug.hpp"
 #include "System/Math.hpp"
+#include "System/SwiftConfig.hpp"
 #include "Vulkan/VkDescriptorSetLayout.hpp"
 #include "Vulkan/VkDevice.hpp"
 #include "Vulkan/VkImageView.hpp"
@@ -38,105 +39,191 @@ SpirvEmitter::ImageSampler *SpirvEmitter::getImageSampler(const vk::Device *devi
 
 	vk::Device::SamplingRoutineCache::Key key = { signature, samplerId, imageViewId };
 
-	auto createSamplingRoutine = [device](const vk::Device::SamplingRoutineCache::Key &key) {
-		ImageInstructionSignature instruction(key.instruction);
-		const vk::Identifier::State imageViewState = vk::Identifier(key.imageView).getState();
+	auto createRoutine = [device](const vk::Device::SamplingRoutineCache::Key &key) {
 		const vk::SamplerState *vkSamplerState = (key.sampler != 0) ? device->findSampler(key.sampler) : nullptr;
 
-		auto type = imageViewState.imageViewType;
-		auto samplerMethod = static_cast<SamplerMethod>(instruction.samplerMethod);
+		return createSamplingRoutine(key.instruction, vkSamplerState, key.imageView);
+	};
+
+	vk::Device::SamplingRoutineCache *cache = device->getSamplingRoutineCache();
+	auto routine = cache->getOrCreate(key, createRoutine);
 
-		Sampler samplerState = {};
-		samplerState.textureType = type;
-		ASSERT(instruction.coordinates >= samplerState.dimensionality());  // "It may be a vector larger than needed, but all unused components appear after all used components."
-		samplerState.textureFormat = imageViewState.format;
+	return (ImageSampler *)(routine->getEntry());
+}
 
-		samplerState.addressingModeU = convertAddressingMode(0, vkSamplerState, type);
-		samplerState.addressingModeV = convertAddressingMode(1, vkSamplerState, type);
-		samplerState.addressingModeW = convertAddressingMode(2, vkSamplerState, type);
+std::shared_ptr<rr::Routine> SpirvEmitter::createSamplingRoutine(uint32_t signature, const vk::SamplerState *vkSamplerState, uint32_t imageViewId)
+{
+	rr::ScopedPragma optimizationPasses(rr::OptimizationPasses, static_cast<int>(getConfiguration().samplerOptimization));
 
-		samplerState.mipmapFilter = convertMipmapMode(vkSamplerState);
-		samplerState.swizzle = imageViewState.mapping;
-		samplerState.gatherComponent = instruction.gatherComponent;
+	ImageInstructionSignature instruction(signature);
+	const vk::Identifier::State imageViewState = vk::Identifier(imageViewId).getState();
+
+	auto type = imageViewState.imageViewType;
+	auto samplerMethod = static_cast<SamplerMethod>(instruction.samplerMethod);
+
+	Sampler samplerState = {};
+	samplerState.textureType = type;
+	ASSERT(instruction.coordinates >= samplerState.dimensionality());  // "It may be a vector larger than needed, but all unused components appear after all used components."
+	samplerState.textureFormat = imageViewState.format;
+	samplerState.compressedFormat = VK_FORMAT_UNDEFINED;
+	samplerState.quadLayout = imageViewState.quadLayout;
+
+	// Compressed views only reach the sampler for images without a decompressed copy.
+	// Their blocks are decoded at fetch time into texels of the decompressed format.
+	if(samplerState.textureFormat.isCompressed())
+	{
+		samplerState.compressedFormat = samplerState.textureFormat;
+		samplerState.textureFormat = samplerState.compressedFormat.getDecompressedFormat();
+	}
+
+	samplerState.addressingModeU = convertAddressingMode(0, vkSamplerState, type);
+	samplerState.addressingModeV = convertAddressingMode(1, vkSamplerState, type);
+	samplerState.addressingModeW = convertAddressingMode(2, vkSamplerState, type);
+
+	samplerState.mipmapFilter = convertMipmapMode(vkSamplerState);
+	samplerState.swizzle = imageViewState.mapping;
+	samplerState.gatherComponent = instruction.gatherComponent;
 
-		if(vkSamplerState)
+	if(vkSamplerState)
+	{
+		samplerState.textureFilter = convertFilterMode(vkSamplerState, type, samplerMethod);
+		samplerState.border = vkSamplerState->borderColor;
+		samplerState.customBorder = vkSamplerState->customBorderColor;
+
+		samplerState.mipmapFilter = convertMipmapMode(vkSamplerState);
+		samplerState.highPrecisionFiltering = vkSamplerState->highPrecisionFiltering;
+
+		samplerState.compareEnable = (vkSamplerState->compareEnable != VK_FALSE);
+		samplerState.compareOp = vkSamplerState->compareOp;
+		samplerState.unnormalizedCoordinates = (vkSamplerState->unnormalizedCoordinates != VK_FALSE);
+
+		samplerState.ycbcrModel = vkSamplerState->ycbcrModel;
+		samplerState.studioSwing = vkSamplerState->studioSwing;
+		samplerState.swappedChroma = vkSamplerState->swappedChroma;
+		samplerState.chromaFilter = vkSamplerState->chromaFilter == VK_FILTER_LINEAR ?  FILTER_LINEAR : FILTER_POINT;
+		samplerState.chromaXOffset = vkSamplerState->chromaXOffset;
+		samplerState.chromaYOffset = vkSamplerState->chromaYOffset;
+
+		samplerState.mipLodBias = vkSamplerState->mipLodBias;
+		samplerState.maxAnisotropy = vkSamplerState->maxAnisotropy;
+		samplerState.minLod = vkSamplerState->minLod;
+		samplerState.maxLod = vkSamplerState->maxLod;
+
+		// If there's a single mip level and filtering doesn't depend on the LOD level,
+		// the sampler will need to compute the LOD to produce the proper result.
+		// Otherwise, it can be ignored.
+		// We can skip the LOD computation for all modes, except LOD query,
+		// where we have to return the proper value even if nothing else requires it.
+		if(imageViewState.singleMipLevel &&
+		   (samplerState.textureFilter != FILTER_MIN_POINT_MAG_LINEAR) &&
+		   (samplerState.textureFilter != FILTER_MIN_LINEAR_MAG_POINT) &&
+		   (samplerMethod != Query))
 		{
-			samplerState.textureFilter = convertFilterMode(vkSamplerState, type, samplerMethod);
-			samplerState.border = vkSamplerState->borderColor;
-			samplerState.customBorder = vkSamplerState->customBorderColor;
-
-			samplerState.mipmapFilter = convertMipmapMode(vkSamplerState);
-			samplerState.highPrecisionFiltering = vkSamplerState->highPrecisionFiltering;
-
-			samplerState.compareEnable = (vkSamplerState->compareEnable != VK_FALSE);
-			samplerState.compareOp = vkSamplerState->compareOp;
-			samplerState.unnormalizedCoordinates = (vkSamplerState->unnormalizedCoordinates != VK_FALSE);
-
-			samplerState.ycbcrModel = vkSamplerState->ycbcrModel;
-			samplerState.studioSwing = vkSamplerState->studioSwing;
-			samplerState.swappedChroma = vkSamplerState->swappedChroma;
-			samplerState.chromaFilter = vkSamplerState->chromaFilter == VK_FILTER_LINEAR ?  FILTER_LINEAR : FILTER_POINT;
-			samplerState.chromaXOffset = vkSamplerState->chromaXOffset;
-			samplerState.chromaYOffset = vkSamplerState->chromaYOffset;
-
-			samplerState.mipLodBias = vkSamplerState->mipLodBias;
-			samplerState.maxAnisotropy = vkSamplerState->maxAnisotropy;
-			samplerState.minLod = vkSamplerState->minLod;
-			samplerState.maxLod = vkSamplerState->maxLod;
-
-			// If there's a single mip level and filtering doesn't depend on the LOD level,
-			// the sampler will need to compute the LOD to produce the proper result.
-			// Otherwise, it can be ignored.
-			// We can skip the LOD computation for all modes, except LOD query,
-			// where we have to return the proper value even if nothing else requires it.
-			if(imageViewState.singleMipLevel &&
-			   (samplerState.textureFilter != FILTER_MIN_POINT_MAG_LINEAR) &&
-			   (samplerState.textureFilter != FILTER_MIN_LINEAR_MAG_POINT) &&
-			   (samplerMethod != Query))
-			{
-				samplerState.minLod = 0.0f;
-				samplerState.maxLod = 0.0f;
-			}
+			samplerState.minLod = 0.0f;
+			samplerState.maxLod = 0.0f;
 		}
-		else if(samplerMethod == Fetch)
-		{
-			// OpImageFetch does not take a sampler descriptor, but for VK_EXT_image_robustness
-			// requires replacing invalid texels with zero.
-			// TODO(b/162327166): Only perform bounds checks when VK_EXT_image_robustness is enabled.
-			samplerState.border = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+	}
+	else if(samplerMethod == Fetch)
+	{
+		// OpImageFetch does not take a sampler descriptor, but for VK_EXT_image_robustness
+		// requires replacing invalid texels with zero.
+		// TODO(b/162327166): Only perform bounds checks when VK_EXT_image_robustness is enabled.
+		samplerState.border = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
 
-			// If there's a single mip level we can skip LOD computation.
-			if(imageViewState.singleMipLevel)
-			{
-				samplerState.minLod = 0.0f;
-				samplerState.maxLod = 0.0f;
-			}
-			// Otherwise make sure LOD is clamped for robustness
-			else
-			{
-				samplerState.minLod = imageViewState.minLod;
-				samplerState.maxLod = imageViewState.maxLod;
-			}
-		}
-		else if(samplerMethod == Write)
+		// If there's a single mip level we can skip LOD computation.
+		if(imageViewState.singleMipLevel)
 		{
-			return emitWriteRoutine(instruction, samplerState);
+			samplerState.minLod = 0.0f;
+			samplerState.maxLod = 0.0f;
 		}
+		// Otherwise make sure LOD is clamped for robustness
 		else
-			ASSERT(false);
+		{
+			samplerState.minLod = imageViewState.minLod;
+			samplerState.maxLod = imageViewState.maxLod;
+		}
+	}
+	else if(samplerMethod == Write)
+	{
+		return emitWriteRoutine(instruction, samplerState);
+	}
+	else
+		ASSERT(false);
+
+	return emitSamplerRoutine(instruction, samplerState);
+}
 
-		return emitSamplerRoutine(instruction, samplerState);
+void SpirvEmitter::prewarmImageSamplers(vk::Device *device, uint32_t imageViewId, uint32_t samplerId, bool storageImage)
+{
+	ASSERT(imageViewId != 0);
+
+	const vk::SamplerState *vkSamplerState = (samplerId != 0) ? device->findSampler(samplerId) : nullptr;
+	if((samplerId != 0) && !vkSamplerState)
+	{
+		return;
+	}
+
+	// The sampler may be destroyed once the descriptor has been written, so
+	// the routines are created from a copy of its state.
+	auto samplerState = vkSamplerState ? std::make_shared<vk::SamplerState>(*vkSamplerState) : nullptr;
+	auto createRoutine = [samplerState](const vk::Device::SamplingRoutineCache::Key &key) {
+		return createSamplingRoutine(key.instruction, (key.sampler != 0) ? samplerState.get() : nullptr, key.imageView);
 	};
 
+	uint32_t dim = spv::DimMax;
+	bool arrayed = false;
+	switch(vk::Identifier(imageViewId).getState().imageViewType)
+	{
+	case VK_IMAGE_VIEW_TYPE_1D: dim = spv::Dim1D; break;
+	case VK_IMAGE_VIEW_TYPE_1D_ARRAY: dim = spv::Dim1D, arrayed = true; break;
+	case VK_IMAGE_VIEW_TYPE_2D: dim = spv::Dim2D; break;
+	case VK_IMAGE_VIEW_TYPE_2D_ARRAY: dim = spv::Dim2D, arrayed = true; break;
+	case VK_IMAGE_VIEW_TYPE_CUBE: dim = spv::DimCube; break;
+	case VK_IMAGE_VIEW_TYPE_CUBE_ARRAY: dim = spv::DimCube, arrayed = true; break;
+	case VK_IMAGE_VIEW_TYPE_3D: dim = spv::Dim3D; break;
+	default: UNSUPPORTED("VkImageViewType %d", int(vk::Identifier(imageViewId).getState().imageViewType));
+	}
+
 	vk::Device::SamplingRoutineCache *cache = device->getSamplingRoutineCache();
-	auto routine = cache->getOrCreate(key, createSamplingRoutine);
 
-	return (ImageSampler *)(routine->getEntry());
+	// The pipelines which will access this descriptor aren't known yet, so the
+	// routines for image instructions already used with a compatible view type
+	// are created ahead of the draws that need them.
+	for(uint32_t signature : cache->getSignatures())
+	{
+		ImageInstructionSignature instruction(signature);
+
+		bool sameDim = (instruction.dim == dim) || ((instruction.dim == spv::DimSubpassData) && (dim == spv::Dim2D));
+		if(!sameDim || ((instruction.arrayed != 0) != arrayed))
+		{
+			continue;
+		}
+
+		uint32_t routineSamplerId = 0;
+		switch(instruction.samplerMethod)
+		{
+		case Write:
+			if(!storageImage) { continue; }
+			break;
+		case Fetch:
+			if(storageImage) { continue; }
+			break;
+		default:
+			if(storageImage || (samplerId == 0)) { continue; }
+			routineSamplerId = samplerId;
+			break;
+		}
+
+		vk::Device::SamplingRoutineCache::Key key = { signature, routineSamplerId, imageViewId };
+		if(!cache->prewarm(device->getScheduler(), key, createRoutine))
+		{
+			return;
+		}
+	}
 }
 
 std::shared_ptr<rr::Routine> SpirvEmitter::emitWriteRoutine(ImageInstructionSignature instruction, const Sampler &samplerState)
 {
-	// TODO(b/129523279): Hold a separate mutex lock for the sampler being built.
 	rr::Function<Void(Pointer<Byte>, Pointer<SIMD::Float>, Pointer<SIMD::Float>, Pointer<Byte>)> function;
 	{
 		Pointer<Byte> descriptor = function.Arg<0>();
@@ -152,7 +239,6 @@ std::shared_ptr<rr::Routine> SpirvEmitter::emitWriteRoutine(ImageInstructionSign
 
 std::shared_ptr<rr::Routine> SpirvEmitter::emitSamplerRoutine(ImageInstructionSignature instruction, const Sampler &samplerState)
 {
-	// TODO(b/129523279): Hold a separate mutex lock for the sampler being built.
 	rr::Function<Void(Pointer<Byte>, Pointer<SIMD::Float>, Pointer<SIMD::Float>, Pointer<Byte>)> function;
 	{
 		Pointer<Byte> texture = function.Arg<0>();
@@ -37,7 +37,7 @@ VertexProgram::VertexProgram(
 	// TODO(b/146486064): Consider only assigning these to the SpirvRoutine iff
 	// they are ever going to be read.
 	routine.layer = *Pointer<Int>(data + OFFSET(DrawData, layer));
-	routine.instanceID = *Pointer<Int>(data + OFFSET(DrawData, instanceID));
+	routine.instanceID = *Pointer<Int>(task + OFFSET(VertexTask, instanceID));
 
 	routine.setInputBuiltin(spirvShader, spv::BuiltInViewIndex, [&](const Spirv::BuiltinMapping &builtin, Array<SIMD::Float> &value) {
 		assert(builtin.SizeInComponents == 1);
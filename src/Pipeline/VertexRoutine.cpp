@@ -47,41 +47,88 @@ void VertexRoutine::generate()
 	Pointer<UInt> tagCache = Pointer<UInt>(cache + OFFSET(VertexCache, tag));
 
 	UInt vertexCount = *Pointer<UInt>(task + OFFSET(VertexTask, vertexCount));
+	UInt uniqueCount = *Pointer<UInt>(task + OFFSET(VertexTask, uniqueCount));
 
 	constants = device + OFFSET(vk::Device, constants);
 
 	// Check the cache one vertex index at a time. If a hit occurs, copy from the cache to the 'vertex' output buffer.
 	// On a cache miss, process a SIMD width of consecutive indices from the input batch. They're written to the cache
 	// in reverse order to guarantee that the first one doesn't get evicted and can be written out.
+	// Deduplicated batches instead run this loop over their unique vertices, shading each SIMD width group of them
+	// into consecutive entries of the shaded vertex array. The primitives' vertices are gathered from it afterwards.
 
-	Do
+	Bool deduplicated = (Int(*Pointer<Byte>(task + OFFSET(VertexTask, deduplicated))) != 0);
+	Pointer<UInt> indices = batch;
+	UInt count = vertexCount;
+
+	If(deduplicated)
+	{
+		indices = *Pointer<Pointer<UInt>>(task + OFFSET(VertexTask, uniqueIndices));
+		vertexCache = *Pointer<Pointer<Byte>>(task + OFFSET(VertexTask, shadedVertices));
+		count = uniqueCount;
+	}
+
+	UInt slot = 0;
+
+	// All the vertices of a deduplicated batch may have been shaded by the previous batches of its group.
+	While(count != 0)
 	{
-		UInt index = *batch;
+		UInt index = *indices;
 		UInt cacheIndex = index & VertexCache::TAG_MASK;
+		Bool miss = (tagCache[cacheIndex] != index);
+
+		If(deduplicated)
+		{
+			cacheIndex = slot;
+			miss = ((slot % UInt(SIMD::Width)) == 0);
+		}
 
-		If(tagCache[cacheIndex] != index)
+		If(miss)
 		{
-			readInput(batch);
-			program(batch, vertexCount);
+			readInput(indices);
+			program(indices, count);
 			computeClipFlags();
 			computeCullMask();
 
-			writeCache(vertexCache, tagCache, batch);
+			writeCache(vertexCache, tagCache, indices, slot, deduplicated);
 		}
 
-		Pointer<Byte> cacheEntry = vertexCache + cacheIndex * UInt((int)sizeof(Vertex));
-
-		// For points, vertexCount is 1 per primitive, so duplicate vertex for all 3 vertices of the primitive
-		for(int i = 0; i < (state.isPoint ? 3 : 1); i++)
+		If(!deduplicated)
 		{
-			writeVertex(vertex, cacheEntry);
-			vertex += sizeof(Vertex);
+			Pointer<Byte> cacheEntry = vertexCache + cacheIndex * UInt((int)sizeof(Vertex));
+
+			// For points, vertexCount is 1 per primitive, so duplicate vertex for all 3 vertices of the primitive
+			for(int i = 0; i < (state.isPoint ? 3 : 1); i++)
+			{
+				writeVertex(vertex, cacheEntry);
+				vertex += sizeof(Vertex);
+			}
 		}
 
-		batch = Pointer<UInt>(Pointer<Byte>(batch) + sizeof(uint32_t));
-		vertexCount--;
+		indices = Pointer<UInt>(Pointer<Byte>(indices) + sizeof(uint32_t));
+		count--;
+		slot++;
+	}
+
+	If(deduplicated)
+	{
+		// The batch holds indices into the shaded vertex array.
+		Do
+		{
+			UInt shadedIndex = *batch;
+			Pointer<Byte> shadedVertex = vertexCache + shadedIndex * UInt((int)sizeof(Vertex));
+
+			for(int i = 0; i < (state.isPoint ? 3 : 1); i++)
+			{
+				writeVertex(vertex, shadedVertex);
+				vertex += sizeof(Vertex);
+			}
+
+			batch = Pointer<UInt>(Pointer<Byte>(batch) + sizeof(uint32_t));
+			vertexCount--;
+		}
+		Until(vertexCount == 0);
 	}
-	Until(vertexCount == 0);
 
 	Return();
 }
@@ -98,10 +145,25 @@ void VertexRoutine::readInput(Pointer<UInt> &batch)
 			Pointer<Byte> input = *Pointer<Pointer<Byte>>(data + OFFSET(DrawData, input) + sizeof(void *) * (i / 4));
 			UInt stride = *Pointer<UInt>(data + OFFSET(DrawData, stride) + sizeof(uint32_t) * (i / 4));
 			Int baseVertex = *Pointer<Int>(data + OFFSET(DrawData, baseVertex));
+
+			// Instances of a draw are processed in separate batches, so the
+			// instance-rate attributes are uniform across the batch.
+			UInt instanceID = *Pointer<UInt>(task + OFFSET(VertexTask, instanceID));
+			UInt instanceStride = *Pointer<UInt>(data + OFFSET(DrawData, instanceStride) + sizeof(uint32_t) * (i / 4));
+
+			// The 32-bit product of the instance index and stride can wrap around
+			// back into the buffer. Offsets past the largest buffer size are clamped
+			// to it instead, so they remain out of bounds.
+			static_assert(vk::MAX_MEMORY_ALLOCATION_SIZE <= 0xFFFFFFFFull, "the largest offset must fit in 32 bits");
+			UInt maxOffset = UInt(static_cast<unsigned int>(vk::MAX_MEMORY_ALLOCATION_SIZE));
+			UInt instanceOffset = IfThenElse(instanceID <= maxOffset / Max(instanceStride, UInt(1)), instanceID * instanceStride, maxOffset);
+			input += instanceOffset;
+
 			UInt robustnessSize(0);
 			if(state.robustBufferAccess)
 			{
 				robustnessSize = *Pointer<UInt>(data + OFFSET(DrawData, robustnessSize) + sizeof(uint32_t) * (i / 4));
+				robustnessSize = Max(robustnessSize, instanceOffset) - instanceOffset;
 			}
 
 			auto value = readStream(input, stride, state.input[i / 4], batch, state.robustBufferAccess, robustnessSize, baseVertex);
@@ -155,7 +217,7 @@ void VertexRoutine::computeClipFlags()
 
 void VertexRoutine::computeCullMask()
 {
-	cullMask = Int(15);
+	cullMask = Int((1 << SIMD::Width) - 1);
 
 	auto it = spirvShader->outputBuiltins.find(spv::BuiltInCullDistance);
 	if(it != spirvShader->outputBuiltins.end())
@@ -567,26 +629,53 @@ Vector4f VertexRoutine::readStream(Pointer<Byte> &buffer, UInt &stride, const St
 	return v;
 }
 
-void VertexRoutine::writeCache(Pointer<Byte> &vertexCache, Pointer<UInt> &tagCache, Pointer<UInt> &batch)
+void VertexRoutine::writeCache(Pointer<Byte> &vertexCache, Pointer<UInt> &tagCache, Pointer<UInt> &batch, UInt &slot, Bool &deduplicated)
 {
-	ASSERT(SIMD::Width == 4);
+	std::vector<UInt> index(SIMD::Width);
+	std::vector<UInt> cacheIndex(SIMD::Width);
 
-	UInt index0 = batch[0];
-	UInt index1 = batch[1];
-	UInt index2 = batch[2];
-	UInt index3 = batch[3];
+	for(int i = 0; i < SIMD::Width; i++)
+	{
+		index[i] = batch[i];
+		cacheIndex[i] = index[i] & VertexCache::TAG_MASK;
+	}
 
-	UInt cacheIndex0 = index0 & VertexCache::TAG_MASK;
-	UInt cacheIndex1 = index1 & VertexCache::TAG_MASK;
-	UInt cacheIndex2 = index2 & VertexCache::TAG_MASK;
-	UInt cacheIndex3 = index3 & VertexCache::TAG_MASK;
+	If(deduplicated)
+	{
+		// Unique vertices are stored consecutively, and never evicted.
+		for(int i = 0; i < SIMD::Width; i++)
+		{
+			cacheIndex[i] = slot + i;
+		}
+	}
+	Else
+	{
+		// We processed a SIMD group of vertices, with the first one being the one that missed the cache tag check.
+		// Write them out in reverse order here and below to ensure the first one is now guaranteed to be in the cache.
+		for(int i = SIMD::Width - 1; i >= 0; i--)
+		{
+			tagCache[cacheIndex[i]] = index[i];
+		}
+	}
+
+	// Writes each group of four lanes of the vector, transposed to one Float4 per vertex.
+	auto writeTransposed = [&](const SIMD::Float4 &vector, int offset) {
+		for(int group = SIMD::Width / 4 - 1; group >= 0; group--)
+		{
+			Vector4f v;
+			v.x = Extract128(vector.x, group);
+			v.y = Extract128(vector.y, group);
+			v.z = Extract128(vector.z, group);
+			v.w = Extract128(vector.w, group);
 
-	// We processed a SIMD group of vertices, with the first one being the one that missed the cache tag check.
-	// Write them out in reverse order here and below to ensure the first one is now guaranteed to be in the cache.
-	tagCache[cacheIndex3] = index3;
-	tagCache[cacheIndex2] = index2;
-	tagCache[cacheIndex1] = index1;
-	tagCache[cacheIndex0] = index0;
+			transpose4x4(v.x, v.y, v.z, v.w);
+
+			for(int i = 3; i >= 0; i--)
+			{
+				*Pointer<Float4>(vertexCache + sizeof(Vertex) * cacheIndex[group * 4 + i] + offset, 16) = v[i];
+			}
+		}
+	};
 
 	auto it = spirvShader->outputBuiltins.find(spv::BuiltInPosition);
 	if(it != spirvShader->outputBuiltins.end())
@@ -605,37 +694,19 @@ void VertexRoutine::writeCache(Pointer<Byte> &vertexCache, Pointer<UInt> &tagCac
 		SIMD::Float rhw = 1.0f / w;
 
 		SIMD::Float4 proj;
-		proj.x = As<Float4>(RoundIntClamped(SIMD::Float(*Pointer<Float>(data + OFFSET(DrawData, X0xF))) + pos.x * rhw * SIMD::Float(*Pointer<Float>(data + OFFSET(DrawData, WxF)))));
-		proj.y = As<Float4>(RoundIntClamped(SIMD::Float(*Pointer<Float>(data + OFFSET(DrawData, Y0xF))) + pos.y * rhw * SIMD::Float(*Pointer<Float>(data + OFFSET(DrawData, HxF)))));
+		proj.x = As<SIMD::Float>(RoundIntClamped(SIMD::Float(*Pointer<Float>(data + OFFSET(DrawData, X0xF))) + pos.x * rhw * SIMD::Float(*Pointer<Float>(data + OFFSET(DrawData, WxF)))));
+		proj.y = As<SIMD::Float>(RoundIntClamped(SIMD::Float(*Pointer<Float>(data + OFFSET(DrawData, Y0xF))) + pos.y * rhw * SIMD::Float(*Pointer<Float>(data + OFFSET(DrawData, HxF)))));
 		proj.z = pos.z * rhw;
 		proj.w = rhw;
 
-		Float4 pos_x = Extract128(pos.x, 0);
-		Float4 pos_y = Extract128(pos.y, 0);
-		Float4 pos_z = Extract128(pos.z, 0);
-		Float4 pos_w = Extract128(pos.w, 0);
-		transpose4x4(pos_x, pos_y, pos_z, pos_w);
-
-		*Pointer<Float4>(vertexCache + sizeof(Vertex) * cacheIndex3 + OFFSET(Vertex, position), 16) = pos_w;
-		*Pointer<Float4>(vertexCache + sizeof(Vertex) * cacheIndex2 + OFFSET(Vertex, position), 16) = pos_z;
-		*Pointer<Float4>(vertexCache + sizeof(Vertex) * cacheIndex1 + OFFSET(Vertex, position), 16) = pos_y;
-		*Pointer<Float4>(vertexCache + sizeof(Vertex) * cacheIndex0 + OFFSET(Vertex, position), 16) = pos_x;
-
-		*Pointer<Int>(vertexCache + sizeof(Vertex) * cacheIndex3 + OFFSET(Vertex, clipFlags)) = Extract(clipFlags, 3);
-		*Pointer<Int>(vertexCache + sizeof(Vertex) * cacheIndex2 + OFFSET(Vertex, clipFlags)) = Extract(clipFlags, 2);
-		*Pointer<Int>(vertexCache + sizeof(Vertex) * cacheIndex1 + OFFSET(Vertex, clipFlags)) = Extract(clipFlags, 1);
-		*Pointer<Int>(vertexCache + sizeof(Vertex) * cacheIndex0 + OFFSET(Vertex, clipFlags)) = Extract(clipFlags, 0);
-
-		Float4 proj_x = Extract128(proj.x, 0);
-		Float4 proj_y = Extract128(proj.y, 0);
-		Float4 proj_z = Extract128(proj.z, 0);
-		Float4 proj_w = Extract128(proj.w, 0);
-		transpose4x4(proj_x, proj_y, proj_z, proj_w);
-
-		*Pointer<Float4>(vertexCache + sizeof(Vertex) * cacheIndex3 + OFFSET(Vertex, projected), 16) = proj_w;
-		*Pointer<Float4>(vertexCache + sizeof(Vertex) * cacheIndex2 + OFFSET(Vertex, projected), 16) = proj_z;
-		*Pointer<Float4>(vertexCache + sizeof(Vertex) * cacheIndex1 + OFFSET(Vertex, projected), 16) = proj_y;
-		*Pointer<Float4>(vertexCache + sizeof(Vertex) * cacheIndex0 + OFFSET(Vertex, projected), 16) = proj_x;
+		writeTransposed(pos, OFFSET(Vertex, position));
+
+		for(int i = SIMD::Width - 1; i >= 0; i--)
+		{
+			*Pointer<Int>(vertexCache + sizeof(Vertex) * cacheIndex[i] + OFFSET(Vertex, clipFlags)) = Extract(clipFlags, i);
+		}
+
+		writeTransposed(proj, OFFSET(Vertex, projected));
 	}
 
 	it = spirvShader->outputBuiltins.find(spv::BuiltInPointSize);
@@ -644,23 +715,23 @@ void VertexRoutine::writeCache(Pointer<Byte> &vertexCache, Pointer<UInt> &tagCac
 		ASSERT(it->second.SizeInComponents == 1);
 		auto psize = routine.getVariable(it->second.Id)[it->second.FirstComponent];
 
-		*Pointer<Float>(vertexCache + sizeof(Vertex) * cacheIndex3 + OFFSET(Vertex, pointSize)) = Extract(psize, 3);
-		*Pointer<Float>(vertexCache + sizeof(Vertex) * cacheIndex2 + OFFSET(Vertex, pointSize)) = Extract(psize, 2);
-		*Pointer<Float>(vertexCache + sizeof(Vertex) * cacheIndex1 + OFFSET(Vertex, pointSize)) = Extract(psize, 1);
-		*Pointer<Float>(vertexCache + sizeof(Vertex) * cacheIndex0 + OFFSET(Vertex, pointSize)) = Extract(psize, 0);
+		for(int i = SIMD::Width - 1; i >= 0; i--)
+		{
+			*Pointer<Float>(vertexCache + sizeof(Vertex) * cacheIndex[i] + OFFSET(Vertex, pointSize)) = Extract(psize, i);
+		}
 	}
 
 	it = spirvShader->outputBuiltins.find(spv::BuiltInClipDistance);
 	if(it != spirvShader->outputBuiltins.end())
 	{
 		auto count = spirvShader->getNumOutputClipDistances();
-		for(unsigned int i = 0; i < count; i++)
+		for(unsigned int j = 0; j < count; j++)
 		{
-			auto dist = routine.getVariable(it->second.Id)[it->second.FirstComponent + i];
-			*Pointer<Float>(vertexCache + sizeof(Vertex) * cacheIndex3 + OFFSET(Vertex, clipDistance[i])) = Extract(dist, 3);
-			*Pointer<Float>(vertexCache + sizeof(Vertex) * cacheIndex2 + OFFSET(Vertex, clipDistance[i])) = Extract(dist, 2);
-			*Pointer<Float>(vertexCache + sizeof(Vertex) * cacheIndex1 + OFFSET(Vertex, clipDistance[i])) = Extract(dist, 1);
-			*Pointer<Float>(vertexCache + sizeof(Vertex) * cacheIndex0 + OFFSET(Vertex, clipDistance[i])) = Extract(dist, 0);
+			auto dist = routine.getVariable(it->second.Id)[it->second.FirstComponent + j];
+			for(int i = SIMD::Width - 1; i >= 0; i--)
+			{
+				*Pointer<Float>(vertexCache + sizeof(Vertex) * cacheIndex[i] + OFFSET(Vertex, clipDistance[j])) = Extract(dist, i);
+			}
 		}
 	}
 
@@ -668,20 +739,20 @@ void VertexRoutine::writeCache(Pointer<Byte> &vertexCache, Pointer<UInt> &tagCac
 	if(it != spirvShader->outputBuiltins.end())
 	{
 		auto count = spirvShader->getNumOutputCullDistances();
-		for(unsigned int i = 0; i < count; i++)
+		for(unsigned int j = 0; j < count; j++)
 		{
-			auto dist = routine.getVariable(it->second.Id)[it->second.FirstComponent + i];
-			*Pointer<Float>(vertexCache + sizeof(Vertex) * cacheIndex3 + OFFSET(Vertex, cullDistance[i])) = Extract(dist, 3);
-			*Pointer<Float>(vertexCache + sizeof(Vertex) * cacheIndex2 + OFFSET(Vertex, cullDistance[i])) = Extract(dist, 2);
-			*Pointer<Float>(vertexCache + sizeof(Vertex) * cacheIndex1 + OFFSET(Vertex, cullDistance[i])) = Extract(dist, 1);
-			*Pointer<Float>(vertexCache + sizeof(Vertex) * cacheIndex0 + OFFSET(Vertex, cullDistance[i])) = Extract(dist, 0);
+			auto dist = routine.getVariable(it->second.Id)[it->second.FirstComponent + j];
+			for(int i = SIMD::Width - 1; i >= 0; i--)
+			{
+				*Pointer<Float>(vertexCache + sizeof(Vertex) * cacheIndex[i] + OFFSET(Vertex, cullDistance[j])) = Extract(dist, i);
+			}
 		}
 	}
 
-	*Pointer<Int>(vertexCache + sizeof(Vertex) * cacheIndex3 + OFFSET(Vertex, cullMask)) = -((cullMask >> 3) & 1);
-	*Pointer<Int>(vertexCache + sizeof(Vertex) * cacheIndex2 + OFFSET(Vertex, cullMask)) = -((cullMask >> 2) & 1);
-	*Pointer<Int>(vertexCache + sizeof(Vertex) * cacheIndex1 + OFFSET(Vertex, cullMask)) = -((cullMask >> 1) & 1);
-	*Pointer<Int>(vertexCache + sizeof(Vertex) * cacheIndex0 + OFFSET(Vertex, cullMask)) = -((cullMask >> 0) & 1);
+	for(int i = SIMD::Width - 1; i >= 0; i--)
+	{
+		*Pointer<Int>(vertexCache + sizeof(Vertex) * cacheIndex[i] + OFFSET(Vertex, cullMask)) = -((cullMask >> i) & 1);
+	}
 
 	for(int i = 0; i < MAX_INTERFACE_COMPONENTS; i += 4)
 	{
@@ -690,18 +761,13 @@ void VertexRoutine::writeCache(Pointer<Byte> &vertexCache, Pointer<UInt> &tagCac
 		   spirvShader->outputs[i + 2].Type != Spirv::ATTRIBTYPE_UNUSED ||
 		   spirvShader->outputs[i + 3].Type != Spirv::ATTRIBTYPE_UNUSED)
 		{
-			Vector4f v;
-			v.x = Extract128(routine.outputs[i + 0], 0);
-			v.y = Extract128(routine.outputs[i + 1], 0);
-			v.z = Extract128(routine.outputs[i + 2], 0);
-			v.w = Extract128(routine.outputs[i + 3], 0);
-
-			transpose4x4(v.x, v.y, v.z, v.w);
+			SIMD::Float4 v;
+			v.x = routine.outputs[i + 0];
+			v.y = routine.outputs[i + 1];
+			v.z = routine.outputs[i + 2];
+			v.w = routine.outputs[i + 3];
 
-			*Pointer<Float4>(vertexCache + sizeof(Vertex) * cacheIndex3 + OFFSET(Vertex, v[i]), 16) = v.w;
-			*Pointer<Float4>(vertexCache + sizeof(Vertex) * cacheIndex2 + OFFSET(Vertex, v[i]), 16) = v.z;
-			*Pointer<Float4>(vertexCache + sizeof(Vertex) * cacheIndex1 + OFFSET(Vertex, v[i]), 16) = v.y;
-			*Pointer<Float4>(vertexCache + sizeof(Vertex) * cacheIndex0 + OFFSET(Vertex, v[i]), 16) = v.x;
+			writeTransposed(v, OFFSET(Vertex, v[i]));
 		}
 	}
 }
@@ -47,6 +47,24 @@ static void cpuid(int eax_ebx_ecx_edx[4], int eax, int ecx = 0)
 #endif
 }
 
+// Returns the XCR0 extended control register. Only valid if OSXSAVE is supported.
+static unsigned long long xgetbv()
+{
+#if defined(__i386__) || defined(__x86_64__)
+#	if defined(_WIN32)
+	return _xgetbv(0);
+#	else
+	unsigned int eax, edx;
+	__asm volatile("xgetbv"
+	               : "=a"(eax), "=d"(edx)
+	               : "c"(0));
+	return (static_cast<unsigned long long>(edx) << 32) | eax;
+#	endif
+#else
+	return 0;
+#endif
+}
+
 bool CPUID::supportsSSE4_1()
 {
 	int eax_ebx_ecx_edx[4];
@@ -73,4 +91,22 @@ bool CPUID::supportsAVX2()
 	return (eax_ebx_ecx_edx[1] & 0x00000020) != 0;
 }
 
+bool CPUID::supportsAVX512F()
+{
+	if(!supportsAVX2())
+	{
+		return false;
+	}
+
+	// Test bits 1 (SSE), 2 (AVX), 5 (opmask), 6 (ZMM_Hi256), and 7 (Hi16_ZMM) of XCR0
+	if((xgetbv() & 0xE6) != 0xE6)
+	{
+		return false;
+	}
+
+	int eax_ebx_ecx_edx[4];
+	cpuid(eax_ebx_ecx_edx, 7, 0);
+	return (eax_ebx_ecx_edx[1] & 0x00010000) != 0;
+}
+
 }  // namespace rr
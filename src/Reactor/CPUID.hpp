@@ -29,7 +29,8 @@ class CPUID
 {
 public:
 	static bool supportsSSE4_1();
-	static bool supportsAVX2();  // Also ensures support for OSXSAVE and FMA
+	static bool supportsAVX2();     // Also ensures support for OSXSAVE and FMA
+	static bool supportsAVX512F();  // Also ensures the OS saves/restores zmm and opmask registers
 };
 
 }  // namespace rr
@@ -418,4 +418,170 @@ void deallocateMemoryPages(void *memory, size_t bytes)
 #endif
 }
 
+MemoryArena::MemoryArena(size_t granularity, bool executable, bool protectable)
+    : granularity(granularity)
+    , executable(executable)
+    , protectable(protectable)
+{}
+
+MemoryArena::~MemoryArena()
+{
+	for(auto &it : slabs)
+	{
+		deallocateMemoryPages(it.second.base, SlabSize);
+	}
+}
+
+void *MemoryArena::allocate(size_t bytes)
+{
+	size_t size = roundUp(bytes, granularity);
+	if(size > MaxAllocationSize)
+	{
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for(auto &it : slabs)
+	{
+		if(void *memory = allocate(it.second, size))
+		{
+			return memory;
+		}
+	}
+
+	uint8_t *base = static_cast<uint8_t *>(allocateMemoryPages(SlabSize, PERMISSION_READ | PERMISSION_WRITE, executable));
+	if(!base)
+	{
+		return nullptr;
+	}
+
+	Slab &slab = slabs[reinterpret_cast<uintptr_t>(base)];
+	slab.base = base;
+	slab.freeRanges[0] = SlabSize;
+
+	return allocate(slab, size);
+}
+
+bool MemoryArena::deallocate(void *memory, size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto it = slabs.upper_bound(reinterpret_cast<uintptr_t>(memory));
+	if(it == slabs.begin())
+	{
+		return false;
+	}
+
+	Slab &slab = (--it)->second;
+	size_t offset = static_cast<uint8_t *>(memory) - slab.base;
+	if(offset >= SlabSize)
+	{
+		return false;
+	}
+
+	size_t size = roundUp(bytes, granularity);
+	if(protectable)
+	{
+		protectMemoryPages(memory, size, PERMISSION_READ | PERMISSION_WRITE);
+	}
+
+	// Merge the range with adjacent free ranges.
+	auto next = slab.freeRanges.lower_bound(offset);
+	if(next != slab.freeRanges.end() && offset + size == next->first)
+	{
+		size += next->second;
+		next = slab.freeRanges.erase(next);
+	}
+
+	if(next != slab.freeRanges.begin())
+	{
+		auto previous = std::prev(next);
+		if(previous->first + previous->second == offset)
+		{
+			offset = previous->first;
+			size += previous->second;
+		}
+	}
+
+	slab.freeRanges[offset] = size;
+
+	if(--slab.allocationCount == 0 && slabs.size() > 1)
+	{
+		deallocateMemoryPages(slab.base, SlabSize);
+		slabs.erase(it);
+	}
+
+	return true;
+}
+
+void *MemoryArena::allocate(Slab &slab, size_t size)
+{
+	for(auto it = slab.freeRanges.begin(); it != slab.freeRanges.end(); ++it)
+	{
+		if(it->second < size)
+		{
+			continue;
+		}
+
+		size_t offset = it->first;
+		size_t remainder = it->second - size;
+		slab.freeRanges.erase(it);
+		if(remainder > 0)
+		{
+			slab.freeRanges[offset + size] = remainder;
+		}
+
+		slab.allocationCount++;
+
+		// Reused memory of other routines gets cleared, like newly mapped pages.
+		memset(slab.base + offset, 0, size);
+
+		return slab.base + offset;
+	}
+
+	return nullptr;
+}
+
+namespace {
+
+// Code and read-only data can only be protected at page granularity. Other
+// data allocations are aligned to cache lines to avoid false sharing.
+MemoryArena &getArena(RoutineMemoryType type)
+{
+	// Never destroyed, since routines may outlive static destructors.
+	static MemoryArena *codeArena = new MemoryArena(memoryPageSize(), true, true);
+	static MemoryArena *readOnlyArena = new MemoryArena(memoryPageSize(), false, true);
+	static MemoryArena *dataArena = new MemoryArena(64, false, false);
+
+	switch(type)
+	{
+	case ROUTINE_MEMORY_CODE: return *codeArena;
+	case ROUTINE_MEMORY_READ_ONLY: return *readOnlyArena;
+	default: return *dataArena;
+	}
+}
+
+}  // anonymous namespace
+
+void *allocateRoutineMemory(size_t bytes, RoutineMemoryType type)
+{
+	if(void *memory = getArena(type).allocate(bytes))
+	{
+		return memory;
+	}
+
+	return allocateMemoryPages(bytes, PERMISSION_READ | PERMISSION_WRITE, type == ROUTINE_MEMORY_CODE);
+}
+
+void deallocateRoutineMemory(void *memory, size_t bytes)
+{
+	if(!getArena(ROUTINE_MEMORY_CODE).deallocate(memory, bytes) &&
+	   !getArena(ROUTINE_MEMORY_READ_ONLY).deallocate(memory, bytes) &&
+	   !getArena(ROUTINE_MEMORY_DATA).deallocate(memory, bytes))
+	{
+		deallocateMemoryPages(memory, bytes);
+	}
+}
+
 }  // namespace rr
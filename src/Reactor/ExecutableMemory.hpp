@@ -18,6 +18,8 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <map>
+#include <mutex>
 
 namespace rr {
 
@@ -40,6 +42,66 @@ void protectMemoryPages(void *memory, size_t bytes, int permissions);
 // Releases memory allocated with allocateMemoryPages().
 void deallocateMemoryPages(void *memory, size_t bytes);
 
+enum RoutineMemoryType
+{
+	ROUTINE_MEMORY_CODE,       // Can be made executable
+	ROUTINE_MEMORY_READ_ONLY,  // Can be made read-only
+	ROUTINE_MEMORY_DATA,       // Stays read-write
+};
+
+// Allocates read-write memory for JIT-compiled routines from slabs shared by
+// all routines, which avoids mapping pages for each of them. Code and read-only
+// data allocations are page aligned and sized, so their permissions can be
+// changed with protectMemoryPages() independently of their neighbors. Other
+// data allocations are packed more tightly, and their permissions must not be
+// changed.
+void *allocateRoutineMemory(size_t bytes, RoutineMemoryType type);
+
+// Releases memory allocated with allocateRoutineMemory(). Its permissions are
+// restored to read-write before it gets reused.
+void deallocateRoutineMemory(void *memory, size_t bytes);
+
+// MemoryArena sub-allocates slabs of memory pages. Slabs count their
+// allocations, and are released once they're all freed, except for the last
+// slab which is retained to avoid mapping memory again. Freed ranges are
+// coalesced with their neighbors, and reused first-fit.
+class MemoryArena
+{
+public:
+	static constexpr size_t SlabSize = 1024 * 1024;
+	static constexpr size_t MaxAllocationSize = SlabSize / 4;
+
+	// Allocations are multiples of 'granularity', which must be a power of two
+	// no larger than the page size. If 'protectable' is true, the permissions
+	// of allocations may be changed, and get restored when they're freed.
+	MemoryArena(size_t granularity, bool executable, bool protectable);
+	~MemoryArena();
+
+	// Returns zeroed read-write memory, or nullptr if the allocation is too
+	// large to be made from a slab.
+	void *allocate(size_t bytes);
+
+	// Returns false if the memory wasn't allocated from this arena.
+	bool deallocate(void *memory, size_t bytes);
+
+private:
+	struct Slab
+	{
+		uint8_t *base = nullptr;
+		size_t allocationCount = 0;
+		std::map<size_t, size_t> freeRanges;  // Size of each free range, by offset
+	};
+
+	void *allocate(Slab &slab, size_t size);
+
+	const size_t granularity;
+	const bool executable;
+	const bool protectable;
+
+	std::mutex mutex;
+	std::map<uintptr_t, Slab> slabs;  // By base address
+};
+
 template<typename P>
 P unaligned_read(void *address)
 {
@@ -43,6 +43,15 @@ __pragma(warning(push))
 #else
 #include "llvm/ExecutionEngine/Orc/ObjectLinkingLayer.h"
 #endif
+#if defined(__GNUC__) && !defined(__clang__)
+#	pragma GCC diagnostic push
+#	pragma GCC diagnostic ignored "-Wuninitialized"  // ModuleSummaryIndex::Alloc
+#endif
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#if defined(__GNUC__) && !defined(__clang__)
+#	pragma GCC diagnostic pop
+#endif
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
 #include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/IR/Verifier.h"
@@ -62,15 +71,21 @@ __pragma(warning(push))
 #	include "llvm/Transforms/Scalar/DeadStoreElimination.h"
 #	include "llvm/Transforms/Scalar/EarlyCSE.h"
 #	include "llvm/Transforms/Scalar/LICM.h"
+#	include "llvm/Transforms/Scalar/LoopPassManager.h"
+#	include "llvm/Transforms/Scalar/LoopUnrollPass.h"
 #	include "llvm/Transforms/Scalar/Reassociate.h"
 #	include "llvm/Transforms/Scalar/SCCP.h"
 #	include "llvm/Transforms/Scalar/SROA.h"
 #	include "llvm/Transforms/Scalar/SimplifyCFG.h"
+#	include "llvm/Transforms/Vectorize/SLPVectorizer.h"
 #else  // Legacy pass manager
+#	include "llvm/Analysis/TargetTransformInfo.h"
 #	include "llvm/IR/LegacyPassManager.h"
 #	include "llvm/Pass.h"
 #	include "llvm/Transforms/Coroutines.h"
 #	include "llvm/Transforms/IPO.h"
+#	include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#	include "llvm/Transforms/Vectorize.h"
 #endif
 
 #ifdef _MSC_VER
@@ -338,16 +353,33 @@ public:
 	{
 		errorCode = std::error_code();
 
-		// Round up numBytes to page size.
-		size_t pageSize = rr::memoryPageSize();
-		numBytes = (numBytes + pageSize - 1) & ~(pageSize - 1);
+		// SectionMemoryManager allocates all sections as read-write.
+		ASSERT(flagsToPermissions(flags) == (rr::PERMISSION_READ | rr::PERMISSION_WRITE));
+
+		rr::RoutineMemoryType type = rr::ROUTINE_MEMORY_DATA;
+		switch(purpose)
+		{
+		case llvm::SectionMemoryManager::AllocationPurpose::Code:
+			type = rr::ROUTINE_MEMORY_CODE;
+			break;
+		case llvm::SectionMemoryManager::AllocationPurpose::ROData:
+			type = rr::ROUTINE_MEMORY_READ_ONLY;
+			break;
+		default:
+			break;
+		}
+
+		if(type != rr::ROUTINE_MEMORY_DATA)
+		{
+			// Round up numBytes to page size, so the block can be protected.
+			size_t pageSize = rr::memoryPageSize();
+			numBytes = (numBytes + pageSize - 1) & ~(pageSize - 1);
+		}
 
-		bool need_exec =
-		    purpose == llvm::SectionMemoryManager::AllocationPurpose::Code;
-		void *addr = rr::allocateMemoryPages(
-		    numBytes, flagsToPermissions(flags), need_exec);
+		void *addr = rr::allocateRoutineMemory(numBytes, type);
 		if(!addr)
 			return llvm::sys::MemoryBlock();
+		mappedBytes += numBytes;
 		return llvm::sys::MemoryBlock(addr, numBytes);
 	}
 
@@ -372,10 +404,16 @@ public:
 	{
 		size_t size = block.allocatedSize();
 
-		rr::deallocateMemoryPages(block.base(), size);
+		rr::deallocateRoutineMemory(block.base(), size);
+		mappedBytes -= size;
 		return std::error_code();
 	}
 
+	size_t getMappedBytes() const
+	{
+		return mappedBytes;
+	}
+
 private:
 	int flagsToPermissions(unsigned flags)
 	{
@@ -394,6 +432,8 @@ private:
 		}
 		return result;
 	}
+
+	std::atomic<size_t> mappedBytes = { 0 };
 };
 
 template<typename T>
@@ -788,8 +828,10 @@ public:
 	    std::unique_ptr<llvm::LLVMContext> context,
 	    const char *name,
 	    llvm::Function **funcs,
-	    size_t count)
+	    size_t count,
+	    std::string &&bitcode)
 	    : name(name)
+	    , bitcode(std::move(bitcode))
 #if LLVM_VERSION_MAJOR >= 13
 	    , session(std::move(Unwrap(llvm::orc::SelfExecutorProcessControl::Create())))
 #endif
@@ -912,8 +954,55 @@ public:
 		return addresses[index];
 	}
 
+	size_t getMemoryUsage() const override
+	{
+		// Memory allocated by JITLink's memory manager isn't accounted for.
+		return memoryMapper.getMappedBytes() + bitcode.size();
+	}
+
+	std::shared_ptr<rr::Routine> reoptimize() const override
+	{
+		if(bitcode.empty())
+		{
+			return nullptr;
+		}
+
+		rr::JITBuilder jit;
+		jit.builder.reset();  // Bound to the context being replaced.
+		jit.module.reset();
+		jit.context = std::make_unique<llvm::LLVMContext>();
+
+		auto module = llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode, name), *jit.context);
+		if(!module)
+		{
+			llvm::consumeError(module.takeError());
+			return nullptr;
+		}
+
+		jit.module = std::move(*module);
+
+		llvm::SmallVector<llvm::Function *, 1> funcs;
+		for(auto &func : *jit.module)
+		{
+			if(!func.isDeclaration())
+			{
+				funcs.push_back(&func);
+			}
+		}
+
+		if(funcs.size() != addresses.size())
+		{
+			return nullptr;
+		}
+
+		jit.runPasses();
+
+		return jit.acquireRoutine(name.c_str(), funcs.data(), funcs.size());
+	}
+
 private:
 	std::string name;
+	const std::string bitcode;  // Unoptimized IR, empty if the routine can't be reoptimized
 	llvm::orc::ExecutionSession session;
 	MemoryMapper memoryMapper;
 #if USE_LEGACY_OBJECT_LINKING_LAYER
@@ -937,6 +1026,7 @@ JITBuilder::JITBuilder()
 	module->setDataLayout(JITGlobals::get()->getDataLayout());
 
 	msanInstrumentation = getPragmaState(MemorySanitizerInstrumentation);
+	tieredCompilation = getPragmaState(TieredCompilation);
 }
 
 void JITBuilder::runPasses()
@@ -954,15 +1044,46 @@ void JITBuilder::runPasses()
 	if(debugInfo != nullptr)
 	{
 		optimizationLevel = 0;  // Don't optimize if we're generating debug info.
+		tieredCompilation = false;
 	}
 #endif  // ENABLE_RR_DEBUG_INFO
 
+	// Coroutines can't be reoptimized, as their IR is only valid before the coroutine passes.
+	if(tieredCompilation && !coroutine.id)
+	{
+		llvm::raw_string_ostream stream(bitcode);
+		llvm::WriteBitcodeToFile(*module, stream);
+		stream.flush();
+	}
+
+	// The full optimization pipeline is used for reoptimizing routines (see rr::TieredCompilation).
+	const bool fullPipeline = (optimizationLevel >= 3) && !coroutine.id;
+
+	// Passes added to the basic ones at lower optimization levels.
+	const auto preset = static_cast<OptimizationPreset>(getPragmaState(OptimizationPasses));
+	const bool redundancyPasses = (optimizationLevel > 0) && (preset != OptimizationPreset::Fast);
+	const bool loopPasses = (optimizationLevel > 0) && (preset == OptimizationPreset::Max);
+
 #if LLVM_VERSION_MAJOR >= 13  // New pass manager
 	llvm::LoopAnalysisManager lam;
 	llvm::FunctionAnalysisManager fam;
 	llvm::CGSCCAnalysisManager cgam;
 	llvm::ModuleAnalysisManager mam;
-	llvm::PassBuilder pb;
+	std::unique_ptr<llvm::TargetMachine> targetMachine;
+	if(fullPipeline || loopPasses)
+	{
+		// Lets the vectorizers query the target's costs.
+		auto expectedTargetMachine = JITGlobals::get()->getTargetMachineBuilder().createTargetMachine();
+		if(expectedTargetMachine)
+		{
+			targetMachine = std::move(*expectedTargetMachine);
+		}
+		else
+		{
+			llvm::consumeError(expectedTargetMachine.takeError());
+		}
+	}
+	llvm::PassBuilder pb(targetMachine.get());
 
 	pb.registerModuleAnalyses(mam);
 	pb.registerCGSCCAnalyses(cgam);
@@ -979,10 +1100,42 @@ void JITBuilder::runPasses()
 		pm = pb.buildO0DefaultPipeline(llvm::OptimizationLevel::O0);
 	}
 
-	if(optimizationLevel > 0)
+	if(fullPipeline)
+	{
+		pm = pb.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O3);
+	}
+	else if(optimizationLevel > 0)
 	{
 		fpm.addPass(llvm::SROAPass(llvm::SROAOptions::PreserveCFG));
+
+		if(redundancyPasses)
+		{
+			fpm.addPass(llvm::EarlyCSEPass(true /* UseMemorySSA */));
+		}
+
 		fpm.addPass(llvm::InstCombinePass());
+
+		if(redundancyPasses)
+		{
+			fpm.addPass(llvm::SimplifyCFGPass());
+			fpm.addPass(llvm::createFunctionToLoopPassAdaptor(llvm::LICMPass(llvm::LICMOptions()), true /* UseMemorySSA */));
+		}
+
+		if(loopPasses)
+		{
+			fpm.addPass(llvm::LoopUnrollPass(llvm::LoopUnrollOptions(optimizationLevel)));
+		}
+
+		if(redundancyPasses)
+		{
+			fpm.addPass(llvm::GVNPass());
+		}
+
+		if(loopPasses)
+		{
+			fpm.addPass(llvm::SLPVectorizerPass());
+			fpm.addPass(llvm::InstCombinePass());
+		}
 	}
 
 	if(!fpm.isEmpty())
@@ -1015,10 +1168,59 @@ void JITBuilder::runPasses()
 		passManager.add(llvm::createCoroCleanupLegacyPass());
 	}
 
-	if(optimizationLevel > 0)
+	if(fullPipeline || loopPasses)
+	{
+		auto targetMachine = JITGlobals::get()->getTargetMachineBuilder().createTargetMachine();
+		if(targetMachine)
+		{
+			passManager.add(llvm::createTargetTransformInfoWrapperPass((*targetMachine)->getTargetIRAnalysis()));
+		}
+		else
+		{
+			llvm::consumeError(targetMachine.takeError());
+		}
+	}
+
+	if(fullPipeline)
+	{
+		llvm::PassManagerBuilder passManagerBuilder;
+		passManagerBuilder.OptLevel = 3;
+		passManagerBuilder.LoopVectorize = true;
+		passManagerBuilder.SLPVectorize = true;
+		passManagerBuilder.populateModulePassManager(passManager);
+	}
+	else if(optimizationLevel > 0)
 	{
 		passManager.add(llvm::createSROAPass());
+
+		if(redundancyPasses)
+		{
+			passManager.add(llvm::createEarlyCSEPass(true /* UseMemorySSA */));
+		}
+
 		passManager.add(llvm::createInstructionCombiningPass());
+
+		if(redundancyPasses)
+		{
+			passManager.add(llvm::createCFGSimplificationPass());
+			passManager.add(llvm::createLICMPass());
+		}
+
+		if(loopPasses)
+		{
+			passManager.add(llvm::createLoopUnrollPass(optimizationLevel));
+		}
+
+		if(redundancyPasses)
+		{
+			passManager.add(llvm::createGVNPass());
+		}
+
+		if(loopPasses)
+		{
+			passManager.add(llvm::createSLPVectorizerPass());
+			passManager.add(llvm::createInstructionCombiningPass());
+		}
 	}
 
 	if(__has_feature(memory_sanitizer) && msanInstrumentation)
@@ -1039,7 +1241,7 @@ void JITBuilder::runPasses()
 std::shared_ptr<rr::Routine> JITBuilder::acquireRoutine(const char *name, llvm::Function **funcs, size_t count)
 {
 	ASSERT(module);
-	return std::make_shared<JITRoutine>(std::move(module), std::move(context), name, funcs, count);
+	return std::make_shared<JITRoutine>(std::move(module), std::move(context), name, funcs, count, std::move(bitcode));
 }
 
 }  // namespace rr
@@ -366,7 +366,7 @@ llvm::Value *clampForShift(llvm::Value *rhs)
 
 namespace rr {
 
-const int SIMD::Width = 4;
+thread_local int SIMD::Width = 4;
 
 std::string Caps::backendName()
 {
@@ -386,6 +386,18 @@ bool Caps::fmaIsFast()
 	return AVX2;
 }
 
+int Caps::maxSIMDWidth()
+{
+	static int width = CPUID::supportsAVX512F() ? 16 : CPUID::supportsAVX2() ? 8 : 4;
+
+	return width;
+}
+
+bool Caps::reoptimizationSupported()
+{
+	return true;
+}
+
 // The abstract Type* types are implemented as LLVM types, except that
 // 64-bit vectors are emulated using 128-bit ones to avoid use of MMX in x86
 // and VFP in ARM, and eliminate the overhead of converting them to explicit
@@ -118,6 +118,9 @@ public:
 #endif
 
 	bool msanInstrumentation = false;
+
+	bool tieredCompilation = false;
+	std::string bitcode;  // Unoptimized IR, retained for Routine::reoptimize()
 };
 
 inline std::memory_order atomicOrdering(llvm::AtomicOrdering memoryOrder)
@@ -32,7 +32,9 @@ struct PragmaState
 {
 	bool memorySanitizerInstrumentation = true;
 	bool initializeLocalVariables = false;
+	bool tieredCompilation = false;
 	int optimizationLevel = 2;  // Default
+	int optimizationPasses = static_cast<int>(rr::OptimizationPreset::Fast);
 };
 
 // The initialization of static thread-local data is not observed by MemorySanitizer
@@ -73,6 +75,9 @@ void Pragma(BooleanPragmaOption option, bool enable)
 	case InitializeLocalVariables:
 		state.initializeLocalVariables = enable;
 		break;
+	case TieredCompilation:
+		state.tieredCompilation = enable;
+		break;
 	default:
 		UNSUPPORTED("Unknown Boolean pragma option %d", int(option));
 	}
@@ -87,6 +92,9 @@ void Pragma(IntegerPragmaOption option, int value)
 	case OptimizationLevel:
 		state.optimizationLevel = value;
 		break;
+	case OptimizationPasses:
+		state.optimizationPasses = value;
+		break;
 	default:
 		UNSUPPORTED("Unknown integer pragma option %d", int(option));
 	}
@@ -102,6 +110,8 @@ bool getPragmaState(BooleanPragmaOption option)
 		return state.memorySanitizerInstrumentation;
 	case InitializeLocalVariables:
 		return state.initializeLocalVariables;
+	case TieredCompilation:
+		return state.tieredCompilation;
 	default:
 		UNSUPPORTED("Unknown Boolean pragma option %d", int(option));
 		return false;
@@ -116,6 +126,8 @@ int getPragmaState(IntegerPragmaOption option)
 	{
 	case OptimizationLevel:
 		return state.optimizationLevel;
+	case OptimizationPasses:
+		return state.optimizationPasses;
 	default:
 		UNSUPPORTED("Unknown integer pragma option %d", int(option));
 		return 0;
@@ -23,11 +23,23 @@ enum BooleanPragmaOption
 {
 	MemorySanitizerInstrumentation,
 	InitializeLocalVariables,
+	TieredCompilation,  // Retain the unoptimized IR of routines, for Routine::reoptimize()
 };
 
 enum IntegerPragmaOption
 {
-	OptimizationLevel,  // O0, O1, O2 (default), O3
+	OptimizationLevel,   // O0, O1, O2 (default), O3
+	OptimizationPasses,  // OptimizationPreset of the passes run at O1 and O2
+};
+
+// Optimization passes run by the LLVM backend at optimization levels 1 and 2.
+// Level 3 runs the full pipeline instead, and level 0 doesn't optimize.
+// The Subzero backend ignores this.
+enum class OptimizationPreset
+{
+	Fast,      // Scalar replacement of aggregates and instruction combining (default)
+	Balanced,  // Also early CSE, GVN, loop invariant code motion and CFG simplification
+	Max,       // Also loop unrolling and SLP vectorization
 };
 
 void Pragma(BooleanPragmaOption option, bool enable);
@@ -67,8 +67,10 @@ namespace rr {
 struct Caps
 {
 	static std::string backendName();
-	static bool coroutinesSupported();  // Support for rr::Coroutine<F>
-	static bool fmaIsFast();            // rr::FMA() is faster than `x * y + z`
+	static bool coroutinesSupported();      // Support for rr::Coroutine<F>
+	static bool fmaIsFast();                // rr::FMA() is faster than `x * y + z`
+	static int maxSIMDWidth();              // Widest SIMD::Width which the backend supports and the CPU executes natively
+	static bool reoptimizationSupported();  // Support for Routine::reoptimize()
 };
 
 class Bool;
@@ -15,6 +15,7 @@
 #ifndef rr_Routine_hpp
 #define rr_Routine_hpp
 
+#include <cstddef>
 #include <memory>
 
 namespace rr {
@@ -26,6 +27,16 @@ public:
 	virtual ~Routine() = default;
 
 	virtual const void *getEntry(int index = 0) const = 0;
+
+	// reoptimize() recompiles the routine from its unoptimized IR, at the optimization
+	// level of the calling thread. The IR is only retained for routines acquired with
+	// the TieredCompilation pragma enabled, and when Caps::reoptimizationSupported().
+	// Returns nullptr if the routine can't be reoptimized. Safe to call from any thread.
+	virtual std::shared_ptr<Routine> reoptimize() const { return nullptr; }
+
+	// Returns the number of bytes of memory holding the routine's code and data,
+	// or 0 if it is unknown.
+	virtual size_t getMemoryUsage() const { return 0; }
 };
 
 // RoutineT is a type-safe wrapper around a Routine and its function entry, returned by FunctionT
@@ -65,6 +76,11 @@ public:
 		return function;
 	}
 
+	const std::shared_ptr<Routine> &getRoutine() const
+	{
+		return routine;
+	}
+
 private:
 	std::shared_ptr<Routine> routine;
 	FunctionType function = nullptr;
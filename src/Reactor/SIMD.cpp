@@ -22,6 +22,18 @@
 
 namespace rr {
 
+SIMD::ScopedWidth::ScopedWidth(int width)
+    : previousWidth(SIMD::Width)
+{
+	ASSERT(width >= 4 && width % 4 == 0 && width <= Caps::maxSIMDWidth() && width <= SIMD::MaxWidth);
+	SIMD::Width = width;
+}
+
+SIMD::ScopedWidth::~ScopedWidth()
+{
+	SIMD::Width = previousWidth;
+}
+
 SIMD::Int::Int()
     : XYZW(this)
 {
@@ -580,8 +592,11 @@ SIMD::Float::Float(const Reference<scalar::Float> &rhs)
 SIMD::Float::Float(RValue<packed::Float4> rhs)
     : XYZW(this)
 {
-	ASSERT(SIMD::Width == 4);
-	*this = Insert128(*this, rhs, 0);
+	// Replicate the vector in each group of four lanes.
+	for(int i = 0; i < SIMD::Width / 4; i++)
+	{
+		*this = Insert128(*this, rhs, i);
+	}
 }
 
 RValue<SIMD::Float> SIMD::Float::operator=(RValue<packed::Float4> rhs)
@@ -681,14 +696,22 @@ RValue<SIMD::Float> operator-(RValue<SIMD::Float> val)
 
 RValue<SIMD::Float> Rcp(RValue<SIMD::Float> x, bool relaxedPrecision, bool exactAtPow2)
 {
-	ASSERT(SIMD::Width == 4);
-	return SIMD::Float(Rcp(Extract128(x, 0), relaxedPrecision, exactAtPow2));
+	SIMD::Float result;
+	for(int i = 0; i < SIMD::Width / 4; i++)
+	{
+		result = Insert128(result, Rcp(Extract128(x, i), relaxedPrecision, exactAtPow2), i);
+	}
+	return result;
 }
 
 RValue<SIMD::Float> RcpSqrt(RValue<SIMD::Float> x, bool relaxedPrecision)
 {
-	ASSERT(SIMD::Width == 4);
-	return SIMD::Float(RcpSqrt(Extract128(x, 0), relaxedPrecision));
+	SIMD::Float result;
+	for(int i = 0; i < SIMD::Width / 4; i++)
+	{
+		result = Insert128(result, RcpSqrt(Extract128(x, i), relaxedPrecision), i);
+	}
+	return result;
 }
 
 RValue<SIMD::Float> Insert(RValue<SIMD::Float> x, RValue<scalar::Float> element, int i)
@@ -803,96 +826,145 @@ RValue<SIMD::Float> Log2(RValue<SIMD::Float> x)
 
 RValue<Int> SignMask(RValue<SIMD::Int> x)
 {
-	ASSERT(SIMD::Width == 4);
-	return SignMask(Extract128(x, 0));
+	Int mask = SignMask(Extract128(x, 0));
+	for(int i = 1; i < SIMD::Width / 4; i++)
+	{
+		mask |= SignMask(Extract128(x, i)) << (4 * i);
+	}
+	return mask;
 }
 
 RValue<SIMD::UInt> Ctlz(RValue<SIMD::UInt> x, bool isZeroUndef)
 {
-	ASSERT(SIMD::Width == 4);
 	SIMD::UInt result;
-	return Insert128(result, Ctlz(Extract128(x, 0), isZeroUndef), 0);
+	for(int i = 0; i < SIMD::Width / 4; i++)
+	{
+		result = Insert128(result, Ctlz(Extract128(x, i), isZeroUndef), i);
+	}
+	return result;
 }
 
 RValue<SIMD::UInt> Cttz(RValue<SIMD::UInt> x, bool isZeroUndef)
 {
-	ASSERT(SIMD::Width == 4);
 	SIMD::UInt result;
-	return Insert128(result, Cttz(Extract128(x, 0), isZeroUndef), 0);
+	for(int i = 0; i < SIMD::Width / 4; i++)
+	{
+		result = Insert128(result, Cttz(Extract128(x, i), isZeroUndef), i);
+	}
+	return result;
 }
 
 RValue<SIMD::Int> MulHigh(RValue<SIMD::Int> x, RValue<SIMD::Int> y)
 {
-	ASSERT(SIMD::Width == 4);
 	SIMD::Int result;
-	return Insert128(result, MulHigh(Extract128(x, 0), Extract128(y, 0)), 0);
+	for(int i = 0; i < SIMD::Width / 4; i++)
+	{
+		result = Insert128(result, MulHigh(Extract128(x, i), Extract128(y, i)), i);
+	}
+	return result;
 }
 
 RValue<SIMD::UInt> MulHigh(RValue<SIMD::UInt> x, RValue<SIMD::UInt> y)
 {
-	ASSERT(SIMD::Width == 4);
 	SIMD::UInt result;
-	return Insert128(result, MulHigh(Extract128(x, 0), Extract128(y, 0)), 0);
+	for(int i = 0; i < SIMD::Width / 4; i++)
+	{
+		result = Insert128(result, MulHigh(Extract128(x, i), Extract128(y, i)), i);
+	}
+	return result;
 }
 
 RValue<Bool> AnyTrue(const RValue<SIMD::Int> &bools)
 {
-	ASSERT(SIMD::Width == 4);
-	return AnyTrue(Extract128(bools, 0));
+	packed::Int4 any = Extract128(bools, 0);
+	for(int i = 1; i < SIMD::Width / 4; i++)
+	{
+		any |= Extract128(bools, i);
+	}
+	return AnyTrue(any);
 }
 
 RValue<Bool> AnyFalse(const RValue<SIMD::Int> &bools)
 {
-	ASSERT(SIMD::Width == 4);
-	return AnyFalse(Extract128(bools, 0));
+	packed::Int4 all = Extract128(bools, 0);
+	for(int i = 1; i < SIMD::Width / 4; i++)
+	{
+		all &= Extract128(bools, i);
+	}
+	return AnyFalse(all);
 }
 
 RValue<Bool> Divergent(const RValue<SIMD::Int> &ints)
 {
-	ASSERT(SIMD::Width == 4);
-	return Divergent(Extract128(ints, 0));
+	if(SIMD::Width == 4)
+	{
+		return Divergent(Extract128(ints, 0));
+	}
+
+	auto broadcastFirst = SIMD::Int(Extract(ints, 0));
+	return AnyTrue(CmpNEQ(broadcastFirst, ints));
 }
 
+// Swizzles and shuffles select lanes within each group of four lanes.
+
 RValue<SIMD::Int> Swizzle(RValue<SIMD::Int> x, uint16_t select)
 {
-	ASSERT(SIMD::Width == 4);
 	SIMD::Int result;
-	return Insert128(result, Swizzle(Extract128(x, 0), select), 0);
+	for(int i = 0; i < SIMD::Width / 4; i++)
+	{
+		result = Insert128(result, Swizzle(Extract128(x, i), select), i);
+	}
+	return result;
 }
 
 RValue<SIMD::UInt> Swizzle(RValue<SIMD::UInt> x, uint16_t select)
 {
-	ASSERT(SIMD::Width == 4);
 	SIMD::UInt result;
-	return Insert128(result, Swizzle(Extract128(x, 0), select), 0);
+	for(int i = 0; i < SIMD::Width / 4; i++)
+	{
+		result = Insert128(result, Swizzle(Extract128(x, i), select), i);
+	}
+	return result;
 }
 
 RValue<SIMD::Float> Swizzle(RValue<SIMD::Float> x, uint16_t select)
 {
-	ASSERT(SIMD::Width == 4);
 	SIMD::Float result;
-	return Insert128(result, Swizzle(Extract128(x, 0), select), 0);
+	for(int i = 0; i < SIMD::Width / 4; i++)
+	{
+		result = Insert128(result, Swizzle(Extract128(x, i), select), i);
+	}
+	return result;
 }
 
 RValue<SIMD::Int> Shuffle(RValue<SIMD::Int> x, RValue<SIMD::Int> y, uint16_t select)
 {
-	ASSERT(SIMD::Width == 4);
 	SIMD::Int result;
-	return Insert128(result, Shuffle(Extract128(x, 0), Extract128(y, 0), select), 0);
+	for(int i = 0; i < SIMD::Width / 4; i++)
+	{
+		result = Insert128(result, Shuffle(Extract128(x, i), Extract128(y, i), select), i);
+	}
+	return result;
 }
 
 RValue<SIMD::UInt> Shuffle(RValue<SIMD::UInt> x, RValue<SIMD::UInt> y, uint16_t select)
 {
-	ASSERT(SIMD::Width == 4);
 	SIMD::UInt result;
-	return Insert128(result, Shuffle(Extract128(x, 0), Extract128(y, 0), select), 0);
+	for(int i = 0; i < SIMD::Width / 4; i++)
+	{
+		result = Insert128(result, Shuffle(Extract128(x, i), Extract128(y, i), select), i);
+	}
+	return result;
 }
 
 RValue<SIMD::Float> Shuffle(RValue<SIMD::Float> x, RValue<SIMD::Float> y, uint16_t select)
 {
-	ASSERT(SIMD::Width == 4);
 	SIMD::Float result;
-	return Insert128(result, Shuffle(Extract128(x, 0), Extract128(y, 0), select), 0);
+	for(int i = 0; i < SIMD::Width / 4; i++)
+	{
+		result = Insert128(result, Shuffle(Extract128(x, i), Extract128(y, i), select), i);
+	}
+	return result;
 }
 
 SIMD::Pointer::Pointer(scalar::Pointer<Byte> base, rr::Int limit)
@@ -1027,13 +1099,10 @@ SIMD::Int SIMD::Pointer::isInBounds(unsigned int accessSize, OutOfBoundsBehavior
 
 	if(!hasDynamicOffsets && !hasDynamicLimit)
 	{
-		ASSERT(SIMD::Width == 4);
 		// Common fast paths.
-		return SIMD::Int(
-		    (staticOffsets[0] + accessSize - 1 < staticLimit) ? 0xFFFFFFFF : 0,
-		    (staticOffsets[1] + accessSize - 1 < staticLimit) ? 0xFFFFFFFF : 0,
-		    (staticOffsets[2] + accessSize - 1 < staticLimit) ? 0xFFFFFFFF : 0,
-		    (staticOffsets[3] + accessSize - 1 < staticLimit) ? 0xFFFFFFFF : 0);
+		return SIMD::Int([&](int i) {
+			return (staticOffsets[i] + accessSize - 1 < staticLimit) ? 0xFFFFFFFF : 0;
+		});
 	}
 
 	return CmpGE(offsets(), 0) & CmpLT(offsets() + SIMD::Int(accessSize - 1), limit());
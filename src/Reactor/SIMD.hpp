@@ -38,7 +38,24 @@ using Float4 = rr::Float4;
 
 namespace SIMD {
 
-extern const int Width;
+// Number of lanes of the SIMD::Int, SIMD::UInt, and SIMD::Float types used by
+// routines generated on the calling thread. It defaults to 4, and is always a
+// multiple of 4 no larger than Caps::maxSIMDWidth().
+extern thread_local int Width;
+
+// Upper bound of SIMD::Width, for sizing storage which holds a value per lane.
+constexpr int MaxWidth = 16;
+
+// ScopedWidth changes SIMD::Width for the calling thread until it goes out of scope.
+class ScopedWidth
+{
+public:
+	explicit ScopedWidth(int width);
+	~ScopedWidth();
+
+private:
+	const int previousWidth;
+};
 
 class Int;
 class UInt;
@@ -663,16 +680,30 @@ inline void SIMD::Pointer::Store(T val, OutOfBoundsBehavior robustness, SIMD::In
 		{
 			If(AnyTrue(mask))
 			{
-				assert(SIMD::Width == 4);
-
 				// All equal. One of these writes will win -- elect the winning lane.
-				auto v0111 = SIMD::Int(0, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF);
-				auto elect = mask & ~(v0111 & (mask.xxyz | mask.xxxy | mask.xxxx));
+				SIMD::Int elect;
+				if(SIMD::Width == 4)
+				{
+					auto v0111 = SIMD::Int(0, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF);
+					elect = mask & ~(v0111 & (mask.xxyz | mask.xxxy | mask.xxxx));
+				}
+				else
+				{
+					// Elect the first active lane.
+					scalar::Int preceding = 0;
+					for(int i = 0; i < SIMD::Width; i++)
+					{
+						scalar::Int active = Extract(mask, i);
+						elect = Insert(elect, active & ~preceding, i);
+						preceding |= active;
+					}
+				}
 				auto maskedVal = As<SIMD::Int>(val) & elect;
-				auto scalarVal = Extract(maskedVal, 0) |
-				                 Extract(maskedVal, 1) |
-				                 Extract(maskedVal, 2) |
-				                 Extract(maskedVal, 3);
+				scalar::Int scalarVal = Extract(maskedVal, 0);
+				for(int i = 1; i < SIMD::Width; i++)
+				{
+					scalarVal |= Extract(maskedVal, i);
+				}
 				*scalar::Pointer<EL>(base + staticOffsets[0], alignment) = As<EL>(scalarVal);
 			}
 		}
@@ -30,17 +30,24 @@
 #include "src/IceGlobalInits.h"
 #include "src/IceTypes.h"
 
+#include "llvm/ADT/BitVector.h"
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/raw_os_ostream.h"
 
-#include "marl/event.h"
-
 #if __has_feature(memory_sanitizer)
 #	include <sanitizer/msan_interface.h>
 #endif
 
+#if defined(__i386__) || defined(__x86_64__)
+#	if defined(_WIN32)
+#		include <intrin.h>
+#	else
+#		include <x86intrin.h>
+#	endif
+#endif
+
 #if defined(_WIN32)
 #	ifndef WIN32_LEAN_AND_MEAN
 #		define WIN32_LEAN_AND_MEAN
@@ -52,10 +59,15 @@
 #endif
 
 #include <array>
+#include <chrono>
 #include <cmath>
+#include <cstring>
 #include <iostream>
 #include <limits>
 #include <mutex>
+#include <new>
+#include <unordered_map>
+#include <unordered_set>
 
 // Subzero utility functions
 // These functions only accept and return Subzero (Ice) types, and do not access any globals.
@@ -95,21 +107,6 @@ Ice::Type getPointerType(Ice::Type elementType)
 	}
 }
 
-Ice::Variable *allocateStackVariable(Ice::Cfg *function, Ice::Type type, int arraySize = 0)
-{
-	int typeSize = Ice::typeWidthInBytes(type);
-	int totalSize = typeSize * (arraySize ? arraySize : 1);
-
-	auto bytes = Ice::ConstantInteger32::create(function->getContext(), Ice::IceType_i32, totalSize);
-	auto address = function->makeVariable(getPointerType(type));
-	auto alloca = Ice::InstAlloca::create(function, address, bytes, typeSize);  // SRoA depends on the alignment to match the type size.
-	function->getEntryNode()->getInsts().push_front(alloca);
-
-	ASSERT(!rr::getPragmaState(rr::InitializeLocalVariables) && "Subzero does not support initializing local variables");
-
-	return address;
-}
-
 Ice::Constant *getConstantPointer(Ice::GlobalContext *context, const void *ptr)
 {
 	if(sizeof(void *) == 8)
@@ -223,16 +220,6 @@ Ice::Fdstream *out = nullptr;
 // Coroutine globals
 rr::Type *coroYieldType = nullptr;
 std::shared_ptr<rr::CoroutineGenerator> coroGen;
-marl::Scheduler &getOrCreateScheduler()
-{
-	static auto scheduler = [] {
-		marl::Scheduler::Config cfg;
-		cfg.setWorkerThreadCount(8);
-		return std::make_unique<marl::Scheduler>(cfg);
-	}();
-
-	return *scheduler;
-}
 
 rr::Nucleus::OptimizerCallback *optimizerCallback = nullptr;
 
@@ -343,7 +330,7 @@ static_assert(!subzeroEmitTextAsm, "Compile Subzero with ALLOW_DUMP=1 for subzer
 
 namespace rr {
 
-const int SIMD::Width = 4;
+thread_local int SIMD::Width = 4;
 
 std::string Caps::backendName()
 {
@@ -361,6 +348,17 @@ bool Caps::fmaIsFast()
 	return false;
 }
 
+int Caps::maxSIMDWidth()
+{
+	// Subzero only supports 128-bit SIMD vectors.
+	return 4;
+}
+
+bool Caps::reoptimizationSupported()
+{
+	return false;
+}
+
 enum EmulatedType
 {
 	EmulatedShift = 16,
@@ -730,13 +728,12 @@ struct ExecutableAllocator
 
 	T *allocate(size_type n)
 	{
-		return (T *)allocateMemoryPages(
-		    sizeof(T) * n, PERMISSION_READ | PERMISSION_WRITE, true);
+		return (T *)allocateRoutineMemory(sizeof(T) * n, ROUTINE_MEMORY_CODE);
 	}
 
 	void deallocate(T *p, size_type n)
 	{
-		deallocateMemoryPages(p, sizeof(T) * n);
+		deallocateRoutineMemory(p, sizeof(T) * n);
 	}
 };
 
@@ -826,6 +823,17 @@ public:
 		return funcs[index];
 	}
 
+	size_t getMemoryUsage() const override
+	{
+		size_t usage = buffer.size();
+		for(const auto &c : constantsPool)
+		{
+			usage += c.space;
+		}
+
+		return usage;
+	}
+
 	const void *addConstantData(const void *data, size_t size, size_t alignment = 1)
 	{
 		// Check if we already have a suitable constant.
@@ -971,6 +979,23 @@ Nucleus::~Nucleus()
 	::codegenMutex.unlock();
 }
 
+// Runs Reactor's optimization passes on the function, before it's passed to
+// acquireRoutine(). The function's allocator must be installed in TLS.
+static void optimizeFunction(Ice::Cfg *function)
+{
+	if(::optimizerCallback)
+	{
+		Nucleus::OptimizerReport report;
+		rr::optimize(function, &report);
+		::optimizerCallback(&report);
+		::optimizerCallback = nullptr;
+	}
+	else
+	{
+		rr::optimize(function);
+	}
+}
+
 // This function lowers and produces executable binary code in memory for the input functions,
 // and returns a Routine with the entry points to these functions.
 template<size_t Count>
@@ -998,18 +1023,6 @@ static std::shared_ptr<Routine> acquireRoutine(Ice::Cfg *const (&functions)[Coun
 
 		currFunc->setFunctionName(Ice::GlobalString::createWithString(::context, names[i]));
 
-		if(::optimizerCallback)
-		{
-			Nucleus::OptimizerReport report;
-			rr::optimize(currFunc, &report);
-			::optimizerCallback(&report);
-			::optimizerCallback = nullptr;
-		}
-		else
-		{
-			rr::optimize(currFunc);
-		}
-
 		currFunc->computeInOutEdges();
 		ASSERT_MSG(!currFunc->hasError(), "%s", currFunc->getError().c_str());
 
@@ -1080,6 +1093,7 @@ static std::shared_ptr<Routine> acquireRoutine(Ice::Cfg *const (&functions)[Coun
 std::shared_ptr<Routine> Nucleus::acquireRoutine(const char *name)
 {
 	finalizeFunction();
+	optimizeFunction(::function);
 	return rr::acquireRoutine({ ::function }, { name });
 }
 
@@ -1285,8 +1299,23 @@ Value *Nucleus::createFRem(Value *lhs, Value *rhs)
 	RR_DEBUG_INFO_UPDATE_LOC();
 	// TODO(b/148139679) Fix Subzero generating invalid code for FRem on vector types
 	// createArithmetic(Ice::InstArithmetic::Frem, lhs, rhs);
-	UNIMPLEMENTED("b/148139679 Nucleus::createFRem");
-	return nullptr;
+	Ice::Type type = lhs->getType();
+	ASSERT(Ice::typeElementType(type) == Ice::IceType_f32);
+
+	if(!Ice::isVectorType(type))
+	{
+		return V(sz::Call(::function, ::basicBlock, fmodf, V(lhs), V(rhs)));
+	}
+
+	Value *result = lhs;
+	for(int i = 0; i < static_cast<int>(Ice::typeNumElements(type)); i++)
+	{
+		Value *a = createExtractElement(lhs, T(Ice::IceType_f32), i);
+		Value *b = createExtractElement(rhs, T(Ice::IceType_f32), i);
+		result = createInsertElement(result, V(sz::Call(::function, ::basicBlock, fmodf, V(a), V(b))), i);
+	}
+
+	return result;
 }
 
 Value *Nucleus::createShl(Value *lhs, Value *rhs)
@@ -2917,8 +2946,8 @@ RValue<UInt4> MulHigh(RValue<UInt4> x, RValue<UInt4> y)
 RValue<UShort4> Average(RValue<UShort4> x, RValue<UShort4> y)
 {
 	RR_DEBUG_INFO_UPDATE_LOC();
-	UNIMPLEMENTED_NO_BUG("RValue<UShort4> Average(RValue<UShort4> x, RValue<UShort4> y)");
-	return UShort4(0);
+	// Rounding average, like PAVGW, without overflowing the 16-bit lanes.
+	return (x | y) - ((x ^ y) >> 1);
 }
 
 Type *UShort4::type()
@@ -2967,15 +2996,47 @@ RValue<Short8> operator>>(RValue<Short8> lhs, unsigned char rhs)
 RValue<Int4> MulAdd(RValue<Short8> x, RValue<Short8> y)
 {
 	RR_DEBUG_INFO_UPDATE_LOC();
-	UNIMPLEMENTED_NO_BUG("RValue<Int4> MulAdd(RValue<Short8> x, RValue<Short8> y)");
-	return Int4(0);
+	if(emulateIntrinsics)
+	{
+		Int4 result;
+		result = Insert(result, Int(Extract(x, 0)) * Int(Extract(y, 0)) + Int(Extract(x, 1)) * Int(Extract(y, 1)), 0);
+		result = Insert(result, Int(Extract(x, 2)) * Int(Extract(y, 2)) + Int(Extract(x, 3)) * Int(Extract(y, 3)), 1);
+		result = Insert(result, Int(Extract(x, 4)) * Int(Extract(y, 4)) + Int(Extract(x, 5)) * Int(Extract(y, 5)), 2);
+		result = Insert(result, Int(Extract(x, 6)) * Int(Extract(y, 6)) + Int(Extract(x, 7)) * Int(Extract(y, 7)), 3);
+
+		return result;
+	}
+	else
+	{
+		Ice::Variable *result = ::function->makeVariable(Ice::IceType_v8i16);
+		const Ice::Intrinsics::IntrinsicInfo intrinsic = { Ice::Intrinsics::MultiplyAddPairs, Ice::Intrinsics::SideEffects_F, Ice::Intrinsics::ReturnsTwice_F, Ice::Intrinsics::MemoryWrite_F };
+		auto pmaddwd = Ice::InstIntrinsic::create(::function, 2, result, intrinsic);
+		pmaddwd->addArg(x.value());
+		pmaddwd->addArg(y.value());
+		::basicBlock->appendInst(pmaddwd);
+
+		return As<Int4>(V(result));
+	}
 }
 
 RValue<Short8> MulHigh(RValue<Short8> x, RValue<Short8> y)
 {
 	RR_DEBUG_INFO_UPDATE_LOC();
-	UNIMPLEMENTED_NO_BUG("RValue<Short8> MulHigh(RValue<Short8> x, RValue<Short8> y)");
-	return Short8(0);
+	if(emulateIntrinsics)
+	{
+		return Scalarize([](auto a, auto b) { return Short((Int(a) * Int(b)) >> 16); }, x, y);
+	}
+	else
+	{
+		Ice::Variable *result = ::function->makeVariable(Ice::IceType_v8i16);
+		const Ice::Intrinsics::IntrinsicInfo intrinsic = { Ice::Intrinsics::MultiplyHighSigned, Ice::Intrinsics::SideEffects_F, Ice::Intrinsics::ReturnsTwice_F, Ice::Intrinsics::MemoryWrite_F };
+		auto pmulhw = Ice::InstIntrinsic::create(::function, 2, result, intrinsic);
+		pmulhw->addArg(x.value());
+		pmulhw->addArg(y.value());
+		::basicBlock->appendInst(pmulhw);
+
+		return RValue<Short8>(V(result));
+	}
 }
 
 Type *Short8::type()
@@ -3024,8 +3085,21 @@ RValue<UShort8> operator>>(RValue<UShort8> lhs, unsigned char rhs)
 RValue<UShort8> MulHigh(RValue<UShort8> x, RValue<UShort8> y)
 {
 	RR_DEBUG_INFO_UPDATE_LOC();
-	UNIMPLEMENTED_NO_BUG("RValue<UShort8> MulHigh(RValue<UShort8> x, RValue<UShort8> y)");
-	return UShort8(0);
+	if(emulateIntrinsics)
+	{
+		return Scalarize([](auto a, auto b) { return UShort((UInt(a) * UInt(b)) >> 16); }, x, y);
+	}
+	else
+	{
+		Ice::Variable *result = ::function->makeVariable(Ice::IceType_v8i16);
+		const Ice::Intrinsics::IntrinsicInfo intrinsic = { Ice::Intrinsics::MultiplyHighUnsigned, Ice::Intrinsics::SideEffects_F, Ice::Intrinsics::ReturnsTwice_F, Ice::Intrinsics::MemoryWrite_F };
+		auto pmulhuw = Ice::InstIntrinsic::create(::function, 2, result, intrinsic);
+		pmulhuw->addArg(x.value());
+		pmulhuw->addArg(y.value());
+		::basicBlock->appendInst(pmulhuw);
+
+		return RValue<UShort8>(V(result));
+	}
 }
 
 Type *UShort8::type()
@@ -4037,11 +4111,20 @@ Type *Float4::type()
 	return T(Ice::IceType_v4f32);
 }
 
+// Equivalent of LLVM's readcyclecounter intrinsic, which Subzero lacks.
+static uint64_t readCycleCounter()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
 RValue<Long> Ticks()
 {
 	RR_DEBUG_INFO_UPDATE_LOC();
-	UNIMPLEMENTED_NO_BUG("RValue<Long> Ticks()");
-	return Long(Int(0));
+	return Call(readCycleCounter);
 }
 
 RValue<Pointer<Byte>> ConstantPointer(const void *ptr)
@@ -4080,17 +4163,58 @@ void Nucleus::createFence(std::memory_order memoryOrder)
 	::basicBlock->appendInst(inst);
 }
 
+// Subzero has no masked memory intrinsics, so the enabled lanes are accessed
+// individually, like for gather() and scatter(). Only 4 x 32-bit lanes are used.
 Value *Nucleus::createMaskedLoad(Value *ptr, Type *elTy, Value *mask, unsigned int alignment, bool zeroMaskedLanes)
 {
 	RR_DEBUG_INFO_UPDATE_LOC();
-	UNIMPLEMENTED("b/155867273 Subzero createMaskedLoad()");
-	return nullptr;
+	ASSERT(mask->getType() == Ice::IceType_v4i32);
+	ASSERT(T(elTy) == Ice::IceType_i32 || T(elTy) == Ice::IceType_f32);
+
+	constexpr bool atomic = false;
+	constexpr std::memory_order order = std::memory_order_relaxed;
+
+	Pointer<Int> base = RValue<Pointer<Int>>(ptr);
+	RValue<Int4> laneMask = RValue<Int4>(mask);
+
+	// Masked lanes are zero, which is also a valid value when they're undefined.
+	Int4 result = Int4(0);
+	for(int i = 0; i < 4; i++)
+	{
+		If(Extract(laneMask, i) != 0)
+		{
+			result = Insert(result, Load(Pointer<Int>(&base[i]), alignment, atomic, order), i);
+		}
+	}
+
+	if(T(elTy) == Ice::IceType_f32)
+	{
+		return createBitCast(result.loadValue(), Float4::type());
+	}
+
+	return result.loadValue();
 }
 
 void Nucleus::createMaskedStore(Value *ptr, Value *val, Value *mask, unsigned int alignment)
 {
 	RR_DEBUG_INFO_UPDATE_LOC();
-	UNIMPLEMENTED("b/155867273 Subzero createMaskedStore()");
+	ASSERT(mask->getType() == Ice::IceType_v4i32);
+	ASSERT(val->getType() == Ice::IceType_v4i32 || val->getType() == Ice::IceType_v4f32);
+
+	constexpr bool atomic = false;
+	constexpr std::memory_order order = std::memory_order_relaxed;
+
+	Pointer<Int> base = RValue<Pointer<Int>>(ptr);
+	RValue<Int4> laneMask = RValue<Int4>(mask);
+	RValue<Int4> values = RValue<Int4>((val->getType() == Ice::IceType_v4f32) ? createBitCast(val, Int4::type()) : val);
+
+	for(int i = 0; i < 4; i++)
+	{
+		If(Extract(laneMask, i) != 0)
+		{
+			Store(Extract(values, i), Pointer<Int>(&base[i]), alignment, atomic, order);
+		}
+	}
 }
 
 template<typename T>
@@ -4302,121 +4426,44 @@ void FlushDebug() {}
 namespace {
 namespace coro {
 
-// Instance data per generated coroutine
-// This is the "handle" type used for Coroutine functions
-// Lifetime: from yield to when CoroutineEntryDestroy generated function is called.
-struct CoroutineData
-{
-	bool useInternalScheduler = false;
-	bool done = false;        // the coroutine should stop at the next yield()
-	bool terminated = false;  // the coroutine has finished.
-	bool inRoutine = false;   // is the coroutine currently executing?
-	marl::Scheduler::Fiber *mainFiber = nullptr;
-	marl::Scheduler::Fiber *routineFiber = nullptr;
-	void *promisePtr = nullptr;
-};
-
-CoroutineData *createCoroutineData()
+// Header of the frame holding the state of a coroutine instance in between
+// calls to its await function. The frame is the coroutine's handle.
+// It is followed by the yielded value at PromiseOffset, and then by the
+// arguments, the stack variables, and the values live across yields.
+// Lifetime: from CoroutineEntryBegin to CoroutineEntryDestroy.
+struct Frame
 {
-	return new CoroutineData{};
-}
-
-void destroyCoroutineData(CoroutineData *coroData)
-{
-	delete coroData;
-}
-
-// suspend() pauses execution of the coroutine, and resumes execution from the
-// caller's call to await().
-// Returns true if await() is called again, or false if coroutine_destroy()
-// is called.
-bool suspend(Nucleus::CoroutineHandle handle)
-{
-	auto *coroData = reinterpret_cast<CoroutineData *>(handle);
-	ASSERT(marl::Scheduler::Fiber::current() == coroData->routineFiber);
-	ASSERT(coroData->inRoutine);
-	coroData->inRoutine = false;
-	coroData->mainFiber->notify();
-	while(!coroData->inRoutine)
-	{
-		coroData->routineFiber->wait();
-	}
-	return !coroData->done;
-}
-
-// resume() is called by await(), blocking until the coroutine calls yield()
-// or the coroutine terminates.
-void resume(Nucleus::CoroutineHandle handle)
-{
-	auto *coroData = reinterpret_cast<CoroutineData *>(handle);
-	ASSERT(marl::Scheduler::Fiber::current() == coroData->mainFiber);
-	ASSERT(!coroData->inRoutine);
-	coroData->inRoutine = true;
-	coroData->routineFiber->notify();
-	while(coroData->inRoutine)
-	{
-		coroData->mainFiber->wait();
-	}
-}
-
-// stop() is called by coroutine_destroy(), signalling that it's done, then blocks
-// until the coroutine ends, and deletes the coroutine data.
-void stop(Nucleus::CoroutineHandle handle)
-{
-	auto *coroData = reinterpret_cast<CoroutineData *>(handle);
-	ASSERT(marl::Scheduler::Fiber::current() == coroData->mainFiber);
-	ASSERT(!coroData->inRoutine);
-	if(!coroData->terminated)
-	{
-		coroData->done = true;
-		coroData->inRoutine = true;
-		coroData->routineFiber->notify();
-		while(!coroData->terminated)
-		{
-			coroData->mainFiber->wait();
-		}
-	}
-	if(coroData->useInternalScheduler)
-	{
-		::getOrCreateScheduler().unbind();
-	}
-	coro::destroyCoroutineData(coroData);  // free the coroutine data.
-}
+	uint32_t resumePoint;  // 0 to start from the top, otherwise 1 + the index of the yield to resume from
+	uint32_t done;         // non-zero once the coroutine has returned
+};
 
-namespace detail {
-thread_local rr::Nucleus::CoroutineHandle coroHandle{};
-}  // namespace detail
+constexpr uint32_t FrameAlignment = 16;
+constexpr uint32_t PromiseOffset = FrameAlignment;
+static_assert(sizeof(Frame) <= PromiseOffset, "Frame header overlaps the promise");
 
-void setHandleParam(Nucleus::CoroutineHandle handle)
+Nucleus::CoroutineHandle createFrame(uint32_t size)
 {
-	ASSERT(!detail::coroHandle);
-	detail::coroHandle = handle;
-}
+	void *frame = ::operator new(size, std::align_val_t(FrameAlignment));
+	memset(frame, 0, size);
 
-Nucleus::CoroutineHandle getHandleParam()
-{
-	ASSERT(detail::coroHandle);
-	auto handle = detail::coroHandle;
-	detail::coroHandle = {};
-	return handle;
+	return frame;
 }
 
-bool isDone(Nucleus::CoroutineHandle handle)
+void destroyFrame(Nucleus::CoroutineHandle handle)
 {
-	auto *coroData = reinterpret_cast<CoroutineData *>(handle);
-	return coroData->done;
+	::operator delete(handle, std::align_val_t(FrameAlignment));
 }
 
-void setPromisePtr(Nucleus::CoroutineHandle handle, void *promisePtr)
+void *getPromisePtr(Nucleus::CoroutineHandle handle)
 {
-	auto *coroData = reinterpret_cast<CoroutineData *>(handle);
-	coroData->promisePtr = promisePtr;
+	return reinterpret_cast<uint8_t *>(handle) + PromiseOffset;
 }
 
-void *getPromisePtr(Nucleus::CoroutineHandle handle)
+// Callee of the instructions marking yields, until they get replaced by
+// CoroutineGenerator::generateAwaitFunction(). Never called.
+void yieldMarker()
 {
-	auto *coroData = reinterpret_cast<CoroutineData *>(handle);
-	return coroData->promisePtr;
+	UNREACHABLE("Coroutine yield marker was not lowered");
 }
 
 }  // namespace coro
@@ -4424,6 +4471,11 @@ void *getPromisePtr(Nucleus::CoroutineHandle handle)
 
 // Used to generate coroutines.
 // Lifetime: from yield to acquireCoroutine
+//
+// Coroutines are compiled into state machines, instead of running on fibers.
+// The function built by Reactor becomes the await function, which resumes
+// execution after the yield it last returned at, and returns at the next one.
+// State which has to survive in between calls lives in the coroutine's frame.
 class CoroutineGenerator
 {
 public:
@@ -4431,136 +4483,279 @@ public:
 	{
 	}
 
-	// Inserts instructions at the top of the current function to make it a coroutine.
-	void generateCoroutineBegin()
-	{
-		// Begin building the main coroutine_begin() function.
-		// We insert these instructions at the top of the entry node,
-		// before existing reactor-generated instructions.
-
-		//    CoroutineHandle coroutine_begin(<Arguments>)
-		//    {
-		//        this->handle = coro::getHandleParam();
-		//
-		//        YieldType promise;
-		//        coro::setPromisePtr(handle, &promise); // For await
-		//
-		//        ... <REACTOR CODE> ...
-		//
-
-		//        this->handle = coro::getHandleParam();
-		this->handle = sz::Call(::function, ::entryBlock, coro::getHandleParam);
-
-		//        YieldType promise;
-		//        coro::setPromisePtr(handle, &promise); // For await
-		this->promise = sz::allocateStackVariable(::function, T(::coroYieldType));
-		sz::Call(::function, ::entryBlock, coro::setPromisePtr, this->handle, this->promise);
-	}
-
 	// Adds instructions for Yield() calls at the current location of the main coroutine function.
 	void generateYield(Value *val)
 	{
 		//        ... <REACTOR CODE> ...
 		//
-		//        promise = val;
-		//        if (!coro::suspend(handle)) {
-		//            return false; // coroutine has been stopped by the caller.
-		//        }
+		//        coro::yieldMarker(val);
+		//        goto resume;
+		//    resume:
 		//
 		//        ... <REACTOR CODE> ...
+		//
+		// The marker keeps the yielded value alive until generateAwaitFunction()
+		// replaces it with the suspension of the coroutine. Until then, the branch
+		// models resuming execution, so the function can still be optimized as usual.
 
-		//        promise = val;
-		Nucleus::createStore(val, V(this->promise), ::coroYieldType);
+		auto callTarget = sz::getConstantPointer(::context, reinterpret_cast<const void *>(coro::yieldMarker));
+		auto marker = Ice::InstCall::create(::function, 1, nullptr, callTarget, false);
+		marker->addArg(V(val));
+		::basicBlock->appendInst(marker);
 
-		//        if (!coro::suspend(handle)) {
-		auto result = sz::Call(::function, ::basicBlock, coro::suspend, this->handle);
-		auto doneBlock = Nucleus::createBasicBlock();
-		auto resumeBlock = Nucleus::createBasicBlock();
-		Nucleus::createCondBr(V(result), resumeBlock, doneBlock);
+		auto resumeBlock = ::function->makeNode();
+		auto branch = Ice::InstBr::create(::function, resumeBlock);
+		::basicBlock->appendInst(branch);
 
-		//            return false; // coroutine has been stopped by the caller.
-		::basicBlock = doneBlock;
-		Nucleus::createRetVoid();  // coroutine return value is ignored.
+		yields.push_back({ ::basicBlock, marker, branch, resumeBlock });
 
-		//        ... <REACTOR CODE> ...
 		::basicBlock = resumeBlock;
 	}
 
 	using FunctionUniquePtr = std::unique_ptr<Ice::Cfg>;
 
-	// Generates the await function for the current coroutine.
-	// Cannot use Nucleus functions that modify ::function and ::basicBlock.
-	static FunctionUniquePtr generateAwaitFunction()
+	// Turns the main coroutine function into the await function. Must be called after it
+	// has been finalized and optimized, as the optimizer expects values to have a single
+	// definition, while the values live across yields get reloaded from the frame.
+	void generateAwaitFunction()
 	{
-		// bool coroutine_await(CoroutineHandle handle, YieldType* out)
+		// bool coroutine_await(CoroutineHandle frame, YieldType *out)
 		// {
-		//     if (coro::isDone())
+		//     <stack variables> = frame + <offset>;
+		//     <arguments> = *(frame + <offset>);
+		//
+		//     if(frame->done)
 		//     {
 		//         return false;
 		//     }
-		//     else // resume
+		//
+		//     *out = frame->promise;
+		//
+		//     switch(frame->resumePoint)
 		//     {
-		//         YieldType* promise = coro::getPromisePtr(handle);
-		//         *out = *promise;
-		//         coro::resume(handle);
-		//         return true;
+		//     case 1 + <yield index>:
+		//         <values live across the yield> = *(frame + <offset>);
+		//         goto <code following the yield>;
+		//     ...
 		//     }
+		//
+		//     ... <REACTOR CODE> ...
+		//
+		//     // Yield(val)
+		//     frame->promise = val;
+		//     *(frame + <offset>) = <values live across the yield>;
+		//     frame->resumePoint = 1 + <yield index>;
+		//     return true;
+		//
+		//     ... <REACTOR CODE> ...
+		//
+		//     // Return()
+		//     frame->done = true;
+		//     return true;
 		// }
 
-		// Subzero doesn't support bool types (IceType_i1) as return type
-		const Ice::Type ReturnType = Ice::IceType_i32;
-		const Ice::Type YieldPtrType = sz::getPointerType(T(::coroYieldType));
+		Ice::Cfg *function = ::function;
 		const Ice::Type HandleType = sz::getPointerType(Ice::IceType_void);
+		const Ice::Type YieldType = T(::coroYieldType);
+
+		// Stack variable addresses and arguments are recomputed on entry to the await
+		// function, so they don't need to be preserved across yields.
+		std::vector<Ice::InstAlloca *> allocas;
+		std::unordered_set<Ice::SizeT> recomputed;
+
+		for(Ice::CfgNode *block : function->getNodes())
+		{
+			for(Ice::Inst &inst : block->getInsts())
+			{
+				auto *alloca = llvm::dyn_cast<Ice::InstAlloca>(&inst);
 
-		Ice::Cfg *awaitFunc = sz::createFunction(::context, ReturnType, std::vector<Ice::Type>{ HandleType, YieldPtrType });
-		Ice::CfgLocalAllocatorScope scopedAlloc{ awaitFunc };
+				if(alloca && !alloca->isDeleted())
+				{
+					allocas.push_back(alloca);
+					recomputed.insert(alloca->getDest()->getIndex());
+				}
+			}
+		}
 
-		Ice::Variable *handle = awaitFunc->getArgs()[0];
-		Ice::Variable *outPtr = awaitFunc->getArgs()[1];
+		const Ice::VarList arguments = function->getArgs();  // Copy
 
-		auto doneBlock = awaitFunc->makeNode();
+		for(Ice::Variable *argument : arguments)
 		{
-			//         return false;
-			Ice::InstRet *ret = Ice::InstRet::create(awaitFunc, ::context->getConstantInt32(0));
-			doneBlock->appendInst(ret);
+			recomputed.insert(argument->getIndex());
 		}
 
-		auto resumeBlock = awaitFunc->makeNode();
+		const std::vector<std::vector<Ice::Variable *>> liveValues = getLiveValues(recomputed);
+		const Ice::NodeList reactorBlocks = function->getNodes();  // Copy
+		Ice::CfgNode *startBlock = function->getEntryNode();
+
+		frameSize = coro::PromiseOffset + Ice::typeWidthInBytes(YieldType);
+
+		// Replace the arguments with the frame and output pointers.
+		function->getArgs().clear();
+		for(Ice::Variable *argument : arguments)
 		{
-			//         YieldType* promise = coro::getPromisePtr(handle);
-			Ice::Variable *promise = sz::Call(awaitFunc, resumeBlock, coro::getPromisePtr, handle);
-
-			//         *out = *promise;
-			// Load promise value
-			Ice::Variable *promiseVal = awaitFunc->makeVariable(T(::coroYieldType));
-			auto load = Ice::InstLoad::create(awaitFunc, promiseVal, promise);
-			resumeBlock->appendInst(load);
-			// Then store it in output param
-			auto store = Ice::InstStore::create(awaitFunc, promiseVal, outPtr);
-			resumeBlock->appendInst(store);
-
-			//         coro::resume(handle);
-			sz::Call(awaitFunc, resumeBlock, coro::resume, handle);
-
-			//         return true;
-			Ice::InstRet *ret = Ice::InstRet::create(awaitFunc, ::context->getConstantInt32(1));
-			resumeBlock->appendInst(ret);
+			argument->setIsArg(false);
 		}
 
-		//     if (coro::isDone())
-		//     {
-		//         <doneBlock>
-		//     }
-		//     else // resume
+		Ice::Variable *frame = function->makeVariable(HandleType);
+		Ice::Variable *out = function->makeVariable(HandleType);
+		function->addArg(frame);
+		function->addArg(out);
+
+		// Subzero doesn't support bool types (IceType_i1) as return type
+		function->setReturnType(Ice::IceType_i32);
+
+		Ice::CfgNode *entryBlock = function->makeNode();
+
+		for(Ice::InstAlloca *alloca : allocas)
+		{
+			uint32_t size = llvm::cast<Ice::ConstantInteger32>(alloca->getSizeInBytes())->getValue();
+			uint32_t offset = allocateFrameSlot(size, alloca->getAlignInBytes());
+
+			auto address = Ice::InstArithmetic::create(function, Ice::InstArithmetic::Add, alloca->getDest(), frame, getConstantOffset(offset));
+			entryBlock->appendInst(address);
+			alloca->setDeleted();
+		}
+
+		for(Ice::Variable *argument : arguments)
+		{
+			uint32_t offset = allocateFrameSlot(argument->getType());
+			loadFromFrame(function, entryBlock, frame, argument, offset);
+
+			argumentTypes.push_back(argument->getType());
+			argumentOffsets.push_back(offset);
+		}
+
+		//     if(frame->done)
 		//     {
-		//         <resumeBlock>
+		//         return false;
 		//     }
-		Ice::CfgNode *bb = awaitFunc->getEntryNode();
-		Ice::Variable *done = sz::Call(awaitFunc, bb, coro::isDone, handle);
-		auto br = Ice::InstBr::create(awaitFunc, done, doneBlock, resumeBlock);
-		bb->appendInst(br);
+		auto doneBlock = function->makeNode();
+		doneBlock->appendInst(Ice::InstRet::create(function, ::context->getConstantInt32(0)));
+
+		auto dispatchBlock = function->makeNode();
+		{
+			Ice::Variable *done = function->makeVariable(Ice::IceType_i32);
+			loadFromFrame(function, entryBlock, frame, done, offsetof(coro::Frame, done));
+
+			Ice::Variable *isDone = function->makeVariable(Ice::IceType_i1);
+			entryBlock->appendInst(Ice::InstIcmp::create(function, Ice::InstIcmp::Ne, isDone, done, ::context->getConstantInt32(0)));
+			entryBlock->appendInst(Ice::InstBr::create(function, isDone, doneBlock, dispatchBlock));
+		}
+
+		//     *out = frame->promise;
+		Ice::Variable *promise = function->makeVariable(YieldType);
+		loadFromFrame(function, dispatchBlock, frame, promise, coro::PromiseOffset);
+		dispatchBlock->appendInst(Ice::InstStore::create(function, promise, out));
+
+		//     switch(frame->resumePoint)
+		Ice::Variable *resumePoint = function->makeVariable(Ice::IceType_i32);
+		loadFromFrame(function, dispatchBlock, frame, resumePoint, offsetof(coro::Frame, resumePoint));
+		auto dispatch = Ice::InstSwitch::create(function, yields.size(), resumePoint, startBlock);
+		dispatchBlock->appendInst(dispatch);
+
+		// Mark the coroutine as done when it returns. This precedes the lowering of yields, which
+		// adds returns that suspend it instead.
+		for(Ice::CfgNode *block : reactorBlocks)
+		{
+			Ice::Inst *last = getLastInst(block);
+
+			if(last && llvm::isa<Ice::InstRet>(last))
+			{
+				last->setDeleted();
+
+				storeToFrame(function, block, frame, ::context->getConstantInt32(1), offsetof(coro::Frame, done));
+				block->appendInst(Ice::InstRet::create(function, ::context->getConstantInt32(1)));
+			}
+		}
+
+		std::unordered_map<Ice::SizeT, uint32_t> liveValueOffsets;
+		Ice::NodeList restoreBlocks;
 
-		return FunctionUniquePtr{ awaitFunc };
+		for(size_t i = 0; i < yields.size(); i++)
+		{
+			const Yield &yield = yields[i];
+			const uint32_t yieldResumePoint = static_cast<uint32_t>(1 + i);
+
+			// Suspend the coroutine in place of the marker and the branch to the code following the yield.
+			Ice::Operand *value = yield.marker->getArg(0);
+			yield.marker->setDeleted();
+			yield.branch->setDeleted();
+
+			storeToFrame(function, yield.block, frame, value, coro::PromiseOffset);
+
+			for(Ice::Variable *liveValue : liveValues[i])
+			{
+				auto slot = liveValueOffsets.find(liveValue->getIndex());
+				if(slot == liveValueOffsets.end())
+				{
+					slot = liveValueOffsets.emplace(liveValue->getIndex(), allocateFrameSlot(getFrameType(liveValue->getType()))).first;
+				}
+
+				storeToFrame(function, yield.block, frame, liveValue, slot->second);
+			}
+
+			storeToFrame(function, yield.block, frame, ::context->getConstantInt32(yieldResumePoint), offsetof(coro::Frame, resumePoint));
+			yield.block->appendInst(Ice::InstRet::create(function, ::context->getConstantInt32(1)));
+
+			// Resume from the yield.
+			auto restoreBlock = function->makeNode();
+
+			for(Ice::Variable *liveValue : liveValues[i])
+			{
+				loadFromFrame(function, restoreBlock, frame, liveValue, liveValueOffsets[liveValue->getIndex()]);
+			}
+
+			restoreBlock->appendInst(Ice::InstBr::create(function, yield.resumeBlock));
+			dispatch->addBranch(i, yieldResumePoint, restoreBlock);
+			restoreBlocks.push_back(restoreBlock);
+		}
+
+		// Place the new entry block first, as the function's code starts with the first block.
+		Ice::NodeList blocks;
+		blocks.push_back(entryBlock);
+		blocks.push_back(dispatchBlock);
+		blocks.insert(blocks.end(), reactorBlocks.begin(), reactorBlocks.end());
+		blocks.insert(blocks.end(), restoreBlocks.begin(), restoreBlocks.end());
+		blocks.push_back(doneBlock);
+
+		function->swapNodes(blocks);
+		function->setEntryNode(entryBlock);
+	}
+
+	// Generates the begin function for the current coroutine, which creates its frame.
+	// Must be called after generateAwaitFunction(), which determines the frame's layout.
+	// Cannot use Nucleus functions that modify ::function and ::basicBlock.
+	FunctionUniquePtr generateBeginFunction() const
+	{
+		// CoroutineHandle coroutine_begin(<Arguments>)
+		// {
+		//     CoroutineHandle frame = coro::createFrame(<frame size>);
+		//     *(frame + <offset>) = <arguments>;
+		//     return frame;
+		// }
+
+		const Ice::Type HandleType = sz::getPointerType(Ice::IceType_void);
+
+		Ice::Cfg *beginFunc = sz::createFunction(::context, HandleType, argumentTypes);
+		Ice::CfgLocalAllocatorScope scopedAlloc{ beginFunc };
+
+		auto *bb = beginFunc->getEntryNode();
+
+		//     CoroutineHandle frame = coro::createFrame(<frame size>);
+		Ice::Variable *frame = sz::Call(beginFunc, bb, coro::createFrame, ::context->getConstantInt32(frameSize));
+
+		//     *(frame + <offset>) = <arguments>;
+		for(size_t i = 0; i < argumentOffsets.size(); i++)
+		{
+			storeToFrame(beginFunc, bb, frame, beginFunc->getArgs()[i], argumentOffsets[i]);
+		}
+
+		//     return frame;
+		Ice::InstRet *ret = Ice::InstRet::create(beginFunc, frame);
+		bb->appendInst(ret);
+
+		return FunctionUniquePtr{ beginFunc };
 	}
 
 	// Generates the destroy function for the current coroutine.
@@ -4569,7 +4764,7 @@ public:
 	{
 		// void coroutine_destroy(Nucleus::CoroutineHandle handle)
 		// {
-		//     coro::stop(handle); // signal and wait for coroutine to stop, and delete coroutine data
+		//     coro::destroyFrame(handle);
 		//     return;
 		// }
 
@@ -4583,8 +4778,8 @@ public:
 
 		auto *bb = destroyFunc->getEntryNode();
 
-		//     coro::stop(handle); // signal and wait for coroutine to stop, and delete coroutine data
-		sz::Call(destroyFunc, bb, coro::stop, handle);
+		//     coro::destroyFrame(handle);
+		sz::Call(destroyFunc, bb, coro::destroyFrame, handle);
 
 		//     return;
 		Ice::InstRet *ret = Ice::InstRet::create(destroyFunc);
@@ -4594,52 +4789,243 @@ public:
 	}
 
 private:
-	Ice::Variable *handle{};
-	Ice::Variable *promise{};
-};
+	struct Yield
+	{
+		Ice::CfgNode *block;        // Block ending with the yield
+		Ice::InstCall *marker;      // Call to coro::yieldMarker() holding the yielded value
+		Ice::InstBr *branch;        // Branch to the code following the yield
+		Ice::CfgNode *resumeBlock;  // Block where execution resumes
+	};
 
-static Nucleus::CoroutineHandle invokeCoroutineBegin(std::function<Nucleus::CoroutineHandle()> beginFunc)
-{
-	// This doubles up as our coroutine handle
-	auto coroData = coro::createCoroutineData();
+	// Returns the values live across each yield, except for the recomputed ones.
+	std::vector<std::vector<Ice::Variable *>> getLiveValues(const std::unordered_set<Ice::SizeT> &recomputed) const
+	{
+		const Ice::NodeList &blocks = ::function->getNodes();
+
+		// Only values used in more than one block can be live across yields,
+		// since the code following a yield always starts a new block.
+		constexpr Ice::SizeT None = std::numeric_limits<Ice::SizeT>::max();
+		std::vector<Ice::SizeT> firstBlock(::function->getNumVariables(), None);
+		std::vector<Ice::SizeT> liveIndex(::function->getNumVariables(), None);
+		std::vector<Ice::Variable *> candidates;
+
+		auto visit = [&](Ice::Operand *operand, Ice::SizeT block) {
+			auto *var = llvm::dyn_cast_or_null<Ice::Variable>(operand);
+
+			if(!var || recomputed.count(var->getIndex()) != 0)
+			{
+				return;
+			}
 
-	coroData->useInternalScheduler = (marl::Scheduler::get() == nullptr);
-	if(coroData->useInternalScheduler)
+			Ice::SizeT index = var->getIndex();
+
+			if(firstBlock[index] == None)
+			{
+				firstBlock[index] = block;
+			}
+			else if(firstBlock[index] != block && liveIndex[index] == None)
+			{
+				liveIndex[index] = candidates.size();
+				candidates.push_back(var);
+			}
+		};
+
+		for(Ice::CfgNode *block : blocks)
+		{
+			for(Ice::Inst &inst : block->getInsts())
+			{
+				if(inst.isDeleted())
+				{
+					continue;
+				}
+
+				for(Ice::SizeT i = 0; i < inst.getSrcSize(); i++)
+				{
+					visit(inst.getSrc(i), block->getIndex());
+				}
+
+				visit(inst.getDest(), block->getIndex());
+			}
+		}
+
+		// Backward dataflow analysis of the candidates' liveness at the start of each block.
+		std::vector<llvm::BitVector> uses(blocks.size(), llvm::BitVector(candidates.size()));
+		std::vector<llvm::BitVector> defs(blocks.size(), llvm::BitVector(candidates.size()));
+		std::vector<llvm::BitVector> liveIn(blocks.size(), llvm::BitVector(candidates.size()));
+
+		for(Ice::CfgNode *block : blocks)
+		{
+			auto &blockUses = uses[block->getIndex()];
+			auto &blockDefs = defs[block->getIndex()];
+
+			for(Ice::Inst &inst : block->getInsts())
+			{
+				if(inst.isDeleted())
+				{
+					continue;
+				}
+
+				for(Ice::SizeT i = 0; i < inst.getSrcSize(); i++)
+				{
+					auto *var = llvm::dyn_cast<Ice::Variable>(inst.getSrc(i));
+					if(var && liveIndex[var->getIndex()] != None && !blockDefs[liveIndex[var->getIndex()]])
+					{
+						blockUses.set(liveIndex[var->getIndex()]);
+					}
+				}
+
+				Ice::Variable *dest = inst.getDest();
+				if(dest && liveIndex[dest->getIndex()] != None)
+				{
+					blockDefs.set(liveIndex[dest->getIndex()]);
+				}
+			}
+		}
+
+		bool changed = true;
+		while(changed)
+		{
+			changed = false;
+
+			for(auto b = blocks.rbegin(); b != blocks.rend(); b++)
+			{
+				Ice::CfgNode *block = *b;
+				llvm::BitVector live(candidates.size());
+
+				if(Ice::Inst *last = getLastInst(block))
+				{
+					for(Ice::CfgNode *successor : last->getTerminatorEdges())
+					{
+						live |= liveIn[successor->getIndex()];
+					}
+				}
+
+				live.reset(defs[block->getIndex()]);
+				live |= uses[block->getIndex()];
+
+				if(live != liveIn[block->getIndex()])
+				{
+					liveIn[block->getIndex()] = std::move(live);
+					changed = true;
+				}
+			}
+		}
+
+		std::vector<std::vector<Ice::Variable *>> liveValues(yields.size());
+
+		for(size_t i = 0; i < yields.size(); i++)
+		{
+			const llvm::BitVector &live = liveIn[yields[i].resumeBlock->getIndex()];
+
+			for(int index = live.find_first(); index != -1; index = live.find_next(index))
+			{
+				liveValues[i].push_back(candidates[index]);
+			}
+		}
+
+		return liveValues;
+	}
+
+	static Ice::Inst *getLastInst(Ice::CfgNode *block)
 	{
-		::getOrCreateScheduler().bind();
+		for(Ice::Inst &inst : Ice::reverse_range(block->getInsts()))
+		{
+			if(!inst.isDeleted())
+			{
+				return &inst;
+			}
+		}
+
+		return nullptr;
 	}
 
-	auto run = [=] {
-		// Store handle in TLS so that the coroutine can grab it right away, before
-		// any fiber switch occurs.
-		coro::setHandleParam(coroData);
+	// Returns the type used to hold a value of the given type in the frame.
+	// Booleans have no memory representation, so they're sign-extended.
+	static Ice::Type getFrameType(Ice::Type type)
+	{
+		switch(type)
+		{
+		case Ice::IceType_i1: return Ice::IceType_i8;
+		case Ice::IceType_v4i1: return Ice::IceType_v4i32;
+		case Ice::IceType_v8i1: return Ice::IceType_v8i16;
+		case Ice::IceType_v16i1: return Ice::IceType_v16i8;
+		default: return type;
+		}
+	}
 
-		ASSERT(!coroData->routineFiber);
-		coroData->routineFiber = marl::Scheduler::Fiber::current();
+	// Pointer offsets are 32-bit constants, like in Nucleus::createGEP().
+	static Ice::Constant *getConstantOffset(uint32_t offset)
+	{
+		return ::context->getConstantInt32(offset);
+	}
 
-		beginFunc();
+	static Ice::Variable *getFrameAddress(Ice::Cfg *function, Ice::CfgNode *block, Ice::Variable *frame, uint32_t offset)
+	{
+		if(offset == 0)
+		{
+			return frame;
+		}
 
-		ASSERT(coroData->inRoutine);
-		coroData->done = true;        // coroutine is done.
-		coroData->terminated = true;  // signal that the coroutine data is ready for freeing.
-		coroData->inRoutine = false;
-		coroData->mainFiber->notify();
-	};
+		Ice::Variable *address = function->makeVariable(frame->getType());
+		block->appendInst(Ice::InstArithmetic::create(function, Ice::InstArithmetic::Add, address, frame, getConstantOffset(offset)));
 
-	ASSERT(!coroData->mainFiber);
-	coroData->mainFiber = marl::Scheduler::Fiber::current();
+		return address;
+	}
 
-	// block until the first yield or coroutine end
-	ASSERT(!coroData->inRoutine);
-	coroData->inRoutine = true;
-	marl::schedule(marl::Task(run, marl::Task::Flags::SameThread));
-	while(coroData->inRoutine)
+	static void storeToFrame(Ice::Cfg *function, Ice::CfgNode *block, Ice::Variable *frame, Ice::Operand *value, uint32_t offset)
 	{
-		coroData->mainFiber->wait();
+		Ice::Type frameType = getFrameType(value->getType());
+
+		if(frameType != value->getType())
+		{
+			Ice::Variable *extended = function->makeVariable(frameType);
+			block->appendInst(Ice::InstCast::create(function, Ice::InstCast::Sext, extended, value));
+			value = extended;
+		}
+
+		block->appendInst(Ice::InstStore::create(function, value, getFrameAddress(function, block, frame, offset)));
 	}
 
-	return coroData;
-}
+	static void loadFromFrame(Ice::Cfg *function, Ice::CfgNode *block, Ice::Variable *frame, Ice::Variable *dest, uint32_t offset)
+	{
+		Ice::Type frameType = getFrameType(dest->getType());
+		Ice::Variable *address = getFrameAddress(function, block, frame, offset);
+
+		if(frameType != dest->getType())
+		{
+			Ice::Variable *extended = function->makeVariable(frameType);
+			block->appendInst(Ice::InstLoad::create(function, extended, address));
+			block->appendInst(Ice::InstCast::create(function, Ice::InstCast::Trunc, dest, extended));
+		}
+		else
+		{
+			block->appendInst(Ice::InstLoad::create(function, dest, address));
+		}
+	}
+
+	uint32_t allocateFrameSlot(Ice::Type type)
+	{
+		uint32_t size = Ice::typeWidthInBytes(type);
+		return allocateFrameSlot(size, size);
+	}
+
+	uint32_t allocateFrameSlot(uint32_t size, uint32_t alignment)
+	{
+		alignment = std::min(alignment, coro::FrameAlignment);
+		ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+		uint32_t offset = (frameSize + alignment - 1) & ~(alignment - 1);
+		frameSize = offset + size;
+
+		return offset;
+	}
+
+	std::vector<Yield> yields;
+
+	uint32_t frameSize = 0;
+	std::vector<Ice::Type> argumentTypes;
+	std::vector<uint32_t> argumentOffsets;
+};
 
 void Nucleus::createCoroutine(Type *yieldType, const std::vector<Type *> &params)
 {
@@ -4660,10 +5046,8 @@ void Nucleus::yield(Value *val)
 	if(!::coroGen)
 	{
 		::coroGen = std::make_shared<CoroutineGenerator>();
-		::coroGen->generateCoroutineBegin();
 	}
 
-	ASSERT(::coroGen);
 	::coroGen->generateYield(val);
 }
 
@@ -4684,16 +5068,18 @@ std::shared_ptr<Routine> Nucleus::acquireCoroutine(const char *name)
 		{
 			Ice::CfgLocalAllocatorScope scopedAlloc{ ::function };
 			finalizeFunction();
+			optimizeFunction(::function);
+			::coroGen->generateAwaitFunction();
 		}
 
-		auto awaitFunc = ::coroGen->generateAwaitFunction();
+		auto beginFunc = ::coroGen->generateBeginFunction();
 		auto destroyFunc = ::coroGen->generateDestroyFunction();
 
 		// At this point, we no longer need the CoroutineGenerator.
 		::coroGen.reset();
 		::coroYieldType = nullptr;
 
-		auto routine = rr::acquireRoutine({ ::function, awaitFunc.get(), destroyFunc.get() },
+		auto routine = rr::acquireRoutine({ beginFunc.get(), ::function, destroyFunc.get() },
 		                                  { name, "await", "destroy" });
 
 		return routine;
@@ -4703,6 +5089,7 @@ std::shared_ptr<Routine> Nucleus::acquireCoroutine(const char *name)
 		{
 			Ice::CfgLocalAllocatorScope scopedAlloc{ ::function };
 			finalizeFunction();
+			optimizeFunction(::function);
 		}
 
 		::coroYieldType = nullptr;
@@ -4723,7 +5110,13 @@ Nucleus::CoroutineHandle Nucleus::invokeCoroutineBegin(Routine &routine, std::fu
 
 	if(isCoroutine)
 	{
-		return rr::invokeCoroutineBegin(func);
+		// The begin function only creates the frame. Execute up to the first yield,
+		// letting the await function output the not yet yielded promise onto itself.
+		auto handle = func();
+		auto await = (Nucleus::CoroutineAwait *)routine.getEntry(Nucleus::CoroutineEntryAwait);
+		await(handle, coro::getPromisePtr(handle));
+
+		return handle;
 	}
 	else
 	{
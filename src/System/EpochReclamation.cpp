@@ -0,0 +1,120 @@
+// Copyright 2022 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "EpochReclamation.hpp"
+
+#include <atomic>
+
+namespace sw {
+
+namespace {
+
+// The epoch a thread's outermost guard was entered in, or 0 when it has none.
+// Slots are on their own cache line, so guards don't contend with each other.
+struct alignas(64) Slot
+{
+	std::atomic<uint64_t> active = { 0 };
+	std::atomic<bool> owned = { false };
+	Slot *next = nullptr;
+};
+
+std::atomic<uint64_t> globalEpoch = { 1 };
+
+// Slots are never freed, but get reused once their thread exits.
+std::atomic<Slot *> slots = { nullptr };
+
+Slot *acquireSlot()
+{
+	for(Slot *slot = slots.load(); slot; slot = slot->next)
+	{
+		bool owned = false;
+		if(!slot->owned.load(std::memory_order_relaxed) && slot->owned.compare_exchange_strong(owned, true))
+		{
+			return slot;
+		}
+	}
+
+	Slot *slot = new Slot();
+	slot->owned = true;
+	slot->next = slots.load();
+	while(!slots.compare_exchange_weak(slot->next, slot))
+	{
+	}
+
+	return slot;
+}
+
+struct ThreadSlot
+{
+	~ThreadSlot()
+	{
+		if(slot)
+		{
+			slot->active = 0;
+			slot->owned = false;
+		}
+	}
+
+	Slot *slot = nullptr;
+	int depth = 0;  // Nesting level of the thread's guards
+};
+
+thread_local ThreadSlot threadSlot;
+
+}  // anonymous namespace
+
+// All the accesses below are sequentially consistent. A reader which loaded an
+// object before its writer unpublished it and advanced the epoch, has stored
+// an epoch no later than the retired one to its slot before loading it.
+EpochGuard::EpochGuard()
+{
+	if(threadSlot.depth++ == 0)
+	{
+		if(!threadSlot.slot)
+		{
+			threadSlot.slot = acquireSlot();
+		}
+
+		threadSlot.slot->active = globalEpoch.load();
+	}
+}
+
+EpochGuard::~EpochGuard()
+{
+	if(--threadSlot.depth == 0)
+	{
+		threadSlot.slot->active = 0;
+	}
+}
+
+uint64_t EpochGuard::Advance()
+{
+	return globalEpoch.fetch_add(1);
+}
+
+bool EpochGuard::IsQuiescent(uint64_t epoch)
+{
+	for(Slot *slot = slots.load(); slot; slot = slot->next)
+	{
+		uint64_t active = slot->active.load();
+		if(active != 0 && active <= epoch)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+}  // namespace sw
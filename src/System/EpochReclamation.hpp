@@ -0,0 +1,101 @@
+// Copyright 2022 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef sw_EpochReclamation_hpp
+#define sw_EpochReclamation_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace sw {
+
+// Epoch-based reclamation, for objects which are read without taking a lock
+// while writers replace them. Readers only access such objects within the
+// scope of an EpochGuard, which doesn't write to any memory shared with other
+// threads. Objects replaced by a writer get retired, and are deleted once all
+// the readers which may still access them have left their guard.
+class EpochGuard
+{
+public:
+	EpochGuard();
+	~EpochGuard();
+
+	EpochGuard(const EpochGuard &) = delete;
+	EpochGuard &operator=(const EpochGuard &) = delete;
+
+	// Advances the global epoch, and returns the previous one. Objects which
+	// were unpublished before the call can be deleted once IsQuiescent()
+	// returns true for the returned epoch.
+	static uint64_t Advance();
+
+	// Returns true if no guard entered during or before 'epoch' is still active.
+	static bool IsQuiescent(uint64_t epoch);
+};
+
+// RetiredList holds the objects unpublished by a writer until no reader can
+// access them anymore. It must only be used by one writer at a time.
+template<class T>
+class RetiredList
+{
+public:
+	RetiredList() = default;
+	RetiredList(const RetiredList &) = delete;
+	RetiredList &operator=(const RetiredList &) = delete;
+
+	// All readers must have left their guard.
+	~RetiredList()
+	{
+		for(auto &object : retired)
+		{
+			delete object.second;
+		}
+	}
+
+	// 'object' must no longer be reachable by readers which enter a guard.
+	void retire(const T *object)
+	{
+		retired.push_back({ EpochGuard::Advance(), object });
+		reclaim();
+	}
+
+	// Deletes the retired objects which can no longer be accessed.
+	void reclaim()
+	{
+		size_t kept = 0;
+		for(auto &object : retired)
+		{
+			if(EpochGuard::IsQuiescent(object.first))
+			{
+				delete object.second;
+			}
+			else
+			{
+				retired[kept++] = object;
+			}
+		}
+
+		retired.resize(kept);
+	}
+
+	size_t size() const { return retired.size(); }
+
+private:
+	std::vector<std::pair<uint64_t, const T *>> retired;  // By the epoch they were retired in
+};
+
+}  // namespace sw
+
+#endif  // sw_EpochReclamation_hpp
@@ -15,8 +15,12 @@
 #include "Memory.hpp"
 
 #include "Debug.hpp"
+#include "SwiftConfig.hpp"
 #include "Types.hpp"
 
+#include "marl/scheduler.h"
+#include "marl/waitgroup.h"
+
 #if defined(_WIN32)
 #	ifndef WIN32_LEAN_AND_MEAN
 #		define WIN32_LEAN_AND_MEAN
@@ -30,6 +34,7 @@
 #	include <unistd.h>
 #endif
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 
@@ -155,4 +160,103 @@ void clear(uint32_t *memory, uint32_t element, size_t count)
 #endif
 }
 
+// Returns the number of bytes processed by each transfer task, or 0 if the
+// transfer should be performed by the calling thread.
+static size_t transferTaskSize(size_t bytes)
+{
+	size_t taskSize = static_cast<size_t>(getConfiguration().transferTaskSize);
+
+	if(taskSize == 0 || bytes < 2 * taskSize || !marl::Scheduler::get())
+	{
+		return 0;
+	}
+
+	return taskSize;
+}
+
+static void copyRows(uint8_t *dst, size_t dstPitch, const uint8_t *src, size_t srcPitch, size_t rowSize, size_t rowCount)
+{
+	for(size_t y = 0; y < rowCount; y++)
+	{
+		memcpy(dst, src, rowSize);
+		dst += dstPitch;
+		src += srcPitch;
+	}
+}
+
+void copyConcurrently(void *dst, const void *src, size_t bytes, marl::WaitGroup &done)
+{
+	size_t taskSize = transferTaskSize(bytes);
+
+	if(taskSize == 0)
+	{
+		memcpy(dst, src, bytes);
+		return;
+	}
+
+	for(size_t offset = 0; offset < bytes; offset += taskSize)
+	{
+		uint8_t *taskDst = static_cast<uint8_t *>(dst) + offset;
+		const uint8_t *taskSrc = static_cast<const uint8_t *>(src) + offset;
+		size_t taskBytes = std::min(taskSize, bytes - offset);
+
+		done.add(1);
+		marl::schedule([taskDst, taskSrc, taskBytes, done] {
+			memcpy(taskDst, taskSrc, taskBytes);
+			done.done();
+		});
+	}
+}
+
+void copyRowsConcurrently(void *dst, size_t dstPitch, const void *src, size_t srcPitch, size_t rowSize, size_t rowCount, marl::WaitGroup &done)
+{
+	size_t taskSize = transferTaskSize(rowSize * rowCount);
+
+	if(taskSize == 0)
+	{
+		copyRows(static_cast<uint8_t *>(dst), dstPitch, static_cast<const uint8_t *>(src), srcPitch, rowSize, rowCount);
+		return;
+	}
+
+	size_t taskRowCount = std::max(taskSize / rowSize, size_t(1));
+
+	for(size_t y = 0; y < rowCount; y += taskRowCount)
+	{
+		uint8_t *taskDst = static_cast<uint8_t *>(dst) + y * dstPitch;
+		const uint8_t *taskSrc = static_cast<const uint8_t *>(src) + y * srcPitch;
+		size_t taskRows = std::min(taskRowCount, rowCount - y);
+
+		done.add(1);
+		marl::schedule([taskDst, dstPitch, taskSrc, srcPitch, rowSize, taskRows, done] {
+			copyRows(taskDst, dstPitch, taskSrc, srcPitch, rowSize, taskRows);
+			done.done();
+		});
+	}
+}
+
+void clearConcurrently(uint32_t *memory, uint32_t element, size_t count, marl::WaitGroup &done)
+{
+	size_t taskSize = transferTaskSize(count * sizeof(uint32_t));
+
+	if(taskSize == 0)
+	{
+		clear(memory, element, count);
+		return;
+	}
+
+	size_t taskCount = taskSize / sizeof(uint32_t);
+
+	for(size_t i = 0; i < count; i += taskCount)
+	{
+		uint32_t *taskMemory = memory + i;
+		size_t taskElements = std::min(taskCount, count - i);
+
+		done.add(1);
+		marl::schedule([taskMemory, element, taskElements, done] {
+			clear(taskMemory, element, taskElements);
+			done.done();
+		});
+	}
+}
+
 }  // namespace sw
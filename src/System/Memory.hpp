@@ -18,6 +18,10 @@
 #include <stddef.h>
 #include <stdint.h>
 
+namespace marl {
+class WaitGroup;
+}
+
 namespace sw {
 
 size_t memoryPageSize();
@@ -30,6 +34,13 @@ void freeMemory(void *memory);
 void clear(uint16_t *memory, uint16_t element, size_t count);
 void clear(uint32_t *memory, uint32_t element, size_t count);
 
+// Large copies and fills are split into tasks which run concurrently on the
+// current thread's marl scheduler, if any. 'done' is signaled by each task
+// once it completes, so the memory must remain valid until it is waited on.
+void copyConcurrently(void *dst, const void *src, size_t bytes, marl::WaitGroup &done);
+void copyRowsConcurrently(void *dst, size_t dstPitch, const void *src, size_t srcPitch, size_t rowSize, size_t rowCount, marl::WaitGroup &done);
+void clearConcurrently(uint32_t *memory, uint32_t element, size_t count, marl::WaitGroup &done);
+
 }  // namespace sw
 
 #endif  // Memory_hpp
@@ -20,6 +20,7 @@
 #include "marl/scheduler.h"
 
 #include <algorithm>
+#include <cstdlib>
 
 namespace {
 
@@ -81,6 +82,26 @@ std::shared_ptr<marl::Thread::Affinity::Policy> getAffinityPolicy(marl::Thread::
 	}
 	return nullptr;
 }
+
+rr::OptimizationPreset getOptimizationPreset(const sw::Configurator &ini, const char *keyName)
+{
+	std::string preset = toLowerStr(ini.getValue("Compiler", keyName, "fast"));
+	if(preset == "balanced")
+	{
+		return rr::OptimizationPreset::Balanced;
+	}
+	else if(preset == "max")
+	{
+		return rr::OptimizationPreset::Max;
+	}
+	else if(preset != "fast")
+	{
+		sw::warn("Optimization preset '%s' is not supported, using 'fast'\n", preset.c_str());
+	}
+
+	// Default.
+	return rr::OptimizationPreset::Fast;
+}
 }  // namespace
 
 namespace sw {
@@ -108,6 +129,25 @@ Configuration readConfigurationFromFile()
 		// Default.
 		config.affinityPolicy = Configuration::AffinityPolicy::AnyOf;
 	}
+	config.simdWidth = ini.getInteger<uint32_t>("Processor", "SIMDWidth", 4);
+	if(config.simdWidth != 0 && config.simdWidth != 4 && config.simdWidth != 8 && config.simdWidth != 16)
+	{
+		warn("SIMD width %d is not supported, using a width of 4\n", int(config.simdWidth));
+		config.simdWidth = 4;
+	}
+
+	// Renderer flags.
+	config.vertexDeduplication = ini.getBoolean("Renderer", "VertexDeduplication", true);
+	config.transferTaskSize = ini.getInteger<uint64_t>("Renderer", "TransferTaskSize", 1024 * 1024);
+	config.routineCacheBudget = ini.getInteger<uint64_t>("Renderer", "RoutineCacheBudget", 64 * 1024 * 1024);
+
+	// Compiler flags.
+	config.tierUpThreshold = ini.getInteger<uint32_t>("Compiler", "TierUpThreshold", 0);
+	config.vertexOptimization = getOptimizationPreset(ini, "VertexOptimization");
+	config.pixelOptimization = getOptimizationPreset(ini, "PixelOptimization");
+	config.computeOptimization = getOptimizationPreset(ini, "ComputeOptimization");
+	config.samplerOptimization = getOptimizationPreset(ini, "SamplerOptimization");
+	config.blitterOptimization = getOptimizationPreset(ini, "BlitterOptimization");
 
 	// Profiling flags.
 	config.enableSpirvProfiling = ini.getBoolean("Profiler", "EnableSpirvProfiling");
@@ -125,8 +165,19 @@ const Configuration &getConfiguration()
 
 marl::Scheduler::Config getSchedulerConfiguration(const Configuration &config)
 {
-	uint32_t threadCount = (config.threadCount == 0) ? std::min<size_t>(marl::Thread::numLogicalCPUs(), 16)
-	                                                 : config.threadCount;
+	uint32_t threadCount = config.threadCount;
+
+	// The environment variable is read each time a scheduler is created, so
+	// that benchmarks can measure scaling across thread counts in one process.
+	if(const char *threadCountOverride = getenv("SWIFTSHADER_THREAD_COUNT"))
+	{
+		threadCount = static_cast<uint32_t>(strtoul(threadCountOverride, nullptr, 0));
+	}
+
+	if(threadCount == 0)
+	{
+		threadCount = static_cast<uint32_t>(marl::Thread::numLogicalCPUs());
+	}
 	auto affinity = getAffinityFromMask(config.affinityMask);
 	auto affinityPolicy = getAffinityPolicy(std::move(affinity), config.affinityPolicy);
 
@@ -16,6 +16,7 @@
 #define sw_SwiftConfig_hpp
 
 #include "Reactor/Nucleus.hpp"
+#include "Reactor/Pragma.hpp"
 #include "marl/scheduler.h"
 
 #include <stdint.h>
@@ -34,13 +35,50 @@ struct Configuration
 
 	// -------- [Processor] --------
 	// Number of threads used by the scheduler. A thread count of 0 is
-	// interpreted as min(cpu_cores_available, 16).
+	// interpreted as the number of logical CPUs available. Overridden by the
+	// SWIFTSHADER_THREAD_COUNT environment variable.
 	uint32_t threadCount = 0;
 
 	// Core affinity and affinity policy used by the scheduler.
 	uint64_t affinityMask = 0xFFFFFFFFFFFFFFFFu;
 	AffinityPolicy affinityPolicy = AffinityPolicy::AnyOf;
 
+	// Number of SIMD lanes used by compute shaders which don't use image
+	// instructions or subgroup operations. Must be 4, 8, or 16. A width of 0
+	// is interpreted as the widest width the CPU executes natively.
+	uint32_t simdWidth = 4;
+
+	// -------- [Renderer] --------
+	// Whether indexed draws shade each unique vertex of a batch once, instead
+	// of relying on the post-transform vertex cache.
+	bool vertexDeduplication = true;
+
+	// Number of bytes copied or filled by each task of large transfer
+	// commands, which run concurrently on the scheduler's threads. Transfers
+	// smaller than two tasks are performed by the queue's thread. A size of 0
+	// disables splitting transfers.
+	uint64_t transferTaskSize = 1024 * 1024;
+
+	// Number of bytes of generated code and data retained by each of a
+	// device's vertex, setup and pixel routine caches. The least recently used
+	// routines are evicted when the budget is exceeded.
+	uint64_t routineCacheBudget = 64 * 1024 * 1024;
+
+	// -------- [Compiler] --------
+	// Number of draw calls using a graphics routine after which it gets
+	// reoptimized at O3 on a background thread. Until then, routines are
+	// compiled without optimizations. A threshold of 0 disables tiering.
+	uint32_t tierUpThreshold = 0;
+
+	// Optimization passes used for each kind of routine, at the default
+	// optimization level. Richer presets make routines faster to execute but
+	// slower to compile.
+	rr::OptimizationPreset vertexOptimization = rr::OptimizationPreset::Fast;
+	rr::OptimizationPreset pixelOptimization = rr::OptimizationPreset::Fast;
+	rr::OptimizationPreset computeOptimization = rr::OptimizationPreset::Fast;
+	rr::OptimizationPreset samplerOptimization = rr::OptimizationPreset::Fast;
+	rr::OptimizationPreset blitterOptimization = rr::OptimizationPreset::Fast;
+
 	// -------- [Profiler] --------
 	// Whether SPIR-V profiling is enabled.
 	bool enableSpirvProfiling = false;
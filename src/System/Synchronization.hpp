@@ -27,10 +27,13 @@
 #include <assert.h>
 #include <chrono>
 #include <condition_variable>
+#include <memory>
 #include <queue>
 
+#include "marl/conditionvariable.h"
 #include "marl/event.h"
 #include "marl/mutex.h"
+#include "marl/pool.h"
 #include "marl/waitgroup.h"
 
 namespace sw {
@@ -178,6 +181,91 @@ size_t Chan<T>::count()
 	return queue.size();
 }
 
+// BlockingPool is a marl::BoundedPool whose capacity is chosen at
+// construction instead of at compile time.
+// The items are constructed once, and keep their state between loans.
+// borrow() blocks until an item is returned if the pool is empty.
+template<typename T>
+class BlockingPool : public marl::Pool<T>
+{
+public:
+	using Item = typename marl::Pool<T>::Item;
+	using Loan = typename marl::Pool<T>::Loan;
+
+	BlockingPool(size_t capacity)
+	    : storage(std::make_shared<Storage>(capacity))
+	{}
+
+	Loan borrow() const;
+
+	size_t capacity() const { return storage->capacity; }
+
+private:
+	class Storage : public marl::Pool<T>::Storage
+	{
+	public:
+		Storage(size_t capacity);
+		~Storage();
+
+		void return_(Item *item) override;
+
+		const size_t capacity;
+		std::unique_ptr<Item[]> items;
+		marl::mutex mutex;
+		marl::ConditionVariable returned;  // Fiber-aware, as borrow() may be called from scheduler tasks
+		Item *free GUARDED_BY(mutex) = nullptr;
+	};
+
+	std::shared_ptr<Storage> storage;
+};
+
+template<typename T>
+BlockingPool<T>::Storage::Storage(size_t capacity)
+    : capacity(capacity)
+    , items(new Item[capacity])
+{
+	marl::lock lock(mutex);
+	for(size_t i = 0; i < capacity; i++)
+	{
+		items[i].construct();
+		items[i].next = free;
+		free = &items[i];
+	}
+}
+
+template<typename T>
+BlockingPool<T>::Storage::~Storage()
+{
+	for(size_t i = 0; i < capacity; i++)
+	{
+		items[i].destruct();
+	}
+}
+
+template<typename T>
+typename BlockingPool<T>::Loan BlockingPool<T>::borrow() const
+{
+	marl::lock lock(storage->mutex);
+	storage->returned.wait(lock, [&]() REQUIRES(storage->mutex) { return storage->free != nullptr; });
+
+	Item *item = storage->free;
+	storage->free = item->next;
+
+	return Loan(item, storage);
+}
+
+template<typename T>
+void BlockingPool<T>::Storage::return_(Item *item)
+{
+	{
+		marl::lock lock(mutex);
+		item->next = free;
+		free = item;
+	}
+
+	returned.notify_one();
+}
+
 }  // namespace sw
 
 #endif  // sw_Synchronization_hpp
@@ -0,0 +1,173 @@
+// Copyright 2026 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef sw_WorkgroupOrder_hpp
+#define sw_WorkgroupOrder_hpp
+
+#include <atomic>
+#include <cstdint>
+
+namespace sw {
+
+// WorkgroupOrder maps indices onto workgroup offsets in Morton (Z-order), so
+// that contiguous ranges of indices cover compact blocks of workgroups. Each
+// dimension is padded to a power of two, and the bits of the dimensions which
+// are exhausted first are skipped, so non-square dispatches don't need to be
+// padded to a cube. Indices which fall outside of the dispatch are rejected.
+class WorkgroupOrder
+{
+public:
+	WorkgroupOrder(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+	    : groupCount{ groupCountX, groupCountY, groupCountZ }
+	{
+		uint32_t bits[3] = { bitCount(groupCountX), bitCount(groupCountY), bitCount(groupCountZ) };
+		uint32_t totalBits = bits[0] + bits[1] + bits[2];
+
+		// Fall back to a linear order when the padded dispatch doesn't fit the
+		// 32-bit index space.
+		if(totalBits >= 32)
+		{
+			linear = true;
+			size = groupCountX * groupCountY * groupCountZ;
+			return;
+		}
+
+		for(uint32_t bit = 0; codeBits < totalBits; bit++)
+		{
+			for(uint8_t axis = 0; axis < 3; axis++)
+			{
+				if(bit < bits[axis])
+				{
+					codeAxis[codeBits++] = axis;
+				}
+			}
+		}
+
+		size = 1u << totalBits;
+	}
+
+	// Number of indices to be visited.
+	uint32_t count() const { return size; }
+
+	// Returns false when the index lies in the padding of the dispatch.
+	bool offset(uint32_t index, uint32_t groupOffset[3]) const
+	{
+		if(linear)
+		{
+			groupOffset[2] = index / (groupCount[0] * groupCount[1]);
+			index -= groupOffset[2] * (groupCount[0] * groupCount[1]);
+			groupOffset[1] = index / groupCount[0];
+			groupOffset[0] = index - groupOffset[1] * groupCount[0];
+
+			return true;
+		}
+
+		uint32_t coordinate[3] = { 0, 0, 0 };
+		uint32_t axisBit[3] = { 0, 0, 0 };
+		for(uint32_t i = 0; i < codeBits; i++)
+		{
+			uint8_t axis = codeAxis[i];
+			coordinate[axis] |= ((index >> i) & 1) << axisBit[axis]++;
+		}
+
+		for(int axis = 0; axis < 3; axis++)
+		{
+			if(coordinate[axis] >= groupCount[axis])
+			{
+				return false;
+			}
+
+			groupOffset[axis] = coordinate[axis];
+		}
+
+		return true;
+	}
+
+private:
+	// Returns the number of bits needed to index 'size' elements.
+	static uint32_t bitCount(uint32_t size)
+	{
+		uint32_t bits = 0;
+		while((1ull << bits) < size)
+		{
+			bits++;
+		}
+
+		return bits;
+	}
+
+	const uint32_t groupCount[3];
+	bool linear = false;
+	uint32_t size = 0;
+	uint32_t codeBits = 0;
+	uint8_t codeAxis[32] = {};
+};
+
+// IndexRange is a range of workgroup indices owned by a task. The owner takes
+// indices from the front, while idle tasks steal half of the remaining
+// indices from the back. Both ends are packed into a single atomic so that
+// either operation is a single compare-and-swap.
+class IndexRange
+{
+public:
+	void reset(uint32_t begin, uint32_t end)
+	{
+		bounds.store(pack(begin, end), std::memory_order_relaxed);
+	}
+
+	// Takes the next index from the front of the range.
+	bool pop(uint32_t &index)
+	{
+		uint64_t current = bounds.load(std::memory_order_relaxed);
+		while(begin(current) < end(current))
+		{
+			if(bounds.compare_exchange_weak(current, pack(begin(current) + 1, end(current)), std::memory_order_relaxed))
+			{
+				index = begin(current);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Removes the back half of the range, and returns it.
+	bool steal(uint32_t &stolenBegin, uint32_t &stolenEnd)
+	{
+		uint64_t current = bounds.load(std::memory_order_relaxed);
+		while(begin(current) < end(current))
+		{
+			uint32_t mid = begin(current) + (end(current) - begin(current)) / 2;
+			if(bounds.compare_exchange_weak(current, pack(begin(current), mid), std::memory_order_relaxed))
+			{
+				stolenBegin = mid;
+				stolenEnd = end(current);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+private:
+	static uint64_t pack(uint32_t begin, uint32_t end) { return (static_cast<uint64_t>(end) << 32) | begin; }
+	static uint32_t begin(uint64_t bounds) { return static_cast<uint32_t>(bounds); }
+	static uint32_t end(uint64_t bounds) { return static_cast<uint32_t>(bounds >> 32); }
+
+	std::atomic<uint64_t> bounds = { 0 };
+};
+
+}  // namespace sw
+
+#endif  // sw_WorkgroupOrder_hpp
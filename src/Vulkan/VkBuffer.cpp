@@ -16,6 +16,9 @@
 
 #include "VkConfig.hpp"
 #include "VkDeviceMemory.hpp"
+#include "System/Memory.hpp"
+
+#include "marl/waitgroup.h"
 
 #include <algorithm>
 #include <cstring>
@@ -120,7 +123,11 @@ void Buffer::copyTo(void *dstMemory, VkDeviceSize pSize, VkDeviceSize pOffset) c
 
 void Buffer::copyTo(Buffer *dstBuffer, const VkBufferCopy2KHR &pRegion) const
 {
-	copyTo(dstBuffer->getOffsetPointer(pRegion.dstOffset), pRegion.size, pRegion.srcOffset);
+	ASSERT((pRegion.size + pRegion.srcOffset) <= size);
+
+	marl::WaitGroup copied;
+	sw::copyConcurrently(dstBuffer->getOffsetPointer(pRegion.dstOffset), getOffsetPointer(pRegion.srcOffset), pRegion.size, copied);
+	copied.wait();
 }
 
 void Buffer::fill(VkDeviceSize dstOffset, VkDeviceSize fillSize, uint32_t data)
@@ -133,10 +140,9 @@ void Buffer::fill(VkDeviceSize dstOffset, VkDeviceSize fillSize, uint32_t data)
 
 	// Vulkan 1.1 spec: "If VK_WHOLE_SIZE is used and the remaining size of the buffer is
 	//                   not a multiple of 4, then the nearest smaller multiple is used."
-	for(; bytes >= 4; bytes -= 4, memToWrite++)
-	{
-		*memToWrite = data;
-	}
+	marl::WaitGroup filled;
+	sw::clearConcurrently(memToWrite, data, bytes / 4, filled);
+	filled.wait();
 }
 
 void Buffer::update(VkDeviceSize dstOffset, VkDeviceSize dataSize, const void *pData)
@@ -15,6 +15,7 @@
 #include "VkCommandBuffer.hpp"
 
 #include "VkBuffer.hpp"
+#include "VkCommandPool.hpp"
 #include "VkConfig.hpp"
 #include "VkDevice.hpp"
 #include "VkEvent.hpp"
@@ -27,6 +28,7 @@
 #include "VkQueryPool.hpp"
 #include "VkRenderPass.hpp"
 #include "Device/Renderer.hpp"
+#include "System/Math.hpp"
 
 #include "./Debug/Context.hpp"
 #include "./Debug/File.hpp"
@@ -34,41 +36,74 @@
 
 #include "marl/defer.h"
 
+#include <algorithm>
 #include <bitset>
 #include <cstring>
+#include <type_traits>
 
 namespace {
 
+// Stages executed asynchronously by the Renderer's draws. Index input is excluded
+// because primitive restart scans the index buffer before the draw is issued.
+// BOTTOM_OF_PIPE is equivalent to NONE in the second synchronization scope.
+constexpr VkPipelineStageFlags2 DrawStages =
+    VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT |
+    VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT |
+    VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT |
+    VK_PIPELINE_STAGE_2_TESSELLATION_CONTROL_SHADER_BIT |
+    VK_PIPELINE_STAGE_2_TESSELLATION_EVALUATION_SHADER_BIT |
+    VK_PIPELINE_STAGE_2_GEOMETRY_SHADER_BIT |
+    VK_PIPELINE_STAGE_2_PRE_RASTERIZATION_SHADERS_BIT |
+    VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT |
+    VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+    VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT |
+    VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+// Returns whether ending the given subpass requires the draws to be complete,
+// because it resolves attachments on the queue thread, or because commands
+// which are executed synchronously depend on it.
+bool subpassEndRequiresDraws(const vk::RenderPass *renderPass, uint32_t subpassIndex)
+{
+	const VkSubpassDescription &subpass = renderPass->getSubpass(subpassIndex);
+	if(subpass.pResolveAttachments)
+	{
+		return true;
+	}
+
+	if(renderPass->hasDepthStencilResolve() && subpass.pDepthStencilAttachment &&
+	   renderPass->getSubpassDepthStencilResolve(subpassIndex).pDepthStencilResolveAttachment)
+	{
+		return true;
+	}
+
+	for(uint32_t i = 0; i < renderPass->getDependencyCount(); i++)
+	{
+		VkSubpassDependency dependency = renderPass->getDependency(i);
+		if((dependency.srcSubpass == subpassIndex) && (dependency.dstSubpass == VK_SUBPASS_EXTERNAL) &&
+		   ((dependency.dstStageMask & ~DrawStages) != 0))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
 class CmdBeginRenderPass : public vk::CommandBuffer::Command
 {
 public:
+	// clearValues and attachments must remain valid until the command is destroyed.
 	CmdBeginRenderPass(vk::RenderPass *renderPass, vk::Framebuffer *framebuffer, VkRect2D renderArea,
-	                   uint32_t clearValueCount, const VkClearValue *pClearValues,
-	                   const VkRenderPassAttachmentBeginInfo *attachmentInfo)
+	                   uint32_t clearValueCount, const VkClearValue *clearValues,
+	                   uint32_t attachmentCount, vk::ImageView *const *attachments)
 	    : renderPass(renderPass)
 	    , framebuffer(framebuffer)
 	    , renderArea(renderArea)
 	    , clearValueCount(clearValueCount)
-	    , attachmentCount(attachmentInfo ? attachmentInfo->attachmentCount : 0)
-	    , attachments(nullptr)
+	    , clearValues(clearValues)
+	    , attachmentCount(attachmentCount)
+	    , attachments(attachments)
 	{
-		// FIXME(b/119409619): use an allocator here so we can control all memory allocations
-		clearValues = new VkClearValue[clearValueCount];
-		memcpy(clearValues, pClearValues, clearValueCount * sizeof(VkClearValue));
-		if(attachmentCount > 0)
-		{
-			attachments = new vk::ImageView *[attachmentCount];
-			for(uint32_t i = 0; i < attachmentCount; i++)
-			{
-				attachments[i] = vk::Cast(attachmentInfo->pAttachments[i]);
-			}
-		}
-	}
-
-	~CmdBeginRenderPass() override
-	{
-		delete[] clearValues;
-		delete[] attachments;
 	}
 
 	void execute(vk::CommandBuffer::ExecutionState &executionState) override
@@ -82,6 +117,20 @@ public:
 			framebuffer->setAttachment(attachments[i], i);
 		}
 
+		// Prior render pass instances don't wait for their draws, so the attachments
+		// cleared by this thread must no longer be accessed by them.
+		std::vector<const vk::Image *> clearedImages;
+		uint32_t count = std::min(clearValueCount, renderPass->getAttachmentCount());
+		for(uint32_t i = 0; i < count; i++)
+		{
+			VkAttachmentDescription attachment = renderPass->getAttachment(i);
+			if((attachment.loadOp == VK_ATTACHMENT_LOAD_OP_CLEAR) || (attachment.stencilLoadOp == VK_ATTACHMENT_LOAD_OP_CLEAR))
+			{
+				clearedImages.push_back(framebuffer->getAttachment(i)->getImage());
+			}
+		}
+		executionState.renderer->waitForDraws(clearedImages);
+
 		// Vulkan specifies that the attachments' `loadOp` gets executed "at the beginning of the subpass where it is first used."
 		// Since we don't discard any contents between subpasses, this is equivalent to executing it at the start of the renderpass.
 		framebuffer->executeLoadOp(executionState.renderPass, clearValueCount, clearValues, renderArea);
@@ -94,9 +143,9 @@ private:
 	vk::Framebuffer *const framebuffer;
 	const VkRect2D renderArea;
 	const uint32_t clearValueCount;
-	VkClearValue *clearValues;
-	uint32_t attachmentCount;
-	vk::ImageView **attachments;
+	const VkClearValue *const clearValues;
+	const uint32_t attachmentCount;
+	vk::ImageView *const *const attachments;
 };
 
 class CmdNextSubpass : public vk::CommandBuffer::Command
@@ -109,6 +158,7 @@ public:
 		{
 			// TODO(b/197691918): Avoid halt-the-world synchronization.
 			executionState.renderer->synchronize();
+			executionState.renderer->resetHiZ();
 
 			// TODO(b/197691917): Eliminate redundant resolve operations.
 			executionState.renderPassFramebuffer->resolve(executionState.renderPass, executionState.subpassIndex);
@@ -126,8 +176,17 @@ public:
 	void execute(vk::CommandBuffer::ExecutionState &executionState) override
 	{
 		// Execute (implicit or explicit) VkSubpassDependency to VK_SUBPASS_EXTERNAL.
-		// TODO(b/197691918): Avoid halt-the-world synchronization.
-		executionState.renderer->synchronize();
+		// Subsequent commands which don't depend on this render pass instance don't
+		// have to wait for its draws, and later draws are ordered by the Renderer.
+		if(subpassEndRequiresDraws(executionState.renderPass, executionState.subpassIndex))
+		{
+			executionState.renderer->synchronize();
+		}
+		else
+		{
+			executionState.renderer->barrier(true, nullptr, 0);
+		}
+		executionState.renderer->resetHiZ();
 
 		// TODO(b/197691917): Eliminate redundant resolve operations.
 		executionState.renderPassFramebuffer->resolve(executionState.renderPass, executionState.subpassIndex);
@@ -153,6 +212,10 @@ public:
 
 		if(!executionState.dynamicRendering->resume())
 		{
+			// Prior render pass instances don't wait for their draws, so the attachments
+			// cleared by this thread must no longer be accessed by them.
+			executionState.renderer->waitForDraws(getClearedImages());
+
 			VkClearRect rect = {};
 			rect.rect = executionState.dynamicRendering->getRenderArea();
 			rect.layerCount = executionState.dynamicRendering->getLayerCount();
@@ -200,6 +263,27 @@ public:
 	std::string description() override { return "vkCmdBeginRendering()"; }
 
 private:
+	std::vector<const vk::Image *> getClearedImages() const
+	{
+		std::vector<const vk::Image *> images;
+		auto addImage = [&images](const VkRenderingAttachmentInfo *attachment) {
+			vk::ImageView *imageView = attachment ? vk::Cast(attachment->imageView) : nullptr;
+			if(imageView && (attachment->loadOp == VK_ATTACHMENT_LOAD_OP_CLEAR))
+			{
+				images.push_back(imageView->getImage());
+			}
+		};
+
+		for(uint32_t i = 0; i < dynamicRendering.getColorAttachmentCount(); i++)
+		{
+			addImage(dynamicRendering.getColorAttachment(i));
+		}
+		addImage(&dynamicRendering.getDepthAttachment());
+		addImage(&dynamicRendering.getStencilAttachment());
+
+		return images;
+	}
+
 	vk::DynamicRendering dynamicRendering;
 };
 
@@ -208,8 +292,17 @@ class CmdEndRendering : public vk::CommandBuffer::Command
 public:
 	void execute(vk::CommandBuffer::ExecutionState &executionState) override
 	{
-		// TODO(b/197691918): Avoid halt-the-world synchronization.
-		executionState.renderer->synchronize();
+		// Only resolves are executed by this thread, so other render pass instances
+		// don't have to wait for their draws.
+		if(resolves(*executionState.dynamicRendering))
+		{
+			executionState.renderer->synchronize();
+		}
+		else
+		{
+			executionState.renderer->barrier(true, nullptr, 0);
+		}
+		executionState.renderer->resetHiZ();
 
 		if(!executionState.dynamicRendering->suspend())
 		{
@@ -249,6 +342,27 @@ public:
 	}
 
 	std::string description() override { return "vkCmdEndRendering()"; }
+
+private:
+	static bool resolves(const vk::DynamicRendering &dynamicRendering)
+	{
+		if(dynamicRendering.suspend())
+		{
+			return false;
+		}
+
+		for(uint32_t i = 0; i < dynamicRendering.getColorAttachmentCount(); i++)
+		{
+			const VkRenderingAttachmentInfo *colorAttachment = dynamicRendering.getColorAttachment(i);
+			if(colorAttachment && colorAttachment->resolveMode != VK_RESOLVE_MODE_NONE)
+			{
+				return true;
+			}
+		}
+
+		return (dynamicRendering.getDepthAttachment().resolveMode != VK_RESOLVE_MODE_NONE) ||
+		       (dynamicRendering.getStencilAttachment().resolveMode != VK_RESOLVE_MODE_NONE);
+	}
 };
 
 class CmdExecuteCommands : public vk::CommandBuffer::Command
@@ -920,27 +1034,31 @@ private:
 class CmdSetVertexInput : public vk::CommandBuffer::Command
 {
 public:
+	// The descriptions must remain valid until the command is destroyed.
 	CmdSetVertexInput(uint32_t vertexBindingDescriptionCount,
-	                  const VkVertexInputBindingDescription2EXT *pVertexBindingDescriptions,
+	                  const VkVertexInputBindingDescription2EXT *vertexBindingDescriptions,
 	                  uint32_t vertexAttributeDescriptionCount,
-	                  const VkVertexInputAttributeDescription2EXT *pVertexAttributeDescriptions)
-	    :  // Note: the pNext values are unused, so this copy is currently safe.
-	    vertexBindingDescriptions(pVertexBindingDescriptions, pVertexBindingDescriptions + vertexBindingDescriptionCount)
-	    , vertexAttributeDescriptions(pVertexAttributeDescriptions, pVertexAttributeDescriptions + vertexAttributeDescriptionCount)
+	                  const VkVertexInputAttributeDescription2EXT *vertexAttributeDescriptions)
+	    : vertexBindingDescriptionCount(vertexBindingDescriptionCount)
+	    , vertexBindingDescriptions(vertexBindingDescriptions)
+	    , vertexAttributeDescriptionCount(vertexAttributeDescriptionCount)
+	    , vertexAttributeDescriptions(vertexAttributeDescriptions)
 	{}
 
 	void execute(vk::CommandBuffer::ExecutionState &executionState) override
 	{
-		for(const auto &desc : vertexBindingDescriptions)
+		for(uint32_t i = 0; i < vertexBindingDescriptionCount; i++)
 		{
+			const auto &desc = vertexBindingDescriptions[i];
 			vk::DynamicVertexInputBindingState &state = executionState.dynamicState.vertexInputBindings[desc.binding];
 			state.inputRate = desc.inputRate;
 			state.stride = desc.stride;
 			state.divisor = desc.divisor;
 		}
 
-		for(const auto &desc : vertexAttributeDescriptions)
+		for(uint32_t i = 0; i < vertexAttributeDescriptionCount; i++)
 		{
+			const auto &desc = vertexAttributeDescriptions[i];
 			vk::DynamicVertexInputAttributeState &state = executionState.dynamicState.vertexInputAttributes[desc.location];
 			state.format = desc.format;
 			state.offset = desc.offset;
@@ -951,8 +1069,10 @@ public:
 	std::string description() override { return "vkCmdSetVertexInputEXT()"; }
 
 private:
-	const std::vector<VkVertexInputBindingDescription2EXT> vertexBindingDescriptions;
-	const std::vector<VkVertexInputAttributeDescription2EXT> vertexAttributeDescriptions;
+	const uint32_t vertexBindingDescriptionCount;
+	const VkVertexInputBindingDescription2EXT *const vertexBindingDescriptions;
+	const uint32_t vertexAttributeDescriptionCount;
+	const VkVertexInputAttributeDescription2EXT *const vertexAttributeDescriptions;
 };
 
 class CmdDrawBase : public vk::CommandBuffer::Command
@@ -973,7 +1093,7 @@ public:
 		                            pipelineState.descriptorSets,
 		                            pipelineState.descriptorDynamicOffsets);
 		inputs.setVertexInputBinding(executionState.vertexInputBindings, executionState.dynamicState);
-		inputs.bindVertexInputs(firstInstance);
+		inputs.bindVertexInputs();
 
 		if(indexed)
 		{
@@ -986,9 +1106,16 @@ public:
 
 		VkRect2D renderArea = executionState.getRenderArea();
 
-		for(uint32_t instance = firstInstance; instance != firstInstance + instanceCount; instance++)
+		// All instances are processed by a single draw call, unless primitive restart
+		// splits the index buffer, in which case primitives must still be rasterized
+		// in instance order.
+		const bool singleDraw = (indexBuffers.size() == 1);
+		const uint32_t drawCount = singleDraw ? 1 : instanceCount;
+		const uint32_t drawInstanceCount = singleDraw ? instanceCount : 1;
+
+		// FIXME: reconsider instances/views nesting.
+		for(uint32_t i = 0; i < drawCount; i++)
 		{
-			// FIXME: reconsider instances/views nesting.
 			auto layerMask = executionState.getLayerMask();
 			while(layerMask)
 			{
@@ -998,16 +1125,10 @@ public:
 				for(auto indexBuffer : indexBuffers)
 				{
 					executionState.renderer->draw(pipeline, executionState.dynamicState, indexBuffer.first, vertexOffset,
-					                              executionState.events, instance, layer, indexBuffer.second,
+					                              executionState.events, firstInstance + i, drawInstanceCount, layer, indexBuffer.second,
 					                              renderArea, executionState.pushConstants);
 				}
 			}
-
-			if(instanceCount > 1)
-			{
-				UNOPTIMIZED("Optimize instancing to use a single draw call.");  // TODO(b/137740918)
-				inputs.advanceInstanceAttributes();
-			}
 		}
 	}
 };
@@ -1242,16 +1363,18 @@ private:
 class CmdUpdateBuffer : public vk::CommandBuffer::Command
 {
 public:
+	// pData must remain valid until the command is destroyed.
 	CmdUpdateBuffer(vk::Buffer *dstBuffer, VkDeviceSize dstOffset, VkDeviceSize dataSize, const uint8_t *pData)
 	    : dstBuffer(dstBuffer)
 	    , dstOffset(dstOffset)
-	    , data(pData, &pData[dataSize])
+	    , dataSize(dataSize)
+	    , data(pData)
 	{
 	}
 
 	void execute(vk::CommandBuffer::ExecutionState &executionState) override
 	{
-		dstBuffer->update(dstOffset, data.size(), data.data());
+		dstBuffer->update(dstOffset, dataSize, data);
 	}
 
 	std::string description() override { return "vkCmdUpdateBuffer()"; }
@@ -1259,7 +1382,8 @@ public:
 private:
 	vk::Buffer *const dstBuffer;
 	const VkDeviceSize dstOffset;
-	const std::vector<uint8_t> data;  // FIXME(b/119409619): replace this vector by an allocator so we can control all memory allocations
+	const VkDeviceSize dataSize;
+	const uint8_t *const data;
 };
 
 class CmdClearColorImage : public vk::CommandBuffer::Command
@@ -1324,6 +1448,11 @@ public:
 		// has completed first.
 		executionState.renderer->synchronize();
 
+		if(attachment.aspectMask & VK_IMAGE_ASPECT_DEPTH_BIT)
+		{
+			executionState.renderer->resetHiZ();
+		}
+
 		if(executionState.renderPassFramebuffer)
 		{
 			executionState.renderPassFramebuffer->clearAttachment(executionState.renderPass, executionState.subpassIndex, attachment, rect);
@@ -1431,19 +1560,80 @@ private:
 class CmdPipelineBarrier : public vk::CommandBuffer::Command
 {
 public:
+	// images must have room for the image memory barriers, and remain valid until the command is destroyed.
+	CmdPipelineBarrier(const VkDependencyInfo &dependencyInfo, const vk::Image **images)
+	    : imageCount(dependencyInfo.imageMemoryBarrierCount)
+	    , images(images)
+	{
+		for(uint32_t i = 0; i < dependencyInfo.memoryBarrierCount; i++)
+		{
+			const VkMemoryBarrier2 &barrier = dependencyInfo.pMemoryBarriers[i];
+			srcStageMask |= barrier.srcStageMask;
+			dstStageMask |= barrier.dstStageMask;
+			allImages = allImages || (barrier.srcAccessMask != VK_ACCESS_2_NONE) || (barrier.dstAccessMask != VK_ACCESS_2_NONE);
+		}
+
+		for(uint32_t i = 0; i < dependencyInfo.bufferMemoryBarrierCount; i++)
+		{
+			const VkBufferMemoryBarrier2 &barrier = dependencyInfo.pBufferMemoryBarriers[i];
+			srcStageMask |= barrier.srcStageMask;
+			dstStageMask |= barrier.dstStageMask;
+		}
+
+		for(uint32_t i = 0; i < dependencyInfo.imageMemoryBarrierCount; i++)
+		{
+			const VkImageMemoryBarrier2 &barrier = dependencyInfo.pImageMemoryBarriers[i];
+			srcStageMask |= barrier.srcStageMask;
+			dstStageMask |= barrier.dstStageMask;
+			images[i] = vk::Cast(barrier.image);
+		}
+	}
+
 	void execute(vk::CommandBuffer::ExecutionState &executionState) override
 	{
-		// This is a very simple implementation that simply calls sw::Renderer::synchronize(),
-		// since the driver is free to move the source stage towards the bottom of the pipe
+		// Draws are the only work still executing once a command has been processed,
+		// so barriers whose first scope only contains other commands are already satisfied.
+		if((srcStageMask & ~SynchronousStages) == 0)
+		{
+			return;
+		}
+
+		// Draws which only have to wait for the prior draws they depend on. Buffer
+		// memory is only written by draws with storage writes, which are always ordered.
+		if((dstStageMask & ~DrawStages) == 0)
+		{
+			executionState.renderer->barrier(allImages, images, imageCount);
+			return;
+		}
+
+		// The driver is free to move the source stage towards the bottom of the pipe
 		// and the target stage towards the top, so a full pipeline sync is spec compliant.
 		executionState.renderer->synchronize();
 
-		// Right now all buffers are read-only in drawcalls but a similar mechanism will be required once we support SSBOs.
-
 		// Also note that this would be a good moment to update cube map borders or decompress compressed textures, if necessary.
 	}
 
 	std::string description() override { return "vkCmdPipelineBarrier()"; }
+
+private:
+	// Stages of the commands executed synchronously by the queue thread.
+	// TOP_OF_PIPE is equivalent to NONE in the first synchronization scope.
+	static constexpr VkPipelineStageFlags2 SynchronousStages =
+	    VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT |
+	    VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT |
+	    VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
+	    VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT |
+	    VK_PIPELINE_STAGE_2_COPY_BIT |
+	    VK_PIPELINE_STAGE_2_RESOLVE_BIT |
+	    VK_PIPELINE_STAGE_2_BLIT_BIT |
+	    VK_PIPELINE_STAGE_2_CLEAR_BIT |
+	    VK_PIPELINE_STAGE_2_HOST_BIT;
+
+	VkPipelineStageFlags2 srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+	VkPipelineStageFlags2 dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+	bool allImages = false;                // Global memory barriers make all writes visible
+	const uint32_t imageCount;
+	const vk::Image *const *const images;  // Images with memory barriers
 };
 
 class CmdSignalEvent : public vk::CommandBuffer::Command
@@ -1801,24 +1991,79 @@ void DynamicRendering::getAttachments(Attachments *attachments) const
 	attachments->stencilBuffer = vk::Cast(stencilAttachment.imageView);
 }
 
-CommandBuffer::CommandBuffer(Device *device, VkCommandBufferLevel pLevel)
+CommandBuffer::CommandBuffer(Device *device, VkCommandBufferLevel pLevel, CommandPool *pool)
     : device(device)
+    , pool(pool)
     , level(pLevel)
 {
 }
 
+CommandBuffer::~CommandBuffer()
+{
+	ASSERT(!firstCommand && chunks.empty() && largeAllocations.empty());
+}
+
 void CommandBuffer::destroy(const VkAllocationCallbacks *pAllocator)
 {
+	resetState(true);
 }
 
-void CommandBuffer::resetState()
+void CommandBuffer::resetState(bool releaseResources)
 {
-	// FIXME (b/119409619): replace this vector by an allocator so we can control all memory allocations
-	commands.clear();
+	// Commands are trivially destructible, so rewinding the chunks discards them.
+	firstCommand = nullptr;
+	lastCommand = nullptr;
+
+	for(void *allocation : largeAllocations)
+	{
+		vk::freeHostMemory(allocation, NULL_ALLOCATION_CALLBACKS);
+	}
+	largeAllocations.clear();
+
+	usedChunks = 0;
+	chunkCurrent = nullptr;
+	chunkEnd = nullptr;
+
+	if(releaseResources)
+	{
+		pool->releaseChunks(chunks);
+	}
 
 	state = INITIAL;
 }
 
+void *CommandBuffer::allocate(size_t size, size_t alignment)
+{
+	ASSERT(alignment <= vk::HOST_MEMORY_ALLOCATION_ALIGNMENT);
+
+	uint8_t *memory = reinterpret_cast<uint8_t *>(sw::align(reinterpret_cast<uintptr_t>(chunkCurrent), static_cast<unsigned int>(alignment)));
+
+	if(!chunkCurrent || (memory + size > chunkEnd))
+	{
+		if(size > CommandPool::ChunkSize)
+		{
+			void *allocation = vk::allocateHostMemory(size, vk::HOST_MEMORY_ALLOCATION_ALIGNMENT,
+			                                          NULL_ALLOCATION_CALLBACKS, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+			ASSERT(allocation);
+			largeAllocations.push_back(allocation);
+
+			return allocation;
+		}
+
+		if(usedChunks == chunks.size())
+		{
+			chunks.push_back(pool->allocateChunk());
+		}
+
+		memory = static_cast<uint8_t *>(chunks[usedChunks++]);
+		chunkEnd = memory + CommandPool::ChunkSize;
+	}
+
+	chunkCurrent = memory + size;
+
+	return memory;
+}
+
 VkResult CommandBuffer::begin(VkCommandBufferUsageFlags flags, const VkCommandBufferInheritanceInfo *pInheritanceInfo)
 {
 	ASSERT((state != RECORDING) && (state != PENDING));
@@ -1844,7 +2089,7 @@ VkResult CommandBuffer::begin(VkCommandBufferUsageFlags flags, const VkCommandBu
 	if(state != INITIAL)
 	{
 		// Implicit reset
-		resetState();
+		resetState(false);
 	}
 
 	state = RECORDING;
@@ -1865,16 +2110,41 @@ VkResult CommandBuffer::reset(VkCommandPoolResetFlags flags)
 {
 	ASSERT(state != PENDING);
 
-	resetState();
+	resetState((flags & VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT) != 0);
 
 	return VK_SUCCESS;
 }
 
+template<typename T>
+T *CommandBuffer::allocateArray(uint32_t count)
+{
+	static_assert(std::is_trivially_destructible<T>::value, "Arrays are discarded without destruction");
+
+	if(count == 0)
+	{
+		return nullptr;
+	}
+
+	return static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+}
+
 template<typename T, typename... Args>
 void CommandBuffer::addCommand(Args &&...args)
 {
-	// FIXME (b/119409619): use an allocator here so we can control all memory allocations
-	commands.push_back(std::make_unique<T>(std::forward<Args>(args)...));
+	static_assert(std::is_trivially_destructible<T>::value, "Commands are discarded without destruction");
+
+	Command *command = new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+
+	if(lastCommand)
+	{
+		lastCommand->next = command;
+	}
+	else
+	{
+		firstCommand = command;
+	}
+
+	lastCommand = command;
 }
 
 void CommandBuffer::beginRenderPass(RenderPass *renderPass, Framebuffer *framebuffer, VkRect2D renderArea,
@@ -1883,7 +2153,17 @@ void CommandBuffer::beginRenderPass(RenderPass *renderPass, Framebuffer *framebu
 {
 	ASSERT(state == RECORDING);
 
-	addCommand<::CmdBeginRenderPass>(renderPass, framebuffer, renderArea, clearValueCount, clearValues, attachmentInfo);
+	VkClearValue *clearValuesCopy = allocateArray<VkClearValue>(clearValueCount);
+	memcpy(clearValuesCopy, clearValues, clearValueCount * sizeof(VkClearValue));
+
+	uint32_t attachmentCount = attachmentInfo ? attachmentInfo->attachmentCount : 0;
+	ImageView **attachments = allocateArray<ImageView *>(attachmentCount);
+	for(uint32_t i = 0; i < attachmentCount; i++)
+	{
+		attachments[i] = vk::Cast(attachmentInfo->pAttachments[i]);
+	}
+
+	addCommand<::CmdBeginRenderPass>(renderPass, framebuffer, renderArea, clearValueCount, clearValuesCopy, attachmentCount, attachments);
 }
 
 void CommandBuffer::nextSubpass(VkSubpassContents contents)
@@ -1935,7 +2215,9 @@ void CommandBuffer::dispatchBase(uint32_t baseGroupX, uint32_t baseGroupY, uint3
 
 void CommandBuffer::pipelineBarrier(const VkDependencyInfo &pDependencyInfo)
 {
-	addCommand<::CmdPipelineBarrier>();
+	const Image **images = allocateArray<const Image *>(pDependencyInfo.imageMemoryBarrierCount);
+
+	addCommand<::CmdPipelineBarrier>(pDependencyInfo, images);
 }
 
 void CommandBuffer::bindPipeline(VkPipelineBindPoint pipelineBindPoint, Pipeline *pipeline)
@@ -2141,8 +2423,15 @@ void CommandBuffer::setVertexInput(uint32_t vertexBindingDescriptionCount,
                                    uint32_t vertexAttributeDescriptionCount,
                                    const VkVertexInputAttributeDescription2EXT *pVertexAttributeDescriptions)
 {
-	addCommand<::CmdSetVertexInput>(vertexBindingDescriptionCount, pVertexBindingDescriptions,
-	                                vertexAttributeDescriptionCount, pVertexAttributeDescriptions);
+	// Note: the pNext values are unused, so this copy is currently safe.
+	auto *bindingDescriptions = allocateArray<VkVertexInputBindingDescription2EXT>(vertexBindingDescriptionCount);
+	memcpy(bindingDescriptions, pVertexBindingDescriptions, vertexBindingDescriptionCount * sizeof(VkVertexInputBindingDescription2EXT));
+
+	auto *attributeDescriptions = allocateArray<VkVertexInputAttributeDescription2EXT>(vertexAttributeDescriptionCount);
+	memcpy(attributeDescriptions, pVertexAttributeDescriptions, vertexAttributeDescriptionCount * sizeof(VkVertexInputAttributeDescription2EXT));
+
+	addCommand<::CmdSetVertexInput>(vertexBindingDescriptionCount, bindingDescriptions,
+	                                vertexAttributeDescriptionCount, attributeDescriptions);
 }
 
 void CommandBuffer::bindDescriptorSets(VkPipelineBindPoint pipelineBindPoint, const PipelineLayout *pipelineLayout,
@@ -2253,7 +2542,11 @@ void CommandBuffer::updateBuffer(Buffer *dstBuffer, VkDeviceSize dstOffset, VkDe
 {
 	ASSERT(state == RECORDING);
 
-	addCommand<::CmdUpdateBuffer>(dstBuffer, dstOffset, dataSize, reinterpret_cast<const uint8_t *>(pData));
+	// The data is copied alongside the commands, so it lives until the command buffer is reset.
+	void *data = allocate(static_cast<size_t>(dataSize), 1);
+	memcpy(data, pData, static_cast<size_t>(dataSize));
+
+	addCommand<::CmdUpdateBuffer>(dstBuffer, dstOffset, dataSize, static_cast<const uint8_t *>(data));
 }
 
 void CommandBuffer::fillBuffer(Buffer *dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size, uint32_t data)
@@ -2385,7 +2678,7 @@ void CommandBuffer::submit(CommandBuffer::ExecutionState &executionState)
 	// Perform recorded work
 	state = PENDING;
 
-	for(auto &command : commands)
+	for(Command *command = firstCommand; command; command = command->next)
 	{
 		command->execute(executionState);
 	}
@@ -2396,7 +2689,7 @@ void CommandBuffer::submit(CommandBuffer::ExecutionState &executionState)
 
 void CommandBuffer::submitSecondary(CommandBuffer::ExecutionState &executionState) const
 {
-	for(auto &command : commands)
+	for(Command *command = firstCommand; command; command = command->next)
 	{
 		command->execute(executionState);
 	}
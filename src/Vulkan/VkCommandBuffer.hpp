@@ -20,7 +20,6 @@
 #include "VkPipeline.hpp"
 #include "System/Synchronization.hpp"
 
-#include <memory>
 #include <vector>
 
 namespace sw {
@@ -34,6 +33,7 @@ namespace vk {
 
 class Device;
 class Buffer;
+class CommandPool;
 class Event;
 class Framebuffer;
 class Image;
@@ -84,7 +84,8 @@ class CommandBuffer
 public:
 	static constexpr VkSystemAllocationScope GetAllocationScope() { return VK_SYSTEM_ALLOCATION_SCOPE_OBJECT; }
 
-	CommandBuffer(Device *device, VkCommandBufferLevel pLevel);
+	CommandBuffer(Device *device, VkCommandBufferLevel pLevel, CommandPool *pool);
+	~CommandBuffer();
 
 	void destroy(const VkAllocationCallbacks *pAllocator);
 
@@ -221,16 +222,27 @@ public:
 	void submit(CommandBuffer::ExecutionState &executionState);
 	void submitSecondary(CommandBuffer::ExecutionState &executionState) const;
 
+	// Commands are never destroyed individually. Resetting the command buffer rewinds
+	// the chunks they were constructed in, so they must be trivially destructible.
 	class Command
 	{
 	public:
 		virtual void execute(ExecutionState &executionState) = 0;
 		virtual std::string description() = 0;
-		virtual ~Command() {}
+
+	protected:
+		~Command() = default;
+
+	private:
+		friend class CommandBuffer;
+		Command *next = nullptr;
 	};
 
 private:
-	void resetState();
+	void resetState(bool releaseResources);
+	void *allocate(size_t size, size_t alignment);
+	template<typename T>
+	T *allocateArray(uint32_t count);
 	template<typename T, typename... Args>
 	void addCommand(Args &&...args);
 
@@ -244,11 +256,19 @@ private:
 	};
 
 	Device *const device;
+	CommandPool *const pool;
 	State state = INITIAL;
 	VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 
-	// FIXME (b/119409619): replace this vector by an allocator so we can control all memory allocations
-	std::vector<std::unique_ptr<Command>> commands;
+	// Commands and the arrays they reference are constructed in place in chunks obtained
+	// from the command pool, and linked in recording order. Resetting keeps the chunks for reuse.
+	Command *firstCommand = nullptr;
+	Command *lastCommand = nullptr;
+	std::vector<void *> chunks;
+	size_t usedChunks = 0;
+	uint8_t *chunkCurrent = nullptr;
+	uint8_t *chunkEnd = nullptr;
+	std::vector<void *> largeAllocations;  // Allocations which don't fit in a chunk
 };
 
 using DispatchableCommandBuffer = DispatchableObject<CommandBuffer, VkCommandBuffer>;
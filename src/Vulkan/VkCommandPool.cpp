@@ -33,6 +33,8 @@ void CommandPool::destroy(const VkAllocationCallbacks *pAllocator)
 	{
 		vk::destroy(commandBuffer, NULL_ALLOCATION_CALLBACKS);
 	}
+
+	freeChunks();
 }
 
 size_t CommandPool::ComputeRequiredAllocationSize(const VkCommandPoolCreateInfo *pCreateInfo)
@@ -48,7 +50,7 @@ VkResult CommandPool::allocateCommandBuffers(Device *device, VkCommandBufferLeve
 		void *memory = vk::allocateHostMemory(sizeof(DispatchableCommandBuffer), vk::HOST_MEMORY_ALLOCATION_ALIGNMENT,
 		                                      NULL_ALLOCATION_CALLBACKS, DispatchableCommandBuffer::GetAllocationScope());
 		ASSERT(memory);
-		DispatchableCommandBuffer *commandBuffer = new(memory) DispatchableCommandBuffer(device, level);
+		DispatchableCommandBuffer *commandBuffer = new(memory) DispatchableCommandBuffer(device, level, this);
 		if(commandBuffer)
 		{
 			pCommandBuffers[i] = *commandBuffer;
@@ -93,12 +95,51 @@ VkResult CommandPool::reset(VkCommandPoolResetFlags flags)
 		vk::Cast(commandBuffer)->reset(flags);
 	}
 
+	if(flags & VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT)
+	{
+		freeChunks();
+	}
+
 	return VK_SUCCESS;
 }
 
 void CommandPool::trim(VkCommandPoolTrimFlags flags)
 {
-	// TODO (b/119827933): Optimize memory usage here
+	// Chunks held by command buffers are returned when they get reset with
+	// VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT, freed, or destroyed.
+	freeChunks();
+}
+
+void *CommandPool::allocateChunk()
+{
+	if(!availableChunks.empty())
+	{
+		void *chunk = availableChunks.back();
+		availableChunks.pop_back();
+		return chunk;
+	}
+
+	void *chunk = vk::allocateHostMemory(ChunkSize, vk::HOST_MEMORY_ALLOCATION_ALIGNMENT,
+	                                     NULL_ALLOCATION_CALLBACKS, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+	ASSERT(chunk);
+
+	return chunk;
+}
+
+void CommandPool::releaseChunks(std::vector<void *> &chunks)
+{
+	availableChunks.insert(availableChunks.end(), chunks.begin(), chunks.end());
+	chunks.clear();
+}
+
+void CommandPool::freeChunks()
+{
+	for(void *chunk : availableChunks)
+	{
+		vk::freeHostMemory(chunk, NULL_ALLOCATION_CALLBACKS);
+	}
+
+	availableChunks.clear();
 }
 
 }  // namespace vk
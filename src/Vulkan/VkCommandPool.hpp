@@ -18,6 +18,7 @@
 #include "VkObject.hpp"
 
 #include <set>
+#include <vector>
 
 namespace vk {
 
@@ -36,8 +37,17 @@ public:
 	VkResult reset(VkCommandPoolResetFlags flags);
 	void trim(VkCommandPoolTrimFlags flags);
 
+	// Command buffers record their commands into chunks of this size.
+	static constexpr size_t ChunkSize = 16 * 1024;
+
+	void *allocateChunk();
+	void releaseChunks(std::vector<void *> &chunks);
+
 private:
+	void freeChunks();
+
 	std::set<VkCommandBuffer> commandBuffers;
+	std::vector<void *> availableChunks;
 };
 
 static inline CommandPool *Cast(VkCommandPool object)
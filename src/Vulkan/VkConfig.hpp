@@ -104,6 +104,12 @@ constexpr int SUBPIXEL_PRECISION_MASK = 0xFFFFFFFF >> (32 - SUBPIXEL_PRECISION_B
 
 constexpr int MAX_VIEWPORTS = 16;
 
+// Queue family 0 supports all operations, family 1 only compute and transfer,
+// and family 2 only transfer. Each queue processes its submissions on its own
+// thread, so work submitted to different queues executes concurrently.
+constexpr uint32_t QUEUE_FAMILY_COUNT = 3;
+constexpr uint32_t QUEUE_COUNT_PER_FAMILY = 4;
+
 // TODO: The heap size should be configured based on available RAM.
 constexpr VkDeviceSize PHYSICAL_DEVICE_HEAP_SIZE = 0x80000000ull;   // 0x80000000 = 2 GiB
 constexpr VkDeviceSize MAX_MEMORY_ALLOCATION_SIZE = 0x40000000ull;  // 0x40000000 = 1 GiB
@@ -39,6 +39,8 @@ DescriptorPool::DescriptorPool(const VkDescriptorPoolCreateInfo *pCreateInfo, vo
 
 void DescriptorPool::destroy(const VkAllocationCallbacks *pAllocator)
 {
+	reset();
+
 	vk::freeHostMemory(pool, pAllocator);
 }
 
@@ -200,12 +202,22 @@ void DescriptorPool::freeSet(const VkDescriptorSet descriptorSet)
 	auto it = std::find(nodes.begin(), itEnd, asMemory(descriptorSet));
 	if(it != itEnd)
 	{
+		destroySet(it->set);
 		nodes.erase(it);
 	}
 }
 
+void DescriptorPool::destroySet(uint8_t *memory)
+{
+	reinterpret_cast<DescriptorSet *>(memory)->~DescriptorSet();
+}
+
 VkResult DescriptorPool::reset()
 {
+	for(auto &node : nodes)
+	{
+		destroySet(node.set);
+	}
 	nodes.clear();
 
 	return VK_SUCCESS;
@@ -36,6 +36,7 @@ private:
 	VkResult allocateSets(size_t *sizes, uint32_t numAllocs, VkDescriptorSet *pDescriptorSets);
 	uint8_t *findAvailableMemory(size_t size);
 	void freeSet(const VkDescriptorSet descriptorSet);
+	void destroySet(uint8_t *memory);  // Runs the destructor of the set allocated at 'memory'
 	size_t computeTotalFreeSize() const;
 
 	struct Node
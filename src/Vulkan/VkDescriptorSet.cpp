@@ -20,7 +20,8 @@
 
 namespace vk {
 
-void DescriptorSet::ParseDescriptors(const Array &descriptorSets, const PipelineLayout *layout, Device *device, NotificationType notificationType)
+template<typename Visitor>
+void DescriptorSet::ParseDescriptorSets(const Array &descriptorSets, const PipelineLayout *layout, Visitor &&visitor)
 {
 	if(layout)
 	{
@@ -36,56 +37,137 @@ void DescriptorSet::ParseDescriptors(const Array &descriptorSets, const Pipeline
 			}
 
 			marl::lock lock(descriptorSet->header.mutex);
-			uint32_t bindingCount = layout->getBindingCount(i);
-			for(uint32_t j = 0; j < bindingCount; ++j)
+			visitor(descriptorSet, i);
+		}
+	}
+}
+
+template<typename Visitor>
+void DescriptorSet::parseImageDescriptors(uint32_t setNumber, const PipelineLayout *layout, Visitor &&visitor)
+{
+	uint32_t bindingCount = layout->getBindingCount(setNumber);
+	for(uint32_t j = 0; j < bindingCount; ++j)
+	{
+		VkDescriptorType type = layout->getDescriptorType(setNumber, j);
+		uint32_t descriptorCount = layout->getDescriptorCount(setNumber, j);
+		uint32_t descriptorSize = layout->getDescriptorSize(setNumber, j);
+		uint8_t *descriptorMemory = getDataAddress() + layout->getBindingOffset(setNumber, j);
+
+		for(uint32_t k = 0; k < descriptorCount; k++)
+		{
+			ImageView *memoryOwner = nullptr;
+			uint32_t samplerId = 0;
+			switch(type)
+			{
+			case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+				memoryOwner = reinterpret_cast<SampledImageDescriptor *>(descriptorMemory)->memoryOwner;
+				samplerId = reinterpret_cast<SampledImageDescriptor *>(descriptorMemory)->samplerId;
+				break;
+			case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+				memoryOwner = reinterpret_cast<SampledImageDescriptor *>(descriptorMemory)->memoryOwner;
+				break;
+			case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+			case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+				memoryOwner = reinterpret_cast<StorageImageDescriptor *>(descriptorMemory)->memoryOwner;
+				break;
+			default:
+				break;
+			}
+			if(memoryOwner)
 			{
-				VkDescriptorType type = layout->getDescriptorType(i, j);
-				uint32_t descriptorCount = layout->getDescriptorCount(i, j);
-				uint32_t descriptorSize = layout->getDescriptorSize(i, j);
-				uint8_t *descriptorMemory = descriptorSet->getDataAddress() + layout->getBindingOffset(i, j);
-
-				for(uint32_t k = 0; k < descriptorCount; k++)
-				{
-					ImageView *memoryOwner = nullptr;
-					switch(type)
-					{
-					case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
-					case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
-						memoryOwner = reinterpret_cast<SampledImageDescriptor *>(descriptorMemory)->memoryOwner;
-						break;
-					case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
-					case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
-						memoryOwner = reinterpret_cast<StorageImageDescriptor *>(descriptorMemory)->memoryOwner;
-						break;
-					default:
-						break;
-					}
-					if(memoryOwner)
-					{
-						if(notificationType == PREPARE_FOR_SAMPLING)
-						{
-							device->prepareForSampling(memoryOwner);
-						}
-						else if((notificationType == CONTENTS_CHANGED) && (type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE))
-						{
-							device->contentsChanged(memoryOwner, Image::USING_STORAGE);
-						}
-					}
-					descriptorMemory += descriptorSize;
-				}
+				visitor(type, memoryOwner, samplerId);
 			}
+			descriptorMemory += descriptorSize;
 		}
 	}
 }
 
 void DescriptorSet::ContentsChanged(const Array &descriptorSets, const PipelineLayout *layout, Device *device)
 {
-	ParseDescriptors(descriptorSets, layout, device, CONTENTS_CHANGED);
+	ParseDescriptorSets(descriptorSets, layout, [layout, device](DescriptorSet *descriptorSet, uint32_t setNumber) {
+		DescriptorSetSummary &summary = descriptorSet->header.contentsChanged;
+		uint32_t generation = descriptorSet->header.generation;
+
+		// Only storage images which require preprocessing track their changes.
+		if(summary.isCurrent(generation, layout->identifier) && !summary.hasPreprocessedImages)
+		{
+			return;
+		}
+
+		bool hasPreprocessedImages = false;
+		descriptorSet->parseImageDescriptors(setNumber, layout, [device, &hasPreprocessedImages](VkDescriptorType type, ImageView *memoryOwner, uint32_t samplerId) {
+			if(type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE)
+			{
+				hasPreprocessedImages = device->contentsChanged(memoryOwner, Image::USING_STORAGE) || hasPreprocessedImages;
+			}
+		});
+
+		summary.generation = generation;
+		summary.pipelineLayoutId = layout->identifier;
+		summary.hasPreprocessedImages = hasPreprocessedImages;
+	});
 }
 
 void DescriptorSet::PrepareForSampling(const Array &descriptorSets, const PipelineLayout *layout, Device *device)
 {
-	ParseDescriptors(descriptorSets, layout, device, PREPARE_FOR_SAMPLING);
+	// Read before preparing, so that images changed meanwhile get prepared by the next walk.
+	uint32_t dirtyImageGeneration = device->getDirtyImageGeneration();
+
+	ParseDescriptorSets(descriptorSets, layout, [layout, device, dirtyImageGeneration](DescriptorSet *descriptorSet, uint32_t setNumber) {
+		DescriptorSetSummary &summary = descriptorSet->header.preparedForSampling;
+		uint32_t generation = descriptorSet->header.generation;
+
+		if(summary.isCurrent(generation, layout->identifier) &&
+		   (!summary.hasPreprocessedImages || (summary.dirtyImageGeneration == dirtyImageGeneration)))
+		{
+			return;
+		}
+
+		bool hasPreprocessedImages = false;
+		descriptorSet->parseImageDescriptors(setNumber, layout, [device, &hasPreprocessedImages](VkDescriptorType type, ImageView *memoryOwner, uint32_t samplerId) {
+			hasPreprocessedImages = device->prepareForSampling(memoryOwner) || hasPreprocessedImages;
+
+			// This walk only happens the first time the set is used with this
+			// layout, so it is where sampling routines are created ahead of
+			// the draws which will need them.
+			if(type != VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT)
+			{
+				device->prewarmSamplingRoutines(memoryOwner->id, samplerId, type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+			}
+		});
+
+		summary.generation = generation;
+		summary.pipelineLayoutId = layout->identifier;
+		summary.dirtyImageGeneration = dirtyImageGeneration;
+		summary.hasPreprocessedImages = hasPreprocessedImages;
+	});
+}
+
+void DescriptorSet::GetImages(const Array &descriptorSets, const PipelineLayout *layout, std::vector<const Image *> &images)
+{
+	ParseDescriptorSets(descriptorSets, layout, [layout, &images](DescriptorSet *descriptorSet, uint32_t setNumber) {
+		DescriptorSetSummary &summary = descriptorSet->header.imagesCollected;
+		std::vector<const Image *> &setImages = descriptorSet->header.images;
+		uint32_t generation = descriptorSet->header.generation;
+
+		if(!summary.isCurrent(generation, layout->identifier))
+		{
+			setImages.clear();
+			descriptorSet->parseImageDescriptors(setNumber, layout, [&setImages](VkDescriptorType type, ImageView *memoryOwner, uint32_t samplerId) {
+				setImages.push_back(memoryOwner->getImage());
+			});
+
+			summary.generation = generation;
+			summary.pipelineLayoutId = layout->identifier;
+		}
+
+		images.insert(images.end(), setImages.begin(), setImages.end());
+	});
+}
+
+void DescriptorSet::contentsUpdated()
+{
+	header.generation++;
 }
 
 uint8_t *DescriptorSet::getDataAddress()
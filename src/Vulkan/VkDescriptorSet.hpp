@@ -19,19 +19,46 @@
 #include "marl/mutex.h"
 
 #include <array>
+#include <atomic>
 #include <cstdint>
 #include <memory>
+#include <vector>
 
 namespace vk {
 
 class DescriptorSetLayout;
 class Device;
+class Image;
 class PipelineLayout;
 
+// Result of walking a descriptor set's image descriptors, which later walks
+// can skip while the set and the pipeline layout used for it are unchanged.
+struct DescriptorSetSummary
+{
+	uint32_t generation = ~0u;           // Descriptor set generation at the time of the walk
+	uint32_t pipelineLayoutId = 0;       // PipelineLayout identifier used for the walk
+	uint32_t dirtyImageGeneration = 0;   // Device dirty image generation at the time of the walk
+	bool hasPreprocessedImages = false;  // Whether any image requires preprocessing before sampling
+
+	bool isCurrent(uint32_t setGeneration, uint32_t layoutId) const
+	{
+		return (generation == setGeneration) && (pipelineLayoutId == layoutId);
+	}
+};
+
 struct alignas(16) DescriptorSetHeader
 {
 	DescriptorSetLayout *layout;
 	marl::mutex mutex;
+
+	// Incremented by every update to the set's descriptors.
+	std::atomic<uint32_t> generation = { 0 };
+
+	// Guarded by mutex.
+	DescriptorSetSummary preparedForSampling;
+	DescriptorSetSummary contentsChanged;
+	DescriptorSetSummary imagesCollected;
+	std::vector<const Image *> images;  // Referenced by the image descriptors, as of imagesCollected
 };
 
 class alignas(16) DescriptorSet : public Object<DescriptorSet, VkDescriptorSet>
@@ -44,17 +71,24 @@ public:
 	static void ContentsChanged(const Array &descriptorSets, const PipelineLayout *layout, Device *device);
 	static void PrepareForSampling(const Array &descriptorSets, const PipelineLayout *layout, Device *device);
 
+	// Appends the images referenced by the image descriptors of the sets to 'images'.
+	// Each set only walks its descriptors again after they've been updated.
+	static void GetImages(const Array &descriptorSets, const PipelineLayout *layout, std::vector<const Image *> &images);
+
 	uint8_t *getDataAddress();  // Returns a pointer to the descriptor payload following the header.
+	void contentsUpdated();     // Must be called after writing descriptors.
 
 	DescriptorSetHeader header;
 
 private:
-	enum NotificationType
-	{
-		CONTENTS_CHANGED,
-		PREPARE_FOR_SAMPLING
-	};
-	static void ParseDescriptors(const Array &descriptorSets, const PipelineLayout *layout, Device *device, NotificationType notificationType);
+	// Calls visitor(descriptorSet, setNumber) for each bound set, with the set's mutex held.
+	template<typename Visitor>
+	static void ParseDescriptorSets(const Array &descriptorSets, const PipelineLayout *layout, Visitor &&visitor);
+
+	// Calls visitor(type, imageView, samplerId) for each image descriptor of the set.
+	// samplerId is only non-zero for combined image samplers.
+	template<typename Visitor>
+	void parseImageDescriptors(uint32_t setNumber, const PipelineLayout *layout, Visitor &&visitor);
 };
 
 inline DescriptorSet *Cast(VkDescriptorSet object)
@@ -493,7 +493,8 @@ void DescriptorSetLayout::WriteDescriptorSet(Device *device, DescriptorSet *dstS
 					uint32_t height = extent.height;
 					uint32_t layerCount = imageView->getSubresourceRange().layerCount;
 					uint32_t depth = imageView->getDepthOrLayerCount(level);
-					uint32_t bytes = format.bytes();
+					// Block-compressed images are sampled from their blocks, so their pitches are in blocks.
+					uint32_t bytes = format.isCompressed() ? format.bytesPerBlock() : format.bytes();
 					uint32_t pitchP = imageView->rowPitchBytes(aspect, level, ImageView::SAMPLING) / bytes;
 					uint32_t sliceP = (layerCount > 1 ? imageView->layerPitchBytes(aspect, ImageView::SAMPLING) : imageView->slicePitchBytes(aspect, level, ImageView::SAMPLING)) / bytes;
 					uint32_t samplePitchP = imageView->getMipLevelSize(aspect, level, ImageView::SAMPLING) / bytes;
@@ -585,6 +586,8 @@ void DescriptorSetLayout::WriteDescriptorSet(Device *device, DescriptorSet *dstS
 	{
 		memcpy(memToWrite, src + entry.offset, entry.descriptorCount);
 	}
+
+	dstSet->contentsUpdated();
 }
 
 void DescriptorSetLayout::WriteDescriptorSet(Device *device, const VkWriteDescriptorSet &writeDescriptorSet)
@@ -668,6 +671,8 @@ void DescriptorSetLayout::CopyDescriptorSet(const VkCopyDescriptorSet &descripto
 	ASSERT(srcTypeSize == dstTypeSize);
 	size_t writeSize = dstTypeSize * descriptorCopies.descriptorCount;
 	memcpy(memToWrite, memToRead, writeSize);
+
+	dstSet->contentsUpdated();
 }
 
 }  // namespace vk
@@ -24,7 +24,10 @@
 #include "Debug/Context.hpp"
 #include "Debug/Server.hpp"
 #include "Device/Blitter.hpp"
+#include "Device/Renderer.hpp"
+#include "Pipeline/SpirvShader.hpp"
 #include "System/Debug.hpp"
+#include "System/SwiftConfig.hpp"
 
 #include <chrono>
 #include <climits>
@@ -51,19 +54,27 @@ const time_point getEndTimePoint(uint64_t timeout, bool &infiniteTimeout)
 
 namespace vk {
 
+std::vector<uint32_t> Device::SamplingRoutineCache::getSignatures()
+{
+	marl::lock lock(mutex);
+
+	return std::vector<uint32_t>(signatures.begin(), signatures.end());
+}
+
 void Device::SamplingRoutineCache::updateSnapshot()
 {
 	marl::lock lock(mutex);
 
 	if(snapshotNeedsUpdate)
 	{
-		snapshot.clear();
+		auto newSnapshot = std::make_shared<Snapshot>();
 
 		for(auto it : cache)
 		{
-			snapshot[it.key()] = it.data();
+			(*newSnapshot)[it.key()] = it.data();
 		}
 
+		std::atomic_store(&snapshot, std::shared_ptr<const Snapshot>(std::move(newSnapshot)));
 		snapshotNeedsUpdate = false;
 	}
 }
@@ -133,6 +144,10 @@ Device::Device(const VkDeviceCreateInfo *pCreateInfo, void *mem, PhysicalDevice
 	for(uint32_t i = 0; i < pCreateInfo->queueCreateInfoCount; i++)
 	{
 		const VkDeviceQueueCreateInfo &queueCreateInfo = pCreateInfo->pQueueCreateInfos[i];
+		ASSERT(queueCreateInfo.queueFamilyIndex < QUEUE_FAMILY_COUNT);
+
+		// Each queue family appears at most once in pQueueCreateInfos, so its queues are contiguous.
+		queueFamilyOffsets[queueCreateInfo.queueFamilyIndex] = queueID;
 
 		for(uint32_t j = 0; j < queueCreateInfo.queueCount; j++, queueID++)
 		{
@@ -154,6 +169,8 @@ Device::Device(const VkDeviceCreateInfo *pCreateInfo, void *mem, PhysicalDevice
 
 	// TODO(b/119409619): use an allocator here so we can control all memory allocations
 	blitter.reset(new sw::Blitter());
+	routineCaches = std::make_shared<sw::RoutineCaches>(sw::getConfiguration().routineCacheBudget, sw::getConfiguration().tierUpThreshold);
+	batchDataPool = std::make_shared<sw::BatchDataPool>(scheduler->config().workerThread.count);
 	samplingRoutineCache.reset(new SamplingRoutineCache());
 	samplerIndexer.reset(new SamplerIndexer());
 
@@ -173,6 +190,20 @@ void Device::destroy(const VkAllocationCallbacks *pAllocator)
 		queues[i].~Queue();
 	}
 
+#if !defined(SWIFTSHADER_DISABLE_TRACE)
+	// Report the routine cache statistics, for tuning its budget.
+	auto traceStatistics = [](const char *stage, auto statistics) {
+		TRACE("%s routine cache: %llu hits, %llu misses, %llu insertions, %llu evictions (%llu bytes), %zu routines (%zu bytes)",
+		      stage, (unsigned long long)statistics.hits, (unsigned long long)statistics.misses,
+		      (unsigned long long)statistics.insertions, (unsigned long long)statistics.evictions,
+		      (unsigned long long)statistics.evictedBytes, statistics.entries, statistics.bytes);
+	};
+
+	traceStatistics("Vertex", routineCaches->vertex.getStatistics());
+	traceStatistics("Setup", routineCaches->setup.getStatistics());
+	traceStatistics("Pixel", routineCaches->pixel.getStatistics());
+#endif
+
 	vk::freeHostMemory(queues, pAllocator);
 }
 
@@ -201,9 +232,9 @@ bool Device::hasExtension(const char *extensionName) const
 
 VkQueue Device::getQueue(uint32_t queueFamilyIndex, uint32_t queueIndex) const
 {
-	ASSERT(queueFamilyIndex == 0);
+	ASSERT(queueFamilyIndex < QUEUE_FAMILY_COUNT);
 
-	return queues[queueIndex];
+	return queues[queueFamilyOffsets[queueFamilyIndex] + queueIndex];
 }
 
 VkResult Device::waitForFences(uint32_t fenceCount, const VkFence *pFences, VkBool32 waitAll, uint64_t timeout)
@@ -406,6 +437,11 @@ void Device::updateSamplingRoutineSnapshotCache()
 	samplingRoutineCache->updateSnapshot();
 }
 
+void Device::prewarmSamplingRoutines(uint32_t imageViewId, uint32_t samplerId, bool storageImage)
+{
+	sw::SpirvEmitter::prewarmImageSamplers(this, imageViewId, samplerId, storageImage);
+}
+
 uint32_t Device::indexSampler(const SamplerState &samplerState)
 {
 	return samplerIndexer->index(samplerState);
@@ -455,7 +491,7 @@ void Device::unregisterImageView(ImageView *imageView)
 	}
 }
 
-void Device::prepareForSampling(ImageView *imageView)
+bool Device::prepareForSampling(ImageView *imageView)
 {
 	if(imageView != nullptr)
 	{
@@ -465,11 +501,14 @@ void Device::prepareForSampling(ImageView *imageView)
 		if(it != imageViewSet.end())
 		{
 			imageView->prepareForSampling();
+			return imageView->getImage()->requiresPreprocessing();
 		}
 	}
+
+	return false;
 }
 
-void Device::contentsChanged(ImageView *imageView, Image::ContentsChangedContext context)
+bool Device::contentsChanged(ImageView *imageView, Image::ContentsChangedContext context)
 {
 	if(imageView != nullptr)
 	{
@@ -479,8 +518,11 @@ void Device::contentsChanged(ImageView *imageView, Image::ContentsChangedContext
 		if(it != imageViewSet.end())
 		{
 			imageView->contentsChanged(context);
+			return imageView->getImage()->requiresPreprocessing();
 		}
 	}
+
+	return false;
 }
 
 VkResult Device::setPrivateData(VkObjectType objectType, uint64_t objectHandle, const PrivateData *privateDataSlot, uint64_t data)
@@ -22,17 +22,26 @@
 #include "Reactor/Routine.hpp"
 #include "System/LRUCache.hpp"
 
+#include "marl/event.h"
 #include "marl/mutex.h"
+#include "marl/scheduler.h"
 #include "marl/tsa.h"
+#include "marl/waitgroup.h"
 
+#include <algorithm>
+#include <atomic>
 #include <map>
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
-namespace marl {
-class Scheduler;
-}
+namespace sw {
+
+struct BatchDataPool;
+struct RoutineCaches;
+
+}  // namespace sw
 
 namespace vk {
 
@@ -63,11 +72,20 @@ public:
 	void getRequirements(VkMemoryDedicatedRequirements *requirements) const;
 	const VkPhysicalDeviceFeatures &getEnabledFeatures() const { return enabledFeatures; }
 	sw::Blitter *getBlitter() const { return blitter.get(); }
+	sw::RoutineCaches *getRoutineCaches() const { return routineCaches.get(); }
+	sw::BatchDataPool *getBatchDataPool() const { return batchDataPool.get(); }
+	marl::Scheduler *getScheduler() const { return scheduler.get(); }
 
 	void registerImageView(ImageView *imageView);
 	void unregisterImageView(ImageView *imageView);
-	void prepareForSampling(ImageView *imageView);
-	void contentsChanged(ImageView *imageView, Image::ContentsChangedContext context);
+	// Both return whether the view's image requires preprocessing before sampling.
+	bool prepareForSampling(ImageView *imageView);
+	bool contentsChanged(ImageView *imageView, Image::ContentsChangedContext context);
+
+	// Incremented whenever an image which requires preprocessing has its contents
+	// changed, so that descriptor sets can tell their images are still prepared.
+	void imageContentsChanged() const { dirtyImageGeneration++; }
+	uint32_t getDirtyImageGeneration() const { return dirtyImageGeneration; }
 
 	VkResult setPrivateData(VkObjectType objectType, uint64_t objectHandle, const PrivateData *privateDataSlot, uint64_t data);
 	void getPrivateData(VkObjectType objectType, uint64_t objectHandle, const PrivateData *privateDataSlot, uint64_t *data);
@@ -77,9 +95,9 @@ public:
 	{
 	public:
 		SamplingRoutineCache()
-		    : cache(1024)
+		    : cache(Capacity)
 		{}
-		~SamplingRoutineCache() {}
+		~SamplingRoutineCache() { prewarming.wait(); }
 
 		struct Key
 		{
@@ -96,42 +114,130 @@ public:
 		};
 
 		// getOrCreate() queries the cache for a Routine with the given key.
-		// If one is found, it is returned, otherwise createRoutine(key) is
-		// called, the returned Routine is added to the cache, and it is
-		// returned.
+		// If one is found, it is returned. If another thread is already
+		// creating it, that Routine is waited for. Otherwise createRoutine(key)
+		// is called, the returned Routine is added to the cache, and it is
+		// returned. The cache is not locked while routines are created, so
+		// misses on different keys don't serialize.
 		// Function must be a function of the signature:
 		//     std::shared_ptr<rr::Routine>(const Key &)
 		template<typename Function>
 		std::shared_ptr<rr::Routine> getOrCreate(const Key &key, Function &&createRoutine)
 		{
-			auto it = snapshot.find(key);
-			if(it != snapshot.end()) { return it->second; }
+			auto currentSnapshot = std::atomic_load(&snapshot);
+			auto it = currentSnapshot->find(key);
+			if(it != currentSnapshot->end()) { return it->second; }
+
+			std::shared_ptr<InFlight> inFlight;
+			bool creator = false;
+			{
+				marl::lock lock(mutex);
+				if(auto existingRoutine = cache.lookup(key))
+				{
+					return existingRoutine;
+				}
+
+				auto &pending = inFlightRoutines[key];
+				if(!pending)
+				{
+					pending = std::make_shared<InFlight>();
+					creator = true;
+				}
+				inFlight = pending;
+			}
 
-			marl::lock lock(mutex);
-			if(auto existingRoutine = cache.lookup(key))
+			if(!creator)
 			{
-				return existingRoutine;
+				inFlight->created.wait();
+				return inFlight->routine;
 			}
 
-			std::shared_ptr<rr::Routine> newRoutine = createRoutine(key);
-			cache.add(key, newRoutine);
-			snapshotNeedsUpdate = true;
+			inFlight->routine = createRoutine(key);
 
-			return newRoutine;
+			{
+				marl::lock lock(mutex);
+				cache.add(key, inFlight->routine);
+				inFlightRoutines.erase(key);
+				routineCount = std::min(routineCount + 1, Capacity);
+				snapshotNeedsUpdate = true;
+
+				if(signatures.size() < MaxSignatures)
+				{
+					signatures.insert(key.instruction);
+				}
+			}
+
+			inFlight->created.signal();
+
+			return inFlight->routine;
 		}
 
+		// prewarm() creates the Routine for the given key on the scheduler,
+		// unless it is cached or already being created. Speculative routines
+		// must not evict the ones in use, so prewarming stops once the cache
+		// is half full, in which case false is returned.
+		template<typename Function>
+		bool prewarm(marl::Scheduler *scheduler, const Key &key, Function &&createRoutine)
+		{
+			{
+				marl::lock lock(mutex);
+				if(routineCount + inFlightRoutines.size() >= Capacity / 2)
+				{
+					return false;
+				}
+
+				if(cache.lookup(key) || (inFlightRoutines.count(key) != 0))
+				{
+					return true;
+				}
+			}
+
+			prewarming.add(1);
+			scheduler->enqueue(marl::Task([this, key, createRoutine] {
+				getOrCreate(key, createRoutine);
+				prewarming.done();
+			}));
+
+			return true;
+		}
+
+		// Returns the image instruction signatures of the routines created so far.
+		std::vector<uint32_t> getSignatures();
+
 		void updateSnapshot();
 
 	private:
-		bool snapshotNeedsUpdate = false;
-		std::unordered_map<Key, std::shared_ptr<rr::Routine>, Key::Hash> snapshot;
+		static constexpr size_t Capacity = 1024;
+
+		// Bounds the number of routines prewarmed for each image view and sampler.
+		static constexpr size_t MaxSignatures = 64;
+
+		struct InFlight
+		{
+			marl::Event created{ marl::Event::Mode::Manual };
+			std::shared_ptr<rr::Routine> routine;
+		};
+
+		using Snapshot = std::unordered_map<Key, std::shared_ptr<rr::Routine>, Key::Hash>;
+
+		// Read without locking, with std::atomic_load(). Replaced as a whole
+		// with std::atomic_store(), so readers holding the previous snapshot
+		// are unaffected by updates.
+		std::shared_ptr<const Snapshot> snapshot = std::make_shared<Snapshot>();
 
 		marl::mutex mutex;
+		bool snapshotNeedsUpdate GUARDED_BY(mutex) = false;
+		size_t routineCount GUARDED_BY(mutex) = 0;  // Saturates at Capacity, as the LRU cache recycles entries.
 		sw::LRUCache<Key, std::shared_ptr<rr::Routine>, Key::Hash> cache GUARDED_BY(mutex);
+		std::unordered_map<Key, std::shared_ptr<InFlight>, Key::Hash> inFlightRoutines GUARDED_BY(mutex);
+		std::unordered_set<uint32_t> signatures GUARDED_BY(mutex);
+
+		marl::WaitGroup prewarming;
 	};
 
 	SamplingRoutineCache *getSamplingRoutineCache() const;
 	void updateSamplingRoutineSnapshotCache();
+	void prewarmSamplingRoutines(uint32_t imageViewId, uint32_t samplerId, bool storageImage);
 
 	class SamplerIndexer
 	{
@@ -172,7 +278,10 @@ private:
 	PhysicalDevice *const physicalDevice = nullptr;
 	Queue *const queues = nullptr;
 	uint32_t queueCount = 0;
+	uint32_t queueFamilyOffsets[QUEUE_FAMILY_COUNT] = {};  // Index of each family's first queue
 	std::unique_ptr<sw::Blitter> blitter;
+	std::shared_ptr<sw::RoutineCaches> routineCaches;  // Shared pointer, for its deleter to support the incomplete type
+	std::shared_ptr<sw::BatchDataPool> batchDataPool;  // Shared pointer, for its deleter to support the incomplete type
 	uint32_t enabledExtensionCount = 0;
 	typedef char ExtensionName[VK_MAX_EXTENSION_NAME_SIZE];
 	ExtensionName *extensions = nullptr;
@@ -184,6 +293,7 @@ private:
 
 	marl::mutex imageViewSetMutex;
 	std::unordered_set<ImageView *> imageViewSet GUARDED_BY(imageViewSetMutex);
+	mutable std::atomic<uint32_t> dirtyImageGeneration = { 0 };
 
 	struct PrivateDataObject
 	{
@@ -24,6 +24,10 @@
 #include "Device/BC_Decoder.hpp"
 #include "Device/Blitter.hpp"
 #include "Device/ETC_Decoder.hpp"
+#include "System/Math.hpp"
+#include "System/Memory.hpp"
+
+#include "marl/scheduler.h"
 
 #ifdef __ANDROID__
 #	include <vndk/hardware_buffer.h>
@@ -31,7 +35,10 @@
 #	include "VkDeviceMemoryExternalAndroid.hpp"
 #endif
 
+#include <algorithm>
+#include <climits>
 #include <cstring>
+#include <vector>
 
 namespace {
 
@@ -181,6 +188,34 @@ VkFormat GetImageFormat(const VkImageCreateInfo *pCreateInfo)
 	return pCreateInfo->format;
 }
 
+// Returns true for block-compressed images which the sampler decodes directly from their
+// blocks, so they don't need a decompressed copy. Images which can be viewed with other
+// formats, blitted from, or sampled as cube maps keep using a decompressed copy.
+bool IsSampledDirectly(const VkImageCreateInfo *pCreateInfo)
+{
+	switch(GetImageFormat(pCreateInfo))
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC2_UNORM_BLOCK:
+	case VK_FORMAT_BC2_SRGB_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+		break;
+	default:
+		return false;
+	}
+
+	return (pCreateInfo->imageType == VK_IMAGE_TYPE_2D) &&
+	       (pCreateInfo->tiling == VK_IMAGE_TILING_OPTIMAL) &&
+	       !(pCreateInfo->flags & (VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT)) &&
+	       !(pCreateInfo->usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+}
+
 }  // anonymous namespace
 
 namespace vk {
@@ -197,10 +232,12 @@ Image::Image(const VkImageCreateInfo *pCreateInfo, void *mem, Device *device)
     , tiling(pCreateInfo->tiling)
     , usage(pCreateInfo->usage)
 {
-	if(format.isCompressed())
+	if(format.isCompressed() && !IsSampledDirectly(pCreateInfo))
 	{
 		VkImageCreateInfo compressedImageCreateInfo = *pCreateInfo;
 		compressedImageCreateInfo.format = format.getDecompressedFormat();
+		// The decompressed copy is written by the transfer path.
+		compressedImageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 		decompressedImage = new(mem) Image(&compressedImageCreateInfo, nullptr, device);
 	}
 
@@ -209,6 +246,18 @@ Image::Image(const VkImageCreateInfo *pCreateInfo, void *mem, Device *device)
 	{
 		supportedExternalMemoryHandleTypes = externalInfo->handleTypes;
 	}
+
+	// Images which can't be copied, stored to, or shared are only accessed by render passes
+	// and the sampler, which both address the quad layout, so it is not observable.
+	// Multisampled color images remain linear for the resolve fast path.
+	const VkImageUsageFlags quadUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+	                                    VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	const bool swapchainImage = GetExtendedStruct<VkImageSwapchainCreateInfoKHR>(pCreateInfo->pNext, VK_STRUCTURE_TYPE_IMAGE_SWAPCHAIN_CREATE_INFO_KHR) != nullptr;
+	quadLayout = (tiling == VK_IMAGE_TILING_OPTIMAL) && (imageType == VK_IMAGE_TYPE_2D) &&
+	             ((usage & ~quadUsage) == 0) && !(flags & VK_IMAGE_CREATE_ALIAS_BIT) &&
+	             !isCubeCompatible() && !externalInfo && !swapchainImage &&
+	             !format.isCompressed() && !format.isYcbcrFormat() &&
+	             ((samples == VK_SAMPLE_COUNT_1_BIT) || format.isDepth());
 }
 
 void Image::destroy(const VkAllocationCallbacks *pAllocator)
@@ -221,7 +270,7 @@ void Image::destroy(const VkAllocationCallbacks *pAllocator)
 
 size_t Image::ComputeRequiredAllocationSize(const VkImageCreateInfo *pCreateInfo)
 {
-	return Format(pCreateInfo->format).isCompressed() ? sizeof(Image) : 0;
+	return (Format(pCreateInfo->format).isCompressed() && !IsSampledDirectly(pCreateInfo)) ? sizeof(Image) : 0;
 }
 
 const VkMemoryRequirements Image::getMemoryRequirements() const
@@ -512,6 +561,9 @@ void Image::copySingleAspectTo(Image *dstImage, const VkImageCopy2KHR &region) c
 	const uint8_t *srcLayer = static_cast<const uint8_t *>(getTexelPointer(region.srcOffset, ImageSubresource(region.srcSubresource)));
 	uint8_t *dstLayer = static_cast<uint8_t *>(dstImage->getTexelPointer(region.dstOffset, ImageSubresource(region.dstSubresource)));
 
+	// Large copies are split into tasks running concurrently on the scheduler.
+	marl::WaitGroup copied;
+
 	for(uint32_t layer = 0; layer < layerCount; layer++)
 	{
 		if(isSingleRow)  // Copy one row
@@ -519,21 +571,21 @@ void Image::copySingleAspectTo(Image *dstImage, const VkImageCopy2KHR &region) c
 			size_t copySize = copyExtent.width * bytesPerBlock;
 			ASSERT((srcLayer + copySize) < end());
 			ASSERT((dstLayer + copySize) < dstImage->end());
-			memcpy(dstLayer, srcLayer, copySize);
+			sw::copyConcurrently(dstLayer, srcLayer, copySize, copied);
 		}
 		else if(isEntireRow && isSingleSlice)  // Copy one slice
 		{
 			size_t copySize = copyExtent.height * srcRowPitch;
 			ASSERT((srcLayer + copySize) < end());
 			ASSERT((dstLayer + copySize) < dstImage->end());
-			memcpy(dstLayer, srcLayer, copySize);
+			sw::copyConcurrently(dstLayer, srcLayer, copySize, copied);
 		}
 		else if(isEntireSlice)  // Copy multiple slices
 		{
 			size_t copySize = sliceCount * srcDepthPitch;
 			ASSERT((srcLayer + copySize) < end());
 			ASSERT((dstLayer + copySize) < dstImage->end());
-			memcpy(dstLayer, srcLayer, copySize);
+			sw::copyConcurrently(dstLayer, srcLayer, copySize, copied);
 		}
 		else if(isEntireRow)  // Copy slice by slice
 		{
@@ -546,7 +598,7 @@ void Image::copySingleAspectTo(Image *dstImage, const VkImageCopy2KHR &region) c
 				ASSERT((srcSlice + sliceSize) < end());
 				ASSERT((dstSlice + sliceSize) < dstImage->end());
 
-				memcpy(dstSlice, srcSlice, sliceSize);
+				sw::copyConcurrently(dstSlice, srcSlice, sliceSize, copied);
 
 				dstSlice += dstDepthPitch;
 				srcSlice += srcDepthPitch;
@@ -560,19 +612,10 @@ void Image::copySingleAspectTo(Image *dstImage, const VkImageCopy2KHR &region) c
 
 			for(uint32_t z = 0; z < sliceCount; z++)
 			{
-				const uint8_t *srcRow = srcSlice;
-				uint8_t *dstRow = dstSlice;
-
-				for(uint32_t y = 0; y < copyExtent.height; y++)
-				{
-					ASSERT((srcRow + rowSize) < end());
-					ASSERT((dstRow + rowSize) < dstImage->end());
+				ASSERT((srcSlice + (copyExtent.height - 1) * srcRowPitch + rowSize) < end());
+				ASSERT((dstSlice + (copyExtent.height - 1) * dstRowPitch + rowSize) < dstImage->end());
 
-					memcpy(dstRow, srcRow, rowSize);
-
-					srcRow += srcRowPitch;
-					dstRow += dstRowPitch;
-				}
+				sw::copyRowsConcurrently(dstSlice, dstRowPitch, srcSlice, srcRowPitch, rowSize, copyExtent.height, copied);
 
 				srcSlice += srcDepthPitch;
 				dstSlice += dstDepthPitch;
@@ -583,6 +626,8 @@ void Image::copySingleAspectTo(Image *dstImage, const VkImageCopy2KHR &region) c
 		dstLayer += dstLayerPitch;
 	}
 
+	copied.wait();
+
 	dstImage->contentsChanged(ImageSubresourceRange(region.dstSubresource));
 }
 
@@ -645,21 +690,17 @@ void Image::copy(const void *srcCopyMemory,
 	VkDeviceSize srcLayerSize = memoryIsSource ? memorySlicePitchBytes : imageLayerSize;
 	VkDeviceSize dstLayerSize = memoryIsSource ? imageLayerSize : memorySlicePitchBytes;
 
+	// Large copies are split into tasks running concurrently on the scheduler.
+	marl::WaitGroup copied;
+
 	for(uint32_t i = 0; i < imageSubresource.layerCount; i++)
 	{
 		const uint8_t *srcLayerMemory = srcMemory;
 		uint8_t *dstLayerMemory = dstMemory;
 		for(uint32_t z = 0; z < imageExtent.depth; z++)
 		{
-			const uint8_t *srcSliceMemory = srcLayerMemory;
-			uint8_t *dstSliceMemory = dstLayerMemory;
-			for(uint32_t y = 0; y < imageExtent.height; y++)
-			{
-				ASSERT(((memoryIsSource ? dstSliceMemory : srcSliceMemory) + copySize) < end());
-				memcpy(dstSliceMemory, srcSliceMemory, copySize);
-				srcSliceMemory += srcRowPitchBytes;
-				dstSliceMemory += dstRowPitchBytes;
-			}
+			ASSERT(((memoryIsSource ? dstLayerMemory : srcLayerMemory) + (imageExtent.height - 1) * imageRowPitchBytes + copySize) < end());
+			sw::copyRowsConcurrently(dstLayerMemory, dstRowPitchBytes, srcLayerMemory, srcRowPitchBytes, copySize, imageExtent.height, copied);
 			srcLayerMemory += srcSlicePitchBytes;
 			dstLayerMemory += dstSlicePitchBytes;
 		}
@@ -668,9 +709,23 @@ void Image::copy(const void *srcCopyMemory,
 		dstMemory += dstLayerSize;
 	}
 
+	copied.wait();
+
 	if(memoryIsSource)
 	{
-		contentsChanged(ImageSubresourceRange(imageSubresource));
+		// Only the copied region needs to be decompressed again.
+		DirtyRegion region = {
+			imageCopyOffset,
+			{ imageCopyOffset.x + static_cast<int32_t>(imageCopyExtent.width),
+			  imageCopyOffset.y + static_cast<int32_t>(imageCopyExtent.height),
+			  imageCopyOffset.z + static_cast<int32_t>(imageCopyExtent.depth) }
+		};
+
+		VkImageSubresource subresource = ImageSubresource(imageSubresource);
+		for(uint32_t i = 0; i < imageSubresource.layerCount; i++, subresource.arrayLayer++)
+		{
+			contentsChanged(subresource, region);
+		}
 	}
 }
 
@@ -780,6 +835,18 @@ VkDeviceSize Image::texelOffsetBytesInStorage(const VkOffset3D &offset, const Vk
 {
 	VkImageAspectFlagBits aspect = static_cast<VkImageAspectFlagBits>(subresource.aspectMask);
 	VkOffset3D adjustedOffset = imageOffsetInBlocks(offset, aspect);
+
+	if(hasQuadLayout(aspect))
+	{
+		// Pairs of rows are interleaved per 2x2 quad. The pitches are unchanged since
+		// the width and height are already aligned to quads.
+		int x = adjustedOffset.x;
+		int y = adjustedOffset.y;
+		return adjustedOffset.z * slicePitchBytes(aspect, subresource.mipLevel) +
+		       (y & ~1) * rowPitchBytes(aspect, subresource.mipLevel) +
+		       ((x & ~1) * 2 + (y & 1) * 2 + (x & 1)) * getFormat(aspect).bytesPerBlock();
+	}
+
 	int border = borderSize();
 	return adjustedOffset.z * slicePitchBytes(aspect, subresource.mipLevel) +
 	       (adjustedOffset.y + border) * rowPitchBytes(aspect, subresource.mipLevel) +
@@ -1155,6 +1222,8 @@ void Image::contentsChanged(const VkImageSubresourceRange &subresourceRange, Con
 		subresourceRange.baseArrayLayer
 	};
 
+	const DirtyRegion entireSubresource = { { 0, 0, 0 }, { INT_MAX, INT_MAX, INT_MAX } };
+
 	marl::lock lock(mutex);
 	for(subresource.arrayLayer = subresourceRange.baseArrayLayer;
 	    subresource.arrayLayer <= lastLayer;
@@ -1164,9 +1233,42 @@ void Image::contentsChanged(const VkImageSubresourceRange &subresourceRange, Con
 		    subresource.mipLevel <= lastMipLevel;
 		    subresource.mipLevel++)
 		{
-			dirtySubresources.insert(subresource);
+			auto inserted = dirtySubresources.emplace(subresource, entireSubresource);
+			if(!inserted.second)
+			{
+				inserted.first->second = entireSubresource;
+			}
 		}
 	}
+
+	device->imageContentsChanged();
+}
+
+void Image::contentsChanged(const VkImageSubresource &subresource, const DirtyRegion &region)
+{
+	if(!requiresPreprocessing())
+	{
+		return;
+	}
+
+	marl::lock lock(mutex);
+	auto inserted = dirtySubresources.emplace(subresource, region);
+	if(!inserted.second)
+	{
+		inserted.first->second.merge(region);
+	}
+
+	device->imageContentsChanged();
+}
+
+void Image::DirtyRegion::merge(const DirtyRegion &other)
+{
+	begin.x = std::min(begin.x, other.begin.x);
+	begin.y = std::min(begin.y, other.begin.y);
+	begin.z = std::min(begin.z, other.begin.z);
+	end.x = std::max(end.x, other.end.x);
+	end.y = std::max(end.y, other.end.y);
+	end.z = std::max(end.z, other.end.z);
 }
 
 void Image::prepareForSampling(const VkImageSubresourceRange &subresourceRange) const
@@ -1186,81 +1288,156 @@ void Image::prepareForSampling(const VkImageSubresourceRange &subresourceRange)
 		subresourceRange.baseArrayLayer
 	};
 
-	marl::lock lock(mutex);
+	// Dirty subresources prepared by this thread, ordered by mip level and layer. They're
+	// marked clean as soon as they're claimed, so that changes made while they're being
+	// prepared leave them dirty again, instead of getting lost.
+	std::vector<VkImageSubresource> claimed;
+	marl::WaitGroup decompressed;
+	std::shared_ptr<marl::Event> priorPreparation;
+	std::shared_ptr<marl::Event> preparation;
 
-	if(dirtySubresources.empty())
+	// First, claim the relevant dirty subresources, and start decompressing them
 	{
-		return;
-	}
+		marl::lock lock(mutex);
 
-	// First, decompress all relevant dirty subregions
-	if(decompressedImage)
-	{
-		for(subresource.mipLevel = subresourceRange.baseMipLevel;
-		    subresource.mipLevel <= lastMipLevel;
-		    subresource.mipLevel++)
+		priorPreparation = preparing;
+
+		if(!dirtySubresources.empty())
 		{
-			for(subresource.arrayLayer = subresourceRange.baseArrayLayer;
-			    subresource.arrayLayer <= lastLayer;
-			    subresource.arrayLayer++)
+			for(subresource.mipLevel = subresourceRange.baseMipLevel;
+			    subresource.mipLevel <= lastMipLevel;
+			    subresource.mipLevel++)
 			{
-				auto it = dirtySubresources.find(subresource);
-				if(it != dirtySubresources.end())
+				for(subresource.arrayLayer = subresourceRange.baseArrayLayer;
+				    subresource.arrayLayer <= lastLayer;
+				    subresource.arrayLayer++)
 				{
-					decompress(subresource);
+					auto it = dirtySubresources.find(subresource);
+					if(it != dirtySubresources.end())
+					{
+						if(decompressedImage)
+						{
+							decompress(subresource, it->second, decompressed);
+						}
+
+						claimed.push_back(subresource);
+						dirtySubresources.erase(it);
+					}
 				}
 			}
 		}
+
+		if(!claimed.empty())
+		{
+			preparation = std::make_shared<marl::Event>(marl::Event::Mode::Manual);
+			preparing = preparation;
+		}
 	}
 
-	// Second, update cubemap borders
-	if(isCubeCompatible())
+	// Subresources claimed by other threads may still be getting prepared.
+	if(claimed.empty())
 	{
-		for(subresource.mipLevel = subresourceRange.baseMipLevel;
-		    subresource.mipLevel <= lastMipLevel;
-		    subresource.mipLevel++)
+		if(priorPreparation)
 		{
-			for(subresource.arrayLayer = subresourceRange.baseArrayLayer;
-			    subresource.arrayLayer <= lastLayer;
-			    subresource.arrayLayer++)
-			{
-				auto it = dirtySubresources.find(subresource);
-				if(it != dirtySubresources.end())
-				{
-					// Since cube faces affect each other's borders, we update all 6 layers.
+			priorPreparation->wait();
+		}
+		return;
+	}
 
-					subresource.arrayLayer -= subresource.arrayLayer % 6;  // Round down to a multiple of 6.
+	// Decompression proceeds without holding the lock, so that other threads can mark
+	// or prepare other subresources meanwhile. Cube borders are read from all faces,
+	// which may have been claimed by the prior preparation. It waits for the ones
+	// before it in turn, so this preparation completes after all of them.
+	decompressed.wait();
+	if(priorPreparation)
+	{
+		priorPreparation->wait();
+	}
 
-					if(subresource.arrayLayer + 5 <= lastLayer)
-					{
-						device->getBlitter()->updateBorders(decompressedImage ? decompressedImage : this, subresource);
-					}
+	// Finally, update cubemap borders
+	if(isCubeCompatible())
+	{
+		marl::lock lock(mutex);
 
-					subresource.arrayLayer += 5;  // Together with the loop increment, advances to the next cube.
-				}
+		bool updated = false;
+		VkImageSubresource lastCube = {};
+		for(VkImageSubresource cube : claimed)
+		{
+			// Since cube faces affect each other's borders, we update all 6 layers.
+			cube.arrayLayer -= cube.arrayLayer % 6;  // Round down to a multiple of 6.
+
+			if(updated && (cube.mipLevel == lastCube.mipLevel) && (cube.arrayLayer == lastCube.arrayLayer))
+			{
+				continue;  // Faces of the same cube are claimed consecutively.
 			}
+
+			if(cube.arrayLayer + 5 <= lastLayer)
+			{
+				device->getBlitter()->updateBorders(decompressedImage ? decompressedImage : this, cube);
+			}
+
+			updated = true;
+			lastCube = cube;
 		}
 	}
 
-	// Finally, mark all updated subregions clean
-	for(subresource.mipLevel = subresourceRange.baseMipLevel;
-	    subresource.mipLevel <= lastMipLevel;
-	    subresource.mipLevel++)
+	preparation->signal();
+}
+
+void Image::decompress(const VkImageSubresource &subresource, const DirtyRegion &region, marl::WaitGroup &decompressed) const
+{
+	// Number of texels decoded by each task, to spread large regions over the worker threads.
+	constexpr int taskTexelCount = 64 * 1024;
+
+	VkExtent3D mipLevelExtent = getMipLevelExtent(static_cast<VkImageAspectFlagBits>(subresource.aspectMask), subresource.mipLevel);
+	int blockWidth = format.blockWidth();
+	int blockHeight = format.blockHeight();
+
+	// Expand the region to whole blocks, within the subresource.
+	int x0 = std::max(region.begin.x, 0);
+	int y0 = std::max(region.begin.y, 0);
+	int z0 = std::max(region.begin.z, 0);
+	int x1 = std::min(region.end.x, static_cast<int>(mipLevelExtent.width));
+	int y1 = std::min(region.end.y, static_cast<int>(mipLevelExtent.height));
+	int z1 = std::min(region.end.z, static_cast<int>(mipLevelExtent.depth));
+	x0 -= x0 % blockWidth;
+	y0 -= y0 % blockHeight;
+	x1 = std::min(sw::align(x1, blockWidth), static_cast<int>(mipLevelExtent.width));
+	y1 = std::min(sw::align(y1, blockHeight), static_cast<int>(mipLevelExtent.height));
+
+	if(x0 >= x1 || y0 >= y1 || z0 >= z1)
 	{
-		for(subresource.arrayLayer = subresourceRange.baseArrayLayer;
-		    subresource.arrayLayer <= lastLayer;
-		    subresource.arrayLayer++)
+		return;
+	}
+
+	// Split the region into bands of block rows, decoded concurrently.
+	int bandHeight = sw::align(std::max(taskTexelCount / (x1 - x0), 1), blockHeight);
+	bool singleBand = (bandHeight >= y1 - y0) && (z1 - z0 == 1);
+
+	for(int z = z0; z < z1; z++)
+	{
+		for(int y = y0; y < y1; y += bandHeight)
 		{
-			auto it = dirtySubresources.find(subresource);
-			if(it != dirtySubresources.end())
+			VkOffset3D offset = { x0, y, z };
+			VkExtent3D extent = { static_cast<uint32_t>(x1 - x0), static_cast<uint32_t>(std::min(bandHeight, y1 - y)), 1 };
+
+			if(singleBand || !marl::Scheduler::get())
+			{
+				decompress(subresource, offset, extent);
+			}
+			else
 			{
-				dirtySubresources.erase(it);
+				decompressed.add(1);
+				marl::schedule([this, subresource, offset, extent, decompressed] {
+					decompress(subresource, offset, extent);
+					decompressed.done();
+				});
 			}
 		}
 	}
 }
 
-void Image::decompress(const VkImageSubresource &subresource) const
+void Image::decompress(const VkImageSubresource &subresource, const VkOffset3D &offset, const VkExtent3D &extent) const
 {
 	switch(format)
 	{
@@ -1274,7 +1451,7 @@ void Image::decompress(const VkImageSubresource &subresource) const
 	case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
 	case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
 	case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
-		decodeETC2(subresource);
+		decodeETC2(subresource, offset, extent);
 		break;
 	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
 	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
@@ -1292,7 +1469,7 @@ void Image::decompress(const VkImageSubresource &subresource) const
 	case VK_FORMAT_BC6H_SFLOAT_BLOCK:
 	case VK_FORMAT_BC7_UNORM_BLOCK:
 	case VK_FORMAT_BC7_SRGB_BLOCK:
-		decodeBC(subresource);
+		decodeBC(subresource, offset, extent);
 		break;
 	case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
 	case VK_FORMAT_ASTC_5x4_UNORM_BLOCK:
@@ -1322,7 +1499,7 @@ void Image::decompress(const VkImageSubresource &subresource) const
 	case VK_FORMAT_ASTC_10x10_SRGB_BLOCK:
 	case VK_FORMAT_ASTC_12x10_SRGB_BLOCK:
 	case VK_FORMAT_ASTC_12x12_SRGB_BLOCK:
-		decodeASTC(subresource);
+		decodeASTC(subresource, offset, extent);
 		break;
 	default:
 		UNSUPPORTED("Compressed format %d", (VkFormat)format);
@@ -1330,7 +1507,7 @@ void Image::decompress(const VkImageSubresource &subresource) const
 	}
 }
 
-void Image::decodeETC2(const VkImageSubresource &subresource) const
+void Image::decodeETC2(const VkImageSubresource &subresource, const VkOffset3D &offset, const VkExtent3D &extent) const
 {
 	ASSERT(decompressedImage);
 
@@ -1338,37 +1515,34 @@ void Image::decodeETC2(const VkImageSubresource &subresource) const
 
 	int bytes = decompressedImage->format.bytes();
 	bool fakeAlpha = (format == VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK) || (format == VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK);
-	size_t sizeToWrite = 0;
-
-	VkExtent3D mipLevelExtent = getMipLevelExtent(static_cast<VkImageAspectFlagBits>(subresource.aspectMask), subresource.mipLevel);
+	int blockHeight = format.blockHeight();
 
 	int pitchB = decompressedImage->rowPitchBytes(VK_IMAGE_ASPECT_COLOR_BIT, subresource.mipLevel);
 
-	if(fakeAlpha)
+	// Decode one row of blocks at a time, since the rows of a partial-width region aren't contiguous.
+	for(int32_t depth = offset.z; depth < offset.z + static_cast<int32_t>(extent.depth); depth++)
 	{
-		// To avoid overflow in case of cube textures, which are offset in memory to account for the border,
-		// compute the size from the first pixel to the last pixel, excluding any padding or border before
-		// the first pixel or after the last pixel.
-		sizeToWrite = ((mipLevelExtent.height - 1) * pitchB) + (mipLevelExtent.width * bytes);
-	}
+		for(int32_t y = offset.y; y < offset.y + static_cast<int32_t>(extent.height); y += blockHeight)
+		{
+			int height = std::min(blockHeight, offset.y + static_cast<int32_t>(extent.height) - y);
+			uint8_t *source = static_cast<uint8_t *>(getTexelPointer({ offset.x, y, depth }, subresource));
+			uint8_t *dest = static_cast<uint8_t *>(decompressedImage->getTexelPointer({ offset.x, y, depth }, subresource));
 
-	for(int32_t depth = 0; depth < static_cast<int32_t>(mipLevelExtent.depth); depth++)
-	{
-		uint8_t *source = static_cast<uint8_t *>(getTexelPointer({ 0, 0, depth }, subresource));
-		uint8_t *dest = static_cast<uint8_t *>(decompressedImage->getTexelPointer({ 0, 0, depth }, subresource));
+			if(fakeAlpha)
+			{
+				for(int row = 0; row < height; row++)
+				{
+					ASSERT((dest + row * pitchB + extent.width * bytes) < decompressedImage->end());
+					memset(dest + row * pitchB, 0xFF, extent.width * bytes);
+				}
+			}
 
-		if(fakeAlpha)
-		{
-			ASSERT((dest + sizeToWrite) < decompressedImage->end());
-			memset(dest, 0xFF, sizeToWrite);
+			ETC_Decoder::Decode(source, dest, extent.width, height, pitchB, bytes, inputType);
 		}
-
-		ETC_Decoder::Decode(source, dest, mipLevelExtent.width, mipLevelExtent.height,
-		                    pitchB, bytes, inputType);
 	}
 }
 
-void Image::decodeBC(const VkImageSubresource &subresource) const
+void Image::decodeBC(const VkImageSubresource &subresource, const VkOffset3D &offset, const VkExtent3D &extent) const
 {
 	ASSERT(decompressedImage);
 
@@ -1376,22 +1550,25 @@ void Image::decodeBC(const VkImageSubresource &subresource) const
 	int noAlphaU = GetNoAlphaOrUnsigned(format);
 
 	int bytes = decompressedImage->format.bytes();
-
-	VkExtent3D mipLevelExtent = getMipLevelExtent(static_cast<VkImageAspectFlagBits>(subresource.aspectMask), subresource.mipLevel);
+	int blockHeight = format.blockHeight();
 
 	int pitchB = decompressedImage->rowPitchBytes(VK_IMAGE_ASPECT_COLOR_BIT, subresource.mipLevel);
 
-	for(int32_t depth = 0; depth < static_cast<int32_t>(mipLevelExtent.depth); depth++)
+	// Decode one row of blocks at a time, since the rows of a partial-width region aren't contiguous.
+	for(int32_t depth = offset.z; depth < offset.z + static_cast<int32_t>(extent.depth); depth++)
 	{
-		uint8_t *source = static_cast<uint8_t *>(getTexelPointer({ 0, 0, depth }, subresource));
-		uint8_t *dest = static_cast<uint8_t *>(decompressedImage->getTexelPointer({ 0, 0, depth }, subresource));
+		for(int32_t y = offset.y; y < offset.y + static_cast<int32_t>(extent.height); y += blockHeight)
+		{
+			int height = std::min(blockHeight, offset.y + static_cast<int32_t>(extent.height) - y);
+			uint8_t *source = static_cast<uint8_t *>(getTexelPointer({ offset.x, y, depth }, subresource));
+			uint8_t *dest = static_cast<uint8_t *>(decompressedImage->getTexelPointer({ offset.x, y, depth }, subresource));
 
-		BC_Decoder::Decode(source, dest, mipLevelExtent.width, mipLevelExtent.height,
-		                   pitchB, bytes, n, noAlphaU);
+			BC_Decoder::Decode(source, dest, extent.width, height, pitchB, bytes, n, noAlphaU);
+		}
 	}
 }
 
-void Image::decodeASTC(const VkImageSubresource &subresource) const
+void Image::decodeASTC(const VkImageSubresource &subresource, const VkOffset3D &offset, const VkExtent3D &extent) const
 {
 	ASSERT(decompressedImage);
 
@@ -1402,13 +1579,14 @@ void Image::decodeASTC(const VkImageSubresource &subresource) const
 
 	int bytes = decompressedImage->format.bytes();
 
+	// The decoder's setup is costly, so entire rows of blocks are decoded at once.
 	VkExtent3D mipLevelExtent = getMipLevelExtent(static_cast<VkImageAspectFlagBits>(subresource.aspectMask), subresource.mipLevel);
 
 	int xblocks = (mipLevelExtent.width + xBlockSize - 1) / xBlockSize;
-	int yblocks = (mipLevelExtent.height + yBlockSize - 1) / yBlockSize;
-	int zblocks = (zBlockSize > 1) ? (mipLevelExtent.depth + zBlockSize - 1) / zBlockSize : 1;
+	int yblocks = (extent.height + yBlockSize - 1) / yBlockSize;
+	int zblocks = 1;
 
-	if(xblocks <= 0 || yblocks <= 0 || zblocks <= 0)
+	if(xblocks <= 0 || yblocks <= 0)
 	{
 		return;
 	}
@@ -1416,12 +1594,12 @@ void Image::decodeASTC(const VkImageSubresource &subresource) const
 	int pitchB = decompressedImage->rowPitchBytes(VK_IMAGE_ASPECT_COLOR_BIT, subresource.mipLevel);
 	int sliceB = decompressedImage->slicePitchBytes(VK_IMAGE_ASPECT_COLOR_BIT, subresource.mipLevel);
 
-	for(int32_t depth = 0; depth < static_cast<int32_t>(mipLevelExtent.depth); depth++)
+	for(int32_t depth = offset.z; depth < offset.z + static_cast<int32_t>(extent.depth); depth++)
 	{
-		uint8_t *source = static_cast<uint8_t *>(getTexelPointer({ 0, 0, depth }, subresource));
-		uint8_t *dest = static_cast<uint8_t *>(decompressedImage->getTexelPointer({ 0, 0, depth }, subresource));
+		uint8_t *source = static_cast<uint8_t *>(getTexelPointer({ 0, offset.y, depth }, subresource));
+		uint8_t *dest = static_cast<uint8_t *>(decompressedImage->getTexelPointer({ 0, offset.y, depth }, subresource));
 
-		ASTC_Decoder::Decode(source, dest, mipLevelExtent.width, mipLevelExtent.height, mipLevelExtent.depth, bytes, pitchB, sliceB,
+		ASTC_Decoder::Decode(source, dest, mipLevelExtent.width, extent.height, 1, bytes, pitchB, sliceB,
 		                     xBlockSize, yBlockSize, zBlockSize, xblocks, yblocks, zblocks, isUnsigned);
 	}
 }
@@ -18,13 +18,16 @@
 #include "VkFormat.hpp"
 #include "VkObject.hpp"
 
+#include "marl/event.h"
 #include "marl/mutex.h"
+#include "marl/waitgroup.h"
 
 #ifdef __ANDROID__
 #	include <vulkan/vk_android_native_buffer.h>  // For VkSwapchainImageUsageFlagsANDROID and buffer_handle_t
 #endif
 
-#include <unordered_set>
+#include <memory>
+#include <unordered_map>
 
 namespace vk {
 
@@ -96,11 +99,18 @@ public:
 	void *getTexelPointer(const VkOffset3D &offset, const VkImageSubresource &subresource) const;
 	bool isCubeCompatible() const;
 	bool is3DSlice() const;
+	// The color and depth aspects of images used only as attachments or sampled images store
+	// each 2x2 quad of texels contiguously, so that the pixel pipeline can access a quad with
+	// a single load.
+	bool hasQuadLayout(VkImageAspectFlagBits aspect) const { return quadLayout && ((aspect == VK_IMAGE_ASPECT_COLOR_BIT) || (aspect == VK_IMAGE_ASPECT_DEPTH_BIT)); }
 	uint8_t *end() const;
 	VkDeviceSize getLayerSize(VkImageAspectFlagBits aspect) const;
 	VkDeviceSize getMipLevelSize(VkImageAspectFlagBits aspect, uint32_t mipLevel) const;
 	bool canBindToMemory(DeviceMemory *pDeviceMemory) const;
 
+	// Cube images need their borders updated, and compressed images decompressed,
+	// after their contents change and before they are sampled.
+	bool requiresPreprocessing() const;
 	void prepareForSampling(const VkImageSubresourceRange &subresourceRange) const;
 	enum ContentsChangedContext
 	{
@@ -114,6 +124,9 @@ public:
 	void setBackingMemory(BackingMemory &bm)
 	{
 		backingMemory = bm;
+
+		// Native buffers are read by the compositor, which expects linear rows.
+		quadLayout = quadLayout && !bm.externalMemory;
 	}
 	bool hasExternalMemory() const { return backingMemory.externalMemory; }
 	VkDeviceMemory getExternalMemory() const;
@@ -144,11 +157,21 @@ private:
 	void clear(const void *pixelData, VkFormat pixelFormat, const vk::Format &viewFormat, const VkImageSubresourceRange &subresourceRange, const VkRect2D *renderArea);
 	int borderSize() const;
 
-	bool requiresPreprocessing() const;
-	void decompress(const VkImageSubresource &subresource) const;
-	void decodeETC2(const VkImageSubresource &subresource) const;
-	void decodeBC(const VkImageSubresource &subresource) const;
-	void decodeASTC(const VkImageSubresource &subresource) const;
+	// Texels of a subresource which changed since it was last prepared for sampling.
+	struct DirtyRegion
+	{
+		VkOffset3D begin;
+		VkOffset3D end;  // Exclusive. Clamped to the subresource's extent when used.
+
+		void merge(const DirtyRegion &other);
+	};
+
+	void contentsChanged(const VkImageSubresource &subresource, const DirtyRegion &region);
+	void decompress(const VkImageSubresource &subresource, const DirtyRegion &region, marl::WaitGroup &decompressed) const;
+	void decompress(const VkImageSubresource &subresource, const VkOffset3D &offset, const VkExtent3D &extent) const;
+	void decodeETC2(const VkImageSubresource &subresource, const VkOffset3D &offset, const VkExtent3D &extent) const;
+	void decodeBC(const VkImageSubresource &subresource, const VkOffset3D &offset, const VkExtent3D &extent) const;
+	void decodeASTC(const VkImageSubresource &subresource, const VkOffset3D &offset, const VkExtent3D &extent) const;
 
 	const Device *const device = nullptr;
 	VkDeviceSize memoryOffset = 0;
@@ -161,6 +184,7 @@ private:
 	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
 	VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL;
 	VkImageUsageFlags usage = (VkImageUsageFlags)0;
+	bool quadLayout = false;
 	Image *decompressedImage = nullptr;
 #ifdef __ANDROID__
 	BackingMemory backingMemory = {};
@@ -168,7 +192,7 @@ private:
 
 	VkExternalMemoryHandleTypeFlags supportedExternalMemoryHandleTypes = (VkExternalMemoryHandleTypeFlags)0;
 
-	// VkImageSubresource wrapper for use in unordered_set
+	// VkImageSubresource wrapper for use in unordered_map
 	class Subresource
 	{
 	public:
@@ -199,7 +223,8 @@ private:
 	};
 
 	mutable marl::mutex mutex;
-	mutable std::unordered_set<Subresource, Subresource> dirtySubresources GUARDED_BY(mutex);
+	mutable std::unordered_map<Subresource, DirtyRegion, Subresource> dirtySubresources GUARDED_BY(mutex);
+	mutable std::shared_ptr<marl::Event> preparing GUARDED_BY(mutex);  // Signalled once the last started preparation for sampling completes
 };
 
 static inline Image *Cast(VkImage object)
@@ -91,13 +91,14 @@ Identifier::Identifier(const VkImageViewCreateInfo *pCreateInfo)
 	vk::Format samplingFormat = (image == sampledImage) ? viewFormat : sampledImage->getFormat().getAspectFormat(subresource.aspectMask);
 	pack({ pCreateInfo->viewType, samplingFormat, ResolveComponentMapping(pCreateInfo->components, viewFormat),
 	       static_cast<uint8_t>(subresource.baseMipLevel),
-	       static_cast<uint8_t>(subresource.baseMipLevel + subresource.levelCount), subresource.levelCount <= 1u });
+	       static_cast<uint8_t>(subresource.baseMipLevel + subresource.levelCount), subresource.levelCount <= 1u,
+	       sampledImage->hasQuadLayout(static_cast<VkImageAspectFlagBits>(subresource.aspectMask)) });
 }
 
 Identifier::Identifier(VkFormat bufferFormat)
 {
 	constexpr VkComponentMapping identityMapping = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
-	pack({ VK_IMAGE_VIEW_TYPE_1D, bufferFormat, ResolveComponentMapping(identityMapping, bufferFormat), 0, 1, true });
+	pack({ VK_IMAGE_VIEW_TYPE_1D, bufferFormat, ResolveComponentMapping(identityMapping, bufferFormat), 0, 1, true, false });
 }
 
 void Identifier::pack(const State &state)
@@ -110,7 +111,8 @@ void Identifier::pack(const State &state)
 	a = static_cast<uint32_t>(state.mapping.a);
 	minLod = state.minLod;
 	maxLod = state.maxLod;
-	singleMipLevel = state.singleMipLevel;
+	ASSERT(state.singleMipLevel == (state.maxLod - state.minLod <= 1));
+	quadLayout = state.quadLayout;
 }
 
 Identifier::State Identifier::getState() const
@@ -123,7 +125,8 @@ Identifier::State Identifier::getState() const
 		       static_cast<VkComponentSwizzle>(a) },
 		     static_cast<uint8_t>(minLod),
 		     static_cast<uint8_t>(maxLod),
-		     static_cast<bool>(singleMipLevel) };
+		     (maxLod - minLod) <= 1,
+		     static_cast<bool>(quadLayout) };
 }
 
 ImageView::ImageView(const VkImageViewCreateInfo *pCreateInfo, void *mem, const vk::SamplerYcbcrConversion *ycbcrConversion)
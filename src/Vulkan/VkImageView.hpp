@@ -56,6 +56,7 @@ union Identifier
 		uint8_t minLod;
 		uint8_t maxLod;
 		bool singleMipLevel;
+		bool quadLayout;
 	};
 	State getState() const;
 
@@ -74,7 +75,7 @@ private:
 		uint32_t a : 3;
 		uint32_t minLod : 4;
 		uint32_t maxLod : 4;
-		uint32_t singleMipLevel : 1;
+		uint32_t quadLayout : 1;  // singleMipLevel is derived from minLod and maxLod
 	};
 
 	uint32_t id = 0;
@@ -128,6 +129,7 @@ public:
 	void *getOffsetPointer(const VkOffset3D &offset, VkImageAspectFlagBits aspect, uint32_t mipLevel, uint32_t layer, Usage usage = RAW) const;
 	bool hasDepthAspect() const { return (subresourceRange.aspectMask & VK_IMAGE_ASPECT_DEPTH_BIT) != 0; }
 	bool hasStencilAspect() const { return (subresourceRange.aspectMask & VK_IMAGE_ASPECT_STENCIL_BIT) != 0; }
+	bool hasQuadLayout(VkImageAspectFlagBits aspect) const { return image->hasQuadLayout(aspect); }
 
 	void contentsChanged(Image::ContentsChangedContext context) { image->contentsChanged(subresourceRange, context); }
 
@@ -136,6 +138,7 @@ public:
 	const VkComponentMapping &getComponentMapping() const { return components; }
 	const VkImageSubresourceRange &getSubresourceRange() const { return subresourceRange; }
 	size_t getSizeInBytes() const { return image->getSizeInBytes(subresourceRange); }
+	const Image *getImage() const { return image; }
 
 private:
 	bool imageTypesMatch(VkImageType imageType) const;
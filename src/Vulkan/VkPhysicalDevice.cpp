@@ -2527,28 +2527,52 @@ void PhysicalDevice::getImageFormatProperties(Format format, VkImageType type, V
 
 uint32_t PhysicalDevice::getQueueFamilyPropertyCount() const
 {
-	return 1;
+	return QUEUE_FAMILY_COUNT;
 }
 
-VkQueueFamilyProperties PhysicalDevice::getQueueFamilyProperties() const
+VkQueueFamilyProperties PhysicalDevice::getQueueFamilyProperties(uint32_t queueFamilyIndex) const
 {
 	VkQueueFamilyProperties properties = {};
 	properties.minImageTransferGranularity.width = 1;
 	properties.minImageTransferGranularity.height = 1;
 	properties.minImageTransferGranularity.depth = 1;
-	properties.queueCount = 1;
-	properties.queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+	properties.queueCount = QUEUE_COUNT_PER_FAMILY;
 	properties.timestampValidBits = 64;
 
+	switch(queueFamilyIndex)
+	{
+	case 0:
+		properties.queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+		break;
+	case 1:
+		properties.queueFlags = VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+		break;
+	case 2:
+		properties.queueFlags = VK_QUEUE_TRANSFER_BIT;
+		break;
+	default:
+		UNREACHABLE("queueFamilyIndex: %d", int(queueFamilyIndex));
+		break;
+	}
+
 	return properties;
 }
 
+bool PhysicalDevice::supportsPresentation(uint32_t queueFamilyIndex) const
+{
+	// Presentation is only advertised for families which can render or compute
+	// the presented images, so applications don't pick the transfer-only family.
+	VkQueueFlags flags = getQueueFamilyProperties(queueFamilyIndex).queueFlags;
+
+	return (flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) != 0;
+}
+
 void PhysicalDevice::getQueueFamilyProperties(uint32_t pQueueFamilyPropertyCount,
                                               VkQueueFamilyProperties *pQueueFamilyProperties) const
 {
 	for(uint32_t i = 0; i < pQueueFamilyPropertyCount; i++)
 	{
-		pQueueFamilyProperties[i] = getQueueFamilyProperties();
+		pQueueFamilyProperties[i] = getQueueFamilyProperties(i);
 	}
 }
 
@@ -2579,7 +2603,7 @@ void PhysicalDevice::getQueueFamilyProperties(uint32_t pQueueFamilyPropertyCount
 {
 	for(uint32_t i = 0; i < pQueueFamilyPropertyCount; i++)
 	{
-		pQueueFamilyProperties[i].queueFamilyProperties = getQueueFamilyProperties();
+		pQueueFamilyProperties[i].queueFamilyProperties = getQueueFamilyProperties(i);
 
 		VkBaseOutStructure *extInfo = reinterpret_cast<VkBaseOutStructure *>(pQueueFamilyProperties[i].pNext);
 		while(extInfo)
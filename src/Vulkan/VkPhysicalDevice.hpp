@@ -118,6 +118,7 @@ public:
 	                              VkQueueFamilyProperties *pQueueFamilyProperties) const;
 	void getQueueFamilyProperties(uint32_t pQueueFamilyPropertyCount,
 	                              VkQueueFamilyProperties2 *pQueueFamilyProperties) const;
+	bool supportsPresentation(uint32_t queueFamilyIndex) const;
 	void getQueueFamilyGlobalPriorityProperties(VkQueueFamilyGlobalPriorityPropertiesKHR *pQueueFamilyGlobalPriorityProperties) const;
 	bool validateQueueGlobalPriority(VkQueueGlobalPriorityKHR queueGlobalPriority) const;
 	VkQueueGlobalPriorityKHR getDefaultQueueGlobalPriority() const;
@@ -127,7 +128,7 @@ public:
 
 private:
 	static VkSampleCountFlags getSampleCounts();
-	VkQueueFamilyProperties getQueueFamilyProperties() const;
+	VkQueueFamilyProperties getQueueFamilyProperties(uint32_t queueFamilyIndex) const;
 
 	template<typename T>
 	T getSupportedFeatures(const T *requested) const;
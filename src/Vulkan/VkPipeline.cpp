@@ -21,8 +21,10 @@
 #include "VkRenderPass.hpp"
 #include "VkShaderModule.hpp"
 #include "VkStringify.hpp"
+#include "Device/Renderer.hpp"
 #include "Pipeline/ComputeProgram.hpp"
 #include "Pipeline/SpirvShader.hpp"
+#include "System/SwiftConfig.hpp"
 
 #include "marl/trace.h"
 
@@ -119,6 +121,7 @@ std::shared_ptr<sw::ComputeProgram> createProgram(vk::Device *device, std::share
 	vk::DescriptorSet::Bindings descriptorSets;  // TODO(b/129523279): Delay code generation until dispatch time.
 	// TODO(b/119409619): use allocator.
 	auto program = std::make_shared<sw::ComputeProgram>(device, shader, layout, descriptorSets);
+	rr::ScopedPragma optimizationPasses(rr::OptimizationPasses, static_cast<int>(sw::getConfiguration().computeOptimization));
 	program->generate();
 	program->finalize("ComputeProgram");
 
@@ -408,6 +411,7 @@ void GraphicsPipeline::destroyPipeline(const VkAllocationCallbacks *pAllocator)
 {
 	vertexShader.reset();
 	fragmentShader.reset();
+	precompiledRoutines.reset();
 }
 
 size_t GraphicsPipeline::ComputeRequiredAllocationSize(const VkGraphicsPipelineCreateInfo *pCreateInfo)
@@ -471,6 +475,12 @@ bool GraphicsPipeline::fragmentContainsImageWrite() const
 	return fragmentShader.get() && fragmentShader->containsImageWrite();
 }
 
+bool GraphicsPipeline::containsBufferWrite() const
+{
+	return (vertexShader.get() && vertexShader->containsBufferWrite()) ||
+	       (fragmentShader.get() && fragmentShader->containsBufferWrite());
+}
+
 void GraphicsPipeline::setShader(const VkShaderStageFlagBits &stage, const std::shared_ptr<sw::SpirvShader> spirvShader)
 {
 	switch(stage)
@@ -601,9 +611,104 @@ VkResult GraphicsPipeline::compileShaders(const VkAllocationCallbacks *pAllocato
 		}
 	}
 
+	precompileRoutines(pCreateInfo);
+
 	return VK_SUCCESS;
 }
 
+void GraphicsPipeline::precompileRoutines(const VkGraphicsPipelineCreateInfo *pCreateInfo)
+{
+	// Libraries aren't drawn with, and linked pipelines may have dynamic state from their libraries.
+	if((pCreateInfo->flags & (VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT_EXT)) ||
+	   GetExtendedStruct<VkPipelineLibraryCreateInfoKHR>(pCreateInfo->pNext, VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR))
+	{
+		return;
+	}
+
+	if(!state.hasVertexInputInterfaceState() || !state.hasPreRasterizationState())
+	{
+		return;
+	}
+
+	const PreRasterizationState &preRasterizationState = state.getPreRasterizationState();
+	const bool hasRasterizerDiscard = preRasterizationState.hasRasterizerDiscard();
+	if(!hasRasterizerDiscard && (!state.hasFragmentState() || !state.hasFragmentOutputInterfaceState()))
+	{
+		return;
+	}
+
+	// Only dynamic state which doesn't affect the routines' state keys is allowed.
+	const VkPipelineDynamicStateCreateInfo *dynamicStateCreateInfo = pCreateInfo->pDynamicState;
+	for(uint32_t i = 0; dynamicStateCreateInfo && (i < dynamicStateCreateInfo->dynamicStateCount); i++)
+	{
+		switch(dynamicStateCreateInfo->pDynamicStates[i])
+		{
+		case VK_DYNAMIC_STATE_VIEWPORT:
+		case VK_DYNAMIC_STATE_VIEWPORT_WITH_COUNT:
+			// The depth clamp range is derived from the viewport.
+			if(preRasterizationState.getDepthClampEnable())
+			{
+				return;
+			}
+			break;
+		case VK_DYNAMIC_STATE_SCISSOR:
+		case VK_DYNAMIC_STATE_SCISSOR_WITH_COUNT:
+		case VK_DYNAMIC_STATE_LINE_WIDTH:
+		case VK_DYNAMIC_STATE_BLEND_CONSTANTS:
+		case VK_DYNAMIC_STATE_VERTEX_INPUT_BINDING_STRIDE:
+			break;
+		default:
+			return;
+		}
+	}
+
+	// Describe the attachments the same way CommandBuffer::ExecutionState::bindAttachments()
+	// binds them, using the formats of the render pass or of the dynamic rendering info.
+	Attachments formats = attachments;
+	if(!hasRasterizerDiscard)
+	{
+		const RenderPass *renderPass = vk::Cast(pCreateInfo->renderPass);
+		const auto *rendering = GetExtendedStruct<VkPipelineRenderingCreateInfo>(pCreateInfo->pNext, VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO);
+
+		if(renderPass)
+		{
+			const VkSubpassDescription &subpass = renderPass->getSubpass(pCreateInfo->subpass);
+
+			for(uint32_t i = 0; i < subpass.colorAttachmentCount; i++)
+			{
+				const uint32_t attachment = subpass.pColorAttachments[i].attachment;
+				if(attachment != VK_ATTACHMENT_UNUSED)
+				{
+					formats.colorBufferFormat[i] = renderPass->getAttachment(attachment).format;
+				}
+			}
+
+			if(subpass.pDepthStencilAttachment && (subpass.pDepthStencilAttachment->attachment != VK_ATTACHMENT_UNUSED))
+			{
+				const Format format = renderPass->getAttachment(subpass.pDepthStencilAttachment->attachment).format;
+				formats.depthBufferFormat = format.isDepth() ? VkFormat(format) : VK_FORMAT_UNDEFINED;
+				formats.stencilBufferFormat = format.isStencil() ? VkFormat(format) : VK_FORMAT_UNDEFINED;
+			}
+		}
+		else if(rendering)
+		{
+			for(uint32_t i = 0; i < rendering->colorAttachmentCount; i++)
+			{
+				const uint32_t location = attachments.indexToLocation[i];
+				if(location != VK_ATTACHMENT_UNUSED)
+				{
+					formats.colorBufferFormat[location] = rendering->pColorAttachmentFormats[i];
+				}
+			}
+
+			formats.depthBufferFormat = rendering->depthAttachmentFormat;
+			formats.stencilBufferFormat = rendering->stencilAttachmentFormat;
+		}
+	}
+
+	precompiledRoutines = sw::PrecompiledRoutines::Compile(device, this, formats);
+}
+
 ComputePipeline::ComputePipeline(const VkComputePipelineCreateInfo *pCreateInfo, void *mem, Device *device)
     : Pipeline(vk::Cast(pCreateInfo->layout), device, getPipelineRobustBufferAccess(pCreateInfo->pNext, device))
 {
@@ -23,6 +23,7 @@ namespace sw {
 
 class ComputeProgram;
 class SpirvShader;
+struct PrecompiledRoutines;
 
 }  // namespace sw
 
@@ -106,13 +107,17 @@ public:
 
 	bool preRasterizationContainsImageWrite() const;
 	bool fragmentContainsImageWrite() const;
+	bool containsBufferWrite() const;
 
 	const std::shared_ptr<sw::SpirvShader> getShader(const VkShaderStageFlagBits &stage) const;
+	const sw::PrecompiledRoutines *getPrecompiledRoutines() const { return precompiledRoutines.get(); }
 
 private:
 	void setShader(const VkShaderStageFlagBits &stage, const std::shared_ptr<sw::SpirvShader> spirvShader);
+	void precompileRoutines(const VkGraphicsPipelineCreateInfo *pCreateInfo);
 	std::shared_ptr<sw::SpirvShader> vertexShader;
 	std::shared_ptr<sw::SpirvShader> fragmentShader;
+	std::shared_ptr<sw::PrecompiledRoutines> precompiledRoutines;
 
 	const GraphicsState state;
 
@@ -16,6 +16,137 @@
 
 #include <cstring>
 
+namespace {
+
+// Serializes pipeline cache entries as a stream of 32-bit words.
+class Writer
+{
+public:
+	void write(uint32_t word)
+	{
+		words.push_back(word);
+	}
+
+	void write(const uint32_t *data, size_t count)
+	{
+		write(static_cast<uint32_t>(count));
+		words.insert(words.end(), data, data + count);
+	}
+
+	void writeBytes(const void *data, size_t size)
+	{
+		write(static_cast<uint32_t>(size));
+		size_t offset = words.size();
+		words.resize(offset + (size + sizeof(uint32_t) - 1) / sizeof(uint32_t), 0);
+		if(size > 0)
+		{
+			memcpy(words.data() + offset, data, size);
+		}
+	}
+
+	const std::vector<uint32_t> &getWords() const { return words; }
+
+private:
+	std::vector<uint32_t> words;
+};
+
+// Deserializes pipeline cache entries written by Writer. The input is untrusted
+// application data, so every read is bounds checked. Once a read fails, all
+// subsequent reads fail too.
+class Reader
+{
+public:
+	Reader(const uint8_t *data, size_t size)
+	    : data(data)
+	    , size(size)
+	{}
+
+	bool read(uint32_t &word)
+	{
+		if(!valid || (size - offset) < sizeof(uint32_t))
+		{
+			valid = false;
+			return false;
+		}
+
+		memcpy(&word, data + offset, sizeof(uint32_t));
+		offset += sizeof(uint32_t);
+		return true;
+	}
+
+	bool read(std::vector<uint32_t> &out)
+	{
+		uint32_t count = 0;
+		if(!read(count) || (size - offset) / sizeof(uint32_t) < count)
+		{
+			valid = false;
+			return false;
+		}
+
+		out.resize(count);
+		if(count > 0)
+		{
+			memcpy(out.data(), data + offset, count * sizeof(uint32_t));
+		}
+		offset += count * sizeof(uint32_t);
+		return true;
+	}
+
+	bool readBytes(std::vector<uint8_t> &out)
+	{
+		uint32_t byteCount = 0;
+		if(!read(byteCount))
+		{
+			return false;
+		}
+
+		size_t paddedSize = (static_cast<size_t>(byteCount) + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+		if((size - offset) < paddedSize)
+		{
+			valid = false;
+			return false;
+		}
+
+		out.assign(data + offset, data + offset + byteCount);
+		offset += paddedSize;
+		return true;
+	}
+
+private:
+	const uint8_t *const data;
+	const size_t size;
+	size_t offset = 0;
+	bool valid = true;
+};
+
+void serialize(Writer &writer, const vk::PipelineCache::SpirvBinaryKey &key, const sw::SpirvBinary &optimized)
+{
+	writer.write((key.getRobustBufferAccess() ? 1u : 0u) | (key.getOptimization() ? 2u : 0u));
+	writer.write(key.getBinary().data(), key.getBinary().size());
+
+	const VkSpecializationInfo *specializationInfo = key.getSpecializationInfo();
+	if(specializationInfo)
+	{
+		writer.write(specializationInfo->mapEntryCount);
+		for(uint32_t i = 0; i < specializationInfo->mapEntryCount; i++)
+		{
+			const VkSpecializationMapEntry &entry = specializationInfo->pMapEntries[i];
+			writer.write(entry.constantID);
+			writer.write(entry.offset);
+			writer.write(static_cast<uint32_t>(entry.size));
+		}
+		writer.writeBytes(specializationInfo->pData, specializationInfo->dataSize);
+	}
+	else
+	{
+		writer.write(0u);  // mapEntryCount
+	}
+
+	writer.write(optimized.data(), optimized.size());
+}
+
+}  // anonymous namespace
+
 namespace vk {
 
 PipelineCache::SpirvBinaryKey::SpirvBinaryKey(const sw::SpirvBinary &spirv,
@@ -66,19 +197,10 @@ bool PipelineCache::ComputeProgramKey::operator<(const ComputeProgramKey &other)
 }
 
 PipelineCache::PipelineCache(const VkPipelineCacheCreateInfo *pCreateInfo, void *mem)
-    : dataSize(ComputeRequiredAllocationSize(pCreateInfo))
-    , data(reinterpret_cast<uint8_t *>(mem))
 {
-	CacheHeader *header = reinterpret_cast<CacheHeader *>(mem);
-	header->headerLength = sizeof(CacheHeader);
-	header->headerVersion = VK_PIPELINE_CACHE_HEADER_VERSION_ONE;
-	header->vendorID = VENDOR_ID;
-	header->deviceID = DEVICE_ID;
-	memcpy(header->pipelineCacheUUID, SWIFTSHADER_UUID, VK_UUID_SIZE);
-
 	if(pCreateInfo->pInitialData && (pCreateInfo->initialDataSize > 0))
 	{
-		memcpy(data + sizeof(CacheHeader), pCreateInfo->pInitialData, pCreateInfo->initialDataSize);
+		loadData(reinterpret_cast<const uint8_t *>(pCreateInfo->pInitialData), pCreateInfo->initialDataSize);
 	}
 }
 
@@ -90,34 +212,156 @@ PipelineCache::~PipelineCache()
 
 void PipelineCache::destroy(const VkAllocationCallbacks *pAllocator)
 {
-	vk::freeHostMemory(data, pAllocator);
 }
 
 size_t PipelineCache::ComputeRequiredAllocationSize(const VkPipelineCacheCreateInfo *pCreateInfo)
 {
-	return pCreateInfo->initialDataSize + sizeof(CacheHeader);
+	return 0;
+}
+
+void PipelineCache::loadData(const uint8_t *data, size_t size)
+{
+	// Data which was not produced by this implementation, or by a version of it
+	// using a different serialization layout, is silently ignored as the spec requires.
+	CacheHeader header = {};
+	if(size < sizeof(CacheHeader))
+	{
+		return;
+	}
+
+	memcpy(&header, data, sizeof(CacheHeader));
+	if((header.headerLength != sizeof(CacheHeader)) ||
+	   (header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) ||
+	   (header.vendorID != VENDOR_ID) ||
+	   (header.deviceID != DEVICE_ID) ||
+	   (memcmp(header.pipelineCacheUUID, SWIFTSHADER_UUID, VK_UUID_SIZE) != 0))
+	{
+		return;
+	}
+
+	Reader reader(data + sizeof(CacheHeader), size - sizeof(CacheHeader));
+
+	DataHeader dataHeader = {};
+	if(!reader.read(dataHeader.dataVersion) || (dataHeader.dataVersion != DATA_VERSION) ||
+	   !reader.read(dataHeader.entryCount))
+	{
+		return;
+	}
+
+	marl::lock lock(spirvShadersMutex);
+
+	for(uint32_t i = 0; i < dataHeader.entryCount; i++)
+	{
+		uint32_t flags = 0;
+		std::vector<uint32_t> source;
+		uint32_t mapEntryCount = 0;
+		if(!reader.read(flags) || !reader.read(source) || !reader.read(mapEntryCount))
+		{
+			return;
+		}
+
+		std::vector<VkSpecializationMapEntry> mapEntries(mapEntryCount);
+		for(auto &entry : mapEntries)
+		{
+			uint32_t entrySize = 0;
+			if(!reader.read(entry.constantID) || !reader.read(entry.offset) || !reader.read(entrySize))
+			{
+				return;
+			}
+			entry.size = entrySize;
+		}
+
+		std::vector<uint8_t> specializationData;
+		if((mapEntryCount > 0) && !reader.readBytes(specializationData))
+		{
+			return;
+		}
+
+		std::vector<uint32_t> optimized;
+		if(!reader.read(optimized))
+		{
+			return;
+		}
+
+		VkSpecializationInfo specializationInfo = {
+			mapEntryCount,
+			mapEntries.data(),
+			specializationData.size(),
+			specializationData.data(),
+		};
+
+		SpirvBinaryKey key(sw::SpirvBinary(source.data(), static_cast<uint32_t>(source.size())),
+		                   (mapEntryCount > 0) ? &specializationInfo : nullptr,
+		                   (flags & 1) != 0, (flags & 2) != 0);
+		spirvShaders.emplace(key, sw::SpirvBinary(optimized.data(), static_cast<uint32_t>(optimized.size())));
+	}
 }
 
 VkResult PipelineCache::getData(size_t *pDataSize, void *pData)
 {
+	CacheHeader header = {};
+	header.headerLength = sizeof(CacheHeader);
+	header.headerVersion = VK_PIPELINE_CACHE_HEADER_VERSION_ONE;
+	header.vendorID = VENDOR_ID;
+	header.deviceID = DEVICE_ID;
+	memcpy(header.pipelineCacheUUID, SWIFTSHADER_UUID, VK_UUID_SIZE);
+
+	// Only the optimized SPIR-V is serialized. JIT routines embed absolute
+	// addresses of process-local data, so they cannot be reused across processes.
+	std::vector<std::vector<uint32_t>> entries;
+	{
+		marl::lock lock(spirvShadersMutex);
+
+		entries.reserve(spirvShaders.size());
+		for(const auto &it : spirvShaders)
+		{
+			Writer writer;
+			serialize(writer, it.first, it.second);
+			entries.push_back(writer.getWords());
+		}
+	}
+
+	size_t size = sizeof(CacheHeader) + sizeof(DataHeader);
+	for(const auto &entry : entries)
+	{
+		size += entry.size() * sizeof(uint32_t);
+	}
+
 	if(!pData)
 	{
-		*pDataSize = dataSize;
+		*pDataSize = size;
 		return VK_SUCCESS;
 	}
 
-	if(*pDataSize != dataSize)
+	// When the buffer is too small, write as many complete entries as fit.
+	if(*pDataSize < sizeof(CacheHeader) + sizeof(DataHeader))
 	{
 		*pDataSize = 0;
 		return VK_INCOMPLETE;
 	}
 
-	if(*pDataSize > 0)
+	uint8_t *data = reinterpret_cast<uint8_t *>(pData);
+	size_t offset = sizeof(CacheHeader) + sizeof(DataHeader);
+	DataHeader dataHeader = { DATA_VERSION, 0 };
+
+	for(const auto &entry : entries)
 	{
-		memcpy(pData, data, *pDataSize);
+		size_t entrySize = entry.size() * sizeof(uint32_t);
+		if((*pDataSize - offset) < entrySize)
+		{
+			break;
+		}
+
+		memcpy(data + offset, entry.data(), entrySize);
+		offset += entrySize;
+		dataHeader.entryCount++;
 	}
 
-	return VK_SUCCESS;
+	memcpy(data, &header, sizeof(CacheHeader));
+	memcpy(data + sizeof(CacheHeader), &dataHeader, sizeof(DataHeader));
+	*pDataSize = offset;
+
+	return (dataHeader.entryCount == entries.size()) ? VK_SUCCESS : VK_INCOMPLETE;
 }
 
 VkResult PipelineCache::merge(uint32_t srcCacheCount, const VkPipelineCache *pSrcCaches)
@@ -66,6 +66,7 @@ public:
 
 		const sw::SpirvBinary &getBinary() const { return spirv; }
 		const VkSpecializationInfo *getSpecializationInfo() const { return specializationInfo.get(); }
+		bool getRobustBufferAccess() const { return robustBufferAccess; }
 		bool getOptimization() const { return optimize; }
 
 	private:
@@ -116,8 +117,19 @@ private:
 		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
 	};
 
-	size_t dataSize = 0;
-	uint8_t *data = nullptr;
+	// The cache data following the CacheHeader starts with a DataHeader,
+	// followed by entryCount serialized optimized SPIR-V binaries.
+	struct DataHeader
+	{
+		uint32_t dataVersion;
+		uint32_t entryCount;
+	};
+
+	// Version of the serialized cache data layout. Must be incremented
+	// whenever the layout of the serialized entries changes.
+	static constexpr uint32_t DATA_VERSION = 1;
+
+	void loadData(const uint8_t *data, size_t size);
 
 	marl::mutex spirvShadersMutex;
 	std::map<SpirvBinaryKey, sw::SpirvBinary> spirvShaders GUARDED_BY(spirvShadersMutex);
@@ -15,6 +15,7 @@
 #include "VkQueue.hpp"
 
 #include "VkCommandBuffer.hpp"
+#include "VkDevice.hpp"
 #include "VkFence.hpp"
 #include "VkSemaphore.hpp"
 #include "VkStringify.hpp"
@@ -29,6 +30,7 @@
 #include "marl/trace.h"
 
 #include <cstring>
+#include <vector>
 
 namespace vk {
 
@@ -105,21 +107,32 @@ void Queue::submitQueue(const Task &task)
 			}
 		}
 
-		for(uint32_t j = 0; j < submitInfo.signalSemaphoreCount; j++)
+		if(submitInfo.signalSemaphoreCount > 0)
 		{
-			if(auto *sem = DynamicCast<TimelineSemaphore>(submitInfo.pSignalSemaphores[j]))
-			{
-				ASSERT(j < submitInfo.signalSemaphoreValueCount);
-				sem->signal(submitInfo.pSignalSemaphoreValues[j]);
-			}
-			else if(auto *sem = DynamicCast<BinarySemaphore>(submitInfo.pSignalSemaphores[j]))
-			{
-				sem->signal();
-			}
-			else
-			{
-				UNSUPPORTED("Unknown semaphore type");
-			}
+			// The submit info is released before the semaphores get signaled, so copy their handles.
+			std::vector<VkSemaphore> semaphores(submitInfo.pSignalSemaphores, submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+			std::vector<uint64_t> values(submitInfo.pSignalSemaphoreValues, submitInfo.pSignalSemaphoreValues + submitInfo.signalSemaphoreValueCount);
+
+			// Commands other than draws have been executed synchronously by this thread, so the semaphores
+			// can be signaled as soon as the draws of this and prior submissions are complete.
+			renderer->onDrawsComplete([semaphores = std::move(semaphores), values = std::move(values)] {
+				for(uint32_t j = 0; j < semaphores.size(); j++)
+				{
+					if(auto *sem = DynamicCast<TimelineSemaphore>(semaphores[j]))
+					{
+						ASSERT(j < values.size());
+						sem->signal(values[j]);
+					}
+					else if(auto *sem = DynamicCast<BinarySemaphore>(semaphores[j]))
+					{
+						sem->signal();
+					}
+					else
+					{
+						UNSUPPORTED("Unknown semaphore type");
+					}
+				}
+			});
 		}
 	}
 
@@ -128,12 +141,17 @@ void Queue::submitQueue(const Task &task)
 		toDelete.put(task.pSubmits);
 	}
 
+	// Routines created by this submission's commands can now be found without locking.
+	device->updateSamplingRoutineSnapshotCache();
+
 	if(task.events)
 	{
-		// TODO: fix renderer signaling so that work submitted separately from (but before) a fence
-		// is guaranteed complete by the time the fence signals.
-		renderer->synchronize();
-		task.events->done();
+		// Signal the fence once the draws of this and prior submissions are complete, while
+		// subsequent submissions already get processed.
+		auto events = task.events;
+		renderer->onDrawsComplete([events] {
+			events->done();
+		});
 	}
 }
 
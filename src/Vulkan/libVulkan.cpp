@@ -80,6 +80,7 @@
 #include "marl/scheduler.h"
 #include "marl/thread.h"
 #include "marl/tsa.h"
+#include "marl/waitgroup.h"
 
 #ifdef __ANDROID__
 #	include <unistd.h>
@@ -101,6 +102,7 @@
 #include <functional>
 #include <map>
 #include <string>
+#include <vector>
 
 namespace {
 
@@ -736,6 +738,7 @@ VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceQueueFamilyProperties(VkPhysicalDe
 	}
 	else
 	{
+		*pQueueFamilyPropertyCount = std::min(*pQueueFamilyPropertyCount, vk::Cast(physicalDevice)->getQueueFamilyPropertyCount());
 		vk::Cast(physicalDevice)->getQueueFamilyProperties(*pQueueFamilyPropertyCount, pQueueFamilyProperties);
 	}
 }
@@ -2359,19 +2362,69 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateGraphicsPipelines(VkDevice device, VkPipe
 
 	memset(pPipelines, 0, sizeof(void *) * createInfoCount);
 
-	VkResult errorResult = VK_SUCCESS;
+	std::vector<VkResult> results(createInfoCount, VK_SUCCESS);
 	for(uint32_t i = 0; i < createInfoCount; i++)
 	{
-		VkResult result = vk::GraphicsPipeline::Create(pAllocator, &pCreateInfos[i], &pPipelines[i], vk::Cast(device));
+		results[i] = vk::GraphicsPipeline::Create(pAllocator, &pCreateInfos[i], &pPipelines[i], vk::Cast(device));
 
-		if(result == VK_SUCCESS)
+		if((results[i] != VK_SUCCESS) && (pCreateInfos[i].flags & VK_PIPELINE_CREATE_EARLY_RETURN_ON_FAILURE_BIT_EXT))
 		{
-			result = static_cast<vk::GraphicsPipeline *>(vk::Cast(pPipelines[i]))->compileShaders(pAllocator, &pCreateInfos[i], vk::Cast(pipelineCache));
-			if(result != VK_SUCCESS)
+			break;
+		}
+	}
+
+	auto compile = [&](uint32_t i) {
+		auto *pipeline = static_cast<vk::GraphicsPipeline *>(vk::Cast(pPipelines[i]));
+		results[i] = pipeline->compileShaders(pAllocator, &pCreateInfos[i], vk::Cast(pipelineCache));
+		if(results[i] != VK_SUCCESS)
+		{
+			vk::destroy(pPipelines[i], pAllocator);
+			pPipelines[i] = VK_NULL_HANDLE;
+		}
+	};
+
+	if(createInfoCount == 1)
+	{
+		if(pPipelines[0] != VK_NULL_HANDLE)
+		{
+			compile(0);
+		}
+	}
+	else
+	{
+		// Compile the pipelines concurrently. The calling thread is bound to the
+		// device's scheduler for the duration of the call if it isn't already.
+		marl::Scheduler *scheduler = vk::Cast(device)->getScheduler();
+		const bool bindScheduler = (marl::Scheduler::get() == nullptr);
+		if(bindScheduler)
+		{
+			scheduler->bind();
+		}
+
+		marl::WaitGroup compiled;
+		for(uint32_t i = 0; i < createInfoCount; i++)
+		{
+			if(pPipelines[i] != VK_NULL_HANDLE)
 			{
-				vk::destroy(pPipelines[i], pAllocator);
+				compiled.add(1);
+				marl::schedule([&compile, &compiled, i] {
+					compile(i);
+					compiled.done();
+				});
 			}
 		}
+		compiled.wait();
+
+		if(bindScheduler)
+		{
+			scheduler->unbind();
+		}
+	}
+
+	VkResult errorResult = VK_SUCCESS;
+	for(uint32_t i = 0; i < createInfoCount; i++)
+	{
+		VkResult result = results[i];
 
 		if(result != VK_SUCCESS)
 		{
@@ -2391,6 +2444,16 @@ VKAPI_ATTR VkResult VKAPI_CALL vkCreateGraphicsPipelines(VkDevice device, VkPipe
 			// rather than continuing to create additional pipelines.
 			if(pCreateInfos[i].flags & VK_PIPELINE_CREATE_EARLY_RETURN_ON_FAILURE_BIT_EXT)
 			{
+				// The following pipelines were compiled concurrently, and are discarded.
+				for(uint32_t j = i + 1; j < createInfoCount; j++)
+				{
+					if(pPipelines[j] != VK_NULL_HANDLE)
+					{
+						vk::destroy(pPipelines[j], pAllocator);
+						pPipelines[j] = VK_NULL_HANDLE;
+					}
+				}
+
 				return errorResult;
 			}
 		}
@@ -4089,6 +4152,7 @@ VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceQueueFamilyProperties2(VkPhysicalD
 	}
 	else
 	{
+		*pQueueFamilyPropertyCount = std::min(*pQueueFamilyPropertyCount, vk::Cast(physicalDevice)->getQueueFamilyPropertyCount());
 		vk::Cast(physicalDevice)->getQueueFamilyProperties(*pQueueFamilyPropertyCount, pQueueFamilyProperties);
 	}
 }
@@ -4560,7 +4624,7 @@ VKAPI_ATTR VkBool32 VKAPI_CALL vkGetPhysicalDeviceXcbPresentationSupportKHR(VkPh
 	TRACE("(VkPhysicalDevice physicalDevice = %p, uint32_t queueFamilyIndex = %d, xcb_connection_t* connection = %p, xcb_visualid_t visual_id = %d)",
 	      physicalDevice, int(queueFamilyIndex), connection, int(visual_id));
 
-	return VK_TRUE;
+	return vk::Cast(physicalDevice)->supportsPresentation(queueFamilyIndex) ? VK_TRUE : VK_FALSE;
 }
 #endif
 
@@ -4578,7 +4642,7 @@ VKAPI_ATTR VkBool32 VKAPI_CALL vkGetPhysicalDeviceWaylandPresentationSupportKHR(
 	TRACE("(VkPhysicalDevice physicalDevice = %p, uint32_t queueFamilyIndex = %d, struct wl_display* display = %p)",
 	      physicalDevice, int(queueFamilyIndex), display);
 
-	return VK_TRUE;
+	return vk::Cast(physicalDevice)->supportsPresentation(queueFamilyIndex) ? VK_TRUE : VK_FALSE;
 }
 #endif
 
@@ -4596,7 +4660,7 @@ VKAPI_ATTR VkBool32 VKAPI_CALL vkGetPhysicalDeviceDirectFBPresentationSupportEXT
 	TRACE("(VkPhysicalDevice physicalDevice = %p, uint32_t queueFamilyIndex = %d, IDirectFB* dfb = %p)",
 	      physicalDevice, int(queueFamilyIndex), dfb);
 
-	return VK_TRUE;
+	return vk::Cast(physicalDevice)->supportsPresentation(queueFamilyIndex) ? VK_TRUE : VK_FALSE;
 }
 #endif
 
@@ -4691,7 +4755,7 @@ VKAPI_ATTR VkBool32 VKAPI_CALL vkGetPhysicalDeviceWin32PresentationSupportKHR(Vk
 {
 	TRACE("(VkPhysicalDevice physicalDevice = %p, uint32_t queueFamilyIndex = %d)",
 	      physicalDevice, queueFamilyIndex);
-	return VK_TRUE;
+	return vk::Cast(physicalDevice)->supportsPresentation(queueFamilyIndex) ? VK_TRUE : VK_FALSE;
 }
 #endif
 
@@ -4717,7 +4781,7 @@ VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceSupportKHR(VkPhysicalDe
 	TRACE("(VkPhysicalDevice physicalDevice = %p, uint32_t queueFamilyIndex = %d, VkSurface surface = %p, VKBool32* pSupported = %p)",
 	      physicalDevice, int(queueFamilyIndex), static_cast<void *>(surface), pSupported);
 
-	*pSupported = VK_TRUE;
+	*pSupported = vk::Cast(physicalDevice)->supportsPresentation(queueFamilyIndex) ? VK_TRUE : VK_FALSE;
 	return VK_SUCCESS;
 }
 
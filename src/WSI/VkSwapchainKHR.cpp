@@ -117,7 +117,8 @@ VkResult SwapchainKHR::createImages(VkDevice device, const VkSwapchainCreateInfo
 	imageInfo.arrayLayers = pCreateInfo->imageArrayLayers;
 	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-	imageInfo.usage = pCreateInfo->imageUsage;
+	// Presentation copies the image contents out row by row.
+	imageInfo.usage = pCreateInfo->imageUsage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 	imageInfo.sharingMode = pCreateInfo->imageSharingMode;
 	imageInfo.pQueueFamilyIndices = pCreateInfo->pQueueFamilyIndices;
 	imageInfo.queueFamilyIndexCount = pCreateInfo->queueFamilyIndexCount;
@@ -157,4 +157,70 @@ BENCHMARK_CAPTURE(Transcendental1, rr_Log2, LIFT(rr::Log2))->Arg(REPS);
 BENCHMARK_CAPTURE(Transcendental1, sw_Log2_highp, LIFT(sw::Log2), false /* relaxedPrecision */)->Arg(REPS);
 BENCHMARK_CAPTURE(Transcendental1, sw_Log2_mediump, LIFT(sw::Log2), true /* relaxedPrecision */)->Arg(REPS);
 
+// Emits a routine resembling a long shader, with a loop containing invariant
+// and redundant computations, which the richer optimization presets exploit.
+static void ShaderLike(FunctionT<void(float *, float *, int)> &function)
+{
+	Pointer<SIMD::Float> r = Pointer<Float>(function.Arg<0>());
+	Pointer<SIMD::Float> a = Pointer<Float>(function.Arg<1>());
+	Int count = function.Arg<2>();
+
+	SIMD::Float x = a[0];
+	SIMD::Float y = a[1];
+	SIMD::Float sum = 0.0f;
+
+	For(Int i = 0, i < count, i++)
+	{
+		SIMD::Float scale = sw::Sin(y, false) * sw::Cos(y, false);
+		SIMD::Float u = x * scale;
+		sum += sw::Exp(u, false) + sw::Log(u + 1.0f, false);
+		sum += sw::Exp(x * scale, false) * a[0];
+		x = x * 0.99f;
+	}
+
+	r[0] = sum;
+}
+
+// Time taken to generate and compile the routine with the given preset.
+static void CompileTime(benchmark::State &state, rr::OptimizationPreset preset)
+{
+	ScopedPragma optimizationPasses(OptimizationPasses, static_cast<int>(preset));
+
+	for(auto _ : state)
+	{
+		FunctionT<void(float *, float *, int)> function;
+		ShaderLike(function);
+
+		auto routine = function("shader");
+		benchmark::DoNotOptimize(routine);
+	}
+}
+
+// Time taken to execute the routine compiled with the given preset.
+static void RunTime(benchmark::State &state, rr::OptimizationPreset preset)
+{
+	ScopedPragma optimizationPasses(OptimizationPasses, static_cast<int>(preset));
+
+	FunctionT<void(float *, float *, int)> function;
+	ShaderLike(function);
+
+	auto routine = function("shader");
+
+	std::vector<float> r(SIMD::Width);
+	std::vector<float> a(2 * SIMD::Width, 0.5f);
+	const int iterations = state.range(0);
+
+	for(auto _ : state)
+	{
+		routine(r.data(), a.data(), iterations);
+	}
+}
+
+BENCHMARK_CAPTURE(CompileTime, fast, rr::OptimizationPreset::Fast)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(CompileTime, balanced, rr::OptimizationPreset::Balanced)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(CompileTime, max, rr::OptimizationPreset::Max)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(RunTime, fast, rr::OptimizationPreset::Fast)->Arg(REPS * 100);
+BENCHMARK_CAPTURE(RunTime, balanced, rr::OptimizationPreset::Balanced)->Arg(REPS * 100);
+BENCHMARK_CAPTURE(RunTime, max, rr::OptimizationPreset::Max)->Arg(REPS * 100);
+
 }  // namespace sw
\ No newline at end of file
@@ -206,3 +206,89 @@ TEST(ReactorSIMD, Intrinsics_Gather)
 		EXPECT_EQ(result[i], val[i]);
 	}
 }
+
+TEST(ReactorSIMD, ScopedWidth)
+{
+	SIMD::ScopedWidth scopedWidth(Caps::maxSIMDWidth());
+	const int width = SIMD::Width;
+
+	FunctionT<int(int *, int *)> function;
+	{
+		Pointer<Int> r = Pointer<Int>(function.Arg<0>());
+		Pointer<Int> a = Pointer<Int>(function.Arg<1>());
+
+		SIMD::Int x = *Pointer<SIMD::Int>(a);
+
+		*Pointer<SIMD::Int>(r) = Swizzle(x, 0x1032);
+
+		Return(SignMask(x));
+	}
+
+	auto routine = function(testName().c_str());
+
+	std::vector<int> r(width);
+	std::vector<int> a(width);
+	int expectedMask = 0;
+
+	for(int i = 0; i < width; i++)
+	{
+		a[i] = (i % 3 == 0) ? -1 - i : i;
+		expectedMask |= (a[i] < 0) ? (1 << i) : 0;
+	}
+
+	int mask = routine(r.data(), a.data());
+
+	EXPECT_EQ(mask, expectedMask);
+
+	for(int i = 0; i < width; i++)
+	{
+		EXPECT_EQ(r[i], a[i ^ 1]);
+	}
+}
+
+TEST(ReactorSIMD, Width8)
+{
+	if(Caps::maxSIMDWidth() < 8)
+	{
+		SUCCEED() << "8-wide SIMD not supported";
+		return;
+	}
+
+	SIMD::ScopedWidth scopedWidth(8);
+	ASSERT_EQ(SIMD::Width, 8);
+
+	FunctionT<int(float *, int *, float *)> function;
+	{
+		Pointer<Float> r = Pointer<Float>(function.Arg<0>());
+		Pointer<Int> s = Pointer<Int>(function.Arg<1>());
+		Pointer<Float> a = Pointer<Float>(function.Arg<2>());
+
+		SIMD::Float x = *Pointer<SIMD::Float>(a);
+		SIMD::Float y = SIMD::Float(Float4(1.0f, 2.0f, 3.0f, 4.0f));
+		SIMD::Int lane = SIMD::Int([](int i) { return i; });
+
+		*Pointer<SIMD::Float>(r) = x * y + SIMD::Float(lane);
+		*Pointer<SIMD::Int>(s) = Insert128(lane, Extract128(lane, 0) + Int4(100), 1);
+
+		Return(SignMask(CmpLT(x, y)));
+	}
+
+	auto routine = function(testName().c_str());
+
+	float r[8] = {};
+	int s[8] = {};
+	float a[8] = { 0.0f, 5.0f, -1.0f, 9.0f, 2.0f, 1.0f, 4.0f, -3.0f };
+	const float y[8] = { 1.0f, 2.0f, 3.0f, 4.0f, 1.0f, 2.0f, 3.0f, 4.0f };
+
+	int mask = routine(r, s, a);
+
+	int expectedMask = 0;
+	for(int i = 0; i < 8; i++)
+	{
+		EXPECT_EQ(r[i], a[i] * y[i] + i);
+		EXPECT_EQ(s[i], (i < 4) ? i : (i - 4 + 100));
+		expectedMask |= (a[i] < y[i]) ? (1 << i) : 0;
+	}
+
+	EXPECT_EQ(mask, expectedMask);
+}
@@ -14,6 +14,7 @@
 
 #include "Assert.hpp"
 #include "Coroutine.hpp"
+#include "ExecutableMemory.hpp"
 #include "Print.hpp"
 #include "Reactor.hpp"
 
@@ -1832,14 +1833,19 @@ TEST(ReactorUnitTests, MulHigh)
 		    MulHigh(UInt4(0x7FFFFFFFu, 0x7FFFFFFFu, 0x80008000u, 0xFFFFFFFFu),
 		            UInt4(0x7FFFFFFFu, 0x80000000u, 0x80008000u, 0xFFFFFFFFu));
 
-		// (U)Short8 variants currently unimplemented.
+		*Pointer<Short8>(out + 16 * 6) =
+		    MulHigh(Short8(0x01AA, 0x02DD, 0x03EE, 0xF422, 0x7FFF, 0x8000, 0x1234, 0xFFFF),
+		            Short8(0x01BB, 0x02CC, 0x03FF, 0xF411, 0x7FFF, 0x7FFF, 0x8765, 0xFFFF));
+		*Pointer<UShort8>(out + 16 * 7) =
+		    MulHigh(UShort8(0x01AA, 0x02DD, 0x03EE, 0xF422, 0x7FFF, 0x8000, 0x1234, 0xFFFF),
+		            UShort8(0x01BB, 0x02CC, 0x03FF, 0xF411, 0x7FFF, 0x7FFF, 0x8765, 0xFFFF));
 
 		Return(0);
 	}
 
 	auto routine = function(testName().c_str());
 
-	unsigned int out[6][4];
+	unsigned int out[8][4];
 
 	memset(&out, 0, sizeof(out));
 
@@ -1870,6 +1876,16 @@ TEST(ReactorUnitTests, MulHigh)
 	EXPECT_EQ(out[5][1], 0x3FFFFFFFu);
 	EXPECT_EQ(out[5][2], 0x40008000u);
 	EXPECT_EQ(out[5][3], 0xFFFFFFFEu);
+
+	EXPECT_EQ(out[6][0], 0x00080002u);
+	EXPECT_EQ(out[6][1], 0x008D000Fu);
+	EXPECT_EQ(out[6][2], 0xC0003FFFu);
+	EXPECT_EQ(out[6][3], 0x0000F76Cu);
+
+	EXPECT_EQ(out[7][0], 0x00080002u);
+	EXPECT_EQ(out[7][1], 0xE8C0000Fu);
+	EXPECT_EQ(out[7][2], 0x3FFF3FFFu);
+	EXPECT_EQ(out[7][3], 0xFFFE09A0u);
 }
 
 TEST(ReactorUnitTests, MulAdd)
@@ -1882,13 +1898,16 @@ TEST(ReactorUnitTests, MulAdd)
 		    MulAdd(Short4(0x1aa, 0x2dd, 0x3ee, 0xF422),
 		           Short4(0x1bb, 0x2cc, 0x3ff, 0xF411));
 
-		// (U)Short8 variant is mentioned but unimplemented
+		*Pointer<Int4>(out + 8 * 1) =
+		    MulAdd(Short8(0x1aa, 0x2dd, 0x3ee, 0xF422, 0x7FFF, 0x8000, 0x1234, 0xFFFF),
+		           Short8(0x1bb, 0x2cc, 0x3ff, 0xF411, 0x7FFF, 0x7FFF, 0x8765, 0xFFFF));
+
 		Return(0);
 	}
 
 	auto routine = function(testName().c_str());
 
-	unsigned int out[1][2];
+	unsigned int out[3][2];
 
 	memset(&out, 0, sizeof(out));
 
@@ -1896,6 +1915,36 @@ TEST(ReactorUnitTests, MulAdd)
 
 	EXPECT_EQ(out[0][0], 0x000AE34Au);
 	EXPECT_EQ(out[0][1], 0x009D5254u);
+
+	EXPECT_EQ(out[1][0], 0x000AE34Au);
+	EXPECT_EQ(out[1][1], 0x009D5254u);
+	EXPECT_EQ(out[2][0], 0xFFFF8001u);
+	EXPECT_EQ(out[2][1], 0xF76C9A85u);
+}
+
+TEST(ReactorUnitTests, Average)
+{
+	FunctionT<int(void *)> function;
+	{
+		Pointer<Byte> out = function.Arg<0>();
+
+		*Pointer<UShort4>(out) =
+		    Average(UShort4(0x0000, 0x0001, 0xFFFF, 0x8000),
+		            UShort4(0x0001, 0x0001, 0xFFFE, 0x7FFF));
+
+		Return(0);
+	}
+
+	auto routine = function(testName().c_str());
+
+	unsigned int out[2];
+
+	memset(&out, 0, sizeof(out));
+
+	routine(&out);
+
+	EXPECT_EQ(out[0], 0x00010001u);
+	EXPECT_EQ(out[1], 0x8000FFFFu);
 }
 
 TEST(ReactorUnitTests, PointersEqual)
@@ -2907,6 +2956,57 @@ TEST(ReactorUnitTests, Coroutines_Vectors)
 	EXPECT_EQ(out, 10);
 }
 
+// Test values which are live across yields in loops, including vectors and booleans.
+TEST(ReactorUnitTests, Coroutines_LiveValues)
+{
+	if(!rr::Caps::coroutinesSupported())
+	{
+		SUCCEED() << "Coroutines not supported";
+		return;
+	}
+
+	Coroutine<int(int)> function;
+	{
+		Int n = function.Arg<0>();
+		Float4 v = Float4(1.0f, 2.0f, 3.0f, 4.0f);
+
+		For(Int i = 0, i < n, i++)
+		{
+			Bool odd = (i & 1) != 0;
+			Yield(i);
+
+			v = v * Float4(2.0f);
+
+			For(Int j = 0, j < 2, j++)
+			{
+				Yield(Int(Extract(v, 1)) + j);
+			}
+
+			If(odd)
+			{
+				Yield(Int(-1));
+			}
+		}
+
+		Yield(Int(Extract(v, 3)));
+	}
+	function.finalize(testName().c_str());
+
+	auto coroutine = function(3);
+
+	const int expected[] = { 0, 4, 5, 1, 8, 9, -1, 2, 16, 17, 32 };
+	for(int value : expected)
+	{
+		int out = 0;
+		EXPECT_EQ(coroutine->await(out), true);
+		EXPECT_EQ(out, value);
+	}
+
+	int out = 99;
+	EXPECT_EQ(coroutine->await(out), false);
+	EXPECT_EQ(out, 99);
+}
+
 // This test was written to make sure a coroutine without a Yield()
 // works correctly, by executing like a regular function with no
 // return (the return type is ignored).
@@ -4152,6 +4252,114 @@ TEST(ReactorUnitTests, EmitAsm)
 }
 #endif
 
+TEST(ReactorUnitTests, MemoryArenaReuse)
+{
+	MemoryArena arena(64, false, false);
+
+	uint8_t *a = static_cast<uint8_t *>(arena.allocate(100));
+	uint8_t *b = static_cast<uint8_t *>(arena.allocate(64));
+	ASSERT_NE(a, nullptr);
+	EXPECT_EQ(b, a + 128);
+
+	memset(a, 0xFF, 100);
+	EXPECT_TRUE(arena.deallocate(a, 100));
+
+	// The freed range is reused first, and cleared.
+	uint8_t *c = static_cast<uint8_t *>(arena.allocate(128));
+	EXPECT_EQ(c, a);
+	for(int i = 0; i < 128; i++)
+	{
+		EXPECT_EQ(c[i], 0) << "Byte " << i;
+	}
+
+	EXPECT_EQ(arena.allocate(MemoryArena::MaxAllocationSize + 1), nullptr);
+
+	int local = 0;
+	EXPECT_FALSE(arena.deallocate(&local, sizeof(local)));
+
+	EXPECT_TRUE(arena.deallocate(b, 64));
+	EXPECT_TRUE(arena.deallocate(c, 128));
+}
+
+TEST(ReactorUnitTests, MemoryArenaCoalescing)
+{
+	MemoryArena arena(64, false, false);
+
+	uint8_t *x = static_cast<uint8_t *>(arena.allocate(64));
+	uint8_t *y = static_cast<uint8_t *>(arena.allocate(64));
+	uint8_t *z = static_cast<uint8_t *>(arena.allocate(64));
+	uint8_t *w = static_cast<uint8_t *>(arena.allocate(64));
+	ASSERT_EQ(y, x + 64);
+	ASSERT_EQ(z, x + 128);
+	ASSERT_EQ(w, x + 192);
+
+	// Freeing the middle range last merges it with both of its neighbors.
+	EXPECT_TRUE(arena.deallocate(x, 64));
+	EXPECT_TRUE(arena.deallocate(z, 64));
+	EXPECT_TRUE(arena.deallocate(y, 64));
+
+	EXPECT_EQ(arena.allocate(192), x);
+
+	EXPECT_TRUE(arena.deallocate(x, 192));
+	EXPECT_TRUE(arena.deallocate(w, 64));
+}
+
+TEST(ReactorUnitTests, MemoryArenaSlabs)
+{
+	MemoryArena arena(64, false, false);
+
+	const size_t size = MemoryArena::MaxAllocationSize;
+	const size_t count = MemoryArena::SlabSize / size;
+
+	std::vector<uint8_t *> allocations;
+	for(size_t i = 0; i < count; i++)
+	{
+		allocations.push_back(static_cast<uint8_t *>(arena.allocate(size)));
+		ASSERT_EQ(allocations[i], allocations[0] + i * size);
+	}
+
+	// The first slab is full, so another one gets mapped.
+	void *overflow = arena.allocate(size);
+	ASSERT_NE(overflow, nullptr);
+	EXPECT_TRUE(overflow < allocations[0] || overflow >= allocations[0] + MemoryArena::SlabSize);
+	EXPECT_TRUE(arena.deallocate(overflow, size));
+
+	for(size_t i : { 1, 3, 0, 2 })
+	{
+		EXPECT_TRUE(arena.deallocate(allocations[i], size));
+	}
+
+	// The last slab is retained, with its free ranges merged.
+	for(size_t i = 0; i < count; i++)
+	{
+		EXPECT_EQ(arena.allocate(size), allocations[i]);
+	}
+
+	for(size_t i = 0; i < count; i++)
+	{
+		EXPECT_TRUE(arena.deallocate(allocations[i], size));
+	}
+}
+
+TEST(ReactorUnitTests, MemoryArenaRestoresPermissions)
+{
+	const size_t pageSize = memoryPageSize();
+	MemoryArena arena(pageSize, false, true);
+
+	uint8_t *page = static_cast<uint8_t *>(arena.allocate(1));
+	ASSERT_NE(page, nullptr);
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(page) % pageSize, 0u);
+
+	protectMemoryPages(page, pageSize, PERMISSION_READ);
+	EXPECT_TRUE(arena.deallocate(page, 1));
+
+	// Reusing the page writes to it.
+	EXPECT_EQ(arena.allocate(pageSize), page);
+	page[0] = 1;
+
+	EXPECT_TRUE(arena.deallocate(page, pageSize));
+}
+
 ////////////////////////////////
 // Trait compile time checks. //
 ////////////////////////////////
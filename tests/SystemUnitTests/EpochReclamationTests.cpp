@@ -0,0 +1,192 @@
+// Copyright 2022 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "System/EpochReclamation.hpp"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace sw;
+
+namespace {
+
+struct Counted
+{
+	Counted(int value)
+	    : value(value)
+	    , check(~value)
+	{
+		live++;
+	}
+
+	~Counted()
+	{
+		check = value;  // Detects reads of deleted objects, in most cases.
+		live--;
+	}
+
+	int value;
+	int check;
+
+	static std::atomic<int> live;
+};
+
+std::atomic<int> Counted::live = { 0 };
+
+}  // anonymous namespace
+
+TEST(EpochReclamation, RetainedWhileGuarded)
+{
+	RetiredList<Counted> retired;
+
+	{
+		EpochGuard guard;
+		retired.retire(new Counted(1));
+		EXPECT_EQ(retired.size(), 1u);
+		EXPECT_EQ(Counted::live, 1);
+
+		// Nested guards don't end the outer one.
+		{
+			EpochGuard nested;
+		}
+		retired.reclaim();
+		EXPECT_EQ(Counted::live, 1);
+	}
+
+	retired.reclaim();
+	EXPECT_EQ(retired.size(), 0u);
+	EXPECT_EQ(Counted::live, 0);
+}
+
+TEST(EpochReclamation, LaterGuardsDontRetain)
+{
+	RetiredList<Counted> retired;
+
+	// Without any guard, retired objects are deleted right away.
+	retired.retire(new Counted(1));
+	EXPECT_EQ(Counted::live, 0);
+
+	std::atomic<bool> entered = { false };
+	std::atomic<bool> leave = { false };
+	std::thread reader;
+
+	{
+		EpochGuard guard;
+		retired.retire(new Counted(2));
+		EXPECT_EQ(Counted::live, 1);
+
+		reader = std::thread([&] {
+			EpochGuard later;
+			entered = true;
+			while(!leave)
+			{
+				std::this_thread::yield();
+			}
+		});
+
+		while(!entered)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	// The reader entered its guard after the object got retired, so it can't have read it.
+	retired.reclaim();
+	EXPECT_EQ(Counted::live, 0);
+
+	leave = true;
+	reader.join();
+}
+
+TEST(EpochReclamation, GuardsOfOtherThreads)
+{
+	RetiredList<Counted> retired;
+
+	std::atomic<bool> entered = { false };
+	std::atomic<bool> leave = { false };
+	std::thread reader([&] {
+		EpochGuard guard;
+		entered = true;
+		while(!leave)
+		{
+			std::this_thread::yield();
+		}
+	});
+
+	while(!entered)
+	{
+		std::this_thread::yield();
+	}
+
+	retired.retire(new Counted(1));
+	EXPECT_EQ(Counted::live, 1);
+
+	leave = true;
+	reader.join();
+
+	retired.reclaim();
+	EXPECT_EQ(Counted::live, 0);
+}
+
+TEST(EpochReclamation, ConcurrentReaders)
+{
+	constexpr int readerCount = 4;
+	constexpr int replacements = 20000;
+
+	std::atomic<const Counted *> published = { new Counted(0) };
+	std::atomic<bool> done = { false };
+	std::atomic<int> errors = { 0 };
+
+	std::vector<std::thread> readers;
+	for(int i = 0; i < readerCount; i++)
+	{
+		readers.emplace_back([&] {
+			while(!done)
+			{
+				EpochGuard guard;
+				const Counted *object = published.load();
+				if(object->check != ~object->value)
+				{
+					errors++;
+				}
+			}
+		});
+	}
+
+	{
+		RetiredList<Counted> retired;
+		for(int i = 1; i <= replacements; i++)
+		{
+			retired.retire(published.exchange(new Counted(i)));
+		}
+
+		done = true;
+		for(auto &reader : readers)
+		{
+			reader.join();
+		}
+
+		retired.reclaim();
+		EXPECT_EQ(retired.size(), 0u);
+	}
+
+	delete published.load();
+
+	EXPECT_EQ(errors, 0);
+	EXPECT_EQ(Counted::live, 0);
+}
@@ -0,0 +1,152 @@
+// Copyright 2022 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "System/Memory.hpp"
+#include "System/SwiftConfig.hpp"
+
+#include "marl/scheduler.h"
+#include "marl/waitgroup.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace sw;
+
+namespace {
+
+// Sizes in bytes of transfers, from well below to just above the size from
+// which they're split into concurrent tasks. Most aren't multiples of 4.
+std::vector<size_t> transferSizes()
+{
+	size_t threshold = std::max(2 * static_cast<size_t>(getConfiguration().transferTaskSize), size_t(16));
+
+	return { 1, 4099, threshold - 5, threshold - 1, threshold, threshold + 1, threshold + 7, 3 * threshold + 3 };
+}
+
+std::vector<uint8_t> pattern(size_t bytes)
+{
+	std::vector<uint8_t> data(bytes);
+	for(size_t i = 0; i < bytes; i++)
+	{
+		data[i] = static_cast<uint8_t>(i * 131 + (i >> 8) + 7);
+	}
+
+	return data;
+}
+
+}  // anonymous namespace
+
+// Compares transfers split into tasks on a marl scheduler against their
+// serial equivalents. Destinations are surrounded by bytes which must remain
+// untouched.
+class ConcurrentTransfer : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		scheduler.bind();
+	}
+
+	void TearDown() override
+	{
+		scheduler.unbind();
+	}
+
+	marl::Scheduler scheduler{ marl::Scheduler::Config().setWorkerThreadCount(4) };
+};
+
+TEST_F(ConcurrentTransfer, Copy)
+{
+	for(size_t bytes : transferSizes())
+	{
+		// Both pointers are misaligned, by different amounts.
+		std::vector<uint8_t> src = pattern(bytes + 3);
+		std::vector<uint8_t> dst(bytes + 8, 0xCD);
+		std::vector<uint8_t> expected = dst;
+		memcpy(expected.data() + 1, src.data() + 3, bytes);
+
+		marl::WaitGroup done;
+		copyConcurrently(dst.data() + 1, src.data() + 3, bytes, done);
+		done.wait();
+
+		ASSERT_EQ(dst, expected) << "bytes: " << bytes;
+	}
+}
+
+TEST_F(ConcurrentTransfer, CopyRows)
+{
+	// Rows which don't divide the task size, with distinct padding on each side.
+	const size_t rowSize = 1021;
+	const size_t srcPitch = rowSize + 3;
+	const size_t dstPitch = rowSize + 9;
+
+	for(size_t bytes : transferSizes())
+	{
+		size_t rowCount = (bytes + rowSize - 1) / rowSize;
+
+		std::vector<uint8_t> src = pattern(rowCount * srcPitch);
+		std::vector<uint8_t> dst(rowCount * dstPitch + 1, 0xCD);
+		std::vector<uint8_t> expected = dst;
+		for(size_t y = 0; y < rowCount; y++)
+		{
+			memcpy(expected.data() + 1 + y * dstPitch, src.data() + y * srcPitch, rowSize);
+		}
+
+		marl::WaitGroup done;
+		copyRowsConcurrently(dst.data() + 1, dstPitch, src.data(), srcPitch, rowSize, rowCount, done);
+		done.wait();
+
+		ASSERT_EQ(dst, expected) << "rows: " << rowCount;
+	}
+}
+
+TEST_F(ConcurrentTransfer, Clear)
+{
+	const uint32_t element = 0x12345678;
+
+	for(size_t bytes : transferSizes())
+	{
+		size_t count = (bytes + 3) / 4;
+
+		std::vector<uint32_t> memory(count + 2, 0xCDCDCDCD);
+		std::vector<uint32_t> expected = memory;
+		std::fill(expected.begin() + 1, expected.end() - 1, element);
+
+		marl::WaitGroup done;
+		clearConcurrently(memory.data() + 1, element, count, done);
+		done.wait();
+
+		ASSERT_EQ(memory, expected) << "count: " << count;
+	}
+}
+
+// Without a scheduler, transfers are performed by the calling thread.
+TEST(ConcurrentTransferWithoutScheduler, Copy)
+{
+	ASSERT_EQ(marl::Scheduler::get(), nullptr);
+
+	size_t bytes = transferSizes().back();
+	std::vector<uint8_t> src = pattern(bytes);
+	std::vector<uint8_t> dst(bytes, 0xCD);
+
+	marl::WaitGroup done;
+	copyConcurrently(dst.data(), src.data(), bytes, done);
+
+	EXPECT_EQ(dst, src);
+	done.wait();
+}
@@ -0,0 +1,262 @@
+// Copyright 2022 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "System/WorkgroupOrder.hpp"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace sw;
+
+////////////////////////////////////////////////////////////////////////////////
+// WorkgroupOrder
+////////////////////////////////////////////////////////////////////////////////
+TEST(WorkgroupOrder, VisitsEachWorkgroupOnce)
+{
+	const uint32_t dispatches[][3] = {
+		{ 1, 1, 1 },
+		{ 16, 1, 1 },
+		{ 1, 9, 2 },
+		{ 3, 5, 7 },
+		{ 64, 64, 1 },
+		{ 33, 2, 17 },
+	};
+
+	for(auto &dispatch : dispatches)
+	{
+		WorkgroupOrder order(dispatch[0], dispatch[1], dispatch[2]);
+		std::vector<int> visits(dispatch[0] * dispatch[1] * dispatch[2], 0);
+
+		for(uint32_t index = 0; index < order.count(); index++)
+		{
+			uint32_t offset[3];
+			if(order.offset(index, offset))
+			{
+				ASSERT_LT(offset[0], dispatch[0]);
+				ASSERT_LT(offset[1], dispatch[1]);
+				ASSERT_LT(offset[2], dispatch[2]);
+				visits[(offset[2] * dispatch[1] + offset[1]) * dispatch[0] + offset[0]]++;
+			}
+		}
+
+		for(size_t i = 0; i < visits.size(); i++)
+		{
+			ASSERT_EQ(visits[i], 1) << "Workgroup " << i << " of dispatch "
+			                        << dispatch[0] << "x" << dispatch[1] << "x" << dispatch[2];
+		}
+	}
+}
+
+TEST(WorkgroupOrder, MortonOrder)
+{
+	WorkgroupOrder order(4, 4, 1);
+	ASSERT_EQ(order.count(), 16u);
+
+	const uint32_t expected[16][2] = {
+		{ 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 },
+		{ 2, 0 }, { 3, 0 }, { 2, 1 }, { 3, 1 },
+		{ 0, 2 }, { 1, 2 }, { 0, 3 }, { 1, 3 },
+		{ 2, 2 }, { 3, 2 }, { 2, 3 }, { 3, 3 },
+	};
+
+	for(uint32_t index = 0; index < 16; index++)
+	{
+		uint32_t offset[3];
+		ASSERT_TRUE(order.offset(index, offset));
+		EXPECT_EQ(offset[0], expected[index][0]) << "Index " << index;
+		EXPECT_EQ(offset[1], expected[index][1]) << "Index " << index;
+		EXPECT_EQ(offset[2], 0u) << "Index " << index;
+	}
+}
+
+TEST(WorkgroupOrder, ContiguousIndicesFormBlocks)
+{
+	WorkgroupOrder order(8, 8, 1);
+
+	// Each aligned range of 16 indices covers a 4x4 block of workgroups.
+	for(uint32_t begin = 0; begin < order.count(); begin += 16)
+	{
+		uint32_t first[3];
+		ASSERT_TRUE(order.offset(begin, first));
+		EXPECT_EQ(first[0] % 4, 0u);
+		EXPECT_EQ(first[1] % 4, 0u);
+
+		for(uint32_t index = begin; index < begin + 16; index++)
+		{
+			uint32_t offset[3];
+			ASSERT_TRUE(order.offset(index, offset));
+			EXPECT_GE(offset[0], first[0]);
+			EXPECT_LT(offset[0], first[0] + 4);
+			EXPECT_GE(offset[1], first[1]);
+			EXPECT_LT(offset[1], first[1] + 4);
+		}
+	}
+}
+
+TEST(WorkgroupOrder, SkipsExhaustedDimensions)
+{
+	// The padded dispatch is 16x2x1 rather than a 16x16x16 cube.
+	WorkgroupOrder order(16, 2, 1);
+	EXPECT_EQ(order.count(), 32u);
+
+	// Padding is rejected.
+	WorkgroupOrder padded(3, 3, 1);
+	EXPECT_EQ(padded.count(), 16u);
+
+	uint32_t offset[3];
+	EXPECT_TRUE(padded.offset(0, offset));
+	EXPECT_FALSE(padded.offset(15, offset));
+}
+
+TEST(WorkgroupOrder, LinearFallback)
+{
+	// 16 + 16 bits don't fit the 32-bit index space.
+	WorkgroupOrder order(65535, 65535, 1);
+	EXPECT_EQ(order.count(), 65535u * 65535u);
+
+	uint32_t offset[3];
+	ASSERT_TRUE(order.offset(0, offset));
+	EXPECT_EQ(offset[0], 0u);
+	EXPECT_EQ(offset[1], 0u);
+	EXPECT_EQ(offset[2], 0u);
+
+	ASSERT_TRUE(order.offset(65536, offset));
+	EXPECT_EQ(offset[0], 1u);
+	EXPECT_EQ(offset[1], 1u);
+	EXPECT_EQ(offset[2], 0u);
+
+	ASSERT_TRUE(order.offset(order.count() - 1, offset));
+	EXPECT_EQ(offset[0], 65534u);
+	EXPECT_EQ(offset[1], 65534u);
+	EXPECT_EQ(offset[2], 0u);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// IndexRange
+////////////////////////////////////////////////////////////////////////////////
+TEST(IndexRange, Pop)
+{
+	IndexRange range;
+	range.reset(5, 8);
+
+	uint32_t index = 0;
+	ASSERT_TRUE(range.pop(index));
+	EXPECT_EQ(index, 5u);
+	ASSERT_TRUE(range.pop(index));
+	EXPECT_EQ(index, 6u);
+	ASSERT_TRUE(range.pop(index));
+	EXPECT_EQ(index, 7u);
+	EXPECT_FALSE(range.pop(index));
+}
+
+TEST(IndexRange, Steal)
+{
+	IndexRange range;
+	range.reset(0, 10);
+
+	uint32_t begin = 0;
+	uint32_t end = 0;
+	ASSERT_TRUE(range.steal(begin, end));
+	EXPECT_EQ(begin, 5u);
+	EXPECT_EQ(end, 10u);
+
+	// The owner keeps the front half.
+	uint32_t index = 0;
+	for(uint32_t i = 0; i < 5; i++)
+	{
+		ASSERT_TRUE(range.pop(index));
+		EXPECT_EQ(index, i);
+	}
+	EXPECT_FALSE(range.pop(index));
+	EXPECT_FALSE(range.steal(begin, end));
+}
+
+TEST(IndexRange, StealLastIndex)
+{
+	IndexRange range;
+	range.reset(3, 4);
+
+	uint32_t begin = 0;
+	uint32_t end = 0;
+	ASSERT_TRUE(range.steal(begin, end));
+	EXPECT_EQ(begin, 3u);
+	EXPECT_EQ(end, 4u);
+
+	uint32_t index = 0;
+	EXPECT_FALSE(range.pop(index));
+}
+
+TEST(IndexRange, ConcurrentPopAndSteal)
+{
+	constexpr uint32_t threadCount = 8;
+	constexpr uint32_t indexCount = 100000;
+
+	std::vector<IndexRange> ranges(threadCount);
+	for(uint32_t i = 0; i < threadCount; i++)
+	{
+		ranges[i].reset(indexCount * i / threadCount, indexCount * (i + 1) / threadCount);
+	}
+
+	std::vector<std::atomic<int>> taken(indexCount);
+	for(auto &count : taken)
+	{
+		count = 0;
+	}
+
+	std::vector<std::thread> threads;
+	for(uint32_t i = 0; i < threadCount; i++)
+	{
+		threads.emplace_back([&, i] {
+			uint32_t index = 0;
+			for(;;)
+			{
+				while(ranges[i].pop(index))
+				{
+					taken[index]++;
+				}
+
+				bool stolen = false;
+				for(uint32_t j = 1; j < threadCount && !stolen; j++)
+				{
+					uint32_t begin = 0;
+					uint32_t end = 0;
+					if(ranges[(i + j) % threadCount].steal(begin, end))
+					{
+						ranges[i].reset(begin, end);
+						stolen = true;
+					}
+				}
+
+				if(!stolen)
+				{
+					return;
+				}
+			}
+		});
+	}
+
+	for(auto &thread : threads)
+	{
+		thread.join();
+	}
+
+	for(uint32_t i = 0; i < indexCount; i++)
+	{
+		ASSERT_EQ(taken[i], 1) << "Index " << i;
+	}
+}
@@ -0,0 +1,130 @@
+// Copyright 2022 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "DrawTester.hpp"
+#include "benchmark/benchmark.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Sets the number of threads used by the scheduler of devices created afterwards.
+static void SetThreadCount(int threadCount)
+{
+	std::string value = std::to_string(threadCount);
+#if defined(_WIN32)
+	_putenv_s("SWIFTSHADER_THREAD_COUNT", value.c_str());
+#else
+	setenv("SWIFTSHADER_THREAD_COUNT", value.c_str(), 1);
+#endif
+}
+
+static void ClearThreadCount()
+{
+#if defined(_WIN32)
+	_putenv_s("SWIFTSHADER_THREAD_COUNT", "");
+#else
+	unsetenv("SWIFTSHADER_THREAD_COUNT");
+#endif
+}
+
+// Renders a fullscreen quad with a fragment shader heavy enough for pixel
+// processing to dominate, using state.range(0) threads.
+static void FullscreenShading(benchmark::State &state)
+{
+	SetThreadCount(static_cast<int>(state.range(0)));
+
+	{
+		DrawTester tester;
+
+		tester.onCreateVertexBuffers([](DrawTester &tester) {
+			struct Vertex
+			{
+				float position[3];
+			};
+
+			Vertex vertexBufferData[] = {
+				{ { -1.0f, -1.0f, 0.5f } },
+				{ { 1.0f, -1.0f, 0.5f } },
+				{ { -1.0f, 1.0f, 0.5f } },
+				{ { -1.0f, 1.0f, 0.5f } },
+				{ { 1.0f, -1.0f, 0.5f } },
+				{ { 1.0f, 1.0f, 0.5f } }
+			};
+
+			std::vector<vk::VertexInputAttributeDescription> inputAttributes;
+			inputAttributes.push_back(vk::VertexInputAttributeDescription(0, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, position)));
+
+			tester.addVertexBuffer(vertexBufferData, sizeof(vertexBufferData), std::move(inputAttributes));
+		});
+
+		tester.onCreateVertexShader([](DrawTester &tester) {
+			const char *vertexShader = R"(#version 310 es
+				layout(location = 0) in vec3 inPos;
+
+				void main()
+				{
+					gl_Position = vec4(inPos.xyz, 1.0);
+				})";
+
+			return tester.createShaderModule(vertexShader, EShLanguage::EShLangVertex);
+		});
+
+		tester.onCreateFragmentShader([](DrawTester &tester) {
+			const char *fragmentShader = R"(#version 310 es
+				precision highp float;
+
+				layout(location = 0) out vec4 outColor;
+
+				void main()
+				{
+					vec2 p = gl_FragCoord.xy * 0.01;
+					vec3 color = vec3(0.0);
+					for(int i = 0; i < 16; i++)
+					{
+						color += sin(vec3(p, float(i)) * 1.7 + color.zxy);
+					}
+					outColor = vec4(color * 0.0625, 1.0);
+				})";
+
+			return tester.createShaderModule(fragmentShader, EShLanguage::EShLangFragment);
+		});
+
+		tester.initialize();
+
+		// Warmup
+		tester.renderFrame();
+
+		for(auto _ : state)
+		{
+			tester.renderFrame();
+		}
+	}
+
+	ClearThreadCount();
+}
+
+static void ThreadCounts(benchmark::internal::Benchmark *benchmark)
+{
+	int maxThreads = static_cast<int>(std::thread::hardware_concurrency());
+	for(int threads = 1; threads < maxThreads; threads *= 2)
+	{
+		benchmark->Arg(threads);
+	}
+	benchmark->Arg(std::max(maxThreads, 1));
+}
+
+BENCHMARK(FullscreenShading)->Apply(ThreadCounts)->ArgName("threads")->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,384 @@
+// Copyright 2022 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Tests of sampling images with block-compressed formats, which are uploaded
+// by copies from buffers. BC1-BC5 images are sampled directly from their
+// blocks, while images of other formats are decompressed to a copy when
+// they're prepared for sampling.
+
+#include "RenderTest.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <cstring>
+
+namespace {
+
+constexpr uint32_t width = 16;
+constexpr uint32_t height = 16;
+
+constexpr uint32_t blockSize = 4;  // Width and height of the blocks, in texels
+
+// An ETC2 block in differential mode, whose texels all have the given 5-bit base
+// color components, expanded to 8 bits, plus the smallest modifier of table 0.
+std::vector<uint8_t> etc2Block(uint8_t r, uint8_t g, uint8_t b)
+{
+	return { uint8_t(r << 3), uint8_t(g << 3), uint8_t(b << 3), 0x02, 0, 0, 0, 0 };
+}
+
+const std::vector<uint8_t> etc2Red = etc2Block(31, 0, 0);
+const std::vector<uint8_t> etc2Green = etc2Block(0, 31, 0);
+constexpr uint32_t etc2RedColor = 0xFF0202FF;
+constexpr uint32_t etc2GreenColor = 0xFF02FF02;
+
+// A BC1 block whose texels all have the given RGB565 color.
+std::vector<uint8_t> bc1Block(uint16_t color)
+{
+	return { uint8_t(color), uint8_t(color >> 8), 0, 0, 0, 0, 0, 0 };
+}
+
+// A BC4 block whose texels all have the given value.
+std::vector<uint8_t> bc4Block(uint8_t value)
+{
+	return { value, 0, 0, 0, 0, 0, 0, 0 };
+}
+
+std::vector<uint8_t> concat(std::vector<uint8_t> a, const std::vector<uint8_t> &b)
+{
+	a.insert(a.end(), b.begin(), b.end());
+	return a;
+}
+
+// Size of the decompressed copy the texture would have.
+constexpr VkDeviceSize decompressedSize = width * height * 4;
+
+// Draws a fullscreen triangle.
+const char *vertexShader = R"(
+               OpCapability Shader
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Vertex %main "main" %vertexIndex %position
+               OpDecorate %vertexIndex BuiltIn VertexIndex
+               OpDecorate %position BuiltIn Position
+       %void = OpTypeVoid
+         %fn = OpTypeFunction %void
+        %int = OpTypeInt 32 1
+      %float = OpTypeFloat 32
+    %v4float = OpTypeVector %float 4
+%ptr_in_int = OpTypePointer Input %int
+%vertexIndex = OpVariable %ptr_in_int Input
+%ptr_out_v4float = OpTypePointer Output %v4float
+   %position = OpVariable %ptr_out_v4float Output
+      %int_1 = OpConstant %int 1
+      %int_2 = OpConstant %int 2
+      %int_4 = OpConstant %int 4
+    %float_0 = OpConstant %float 0
+    %float_1 = OpConstant %float 1
+       %main = OpFunction %void None %fn
+      %entry = OpLabel
+         %vi = OpLoad %int %vertexIndex
+       %xbit = OpBitwiseAnd %int %vi %int_1
+         %xi = OpIMul %int %xbit %int_4
+       %ybit = OpBitwiseAnd %int %vi %int_2
+         %yi = OpIMul %int %ybit %int_2
+         %xf = OpConvertSToF %float %xi
+         %yf = OpConvertSToF %float %yi
+          %x = OpFSub %float %xf %float_1
+          %y = OpFSub %float %yf %float_1
+        %pos = OpCompositeConstruct %v4float %x %y %float_0 %float_1
+               OpStore %position %pos
+               OpReturn
+               OpFunctionEnd
+)";
+
+// Outputs the texture sampled at the center of the pixel.
+const char *sampleShader = R"(
+               OpCapability Shader
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Fragment %main "main" %fragCoord %color
+               OpExecutionMode %main OriginUpperLeft
+               OpDecorate %fragCoord BuiltIn FragCoord
+               OpDecorate %color Location 0
+               OpDecorate %texture DescriptorSet 0
+               OpDecorate %texture Binding 0
+       %void = OpTypeVoid
+         %fn = OpTypeFunction %void
+      %float = OpTypeFloat 32
+    %v2float = OpTypeVector %float 2
+    %v4float = OpTypeVector %float 4
+      %image = OpTypeImage %float 2D 0 0 0 1 Unknown
+%sampledImage = OpTypeSampledImage %image
+%ptr_sampledImage = OpTypePointer UniformConstant %sampledImage
+    %texture = OpVariable %ptr_sampledImage UniformConstant
+%ptr_in_v4float = OpTypePointer Input %v4float
+  %fragCoord = OpVariable %ptr_in_v4float Input
+%ptr_out_v4float = OpTypePointer Output %v4float
+      %color = OpVariable %ptr_out_v4float Output
+    %float_0 = OpConstant %float 0
+   %float_16 = OpConstant %float 16
+       %size = OpConstantComposite %v2float %float_16 %float_16
+       %main = OpFunction %void None %fn
+      %entry = OpLabel
+         %fc = OpLoad %v4float %fragCoord
+         %xy = OpVectorShuffle %v2float %fc %fc 0 1
+         %uv = OpFDiv %v2float %xy %size
+          %s = OpLoad %sampledImage %texture
+          %c = OpImageSampleExplicitLod %v4float %s %uv Lod %float_0
+               OpStore %color %c
+               OpReturn
+               OpFunctionEnd
+)";
+
+}  // anonymous namespace
+
+// Samples a 16x16 texture with a block-compressed format, to an R8G8B8A8_UNORM
+// output image of the same size.
+class CompressedImageTest : public RenderTest
+{
+protected:
+	CompressedImageTest()
+	    : RenderTest({ width, height })
+	{
+		enabledFeatures.textureCompressionETC2 = VK_TRUE;
+		enabledFeatures.textureCompressionBC = VK_TRUE;
+	}
+
+	void SetUp() override;
+
+	void createTexture(VkFormat format, VkImage *texture, VkImageView *view);
+
+	// Points the descriptor set to the texture. The set must not be in use.
+	void setTexture(VkImageView view);
+
+	// Returns the size of the memory required by the texture, which includes its decompressed copy, if any.
+	VkDeviceSize memorySize(VkImage texture);
+
+	// Checks that a texture of the given format, filled with the block, is
+	// sampled directly from its blocks, to the expected color.
+	void expectSampledDirectly(VkFormat format, const std::vector<uint8_t> &block, uint32_t expected);
+
+	// Records a copy of the same block to all blocks of the given texel region of the texture.
+	void upload(VkImage texture, const std::vector<uint8_t> &block, VkOffset2D offset, VkExtent2D size);
+
+	// Records a render pass which samples the texture the descriptor set points to,
+	// to the output image.
+	void sampleTexture();
+
+	VkImage outputImage = VK_NULL_HANDLE;
+	VkImageView outputView = VK_NULL_HANDLE;
+
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	VkFramebuffer framebuffer = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	VkSampler sampler = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+};
+
+void CompressedImageTest::SetUp()
+{
+	ASSERT_NO_FATAL_FAILURE(RenderTest::SetUp());
+
+	ASSERT_NO_FATAL_FAILURE(createImage(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+	                                    &outputImage, &outputView));
+
+	renderPass = createRenderPass({ VK_FORMAT_R8G8B8A8_UNORM }, VK_ATTACHMENT_LOAD_OP_CLEAR);
+	framebuffer = createFramebuffer(renderPass, { outputView });
+
+	const VkDescriptorSetLayoutBinding binding = {
+		0,                                          // binding
+		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+		1,                                          // descriptorCount
+		VK_SHADER_STAGE_FRAGMENT_BIT,               // stageFlags
+		nullptr,                                    // pImmutableSamplers
+	};
+
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	descriptorSet = createDescriptorSet({ binding }, &descriptorSetLayout);
+	sampler = createSampler(VK_FILTER_NEAREST);
+	pipelineLayout = createPipelineLayout({ descriptorSetLayout });
+
+	PipelineState state;
+	state.layout = pipelineLayout;
+	state.renderPass = renderPass;
+	state.vertexShader = createShaderModule(vertexShader);
+	state.fragmentShader = createShaderModule(sampleShader);
+	pipeline = createGraphicsPipeline(state);
+}
+
+void CompressedImageTest::createTexture(VkFormat format, VkImage *texture, VkImageView *view)
+{
+	ASSERT_NO_FATAL_FAILURE(createImage(format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, texture, view));
+}
+
+void CompressedImageTest::setTexture(VkImageView view)
+{
+	const VkDescriptorImageInfo imageInfo = { sampler, view, VK_IMAGE_LAYOUT_GENERAL };
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = descriptorSet;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &imageInfo;
+	driver.vkUpdateDescriptorSets(vkDevice, 1, &write, 0, nullptr);
+}
+
+VkDeviceSize CompressedImageTest::memorySize(VkImage texture)
+{
+	VkMemoryRequirements requirements;
+	driver.vkGetImageMemoryRequirements(vkDevice, texture, &requirements);
+
+	return requirements.size;
+}
+
+void CompressedImageTest::expectSampledDirectly(VkFormat format, const std::vector<uint8_t> &block, uint32_t expected)
+{
+	VkImage texture = VK_NULL_HANDLE;
+	VkImageView view = VK_NULL_HANDLE;
+	ASSERT_NO_FATAL_FAILURE(createTexture(format, &texture, &view));
+	EXPECT_LT(memorySize(texture), decompressedSize);
+
+	setTexture(view);
+	ASSERT_NO_FATAL_FAILURE(upload(texture, block, { 0, 0 }, { width, height }));
+
+	sampleTexture();
+	expectColor(outputImage, expected);
+}
+
+void CompressedImageTest::upload(VkImage texture, const std::vector<uint8_t> &block, VkOffset2D offset, VkExtent2D size)
+{
+	const size_t blockBytes = block.size();
+	uint32_t blockCount = (size.width / blockSize) * (size.height / blockSize);
+
+	VkBuffer buffer = VK_NULL_HANDLE;
+	uint8_t *data = nullptr;
+	ASSERT_NO_FATAL_FAILURE(createBuffer(blockCount * blockBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, &buffer, (void **)&data));
+	for(uint32_t i = 0; i < blockCount; i++)
+	{
+		memcpy(data + i * blockBytes, block.data(), blockBytes);
+	}
+
+	const VkBufferImageCopy region = {
+		0,                                       // bufferOffset
+		0,                                       // bufferRowLength
+		0,                                       // bufferImageHeight
+		{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },  // imageSubresource
+		{ offset.x, offset.y, 0 },               // imageOffset
+		{ size.width, size.height, 1 },          // imageExtent
+	};
+	driver.vkCmdCopyBufferToImage(commandBuffer, buffer, texture, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+}
+
+void CompressedImageTest::sampleTexture()
+{
+	barrier();
+
+	beginRenderPass(renderPass, framebuffer, { VkClearValue{} });
+	driver.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	driver.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0,
+	                               1, &descriptorSet, 0, nullptr);
+	driver.vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	endRenderPass();
+}
+
+// ETC2 images are sampled from a decompressed copy.
+TEST_F(CompressedImageTest, ETC2)
+{
+	VkImage texture = VK_NULL_HANDLE;
+	VkImageView view = VK_NULL_HANDLE;
+	ASSERT_NO_FATAL_FAILURE(createTexture(VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, &texture, &view));
+	EXPECT_GE(memorySize(texture), decompressedSize);
+
+	setTexture(view);
+	ASSERT_NO_FATAL_FAILURE(upload(texture, etc2Red, { 0, 0 }, { width, height }));
+
+	sampleTexture();
+	expectColor(outputImage, etc2RedColor);
+}
+
+// Only the blocks written since the texture was last sampled are decompressed
+// again, and sampling must observe them.
+TEST_F(CompressedImageTest, ETC2PartialUpdate)
+{
+	VkImage texture = VK_NULL_HANDLE;
+	VkImageView view = VK_NULL_HANDLE;
+	ASSERT_NO_FATAL_FAILURE(createTexture(VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, &texture, &view));
+	setTexture(view);
+	ASSERT_NO_FATAL_FAILURE(upload(texture, etc2Red, { 0, 0 }, { width, height }));
+
+	sampleTexture();
+	expectColor(outputImage, etc2RedColor);
+
+	ASSERT_NO_FATAL_FAILURE(upload(texture, etc2Green, { 4, 8 }, { 8, 4 }));
+
+	sampleTexture();
+	expectColor(outputImage, [](uint32_t x, uint32_t y) {
+		bool updated = (x >= 4) && (x < 12) && (y >= 8) && (y < 12);
+		return updated ? etc2GreenColor : etc2RedColor;
+	});
+}
+
+// Images are only prepared for sampling by walking the descriptor sets which
+// changed since they were last walked, or when images changed meanwhile. Here
+// no image changes between the draws, so only the update of the set must cause
+// the second texture to be decompressed.
+TEST_F(CompressedImageTest, DescriptorSetUpdate)
+{
+	VkImage textures[2] = {};
+	VkImageView views[2] = {};
+	ASSERT_NO_FATAL_FAILURE(createTexture(VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, &textures[0], &views[0]));
+	ASSERT_NO_FATAL_FAILURE(createTexture(VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, &textures[1], &views[1]));
+	ASSERT_NO_FATAL_FAILURE(upload(textures[0], etc2Red, { 0, 0 }, { width, height }));
+	ASSERT_NO_FATAL_FAILURE(upload(textures[1], etc2Green, { 0, 0 }, { width, height }));
+
+	setTexture(views[0]);
+	sampleTexture();
+	expectColor(outputImage, etc2RedColor);
+
+	// Sampling the same unchanged set again doesn't have to prepare anything.
+	sampleTexture();
+	expectColor(outputImage, etc2RedColor);
+
+	setTexture(views[1]);
+	sampleTexture();
+	expectColor(outputImage, etc2GreenColor);
+}
+
+// BC images which are only sampled and copied to don't have a decompressed copy.
+TEST_F(CompressedImageTest, BC1)
+{
+	expectSampledDirectly(VK_FORMAT_BC1_RGB_UNORM_BLOCK, bc1Block(0xF800), 0xFF0000FF);
+}
+
+// Blocks with explicit 4-bit alpha values, followed by a BC1 color block.
+TEST_F(CompressedImageTest, BC2)
+{
+	expectSampledDirectly(VK_FORMAT_BC2_UNORM_BLOCK, concat(std::vector<uint8_t>(8, 0x55), bc1Block(0x07E0)), 0x5500FF00);
+}
+
+// Blocks with interpolated alpha values, followed by a BC1 color block.
+TEST_F(CompressedImageTest, BC3)
+{
+	expectSampledDirectly(VK_FORMAT_BC3_UNORM_BLOCK, concat(bc4Block(0x80), bc1Block(0x001F)), 0x80FF0000);
+}
+
+TEST_F(CompressedImageTest, BC4)
+{
+	expectSampledDirectly(VK_FORMAT_BC4_UNORM_BLOCK, bc4Block(0xC0), 0xFF0000C0);
+}
+
+TEST_F(CompressedImageTest, BC5)
+{
+	expectSampledDirectly(VK_FORMAT_BC5_UNORM_BLOCK, concat(bc4Block(0xC0), bc4Block(0x40)), 0xFF0040C0);
+}
@@ -122,6 +122,11 @@ public:
 	void test(const std::string &shader,
 	          std::function<uint32_t(uint32_t idx)> input,
 	          std::function<uint32_t(uint32_t idx)> expected);
+
+protected:
+	// If true, the pipeline is created from a pipeline cache initialized with
+	// the data of another pipeline cache which was used to compile the shader.
+	bool usePipelineCacheData = false;
 };
 
 void SwiftShaderVulkanBufferToBufferComputeTest::test(
@@ -238,8 +243,38 @@ void SwiftShaderVulkanBufferToBufferComputeTest::test(
 	VkPipelineLayout pipelineLayout;
 	VK_ASSERT(device->CreatePipelineLayout(descriptorSetLayout, &pipelineLayout));
 
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+	if(usePipelineCacheData)
+	{
+		VkPipelineCache sourceCache;
+		VK_ASSERT(device->CreatePipelineCache({}, &sourceCache));
+
+		VkPipeline sourcePipeline;
+		VK_ASSERT(device->CreateComputePipeline(shaderModule, pipelineLayout, &sourcePipeline, sourceCache));
+		device->DestroyPipeline(sourcePipeline);
+
+		std::vector<uint8_t> data;
+		VK_ASSERT(device->GetPipelineCacheData(sourceCache, &data));
+		device->DestroyPipelineCache(sourceCache);
+
+		// The data must start with a VkPipelineCacheHeaderVersionOne header,
+		// followed by the optimized shader.
+		ASSERT_GT(data.size(), 32u);
+		uint32_t header[2];
+		memcpy(header, data.data(), sizeof(header));
+		EXPECT_EQ(header[0], 32u);
+		EXPECT_EQ(header[1], uint32_t(VK_PIPELINE_CACHE_HEADER_VERSION_ONE));
+
+		VK_ASSERT(device->CreatePipelineCache(data, &pipelineCache));
+
+		// Loading the data must preserve all of its entries.
+		std::vector<uint8_t> roundTripped;
+		VK_ASSERT(device->GetPipelineCacheData(pipelineCache, &roundTripped));
+		EXPECT_EQ(data, roundTripped);
+	}
+
 	VkPipeline pipeline;
-	VK_ASSERT(device->CreateComputePipeline(shaderModule, pipelineLayout, &pipeline));
+	VK_ASSERT(device->CreateComputePipeline(shaderModule, pipelineLayout, &pipeline, pipelineCache));
 
 	VkDescriptorPool descriptorPool;
 	VK_ASSERT(device->CreateStorageBufferDescriptorPool(2, &descriptorPool));
@@ -300,6 +335,10 @@ void SwiftShaderVulkanBufferToBufferComputeTest::test(
 	device->FreeCommandBuffer(commandPool, commandBuffer);
 	device->FreeMemory(memory);
 	device->DestroyPipeline(pipeline);
+	if(pipelineCache != VK_NULL_HANDLE)
+	{
+		device->DestroyPipelineCache(pipelineCache);
+	}
 	device->DestroyCommandPool(commandPool);
 	device->DestroyPipelineLayout(pipelineLayout);
 	device->DestroyDescriptorSetLayout(descriptorSetLayout);
@@ -316,7 +355,7 @@ INSTANTIATE_TEST_SUITE_P(ComputeParams, SwiftShaderVulkanBufferToBufferComputeTe
                                                                                                     // Non-multiple of SIMD-lane.
                                                                                                     ComputeParams{ 3, 1, 1, 1 }, ComputeParams{ 2, 1, 1, 1 }));
 
-TEST_P(SwiftShaderVulkanBufferToBufferComputeTest, Memcpy)
+std::string memcpyShader(const ComputeParams &params)
 {
 	std::stringstream src;
 	// #version 450
@@ -339,9 +378,9 @@ TEST_P(SwiftShaderVulkanBufferToBufferComputeTest, Memcpy)
         "OpMemoryModel Logical GLSL450\n"
         "OpEntryPoint GLCompute %1 \"main\" %2\n"
         "OpExecutionMode %1 LocalSize " <<
-        GetParam().localSizeX << " " <<
-        GetParam().localSizeY << " " <<
-        GetParam().localSizeZ << "\n" <<
+        params.localSizeX << " " <<
+        params.localSizeY << " " <<
+        params.localSizeZ << "\n" <<
         "OpDecorate %3 ArrayStride 4\n"
         "OpMemberDecorate %4 0 Offset 0\n"
         "OpDecorate %4 BufferBlock\n"
@@ -378,8 +417,20 @@ TEST_P(SwiftShaderVulkanBufferToBufferComputeTest, Memcpy)
         "OpFunctionEnd\n";
 	// clang-format on
 
+	return src.str();
+}
+
+TEST_P(SwiftShaderVulkanBufferToBufferComputeTest, Memcpy)
+{
+	test(
+	    memcpyShader(GetParam()), [](uint32_t i) { return i; }, [](uint32_t i) { return i; });
+}
+
+TEST_P(SwiftShaderVulkanBufferToBufferComputeTest, MemcpyWithPipelineCacheData)
+{
+	usePipelineCacheData = true;
 	test(
-	    src.str(), [](uint32_t i) { return i; }, [](uint32_t i) { return i; });
+	    memcpyShader(GetParam()), [](uint32_t i) { return i; }, [](uint32_t i) { return i; });
 }
 
 TEST_P(SwiftShaderVulkanBufferToBufferComputeTest, GlobalInvocationId)
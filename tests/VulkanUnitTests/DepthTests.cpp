@@ -0,0 +1,458 @@
+// Copyright 2022 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Tests of the depth test, in particular of the hierarchical Z rejection of
+// framebuffer tiles, which must stay consistent with the per-fragment test
+// for every compare op and be invalidated by every other depth write.
+
+#include "RenderTest.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <map>
+
+namespace {
+
+// Covers multiple Hi-Z tiles.
+constexpr uint32_t width = 64;
+constexpr uint32_t height = 64;
+
+constexpr uint32_t red = 0xFF0000FF;
+constexpr uint32_t green = 0xFF00FF00;
+constexpr uint32_t blue = 0xFFFF0000;
+
+// Draws a fullscreen triangle at the depth given by the push constants, which
+// increases by their slope per unit of x in normalized device coordinates.
+const char *vertexShader = R"(
+               OpCapability Shader
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Vertex %main "main" %vertexIndex %position
+               OpDecorate %vertexIndex BuiltIn VertexIndex
+               OpDecorate %position BuiltIn Position
+               OpDecorate %PushConstants Block
+               OpMemberDecorate %PushConstants 0 Offset 0
+               OpMemberDecorate %PushConstants 1 Offset 16
+               OpMemberDecorate %PushConstants 2 Offset 20
+       %void = OpTypeVoid
+         %fn = OpTypeFunction %void
+        %int = OpTypeInt 32 1
+      %float = OpTypeFloat 32
+    %v4float = OpTypeVector %float 4
+%PushConstants = OpTypeStruct %v4float %float %float
+%ptr_PushConstants = OpTypePointer PushConstant %PushConstants
+         %pc = OpVariable %ptr_PushConstants PushConstant
+%ptr_pc_float = OpTypePointer PushConstant %float
+%ptr_in_int = OpTypePointer Input %int
+%vertexIndex = OpVariable %ptr_in_int Input
+%ptr_out_v4float = OpTypePointer Output %v4float
+   %position = OpVariable %ptr_out_v4float Output
+      %int_1 = OpConstant %int 1
+      %int_2 = OpConstant %int 2
+      %int_4 = OpConstant %int 4
+    %float_1 = OpConstant %float 1
+       %main = OpFunction %void None %fn
+      %entry = OpLabel
+         %vi = OpLoad %int %vertexIndex
+       %xbit = OpBitwiseAnd %int %vi %int_1
+         %xi = OpIMul %int %xbit %int_4
+       %ybit = OpBitwiseAnd %int %vi %int_2
+         %yi = OpIMul %int %ybit %int_2
+         %xf = OpConvertSToF %float %xi
+         %yf = OpConvertSToF %float %yi
+          %x = OpFSub %float %xf %float_1
+          %y = OpFSub %float %yf %float_1
+   %depthptr = OpAccessChain %ptr_pc_float %pc %int_1
+      %depth = OpLoad %float %depthptr
+   %slopeptr = OpAccessChain %ptr_pc_float %pc %int_2
+      %slope = OpLoad %float %slopeptr
+       %zoff = OpFMul %float %slope %x
+          %z = OpFAdd %float %depth %zoff
+        %pos = OpCompositeConstruct %v4float %x %y %z %float_1
+               OpStore %position %pos
+               OpReturn
+               OpFunctionEnd
+)";
+
+// Outputs the color given by the push constants.
+const char *fragmentShader = R"(
+               OpCapability Shader
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Fragment %main "main" %color
+               OpExecutionMode %main OriginUpperLeft
+               OpDecorate %color Location 0
+               OpDecorate %PushConstants Block
+               OpMemberDecorate %PushConstants 0 Offset 0
+               OpMemberDecorate %PushConstants 1 Offset 16
+               OpMemberDecorate %PushConstants 2 Offset 20
+       %void = OpTypeVoid
+         %fn = OpTypeFunction %void
+        %int = OpTypeInt 32 1
+      %float = OpTypeFloat 32
+    %v4float = OpTypeVector %float 4
+%PushConstants = OpTypeStruct %v4float %float %float
+%ptr_PushConstants = OpTypePointer PushConstant %PushConstants
+         %pc = OpVariable %ptr_PushConstants PushConstant
+%ptr_pc_v4float = OpTypePointer PushConstant %v4float
+%ptr_out_v4float = OpTypePointer Output %v4float
+      %color = OpVariable %ptr_out_v4float Output
+      %int_0 = OpConstant %int 0
+       %main = OpFunction %void None %fn
+      %entry = OpLabel
+       %cptr = OpAccessChain %ptr_pc_v4float %pc %int_0
+          %c = OpLoad %v4float %cptr
+               OpStore %color %c
+               OpReturn
+               OpFunctionEnd
+)";
+
+struct PushConstants
+{
+	float color[4];
+	float depth;
+	float slope;
+};
+
+}  // anonymous namespace
+
+// Renders to a 64x64 R8G8B8A8_UNORM color attachment and a D32_SFLOAT depth
+// attachment.
+class DepthTest : public RenderTest
+{
+protected:
+	DepthTest()
+	    : RenderTest({ width, height })
+	{}
+
+	void SetUp() override;
+
+	// Records the start of a render pass which either clears the attachments,
+	// or loads their contents.
+	void beginRenderPass(bool clear, float clearDepth = 1.0f);
+
+	// Records a fullscreen draw with the given depth compare op, which writes
+	// the color and depth. The depth ranges from depth - slope at the left edge
+	// to depth + slope at the right edge.
+	void draw(VkCompareOp compareOp, uint32_t color, float depth, float slope = 0.0f);
+
+	VkPipeline pipeline(VkCompareOp compareOp);
+
+	VkImage colorImage = VK_NULL_HANDLE;
+	VkImage depthImage = VK_NULL_HANDLE;
+	VkImageView colorView = VK_NULL_HANDLE;
+	VkImageView depthView = VK_NULL_HANDLE;
+
+	VkRenderPass clearRenderPass = VK_NULL_HANDLE;
+	VkRenderPass loadRenderPass = VK_NULL_HANDLE;
+	VkFramebuffer framebuffer = VK_NULL_HANDLE;
+
+	VkShaderModule vertexModule = VK_NULL_HANDLE;
+	VkShaderModule fragmentModule = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	std::map<VkCompareOp, VkPipeline> pipelines;
+};
+
+void DepthTest::SetUp()
+{
+	ASSERT_NO_FATAL_FAILURE(RenderTest::SetUp());
+
+	ASSERT_NO_FATAL_FAILURE(createImage(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+	                                    &colorImage, &colorView));
+	ASSERT_NO_FATAL_FAILURE(createImage(VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+	                                    &depthImage, &depthView));
+
+	clearRenderPass = createRenderPass({ VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_D32_SFLOAT }, VK_ATTACHMENT_LOAD_OP_CLEAR);
+	loadRenderPass = createRenderPass({ VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_D32_SFLOAT }, VK_ATTACHMENT_LOAD_OP_LOAD);
+	framebuffer = createFramebuffer(clearRenderPass, { colorView, depthView });
+
+	vertexModule = createShaderModule(vertexShader);
+	fragmentModule = createShaderModule(fragmentShader);
+	pipelineLayout = createPipelineLayout({}, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PushConstants));
+}
+
+VkPipeline DepthTest::pipeline(VkCompareOp compareOp)
+{
+	auto it = pipelines.find(compareOp);
+	if(it != pipelines.end())
+	{
+		return it->second;
+	}
+
+	const VkPipelineDepthStencilStateCreateInfo depthStencilState = {
+		VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,  // sType
+		nullptr,                                                     // pNext
+		0,                                                           // flags
+		VK_TRUE,                                                     // depthTestEnable
+		VK_TRUE,                                                     // depthWriteEnable
+		compareOp,                                                   // depthCompareOp
+	};
+
+	PipelineState state;
+	state.layout = pipelineLayout;
+	state.renderPass = clearRenderPass;
+	state.vertexShader = vertexModule;
+	state.fragmentShader = fragmentModule;
+	state.depthStencilState = &depthStencilState;
+
+	return pipelines[compareOp] = createGraphicsPipeline(state);
+}
+
+void DepthTest::beginRenderPass(bool clear, float clearDepth)
+{
+	VkClearValue clearValues[2];
+	clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+	clearValues[1].depthStencil = { clearDepth, 0 };
+
+	if(clear)
+	{
+		RenderTest::beginRenderPass(clearRenderPass, framebuffer, { clearValues[0], clearValues[1] });
+	}
+	else
+	{
+		RenderTest::beginRenderPass(loadRenderPass, framebuffer);
+	}
+}
+
+void DepthTest::draw(VkCompareOp compareOp, uint32_t color, float depth, float slope)
+{
+	PushConstants pushConstants = {
+		{
+		    float(color & 0xFF) / 255.0f,
+		    float((color >> 8) & 0xFF) / 255.0f,
+		    float((color >> 16) & 0xFF) / 255.0f,
+		    float((color >> 24) & 0xFF) / 255.0f,
+		},
+		depth,
+		slope,
+	};
+
+	driver.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline(compareOp));
+	driver.vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+	                          0, sizeof(pushConstants), &pushConstants);
+	driver.vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
+
+TEST_F(DepthTest, Less)
+{
+	beginRenderPass(true, 1.0f);
+	draw(VK_COMPARE_OP_LESS, red, 0.5f);
+	draw(VK_COMPARE_OP_LESS, green, 0.75f);
+	draw(VK_COMPARE_OP_LESS, green, 0.5f);
+	endRenderPass();
+
+	expectColor(colorImage, red);
+}
+
+TEST_F(DepthTest, LessAfterWrite)
+{
+	beginRenderPass(true, 1.0f);
+	draw(VK_COMPARE_OP_LESS, red, 0.5f);
+	draw(VK_COMPARE_OP_LESS, blue, 0.25f);
+	endRenderPass();
+
+	expectColor(colorImage, blue);
+}
+
+TEST_F(DepthTest, LessOrEqual)
+{
+	beginRenderPass(true, 1.0f);
+	draw(VK_COMPARE_OP_LESS_OR_EQUAL, red, 0.5f);
+	draw(VK_COMPARE_OP_LESS_OR_EQUAL, green, 0.75f);
+	draw(VK_COMPARE_OP_LESS_OR_EQUAL, blue, 0.5f);
+	endRenderPass();
+
+	expectColor(colorImage, blue);
+}
+
+TEST_F(DepthTest, Greater)
+{
+	beginRenderPass(true, 0.0f);
+	draw(VK_COMPARE_OP_GREATER, red, 0.5f);
+	draw(VK_COMPARE_OP_GREATER, green, 0.25f);
+	draw(VK_COMPARE_OP_GREATER, green, 0.5f);
+	endRenderPass();
+
+	expectColor(colorImage, red);
+}
+
+TEST_F(DepthTest, GreaterAfterWrite)
+{
+	beginRenderPass(true, 0.0f);
+	draw(VK_COMPARE_OP_GREATER, red, 0.5f);
+	draw(VK_COMPARE_OP_GREATER, blue, 0.75f);
+	endRenderPass();
+
+	expectColor(colorImage, blue);
+}
+
+TEST_F(DepthTest, GreaterOrEqual)
+{
+	beginRenderPass(true, 0.0f);
+	draw(VK_COMPARE_OP_GREATER_OR_EQUAL, red, 0.5f);
+	draw(VK_COMPARE_OP_GREATER_OR_EQUAL, green, 0.25f);
+	draw(VK_COMPARE_OP_GREATER_OR_EQUAL, blue, 0.5f);
+	endRenderPass();
+
+	expectColor(colorImage, blue);
+}
+
+TEST_F(DepthTest, Equal)
+{
+	beginRenderPass(true, 0.5f);
+	draw(VK_COMPARE_OP_EQUAL, red, 0.5f);
+	draw(VK_COMPARE_OP_EQUAL, green, 0.75f);
+	draw(VK_COMPARE_OP_EQUAL, green, 0.25f);
+	endRenderPass();
+
+	expectColor(colorImage, red);
+}
+
+// Draws with opposite compare ops use opposite bounds of the tiles, which
+// must both remain valid.
+TEST_F(DepthTest, LessThenGreater)
+{
+	beginRenderPass(true, 1.0f);
+	draw(VK_COMPARE_OP_LESS, red, 0.25f);
+	draw(VK_COMPARE_OP_LESS, red, 0.3f);  // Computes exact bounds
+	draw(VK_COMPARE_OP_GREATER, green, 0.5f);
+	draw(VK_COMPARE_OP_GREATER, blue, 0.4f);
+	endRenderPass();
+
+	expectColor(colorImage, green);
+}
+
+TEST_F(DepthTest, GreaterThenLess)
+{
+	beginRenderPass(true, 0.0f);
+	draw(VK_COMPARE_OP_GREATER, red, 0.75f);
+	draw(VK_COMPARE_OP_GREATER, red, 0.7f);  // Computes exact bounds
+	draw(VK_COMPARE_OP_LESS, green, 0.5f);
+	draw(VK_COMPARE_OP_LESS, blue, 0.6f);
+	endRenderPass();
+
+	expectColor(colorImage, green);
+}
+
+// The depth increases from 0.25 at the left edge to 0.75 at the right edge, so
+// the bounds of each tile differ. Fragments with depth in between them pass on
+// one side of the pixel where the stored depth is equal.
+TEST_F(DepthTest, LessSloped)
+{
+	beginRenderPass(true, 1.0f);
+	draw(VK_COMPARE_OP_LESS, red, 0.5f, 0.25f);
+	draw(VK_COMPARE_OP_LESS, red, 0.5f, 0.25f);  // Computes exact bounds
+	draw(VK_COMPARE_OP_LESS, green, 0.6f);
+	endRenderPass();
+
+	// The stored depth is 0.6 at x = 44.8.
+	expectColor(colorImage, [](uint32_t x, uint32_t y) { return (x < 45) ? red : green; });
+}
+
+TEST_F(DepthTest, GreaterSloped)
+{
+	beginRenderPass(true, 0.0f);
+	draw(VK_COMPARE_OP_GREATER, red, 0.5f, 0.25f);
+	draw(VK_COMPARE_OP_GREATER, red, 0.5f, 0.25f);  // Computes exact bounds
+	draw(VK_COMPARE_OP_GREATER, green, 0.4f);
+	endRenderPass();
+
+	// The stored depth is 0.4 at x = 19.2.
+	expectColor(colorImage, [](uint32_t x, uint32_t y) { return (x < 19) ? green : red; });
+}
+
+TEST_F(DepthTest, EqualSloped)
+{
+	beginRenderPass(true, 1.0f);
+	draw(VK_COMPARE_OP_LESS, red, 0.5f, 0.25f);
+	draw(VK_COMPARE_OP_EQUAL, green, 0.5f, 0.25f);
+	draw(VK_COMPARE_OP_EQUAL, blue, 0.8f);
+	endRenderPass();
+
+	expectColor(colorImage, green);
+}
+
+// Clearing the depth attachment within a render pass invalidates the tiles.
+TEST_F(DepthTest, ClearAttachments)
+{
+	beginRenderPass(true, 1.0f);
+	draw(VK_COMPARE_OP_LESS, red, 0.25f);
+	draw(VK_COMPARE_OP_LESS, red, 0.3f);  // Computes exact bounds
+
+	VkClearAttachment depthClear = {};
+	depthClear.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	depthClear.clearValue.depthStencil = { 1.0f, 0 };
+	const VkClearRect clearRect = { { { 0, 0 }, { width, height } }, 0, 1 };
+	driver.vkCmdClearAttachments(commandBuffer, 1, &depthClear, 1, &clearRect);
+
+	draw(VK_COMPARE_OP_LESS, green, 0.5f);
+	endRenderPass();
+
+	expectColor(colorImage, green);
+}
+
+// Depth written by transfer commands between render passes isn't seen by the
+// tiles of the previous render pass.
+TEST_F(DepthTest, ClearDepthStencilImage)
+{
+	beginRenderPass(true, 1.0f);
+	draw(VK_COMPARE_OP_LESS, red, 0.25f);
+	draw(VK_COMPARE_OP_LESS, red, 0.3f);  // Computes exact bounds
+	endRenderPass();
+
+	barrier();
+	const VkClearDepthStencilValue clearValue = { 1.0f, 0 };
+	const VkImageSubresourceRange range = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+	driver.vkCmdClearDepthStencilImage(commandBuffer, depthImage, VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &range);
+	barrier();
+
+	beginRenderPass(false);
+	draw(VK_COMPARE_OP_LESS, green, 0.5f);
+	endRenderPass();
+
+	expectColor(colorImage, green);
+}
+
+TEST_F(DepthTest, CopyBufferToImage)
+{
+	VkBuffer buffer = VK_NULL_HANDLE;
+	float *bufferData = nullptr;
+	ASSERT_NO_FATAL_FAILURE(createBuffer(width * height * sizeof(float), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, &buffer, (void **)&bufferData));
+	for(uint32_t i = 0; i < width * height; i++)
+	{
+		bufferData[i] = 1.0f;
+	}
+
+	beginRenderPass(true, 1.0f);
+	draw(VK_COMPARE_OP_LESS, red, 0.25f);
+	draw(VK_COMPARE_OP_LESS, red, 0.3f);  // Computes exact bounds
+	endRenderPass();
+
+	barrier();
+	const VkBufferImageCopy region = {
+		0,                                          // bufferOffset
+		0,                                          // bufferRowLength
+		0,                                          // bufferImageHeight
+		{ VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1 },     // imageSubresource
+		{ 0, 0, 0 },                                // imageOffset
+		{ width, height, 1 },                       // imageExtent
+	};
+	driver.vkCmdCopyBufferToImage(commandBuffer, buffer, depthImage, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+	barrier();
+
+	beginRenderPass(false);
+	draw(VK_COMPARE_OP_LESS, green, 0.5f);
+	endRenderPass();
+
+	expectColor(colorImage, green);
+}
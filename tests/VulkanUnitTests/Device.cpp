@@ -45,8 +45,14 @@ bool Device::IsValid() const
 	return device != nullptr;
 }
 
+VkDevice Device::GetVkDevice() const
+{
+	return device;
+}
+
 VkResult Device::CreateComputeDevice(
-    const Driver *driver, VkInstance instance, std::unique_ptr<Device> &out)
+    const Driver *driver, VkInstance instance, std::unique_ptr<Device> &out,
+    const VkPhysicalDeviceFeatures *features)
 {
 	VkResult result;
 
@@ -87,7 +93,7 @@ VkResult Device::CreateComputeDevice(
 			nullptr,                               // ppEnabledLayerNames
 			0,                                     // enabledExtensionCount
 			nullptr,                               // ppEnabledExtensionNames
-			nullptr,                               // pEnabledFeatures
+			features,                              // pEnabledFeatures
 		};
 
 		VkDevice device;
@@ -242,7 +248,7 @@ void Device::DestroyPipelineLayout(VkPipelineLayout pipelineLayout) const
 
 VkResult Device::CreateComputePipeline(
     VkShaderModule module, VkPipelineLayout pipelineLayout,
-    VkPipeline *out) const
+    VkPipeline *out, VkPipelineCache pipelineCache) const
 {
 	VkComputePipelineCreateInfo info = {
 		VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,  // sType
@@ -263,7 +269,7 @@ VkResult Device::CreateComputePipeline(
 		0,               // basePipelineIndex
 	};
 
-	return driver->vkCreateComputePipelines(device, 0, 1, &info, 0, out);
+	return driver->vkCreateComputePipelines(device, pipelineCache, 1, &info, 0, out);
 }
 
 void Device::DestroyPipeline(VkPipeline pipeline) const
@@ -271,6 +277,39 @@ void Device::DestroyPipeline(VkPipeline pipeline) const
 	driver->vkDestroyPipeline(device, pipeline, nullptr);
 }
 
+VkResult Device::CreatePipelineCache(const std::vector<uint8_t> &initialData,
+                                     VkPipelineCache *out) const
+{
+	VkPipelineCacheCreateInfo info = {
+		VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,  // sType
+		nullptr,                                       // pNext
+		0,                                             // flags
+		initialData.size(),                            // initialDataSize
+		initialData.data(),                            // pInitialData
+	};
+
+	return driver->vkCreatePipelineCache(device, &info, nullptr, out);
+}
+
+VkResult Device::GetPipelineCacheData(VkPipelineCache pipelineCache,
+                                      std::vector<uint8_t> *out) const
+{
+	size_t size = 0;
+	VkResult result = driver->vkGetPipelineCacheData(device, pipelineCache, &size, nullptr);
+	if(result != VK_SUCCESS)
+	{
+		return result;
+	}
+
+	out->resize(size);
+	return driver->vkGetPipelineCacheData(device, pipelineCache, &size, out->data());
+}
+
+void Device::DestroyPipelineCache(VkPipelineCache pipelineCache) const
+{
+	driver->vkDestroyPipelineCache(device, pipelineCache, nullptr);
+}
+
 VkResult Device::CreateStorageBufferDescriptorPool(uint32_t descriptorCount,
                                                    VkDescriptorPool *out) const
 {
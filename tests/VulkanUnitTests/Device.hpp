@@ -34,12 +34,19 @@ public:
 	// If a compatible physical device is not found, VK_SUCCESS will still be
 	// returned (as there was no Vulkan error), but calling Device::IsValid()
 	// on this device will return false.
+	// If features is not null, the features it enables are enabled on the
+	// device.
 	static VkResult CreateComputeDevice(
-	    const Driver *driver, VkInstance instance, std::unique_ptr<Device> &out);
+	    const Driver *driver, VkInstance instance, std::unique_ptr<Device> &out,
+	    const VkPhysicalDeviceFeatures *features = nullptr);
 
 	// IsValid returns true if the Device is initialized and can be used.
 	bool IsValid() const;
 
+	// GetVkDevice returns the wrapped VkDevice, for tests which call the
+	// driver directly.
+	VkDevice GetVkDevice() const;
+
 	// CreateBuffer creates a new buffer with the
 	// VK_BUFFER_USAGE_STORAGE_BUFFER_BIT usage, and
 	// VK_SHARING_MODE_EXCLUSIVE sharing mode.
@@ -74,14 +81,28 @@ public:
 	void DestroyPipelineLayout(VkPipelineLayout pipelineLayout) const;
 
 	// CreateComputePipeline creates a new compute pipeline with the entry point
-	// "main".
+	// "main". If pipelineCache is not VK_NULL_HANDLE, it is used to create the
+	// pipeline.
 	VkResult CreateComputePipeline(VkShaderModule module,
 	                               VkPipelineLayout pipelineLayout,
-	                               VkPipeline *out) const;
+	                               VkPipeline *out,
+	                               VkPipelineCache pipelineCache = VK_NULL_HANDLE) const;
 
 	// DestroyPipeline destroys a graphics or compute pipeline.
 	void DestroyPipeline(VkPipeline pipeline) const;
 
+	// CreatePipelineCache creates a new pipeline cache, initialized with the
+	// given data.
+	VkResult CreatePipelineCache(const std::vector<uint8_t> &initialData,
+	                             VkPipelineCache *out) const;
+
+	// GetPipelineCacheData retrieves the data of a pipeline cache.
+	VkResult GetPipelineCacheData(VkPipelineCache pipelineCache,
+	                              std::vector<uint8_t> *out) const;
+
+	// DestroyPipelineCache destroys a VkPipelineCache.
+	void DestroyPipelineCache(VkPipelineCache pipelineCache) const;
+
 	// CreateStorageBufferDescriptorPool creates a new descriptor pool that can
 	// hold descriptorCount storage buffers.
 	VkResult CreateStorageBufferDescriptorPool(uint32_t descriptorCount,
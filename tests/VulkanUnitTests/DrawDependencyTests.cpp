@@ -0,0 +1,313 @@
+// Copyright 2022 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Tests of the ordering of draws which sample images rendered to by prior
+// draws. Only draws which read the prior draws' attachments, after a barrier,
+// have to wait for them to complete. The implicit dependency at the end of
+// each render pass is the barrier, which doesn't make the device idle like
+// pipeline barriers to all commands do.
+
+#include "RenderTest.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// Large enough for draws to take a while to complete.
+constexpr uint32_t width = 256;
+constexpr uint32_t height = 256;
+
+constexpr uint32_t green = 0xFF00FF00;
+constexpr uint32_t red = 0xFF0000FF;
+constexpr uint32_t blue = 0xFFFF0000;
+
+// Draws a fullscreen triangle.
+const char *vertexShader = R"(
+               OpCapability Shader
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Vertex %main "main" %vertexIndex %position
+               OpDecorate %vertexIndex BuiltIn VertexIndex
+               OpDecorate %position BuiltIn Position
+       %void = OpTypeVoid
+         %fn = OpTypeFunction %void
+        %int = OpTypeInt 32 1
+      %float = OpTypeFloat 32
+    %v4float = OpTypeVector %float 4
+%ptr_in_int = OpTypePointer Input %int
+%vertexIndex = OpVariable %ptr_in_int Input
+%ptr_out_v4float = OpTypePointer Output %v4float
+   %position = OpVariable %ptr_out_v4float Output
+      %int_1 = OpConstant %int 1
+      %int_2 = OpConstant %int 2
+      %int_4 = OpConstant %int 4
+    %float_0 = OpConstant %float 0
+    %float_1 = OpConstant %float 1
+       %main = OpFunction %void None %fn
+      %entry = OpLabel
+         %vi = OpLoad %int %vertexIndex
+       %xbit = OpBitwiseAnd %int %vi %int_1
+         %xi = OpIMul %int %xbit %int_4
+       %ybit = OpBitwiseAnd %int %vi %int_2
+         %yi = OpIMul %int %ybit %int_2
+         %xf = OpConvertSToF %float %xi
+         %yf = OpConvertSToF %float %yi
+          %x = OpFSub %float %xf %float_1
+          %y = OpFSub %float %yf %float_1
+        %pos = OpCompositeConstruct %v4float %x %y %float_0 %float_1
+               OpStore %position %pos
+               OpReturn
+               OpFunctionEnd
+)";
+
+// Outputs the color given by the push constants.
+const char *fillShader = R"(
+               OpCapability Shader
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Fragment %main "main" %color
+               OpExecutionMode %main OriginUpperLeft
+               OpDecorate %color Location 0
+               OpDecorate %PushConstants Block
+               OpMemberDecorate %PushConstants 0 Offset 0
+       %void = OpTypeVoid
+         %fn = OpTypeFunction %void
+        %int = OpTypeInt 32 1
+      %float = OpTypeFloat 32
+    %v4float = OpTypeVector %float 4
+%PushConstants = OpTypeStruct %v4float
+%ptr_PushConstants = OpTypePointer PushConstant %PushConstants
+         %pc = OpVariable %ptr_PushConstants PushConstant
+%ptr_pc_v4float = OpTypePointer PushConstant %v4float
+%ptr_out_v4float = OpTypePointer Output %v4float
+      %color = OpVariable %ptr_out_v4float Output
+      %int_0 = OpConstant %int 0
+       %main = OpFunction %void None %fn
+      %entry = OpLabel
+          %p = OpAccessChain %ptr_pc_v4float %pc %int_0
+          %c = OpLoad %v4float %p
+               OpStore %color %c
+               OpReturn
+               OpFunctionEnd
+)";
+
+// Outputs the texel of the texture at the mirrored pixel coordinates. Draws are
+// processed in order per tile cluster, so the texel is read from another tile
+// than the one written to, which a prior draw may still be rendering to.
+const char *fetchShader = R"(
+               OpCapability Shader
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Fragment %main "main" %fragCoord %color
+               OpExecutionMode %main OriginUpperLeft
+               OpDecorate %fragCoord BuiltIn FragCoord
+               OpDecorate %color Location 0
+               OpDecorate %texture DescriptorSet 0
+               OpDecorate %texture Binding 0
+       %void = OpTypeVoid
+         %fn = OpTypeFunction %void
+        %int = OpTypeInt 32 1
+      %v2int = OpTypeVector %int 2
+      %float = OpTypeFloat 32
+    %v2float = OpTypeVector %float 2
+    %v4float = OpTypeVector %float 4
+      %image = OpTypeImage %float 2D 0 0 0 1 Unknown
+%sampledImage = OpTypeSampledImage %image
+%ptr_sampledImage = OpTypePointer UniformConstant %sampledImage
+    %texture = OpVariable %ptr_sampledImage UniformConstant
+%ptr_in_v4float = OpTypePointer Input %v4float
+  %fragCoord = OpVariable %ptr_in_v4float Input
+%ptr_out_v4float = OpTypePointer Output %v4float
+      %color = OpVariable %ptr_out_v4float Output
+      %int_0 = OpConstant %int 0
+    %int_255 = OpConstant %int 255
+  %v2int_255 = OpConstantComposite %v2int %int_255 %int_255
+       %main = OpFunction %void None %fn
+      %entry = OpLabel
+         %fc = OpLoad %v4float %fragCoord
+         %xy = OpVectorShuffle %v2float %fc %fc 0 1
+      %pixel = OpConvertFToS %v2int %xy
+        %ixy = OpISub %v2int %v2int_255 %pixel
+          %s = OpLoad %sampledImage %texture
+          %i = OpImage %image %s
+          %c = OpImageFetch %v4float %i %ixy Lod %int_0
+               OpStore %color %c
+               OpReturn
+               OpFunctionEnd
+)";
+
+}  // anonymous namespace
+
+// Renders to two 256x256 R8G8B8A8_UNORM textures, and copies either of them to
+// an identical output image by fetching its texels through a descriptor set.
+class DrawDependencyTest : public RenderTest
+{
+protected:
+	DrawDependencyTest()
+	    : RenderTest({ width, height })
+	{}
+
+	void SetUp() override;
+
+	// Points the descriptor set to the given texture. The set must not be in use.
+	void setTexture(int texture);
+
+	// Records a render pass which fills the texture with the given color.
+	void fill(int texture, uint32_t color);
+
+	// Records a render pass which copies the texture the descriptor set points to
+	// to the output image.
+	void copyTexture();
+
+	VkImage textureImages[2] = {};
+	VkImageView textureViews[2] = {};
+	VkFramebuffer textureFramebuffers[2] = {};
+
+	VkImage outputImage = VK_NULL_HANDLE;
+	VkImageView outputView = VK_NULL_HANDLE;
+	VkFramebuffer outputFramebuffer = VK_NULL_HANDLE;
+
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	VkSampler sampler = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline fillPipeline = VK_NULL_HANDLE;
+	VkPipeline fetchPipeline = VK_NULL_HANDLE;
+};
+
+void DrawDependencyTest::SetUp()
+{
+	ASSERT_NO_FATAL_FAILURE(RenderTest::SetUp());
+
+	renderPass = createRenderPass({ VK_FORMAT_R8G8B8A8_UNORM }, VK_ATTACHMENT_LOAD_OP_LOAD);
+
+	for(int i = 0; i < 2; i++)
+	{
+		ASSERT_NO_FATAL_FAILURE(createImage(VK_FORMAT_R8G8B8A8_UNORM,
+		                                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+		                                    &textureImages[i], &textureViews[i]));
+		textureFramebuffers[i] = createFramebuffer(renderPass, { textureViews[i] });
+	}
+
+	ASSERT_NO_FATAL_FAILURE(createImage(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+	                                    &outputImage, &outputView));
+	outputFramebuffer = createFramebuffer(renderPass, { outputView });
+
+	const VkDescriptorSetLayoutBinding binding = {
+		0,                                          // binding
+		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+		1,                                          // descriptorCount
+		VK_SHADER_STAGE_FRAGMENT_BIT,               // stageFlags
+		nullptr,                                    // pImmutableSamplers
+	};
+
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	descriptorSet = createDescriptorSet({ binding }, &descriptorSetLayout);
+	sampler = createSampler(VK_FILTER_NEAREST);
+	setTexture(0);
+
+	pipelineLayout = createPipelineLayout({ descriptorSetLayout }, VK_SHADER_STAGE_FRAGMENT_BIT, 4 * sizeof(float));
+
+	PipelineState state;
+	state.layout = pipelineLayout;
+	state.renderPass = renderPass;
+	state.vertexShader = createShaderModule(vertexShader);
+	state.fragmentShader = createShaderModule(fillShader);
+	fillPipeline = createGraphicsPipeline(state);
+
+	state.fragmentShader = createShaderModule(fetchShader);
+	fetchPipeline = createGraphicsPipeline(state);
+}
+
+void DrawDependencyTest::setTexture(int texture)
+{
+	const VkDescriptorImageInfo imageInfo = { sampler, textureViews[texture], VK_IMAGE_LAYOUT_GENERAL };
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = descriptorSet;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &imageInfo;
+	driver.vkUpdateDescriptorSets(vkDevice, 1, &write, 0, nullptr);
+}
+
+void DrawDependencyTest::fill(int texture, uint32_t color)
+{
+	const float pushConstants[4] = {
+		float(color & 0xFF) / 255.0f,
+		float((color >> 8) & 0xFF) / 255.0f,
+		float((color >> 16) & 0xFF) / 255.0f,
+		float((color >> 24) & 0xFF) / 255.0f,
+	};
+
+	beginRenderPass(renderPass, textureFramebuffers[texture]);
+	driver.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, fillPipeline);
+	driver.vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT,
+	                          0, sizeof(pushConstants), pushConstants);
+	driver.vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	endRenderPass();
+}
+
+void DrawDependencyTest::copyTexture()
+{
+	beginRenderPass(renderPass, outputFramebuffer);
+	driver.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, fetchPipeline);
+	driver.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0,
+	                               1, &descriptorSet, 0, nullptr);
+	driver.vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	endRenderPass();
+}
+
+// The copy reads the texture filled by the prior draw, so it must wait for it.
+TEST_F(DrawDependencyTest, SampledAttachment)
+{
+	fill(0, red);
+	ASSERT_NO_FATAL_FAILURE(submit());
+
+	fill(0, green);
+	copyTexture();
+
+	expectColor(outputImage, green);
+}
+
+// The copy reads a texture the prior draw doesn't write to, so it doesn't
+// depend on it, and both draws produce their own results.
+TEST_F(DrawDependencyTest, IndependentDraws)
+{
+	setTexture(1);
+	fill(1, blue);
+	fill(0, red);
+	ASSERT_NO_FATAL_FAILURE(submit());
+
+	fill(0, green);
+	copyTexture();
+
+	expectColor(outputImage, blue);
+	expectColor(textureImages[0], green);
+}
+
+// The images referenced by a descriptor set are collected once per update of
+// the set. Pointing the set to another texture must make the copy depend on
+// the draws to that texture.
+TEST_F(DrawDependencyTest, UpdatedDescriptorSet)
+{
+	setTexture(1);
+	fill(0, red);
+	fill(1, blue);
+	copyTexture();
+	expectColor(outputImage, blue);
+
+	setTexture(0);
+	fill(0, green);
+	copyTexture();
+	expectColor(outputImage, green);
+}
@@ -0,0 +1,372 @@
+// Copyright 2022 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Tests of images which are rendered to and then sampled. These are stored
+// with each 2x2 quad of texels contiguous, so the pixel pipeline, clears, and
+// the sampler must all agree on the location of every texel.
+
+#include "RenderTest.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+// Not a whole number of quads, to cover the padding.
+constexpr uint32_t width = 31;
+constexpr uint32_t height = 17;
+
+constexpr uint32_t green = 0xFF00FF00;
+constexpr uint32_t red = 0xFF0000FF;
+
+// The color of each texel written by the gradient shader.
+uint32_t gradient(uint32_t x, uint32_t y)
+{
+	return 0xFFFF0000 | (y << 8) | x;
+}
+
+// Draws a fullscreen triangle.
+const char *vertexShader = R"(
+               OpCapability Shader
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Vertex %main "main" %vertexIndex %position
+               OpDecorate %vertexIndex BuiltIn VertexIndex
+               OpDecorate %position BuiltIn Position
+       %void = OpTypeVoid
+         %fn = OpTypeFunction %void
+        %int = OpTypeInt 32 1
+      %float = OpTypeFloat 32
+    %v4float = OpTypeVector %float 4
+%ptr_in_int = OpTypePointer Input %int
+%vertexIndex = OpVariable %ptr_in_int Input
+%ptr_out_v4float = OpTypePointer Output %v4float
+   %position = OpVariable %ptr_out_v4float Output
+      %int_1 = OpConstant %int 1
+      %int_2 = OpConstant %int 2
+      %int_4 = OpConstant %int 4
+    %float_0 = OpConstant %float 0
+    %float_1 = OpConstant %float 1
+       %main = OpFunction %void None %fn
+      %entry = OpLabel
+         %vi = OpLoad %int %vertexIndex
+       %xbit = OpBitwiseAnd %int %vi %int_1
+         %xi = OpIMul %int %xbit %int_4
+       %ybit = OpBitwiseAnd %int %vi %int_2
+         %yi = OpIMul %int %ybit %int_2
+         %xf = OpConvertSToF %float %xi
+         %yf = OpConvertSToF %float %yi
+          %x = OpFSub %float %xf %float_1
+          %y = OpFSub %float %yf %float_1
+        %pos = OpCompositeConstruct %v4float %x %y %float_0 %float_1
+               OpStore %position %pos
+               OpReturn
+               OpFunctionEnd
+)";
+
+// Outputs the pixel coordinates as the red and green components.
+const char *gradientShader = R"(
+               OpCapability Shader
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Fragment %main "main" %fragCoord %color
+               OpExecutionMode %main OriginUpperLeft
+               OpDecorate %fragCoord BuiltIn FragCoord
+               OpDecorate %color Location 0
+       %void = OpTypeVoid
+         %fn = OpTypeFunction %void
+      %float = OpTypeFloat 32
+    %v4float = OpTypeVector %float 4
+%ptr_in_v4float = OpTypePointer Input %v4float
+  %fragCoord = OpVariable %ptr_in_v4float Input
+%ptr_out_v4float = OpTypePointer Output %v4float
+      %color = OpVariable %ptr_out_v4float Output
+  %float_0_5 = OpConstant %float 0.5
+    %float_1 = OpConstant %float 1
+  %float_255 = OpConstant %float 255
+       %main = OpFunction %void None %fn
+      %entry = OpLabel
+         %fc = OpLoad %v4float %fragCoord
+         %fx = OpCompositeExtract %float %fc 0
+         %fy = OpCompositeExtract %float %fc 1
+         %px = OpFSub %float %fx %float_0_5
+         %py = OpFSub %float %fy %float_0_5
+          %r = OpFDiv %float %px %float_255
+          %g = OpFDiv %float %py %float_255
+          %c = OpCompositeConstruct %v4float %r %g %float_1 %float_1
+               OpStore %color %c
+               OpReturn
+               OpFunctionEnd
+)";
+
+// Outputs the texel of the texture at the pixel coordinates.
+const char *fetchShader = R"(
+               OpCapability Shader
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Fragment %main "main" %fragCoord %color
+               OpExecutionMode %main OriginUpperLeft
+               OpDecorate %fragCoord BuiltIn FragCoord
+               OpDecorate %color Location 0
+               OpDecorate %texture DescriptorSet 0
+               OpDecorate %texture Binding 0
+       %void = OpTypeVoid
+         %fn = OpTypeFunction %void
+        %int = OpTypeInt 32 1
+      %v2int = OpTypeVector %int 2
+      %float = OpTypeFloat 32
+    %v2float = OpTypeVector %float 2
+    %v4float = OpTypeVector %float 4
+      %image = OpTypeImage %float 2D 0 0 0 1 Unknown
+%sampledImage = OpTypeSampledImage %image
+%ptr_sampledImage = OpTypePointer UniformConstant %sampledImage
+    %texture = OpVariable %ptr_sampledImage UniformConstant
+%ptr_in_v4float = OpTypePointer Input %v4float
+  %fragCoord = OpVariable %ptr_in_v4float Input
+%ptr_out_v4float = OpTypePointer Output %v4float
+      %color = OpVariable %ptr_out_v4float Output
+      %int_0 = OpConstant %int 0
+       %main = OpFunction %void None %fn
+      %entry = OpLabel
+         %fc = OpLoad %v4float %fragCoord
+         %xy = OpVectorShuffle %v2float %fc %fc 0 1
+        %ixy = OpConvertFToS %v2int %xy
+          %s = OpLoad %sampledImage %texture
+          %i = OpImage %image %s
+          %c = OpImageFetch %v4float %i %ixy Lod %int_0
+               OpStore %color %c
+               OpReturn
+               OpFunctionEnd
+)";
+
+// Outputs the texture sampled at the center of the pixel.
+const char *sampleShader = R"(
+               OpCapability Shader
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Fragment %main "main" %fragCoord %color
+               OpExecutionMode %main OriginUpperLeft
+               OpDecorate %fragCoord BuiltIn FragCoord
+               OpDecorate %color Location 0
+               OpDecorate %texture DescriptorSet 0
+               OpDecorate %texture Binding 0
+       %void = OpTypeVoid
+         %fn = OpTypeFunction %void
+      %float = OpTypeFloat 32
+    %v2float = OpTypeVector %float 2
+    %v4float = OpTypeVector %float 4
+      %image = OpTypeImage %float 2D 0 0 0 1 Unknown
+%sampledImage = OpTypeSampledImage %image
+%ptr_sampledImage = OpTypePointer UniformConstant %sampledImage
+    %texture = OpVariable %ptr_sampledImage UniformConstant
+%ptr_in_v4float = OpTypePointer Input %v4float
+  %fragCoord = OpVariable %ptr_in_v4float Input
+%ptr_out_v4float = OpTypePointer Output %v4float
+      %color = OpVariable %ptr_out_v4float Output
+    %float_0 = OpConstant %float 0
+   %float_31 = OpConstant %float 31
+   %float_17 = OpConstant %float 17
+       %size = OpConstantComposite %v2float %float_31 %float_17
+       %main = OpFunction %void None %fn
+      %entry = OpLabel
+         %fc = OpLoad %v4float %fragCoord
+         %xy = OpVectorShuffle %v2float %fc %fc 0 1
+         %uv = OpFDiv %v2float %xy %size
+          %s = OpLoad %sampledImage %texture
+          %c = OpImageSampleExplicitLod %v4float %s %uv Lod %float_0
+               OpStore %color %c
+               OpReturn
+               OpFunctionEnd
+)";
+
+}  // anonymous namespace
+
+// Renders to a 31x17 R8G8B8A8_UNORM texture which is only used as a color
+// attachment and a sampled image, and copies it to an identical output image
+// by sampling it.
+class QuadLayoutTest : public RenderTest
+{
+protected:
+	QuadLayoutTest()
+	    : RenderTest({ width, height })
+	{}
+
+	void SetUp() override;
+
+	// Records a render pass which clears the texture to the given color.
+	void beginTextureRenderPass(uint32_t clearColor);
+	void drawGradient();
+
+	// Records a render pass which copies the texture to the output image with
+	// the given shader and sampler filter.
+	void copyTexture(const char *shader, VkFilter filter);
+
+	VkPipeline pipeline(const char *fragmentShader);
+
+	VkImage textureImage = VK_NULL_HANDLE;
+	VkImage outputImage = VK_NULL_HANDLE;
+	VkImageView textureView = VK_NULL_HANDLE;
+	VkImageView outputView = VK_NULL_HANDLE;
+
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	VkFramebuffer textureFramebuffer = VK_NULL_HANDLE;
+	VkFramebuffer outputFramebuffer = VK_NULL_HANDLE;
+
+	VkDescriptorSet descriptorSets[2] = {};  // Indexed by VkFilter
+	VkShaderModule vertexModule = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+};
+
+void QuadLayoutTest::SetUp()
+{
+	ASSERT_NO_FATAL_FAILURE(RenderTest::SetUp());
+
+	ASSERT_NO_FATAL_FAILURE(createImage(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+	                                    &textureImage, &textureView));
+	ASSERT_NO_FATAL_FAILURE(createImage(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+	                                    &outputImage, &outputView));
+
+	renderPass = createRenderPass({ VK_FORMAT_R8G8B8A8_UNORM }, VK_ATTACHMENT_LOAD_OP_CLEAR);
+	textureFramebuffer = createFramebuffer(renderPass, { textureView });
+	outputFramebuffer = createFramebuffer(renderPass, { outputView });
+
+	const VkDescriptorSetLayoutBinding binding = {
+		0,                                          // binding
+		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,  // descriptorType
+		1,                                          // descriptorCount
+		VK_SHADER_STAGE_FRAGMENT_BIT,               // stageFlags
+		nullptr,                                    // pImmutableSamplers
+	};
+
+	// The layouts of both sets are identically defined, so they're compatible.
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	for(VkFilter filter : { VK_FILTER_NEAREST, VK_FILTER_LINEAR })
+	{
+		descriptorSets[filter] = createDescriptorSet({ binding }, &descriptorSetLayout);
+
+		const VkDescriptorImageInfo imageInfo = { createSampler(filter), textureView, VK_IMAGE_LAYOUT_GENERAL };
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = descriptorSets[filter];
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo = &imageInfo;
+		driver.vkUpdateDescriptorSets(vkDevice, 1, &write, 0, nullptr);
+	}
+
+	vertexModule = createShaderModule(vertexShader);
+	pipelineLayout = createPipelineLayout({ descriptorSetLayout });
+}
+
+VkPipeline QuadLayoutTest::pipeline(const char *fragmentShader)
+{
+	PipelineState state;
+	state.layout = pipelineLayout;
+	state.renderPass = renderPass;
+	state.vertexShader = vertexModule;
+	state.fragmentShader = createShaderModule(fragmentShader);
+
+	return createGraphicsPipeline(state);
+}
+
+void QuadLayoutTest::beginTextureRenderPass(uint32_t clearColor)
+{
+	VkClearValue clearValue;
+	clearValue.color = { {
+		float(clearColor & 0xFF) / 255.0f,
+		float((clearColor >> 8) & 0xFF) / 255.0f,
+		float((clearColor >> 16) & 0xFF) / 255.0f,
+		float((clearColor >> 24) & 0xFF) / 255.0f,
+	} };
+
+	beginRenderPass(renderPass, textureFramebuffer, { clearValue });
+}
+
+void QuadLayoutTest::drawGradient()
+{
+	driver.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline(gradientShader));
+	driver.vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
+
+void QuadLayoutTest::copyTexture(const char *shader, VkFilter filter)
+{
+	barrier();
+
+	beginRenderPass(renderPass, outputFramebuffer, { VkClearValue{} });
+	driver.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline(shader));
+	driver.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0,
+	                               1, &descriptorSets[filter], 0, nullptr);
+	driver.vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	endRenderPass();
+}
+
+TEST_F(QuadLayoutTest, Fetch)
+{
+	beginTextureRenderPass(0);
+	drawGradient();
+	endRenderPass();
+
+	copyTexture(fetchShader, VK_FILTER_NEAREST);
+	expectColor(outputImage, gradient);
+}
+
+TEST_F(QuadLayoutTest, SampleNearest)
+{
+	beginTextureRenderPass(0);
+	drawGradient();
+	endRenderPass();
+
+	copyTexture(sampleShader, VK_FILTER_NEAREST);
+	expectColor(outputImage, gradient);
+}
+
+// Samples at texel centers, so filtering returns the texels unchanged.
+TEST_F(QuadLayoutTest, SampleLinear)
+{
+	beginTextureRenderPass(0);
+	drawGradient();
+	endRenderPass();
+
+	copyTexture(sampleShader, VK_FILTER_LINEAR);
+	expectColor(outputImage, gradient);
+}
+
+TEST_F(QuadLayoutTest, Clear)
+{
+	beginTextureRenderPass(green);
+	endRenderPass();
+
+	copyTexture(fetchShader, VK_FILTER_NEAREST);
+	expectColor(outputImage, [](uint32_t x, uint32_t y) { return green; });
+}
+
+// Clears a rectangle which doesn't start or end on quad boundaries.
+TEST_F(QuadLayoutTest, ClearAttachments)
+{
+	const VkRect2D rect = { { 3, 5 }, { 9, 7 } };
+
+	beginTextureRenderPass(0);
+	drawGradient();
+
+	VkClearAttachment colorClear = {};
+	colorClear.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	colorClear.colorAttachment = 0;
+	colorClear.clearValue.color = { { 1.0f, 0.0f, 0.0f, 1.0f } };
+	const VkClearRect clearRect = { rect, 0, 1 };
+	driver.vkCmdClearAttachments(commandBuffer, 1, &colorClear, 1, &clearRect);
+	endRenderPass();
+
+	copyTexture(fetchShader, VK_FILTER_NEAREST);
+	expectColor(outputImage, [&](uint32_t x, uint32_t y) {
+		bool inside = (x >= uint32_t(rect.offset.x)) && (x < rect.offset.x + rect.extent.width) &&
+		              (y >= uint32_t(rect.offset.y)) && (y < rect.offset.y + rect.extent.height);
+		return inside ? red : gradient(x, y);
+	});
+}
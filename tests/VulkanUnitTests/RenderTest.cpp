@@ -0,0 +1,559 @@
+// Copyright 2022 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "RenderTest.hpp"
+
+#include "spirv-tools/libspirv.hpp"
+
+#define VK_ASSERT(x) ASSERT_EQ(x, VK_SUCCESS)
+#define VK_EXPECT(x) EXPECT_EQ(x, VK_SUCCESS)
+
+namespace {
+
+bool isDepthFormat(VkFormat format)
+{
+	switch(format)
+	{
+	case VK_FORMAT_D16_UNORM:
+	case VK_FORMAT_X8_D24_UNORM_PACK32:
+	case VK_FORMAT_D32_SFLOAT:
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return true;
+	default:
+		return false;
+	}
+}
+
+}  // anonymous namespace
+
+Driver RenderTest::driver;
+
+RenderTest::RenderTest(VkExtent2D extent)
+    : extent(extent)
+{
+}
+
+void RenderTest::SetUpTestSuite()
+{
+	ASSERT_TRUE(driver.loadSwiftShader());
+}
+
+void RenderTest::TearDownTestSuite()
+{
+	driver.unload();
+}
+
+void RenderTest::SetUp()
+{
+	const VkInstanceCreateInfo instanceInfo = {
+		VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,  // sType
+		nullptr,                                 // pNext
+		0,                                       // flags
+		nullptr,                                 // pApplicationInfo
+		0,                                       // enabledLayerCount
+		nullptr,                                 // ppEnabledLayerNames
+		0,                                       // enabledExtensionCount
+		nullptr,                                 // ppEnabledExtensionNames
+	};
+
+	VK_ASSERT(driver.vkCreateInstance(&instanceInfo, nullptr, &instance));
+	ASSERT_TRUE(driver.resolve(instance));
+
+	VK_ASSERT(Device::CreateComputeDevice(&driver, instance, device, &enabledFeatures));
+	ASSERT_TRUE(device->IsValid());
+	vkDevice = device->GetVkDevice();
+
+	VK_ASSERT(device->CreateCommandPool(&commandPool));
+	VK_ASSERT(device->AllocateCommandBuffer(commandPool, &commandBuffer));
+	VK_ASSERT(device->BeginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, commandBuffer));
+
+	createBuffer(extent.width * extent.height * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+	             &readbackBuffer, (void **)&readbackData);
+}
+
+void RenderTest::TearDown()
+{
+	if(!device || !device->IsValid())
+	{
+		if(instance != VK_NULL_HANDLE)
+		{
+			driver.vkDestroyInstance(instance, nullptr);
+		}
+		return;
+	}
+
+	driver.vkDeviceWaitIdle(vkDevice);
+
+	for(auto destroyer = destroyers.rbegin(); destroyer != destroyers.rend(); destroyer++)
+	{
+		(*destroyer)();
+	}
+
+	device->FreeCommandBuffer(commandPool, commandBuffer);
+	device->DestroyCommandPool(commandPool);
+
+	device.reset();
+	driver.vkDestroyInstance(instance, nullptr);
+}
+
+std::vector<uint32_t> RenderTest::assemble(const char *assembly)
+{
+	spvtools::SpirvTools core(SPV_ENV_VULKAN_1_0);
+
+	core.SetMessageConsumer([](spv_message_level_t, const char *, const spv_position_t &p, const char *m) {
+		FAIL() << p.line << ":" << p.column << ": " << m;
+	});
+
+	std::vector<uint32_t> spirv;
+	EXPECT_TRUE(core.Assemble(assembly, &spirv));
+	EXPECT_TRUE(core.Validate(spirv));
+
+	return spirv;
+}
+
+VkShaderModule RenderTest::createShaderModule(const char *assembly)
+{
+	VkShaderModule module = VK_NULL_HANDLE;
+	VK_EXPECT(device->CreateShaderModule(assemble(assembly), &module));
+	destroyers.push_back([=] { device->DestroyShaderModule(module); });
+
+	return module;
+}
+
+void RenderTest::createImage(VkFormat format, VkImageUsageFlags usage, VkImage *image, VkImageView *view)
+{
+	const VkImageAspectFlags aspect = isDepthFormat(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+
+	const VkImageCreateInfo imageInfo = {
+		VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,  // sType
+		nullptr,                              // pNext
+		0,                                    // flags
+		VK_IMAGE_TYPE_2D,                     // imageType
+		format,                               // format
+		{ extent.width, extent.height, 1 },   // extent
+		1,                                    // mipLevels
+		1,                                    // arrayLayers
+		VK_SAMPLE_COUNT_1_BIT,                // samples
+		VK_IMAGE_TILING_OPTIMAL,              // tiling
+		usage,                                // usage
+		VK_SHARING_MODE_EXCLUSIVE,            // sharingMode
+		0,                                    // queueFamilyIndexCount
+		nullptr,                              // pQueueFamilyIndices
+		VK_IMAGE_LAYOUT_UNDEFINED,            // initialLayout
+	};
+	VK_ASSERT(driver.vkCreateImage(vkDevice, &imageInfo, nullptr, image));
+
+	VkMemoryRequirements requirements;
+	driver.vkGetImageMemoryRequirements(vkDevice, *image, &requirements);
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VK_ASSERT(device->AllocateMemory(requirements.size, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memory));
+	destroyers.push_back([=] { device->FreeMemory(memory); });
+	VK_ASSERT(driver.vkBindImageMemory(vkDevice, *image, memory, 0));
+	destroyers.push_back([=, image = *image] { driver.vkDestroyImage(vkDevice, image, nullptr); });
+
+	const VkImageViewCreateInfo viewInfo = {
+		VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,  // sType
+		nullptr,                                   // pNext
+		0,                                         // flags
+		*image,                                    // image
+		VK_IMAGE_VIEW_TYPE_2D,                     // viewType
+		format,                                    // format
+		{},                                        // components
+		{ aspect, 0, 1, 0, 1 },                    // subresourceRange
+	};
+	VK_ASSERT(driver.vkCreateImageView(vkDevice, &viewInfo, nullptr, view));
+	destroyers.push_back([=, view = *view] { driver.vkDestroyImageView(vkDevice, view, nullptr); });
+
+	const VkImageMemoryBarrier imageBarrier = {
+		VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,  // sType
+		nullptr,                                 // pNext
+		0,                                       // srcAccessMask
+		0,                                       // dstAccessMask
+		VK_IMAGE_LAYOUT_UNDEFINED,               // oldLayout
+		VK_IMAGE_LAYOUT_GENERAL,                 // newLayout
+		VK_QUEUE_FAMILY_IGNORED,                 // srcQueueFamilyIndex
+		VK_QUEUE_FAMILY_IGNORED,                 // dstQueueFamilyIndex
+		*image,                                  // image
+		{ aspect, 0, 1, 0, 1 },                  // subresourceRange
+	};
+	driver.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+	                            0, nullptr, 0, nullptr, 1, &imageBarrier);
+}
+
+void RenderTest::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer *buffer, void **data)
+{
+	const VkBufferCreateInfo bufferInfo = {
+		VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,  // sType
+		nullptr,                               // pNext
+		0,                                     // flags
+		size,                                  // size
+		usage,                                 // usage
+		VK_SHARING_MODE_EXCLUSIVE,             // sharingMode
+		0,                                     // queueFamilyIndexCount
+		nullptr,                               // pQueueFamilyIndices
+	};
+	VK_ASSERT(driver.vkCreateBuffer(vkDevice, &bufferInfo, nullptr, buffer));
+
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VK_ASSERT(device->AllocateMemory(size,
+	                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+	                                 &memory));
+	destroyers.push_back([=] { device->FreeMemory(memory); });
+	VK_ASSERT(driver.vkBindBufferMemory(vkDevice, *buffer, memory, 0));
+	destroyers.push_back([=, buffer = *buffer] { device->DestroyBuffer(buffer); });
+	VK_ASSERT(device->MapMemory(memory, 0, size, 0, data));
+	destroyers.push_back([=] { device->UnmapMemory(memory); });
+}
+
+VkRenderPass RenderTest::createRenderPass(const std::vector<VkFormat> &formats, VkAttachmentLoadOp loadOp)
+{
+	std::vector<VkAttachmentDescription> attachments;
+	std::vector<VkAttachmentReference> colorReferences;
+	VkAttachmentReference depthReference = { VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_GENERAL };
+
+	for(VkFormat format : formats)
+	{
+		const VkAttachmentReference reference = { uint32_t(attachments.size()), VK_IMAGE_LAYOUT_GENERAL };
+		if(isDepthFormat(format))
+		{
+			depthReference = reference;
+		}
+		else
+		{
+			colorReferences.push_back(reference);
+		}
+
+		attachments.push_back({
+		    0,                                 // flags
+		    format,                            // format
+		    VK_SAMPLE_COUNT_1_BIT,             // samples
+		    loadOp,                            // loadOp
+		    VK_ATTACHMENT_STORE_OP_STORE,      // storeOp
+		    VK_ATTACHMENT_LOAD_OP_DONT_CARE,   // stencilLoadOp
+		    VK_ATTACHMENT_STORE_OP_DONT_CARE,  // stencilStoreOp
+		    VK_IMAGE_LAYOUT_GENERAL,           // initialLayout
+		    VK_IMAGE_LAYOUT_GENERAL,           // finalLayout
+		});
+	}
+
+	const VkSubpassDescription subpass = {
+		0,                                                                                // flags
+		VK_PIPELINE_BIND_POINT_GRAPHICS,                                                  // pipelineBindPoint
+		0,                                                                                // inputAttachmentCount
+		nullptr,                                                                          // pInputAttachments
+		uint32_t(colorReferences.size()),                                                 // colorAttachmentCount
+		colorReferences.data(),                                                           // pColorAttachments
+		nullptr,                                                                          // pResolveAttachments
+		(depthReference.attachment != VK_ATTACHMENT_UNUSED) ? &depthReference : nullptr,  // pDepthStencilAttachment
+		0,                                                                                // preserveAttachmentCount
+		nullptr,                                                                          // pPreserveAttachments
+	};
+
+	const VkRenderPassCreateInfo renderPassInfo = {
+		VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,  // sType
+		nullptr,                                    // pNext
+		0,                                          // flags
+		uint32_t(attachments.size()),               // attachmentCount
+		attachments.data(),                         // pAttachments
+		1,                                          // subpassCount
+		&subpass,                                   // pSubpasses
+		0,                                          // dependencyCount
+		nullptr,                                    // pDependencies
+	};
+
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	VK_EXPECT(driver.vkCreateRenderPass(vkDevice, &renderPassInfo, nullptr, &renderPass));
+	destroyers.push_back([=] { driver.vkDestroyRenderPass(vkDevice, renderPass, nullptr); });
+
+	return renderPass;
+}
+
+VkFramebuffer RenderTest::createFramebuffer(VkRenderPass renderPass, const std::vector<VkImageView> &attachments)
+{
+	const VkFramebufferCreateInfo framebufferInfo = {
+		VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,  // sType
+		nullptr,                                    // pNext
+		0,                                          // flags
+		renderPass,                                 // renderPass
+		uint32_t(attachments.size()),               // attachmentCount
+		attachments.data(),                         // pAttachments
+		extent.width,                               // width
+		extent.height,                              // height
+		1,                                          // layers
+	};
+
+	VkFramebuffer framebuffer = VK_NULL_HANDLE;
+	VK_EXPECT(driver.vkCreateFramebuffer(vkDevice, &framebufferInfo, nullptr, &framebuffer));
+	destroyers.push_back([=] { driver.vkDestroyFramebuffer(vkDevice, framebuffer, nullptr); });
+
+	return framebuffer;
+}
+
+VkDescriptorSet RenderTest::createDescriptorSet(const std::vector<VkDescriptorSetLayoutBinding> &bindings,
+                                                VkDescriptorSetLayout *layout)
+{
+	VK_EXPECT(device->CreateDescriptorSetLayout(bindings, layout));
+	destroyers.push_back([=, layout = *layout] { device->DestroyDescriptorSetLayout(layout); });
+
+	std::vector<VkDescriptorPoolSize> poolSizes;
+	for(auto &binding : bindings)
+	{
+		poolSizes.push_back({ binding.descriptorType, binding.descriptorCount });
+	}
+
+	const VkDescriptorPoolCreateInfo poolInfo = {
+		VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,  // sType
+		nullptr,                                        // pNext
+		0,                                              // flags
+		1,                                              // maxSets
+		uint32_t(poolSizes.size()),                     // poolSizeCount
+		poolSizes.data(),                               // pPoolSizes
+	};
+
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	VK_EXPECT(driver.vkCreateDescriptorPool(vkDevice, &poolInfo, nullptr, &pool));
+	destroyers.push_back([=] { device->DestroyDescriptorPool(pool); });
+
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	VK_EXPECT(device->AllocateDescriptorSet(pool, *layout, &descriptorSet));
+
+	return descriptorSet;
+}
+
+VkPipelineLayout RenderTest::createPipelineLayout(const std::vector<VkDescriptorSetLayout> &setLayouts,
+                                                  VkShaderStageFlags pushConstantStages, uint32_t pushConstantSize)
+{
+	const VkPushConstantRange pushConstantRange = {
+		pushConstantStages,  // stageFlags
+		0,                   // offset
+		pushConstantSize,    // size
+	};
+
+	const VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+		VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,  // sType
+		nullptr,                                        // pNext
+		0,                                              // flags
+		uint32_t(setLayouts.size()),                    // setLayoutCount
+		setLayouts.data(),                              // pSetLayouts
+		(pushConstantSize > 0) ? 1u : 0u,               // pushConstantRangeCount
+		&pushConstantRange,                             // pPushConstantRanges
+	};
+
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VK_EXPECT(driver.vkCreatePipelineLayout(vkDevice, &pipelineLayoutInfo, nullptr, &pipelineLayout));
+	destroyers.push_back([=] { device->DestroyPipelineLayout(pipelineLayout); });
+
+	return pipelineLayout;
+}
+
+VkSampler RenderTest::createSampler(VkFilter filter)
+{
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = filter;
+	samplerInfo.minFilter = filter;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+	VkSampler sampler = VK_NULL_HANDLE;
+	VK_EXPECT(driver.vkCreateSampler(vkDevice, &samplerInfo, nullptr, &sampler));
+	destroyers.push_back([=] { driver.vkDestroySampler(vkDevice, sampler, nullptr); });
+
+	return sampler;
+}
+
+VkPipeline RenderTest::createGraphicsPipeline(const PipelineState &state)
+{
+	const VkPipelineShaderStageCreateInfo stages[] = {
+		{
+		    VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,  // sType
+		    nullptr,                                              // pNext
+		    0,                                                    // flags
+		    VK_SHADER_STAGE_VERTEX_BIT,                           // stage
+		    state.vertexShader,                                   // module
+		    "main",                                               // pName
+		    nullptr,                                              // pSpecializationInfo
+		},
+		{
+		    VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,  // sType
+		    nullptr,                                              // pNext
+		    0,                                                    // flags
+		    VK_SHADER_STAGE_FRAGMENT_BIT,                         // stage
+		    state.fragmentShader,                                 // module
+		    "main",                                               // pName
+		    nullptr,                                              // pSpecializationInfo
+		},
+	};
+
+	const VkPipelineVertexInputStateCreateInfo noVertexInputState = {
+		VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,  // sType
+	};
+
+	const VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = {
+		VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,  // sType
+		nullptr,                                                      // pNext
+		0,                                                            // flags
+		state.topology,                                               // topology
+		state.primitiveRestartEnable,                                 // primitiveRestartEnable
+	};
+
+	const VkViewport viewport = { 0.0f, 0.0f, float(extent.width), float(extent.height), 0.0f, 1.0f };
+	const VkRect2D scissor = { { 0, 0 }, extent };
+	const VkPipelineViewportStateCreateInfo viewportState = {
+		VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,  // sType
+		nullptr,                                                // pNext
+		0,                                                      // flags
+		1,                                                      // viewportCount
+		&viewport,                                              // pViewports
+		1,                                                      // scissorCount
+		&scissor,                                               // pScissors
+	};
+
+	VkPipelineRasterizationStateCreateInfo rasterizationState = {};
+	rasterizationState.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizationState.cullMode = VK_CULL_MODE_NONE;
+	rasterizationState.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterizationState.lineWidth = 1.0f;
+
+	const VkPipelineMultisampleStateCreateInfo multisampleState = {
+		VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,  // sType
+		nullptr,                                                   // pNext
+		0,                                                         // flags
+		VK_SAMPLE_COUNT_1_BIT,                                     // rasterizationSamples
+	};
+
+	VkPipelineColorBlendAttachmentState blendAttachment = {};
+	blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+	                                 VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	VkPipelineColorBlendStateCreateInfo colorBlendState = {};
+	colorBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlendState.attachmentCount = 1;
+	colorBlendState.pAttachments = &blendAttachment;
+
+	const VkGraphicsPipelineCreateInfo pipelineInfo = {
+		VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,                        // sType
+		nullptr,                                                                // pNext
+		0,                                                                      // flags
+		2,                                                                      // stageCount
+		stages,                                                                 // pStages
+		state.vertexInputState ? state.vertexInputState : &noVertexInputState,  // pVertexInputState
+		&inputAssemblyState,                                                    // pInputAssemblyState
+		nullptr,                                                                // pTessellationState
+		&viewportState,                                                         // pViewportState
+		&rasterizationState,                                                    // pRasterizationState
+		&multisampleState,                                                      // pMultisampleState
+		state.depthStencilState,                                                // pDepthStencilState
+		&colorBlendState,                                                       // pColorBlendState
+		nullptr,                                                                // pDynamicState
+		state.layout,                                                           // layout
+		state.renderPass,                                                       // renderPass
+		0,                                                                      // subpass
+		VK_NULL_HANDLE,                                                         // basePipelineHandle
+		0,                                                                      // basePipelineIndex
+	};
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VK_EXPECT(driver.vkCreateGraphicsPipelines(vkDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline));
+	destroyers.push_back([=] { device->DestroyPipeline(pipeline); });
+
+	return pipeline;
+}
+
+void RenderTest::beginRenderPass(VkRenderPass renderPass, VkFramebuffer framebuffer,
+                                 const std::vector<VkClearValue> &clearValues)
+{
+	const VkRenderPassBeginInfo beginInfo = {
+		VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,  // sType
+		nullptr,                                   // pNext
+		renderPass,                                // renderPass
+		framebuffer,                               // framebuffer
+		{ { 0, 0 }, extent },                      // renderArea
+		uint32_t(clearValues.size()),              // clearValueCount
+		clearValues.data(),                        // pClearValues
+	};
+
+	driver.vkCmdBeginRenderPass(commandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+}
+
+void RenderTest::endRenderPass()
+{
+	driver.vkCmdEndRenderPass(commandBuffer);
+}
+
+void RenderTest::barrier()
+{
+	const VkMemoryBarrier memoryBarrier = {
+		VK_STRUCTURE_TYPE_MEMORY_BARRIER,                        // sType
+		nullptr,                                                 // pNext
+		VK_ACCESS_MEMORY_WRITE_BIT,                              // srcAccessMask
+		VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,  // dstAccessMask
+	};
+
+	driver.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+	                            1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+const uint32_t *RenderTest::readback(VkImage image, VkImageAspectFlags aspect)
+{
+	barrier();
+
+	const VkBufferImageCopy region = {
+		0,                                   // bufferOffset
+		0,                                   // bufferRowLength
+		0,                                   // bufferImageHeight
+		{ aspect, 0, 0, 1 },                 // imageSubresource
+		{ 0, 0, 0 },                         // imageOffset
+		{ extent.width, extent.height, 1 },  // imageExtent
+	};
+	driver.vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_GENERAL, readbackBuffer, 1, &region);
+
+	submit();
+
+	return readbackData;
+}
+
+void RenderTest::submit()
+{
+	VK_ASSERT(driver.vkEndCommandBuffer(commandBuffer));
+	VK_ASSERT(device->QueueSubmitAndWait(commandBuffer));
+
+	// The command pool doesn't allow resetting command buffers, so a new one is allocated.
+	device->FreeCommandBuffer(commandPool, commandBuffer);
+	commandBuffer = VK_NULL_HANDLE;
+	VK_ASSERT(device->AllocateCommandBuffer(commandPool, &commandBuffer));
+	VK_ASSERT(device->BeginCommandBuffer(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, commandBuffer));
+}
+
+void RenderTest::expectColor(VkImage image, uint32_t expected)
+{
+	expectColor(image, [=](uint32_t x, uint32_t y) { return expected; });
+}
+
+void RenderTest::expectColor(VkImage image, std::function<uint32_t(uint32_t x, uint32_t y)> expected)
+{
+	const uint32_t *texels = readback(image);
+
+	for(uint32_t y = 0; y < extent.height; y++)
+	{
+		for(uint32_t x = 0; x < extent.width; x++)
+		{
+			ASSERT_EQ(texels[y * extent.width + x], expected(x, y)) << "Pixel " << x << ", " << y;
+		}
+	}
+}
@@ -0,0 +1,126 @@
+// Copyright 2022 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RENDER_TEST_HPP_
+#define RENDER_TEST_HPP_
+
+#include "Device.hpp"
+#include "Driver.hpp"
+
+#include "gtest/gtest.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+// RenderTest is a test fixture for tests which draw with graphics pipelines,
+// and check the rendered images on the host. All images are kept in the
+// GENERAL layout. The objects created by the helpers below are destroyed by
+// TearDown().
+class RenderTest : public testing::Test
+{
+protected:
+	// Tests render to images of the given size.
+	RenderTest(VkExtent2D extent);
+
+	static Driver driver;
+
+	static void SetUpTestSuite();
+	static void TearDownTestSuite();
+
+	// Creates the device, and begins recording the command buffer.
+	void SetUp() override;
+	void TearDown() override;
+
+	// Assembles and validates SPIR-V assembly.
+	static std::vector<uint32_t> assemble(const char *assembly);
+
+	VkShaderModule createShaderModule(const char *assembly);
+
+	// Creates a 2D image of the test's size with a view of the whole image,
+	// and records its transition to the GENERAL layout.
+	void createImage(VkFormat format, VkImageUsageFlags usage, VkImage *image, VkImageView *view);
+
+	// Creates a host visible buffer, mapped to 'data'.
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer *buffer, void **data);
+
+	// Creates a render pass with a single subpass, which uses all attachments.
+	// The attachment with a depth format, if any, is the depth attachment.
+	VkRenderPass createRenderPass(const std::vector<VkFormat> &formats, VkAttachmentLoadOp loadOp);
+	VkFramebuffer createFramebuffer(VkRenderPass renderPass, const std::vector<VkImageView> &attachments);
+
+	// Creates a descriptor set with its own layout and pool.
+	VkDescriptorSet createDescriptorSet(const std::vector<VkDescriptorSetLayoutBinding> &bindings,
+	                                    VkDescriptorSetLayout *layout);
+	VkPipelineLayout createPipelineLayout(const std::vector<VkDescriptorSetLayout> &setLayouts,
+	                                      VkShaderStageFlags pushConstantStages = 0, uint32_t pushConstantSize = 0);
+	VkSampler createSampler(VkFilter filter);
+
+	// The state of a graphics pipeline which draws to the whole framebuffer
+	// and writes all color components. States given by null pointers are
+	// left to their defaults, which are no vertex inputs and no depth test.
+	struct PipelineState
+	{
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkShaderModule vertexShader = VK_NULL_HANDLE;
+		VkShaderModule fragmentShader = VK_NULL_HANDLE;
+		VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		VkBool32 primitiveRestartEnable = VK_FALSE;
+		const VkPipelineVertexInputStateCreateInfo *vertexInputState = nullptr;
+		const VkPipelineDepthStencilStateCreateInfo *depthStencilState = nullptr;
+	};
+
+	VkPipeline createGraphicsPipeline(const PipelineState &state);
+
+	void beginRenderPass(VkRenderPass renderPass, VkFramebuffer framebuffer,
+	                     const std::vector<VkClearValue> &clearValues = {});
+	void endRenderPass();
+
+	// Records a memory barrier between all the commands recorded before and after.
+	void barrier();
+
+	// Executes the recorded commands, and begins recording a new command buffer.
+	void submit();
+
+	// Copies the aspect of an image with 32-bit texels to the readback buffer,
+	// executes the recorded commands, and returns the texels.
+	const uint32_t *readback(VkImage image, VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
+
+	// Reads back the image, and checks that all of its texels have the expected value.
+	void expectColor(VkImage image, uint32_t expected);
+	void expectColor(VkImage image, std::function<uint32_t(uint32_t x, uint32_t y)> expected);
+
+	const VkExtent2D extent;
+
+	// Features enabled on the device. Must be set before SetUp() is called.
+	VkPhysicalDeviceFeatures enabledFeatures = {};
+
+	VkInstance instance = VK_NULL_HANDLE;
+	std::unique_ptr<Device> device;
+	VkDevice vkDevice = VK_NULL_HANDLE;
+
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+
+private:
+	// Host visible buffer for reading back images.
+	VkBuffer readbackBuffer = VK_NULL_HANDLE;
+	uint32_t *readbackData = nullptr;
+
+	// Destroys the objects created by the helpers, in reverse order.
+	std::vector<std::function<void()>> destroyers;
+};
+
+#endif  // RENDER_TEST_HPP_
@@ -0,0 +1,452 @@
+// Copyright 2022 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Tests of indexed draws whose vertices are shaded once per unique index,
+// across the batches of a group. A grid of vertices is drawn with several
+// batches worth of primitives, and each pixel records the index of its
+// primitive's provoking vertex. The vertex shader also counts how many times
+// each vertex gets shaded.
+
+#include "RenderTest.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// 16x20 cells of 2x2 pixels. Vertices are offset by a quarter pixel
+// horizontally, so that no pixel center lies on the edge of a triangle.
+constexpr uint32_t columns = 17;
+constexpr uint32_t rows = 21;
+constexpr uint32_t vertexCount = columns * rows;
+constexpr uint32_t width = 32;
+constexpr uint32_t height = 42;
+
+constexpr uint32_t batchSize = 128;  // Primitives per batch of single-sampled draws
+constexpr uint32_t unwritten = 0xFFFFFFFF;
+
+uint32_t vertex(uint32_t column, uint32_t row)
+{
+	return row * columns + column;
+}
+
+// Vertex (column, row) of the grid is at pixel coordinates
+// (2 * column + 0.25, 2 * row + offsetY), where offsetY is a push constant.
+// Vertex indices are taken modulo the vertex count, and the resulting index
+// is output as a flat varying.
+const char *vertexShader = R"(
+               OpCapability Shader
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Vertex %main "main" %vertexIndex %position %outIndex
+               OpDecorate %vertexIndex BuiltIn VertexIndex
+               OpDecorate %position BuiltIn Position
+               OpDecorate %outIndex Location 0
+               OpDecorate %outIndex Flat
+               OpDecorate %uint_array ArrayStride 4
+               OpMemberDecorate %Counts 0 Offset 0
+               OpDecorate %Counts BufferBlock
+               OpDecorate %counts DescriptorSet 0
+               OpDecorate %counts Binding 0
+               OpMemberDecorate %PushConstants 0 Offset 0
+               OpMemberDecorate %PushConstants 1 Offset 4
+               OpDecorate %PushConstants Block
+       %void = OpTypeVoid
+         %fn = OpTypeFunction %void
+        %int = OpTypeInt 32 1
+       %uint = OpTypeInt 32 0
+      %float = OpTypeFloat 32
+    %v4float = OpTypeVector %float 4
+ %uint_array = OpTypeRuntimeArray %uint
+     %Counts = OpTypeStruct %uint_array
+%ptr_uniform_Counts = OpTypePointer Uniform %Counts
+     %counts = OpVariable %ptr_uniform_Counts Uniform
+%ptr_uniform_uint = OpTypePointer Uniform %uint
+%PushConstants = OpTypeStruct %uint %float
+%ptr_pc_PushConstants = OpTypePointer PushConstant %PushConstants
+%pushConstants = OpVariable %ptr_pc_PushConstants PushConstant
+%ptr_pc_uint = OpTypePointer PushConstant %uint
+%ptr_pc_float = OpTypePointer PushConstant %float
+ %ptr_in_int = OpTypePointer Input %int
+%vertexIndex = OpVariable %ptr_in_int Input
+%ptr_out_v4float = OpTypePointer Output %v4float
+   %position = OpVariable %ptr_out_v4float Output
+%ptr_out_uint = OpTypePointer Output %uint
+   %outIndex = OpVariable %ptr_out_uint Output
+      %int_0 = OpConstant %int 0
+      %int_1 = OpConstant %int 1
+     %uint_0 = OpConstant %uint 0
+     %uint_1 = OpConstant %uint 1
+    %uint_17 = OpConstant %uint 17
+    %float_0 = OpConstant %float 0
+    %float_1 = OpConstant %float 1
+    %float_2 = OpConstant %float 2
+ %float_0_25 = OpConstant %float 0.25
+   %float_16 = OpConstant %float 16
+   %float_21 = OpConstant %float 21
+       %main = OpFunction %void None %fn
+      %entry = OpLabel
+         %vi = OpLoad %int %vertexIndex
+        %uvi = OpBitcast %uint %vi
+%vertexCountPtr = OpAccessChain %ptr_pc_uint %pushConstants %int_0
+%vertexCount = OpLoad %uint %vertexCountPtr
+ %offsetYPtr = OpAccessChain %ptr_pc_float %pushConstants %int_1
+    %offsetY = OpLoad %float %offsetYPtr
+      %index = OpUMod %uint %uvi %vertexCount
+     %column = OpUMod %uint %index %uint_17
+        %row = OpUDiv %uint %index %uint_17
+   %countPtr = OpAccessChain %ptr_uniform_uint %counts %int_0 %index
+   %previous = OpAtomicIAdd %uint %countPtr %uint_1 %uint_0 %uint_1
+         %cf = OpConvertUToF %float %column
+         %rf = OpConvertUToF %float %row
+         %cx = OpFMul %float %cf %float_2
+         %px = OpFAdd %float %cx %float_0_25
+         %ry = OpFMul %float %rf %float_2
+         %py = OpFAdd %float %ry %offsetY
+         %nx = OpFDiv %float %px %float_16
+         %ny = OpFDiv %float %py %float_21
+          %x = OpFSub %float %nx %float_1
+          %y = OpFSub %float %ny %float_1
+        %pos = OpCompositeConstruct %v4float %x %y %float_0 %float_1
+               OpStore %position %pos
+               OpStore %outIndex %index
+               OpReturn
+               OpFunctionEnd
+)";
+
+// Outputs the index of the provoking vertex.
+const char *fragmentShader = R"(
+               OpCapability Shader
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Fragment %main "main" %inIndex %color
+               OpExecutionMode %main OriginUpperLeft
+               OpDecorate %inIndex Location 0
+               OpDecorate %inIndex Flat
+               OpDecorate %color Location 0
+       %void = OpTypeVoid
+         %fn = OpTypeFunction %void
+       %uint = OpTypeInt 32 0
+%ptr_in_uint = OpTypePointer Input %uint
+    %inIndex = OpVariable %ptr_in_uint Input
+%ptr_out_uint = OpTypePointer Output %uint
+      %color = OpVariable %ptr_out_uint Output
+       %main = OpFunction %void None %fn
+      %entry = OpLabel
+      %index = OpLoad %uint %inIndex
+               OpStore %color %index
+               OpReturn
+               OpFunctionEnd
+)";
+
+// Location of a pixel center within its cell, in units of cells.
+void cellCoordinates(uint32_t x, uint32_t y, float &u, float &v)
+{
+	u = (float(x % 2) + 0.25f) / 2.0f;
+	v = (float(y % 2) + 0.5f) / 2.0f;
+}
+
+// Each cell is split along its main diagonal into triangles ABD and DCA,
+// where A and D are its top-left and bottom-right vertices.
+uint32_t triangleListPixel(uint32_t x, uint32_t y)
+{
+	float u, v;
+	cellCoordinates(x, y, u, v);
+
+	return (u > v) ? vertex(x / 2, y / 2) : vertex(x / 2 + 1, y / 2 + 1);
+}
+
+// Each row of cells is a strip, which splits them along their anti-diagonal
+// into triangles ACB and CBD, where A and C are their top-left and bottom-left
+// vertices.
+uint32_t triangleStripPixel(uint32_t x, uint32_t y)
+{
+	float u, v;
+	cellCoordinates(x, y, u, v);
+
+	return (u + v < 1.0f) ? vertex(x / 2, y / 2) : vertex(x / 2, y / 2 + 1);
+}
+
+// Indices of the triangles ABD and DCA of a cell.
+void appendCell(std::vector<uint32_t> &indices, uint32_t column, uint32_t row)
+{
+	uint32_t a = vertex(column, row);
+	uint32_t b = vertex(column + 1, row);
+	uint32_t c = vertex(column, row + 1);
+	uint32_t d = vertex(column + 1, row + 1);
+
+	indices.insert(indices.end(), { a, b, d, d, c, a });
+}
+
+std::vector<uint32_t> triangleList()
+{
+	std::vector<uint32_t> indices;
+	for(uint32_t row = 0; row < rows - 1; row++)
+	{
+		for(uint32_t column = 0; column < columns - 1; column++)
+		{
+			appendCell(indices, column, row);
+		}
+	}
+
+	return indices;
+}
+
+}  // anonymous namespace
+
+// Draws indexed primitives to a 32x42 R32_UINT color attachment, with a
+// storage buffer counting the vertex shader invocations of each vertex.
+class VertexDeduplicationTest : public RenderTest
+{
+protected:
+	VertexDeduplicationTest()
+	    : RenderTest({ width, height })
+	{}
+
+	void SetUp() override;
+
+	// Draws the indices with the given topology, executes the commands, and
+	// reads back the color attachment.
+	void draw(VkPrimitiveTopology topology, const std::vector<uint32_t> &indices, float offsetY);
+
+	uint32_t pixel(uint32_t x, uint32_t y) const { return pixels[y * width + x]; }
+	uint32_t count(uint32_t index) const { return countData[index]; }
+	uint32_t totalCount() const;
+
+	VkImage image = VK_NULL_HANDLE;
+	VkImageView imageView = VK_NULL_HANDLE;
+	const uint32_t *pixels = nullptr;
+
+	// Host visible storage buffer with the invocation count of each vertex.
+	VkBuffer countBuffer = VK_NULL_HANDLE;
+	uint32_t *countData = nullptr;
+
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	VkFramebuffer framebuffer = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkShaderModule vertexModule = VK_NULL_HANDLE;
+	VkShaderModule fragmentModule = VK_NULL_HANDLE;
+};
+
+void VertexDeduplicationTest::SetUp()
+{
+	ASSERT_NO_FATAL_FAILURE(RenderTest::SetUp());
+
+	ASSERT_NO_FATAL_FAILURE(createImage(VK_FORMAT_R32_UINT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+	                                    &image, &imageView));
+
+	const VkDeviceSize countSize = vertexCount * sizeof(uint32_t);
+	ASSERT_NO_FATAL_FAILURE(createBuffer(countSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &countBuffer, (void **)&countData));
+	memset(countData, 0, countSize);
+
+	renderPass = createRenderPass({ VK_FORMAT_R32_UINT }, VK_ATTACHMENT_LOAD_OP_CLEAR);
+	framebuffer = createFramebuffer(renderPass, { imageView });
+
+	const VkDescriptorSetLayoutBinding binding = {
+		0,                                  // binding
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+		1,                                  // descriptorCount
+		VK_SHADER_STAGE_VERTEX_BIT,         // stageFlags
+		nullptr,                            // pImmutableSamplers
+	};
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	descriptorSet = createDescriptorSet({ binding }, &descriptorSetLayout);
+	device->UpdateStorageBufferDescriptorSets(descriptorSet, { { countBuffer, 0, VK_WHOLE_SIZE } });
+
+	pipelineLayout = createPipelineLayout({ descriptorSetLayout }, VK_SHADER_STAGE_VERTEX_BIT, sizeof(uint32_t) + sizeof(float));
+
+	vertexModule = createShaderModule(vertexShader);
+	fragmentModule = createShaderModule(fragmentShader);
+}
+
+void VertexDeduplicationTest::draw(VkPrimitiveTopology topology, const std::vector<uint32_t> &indices, float offsetY)
+{
+	const VkDeviceSize indexSize = indices.size() * sizeof(uint32_t);
+	VkBuffer indexBuffer = VK_NULL_HANDLE;
+	void *indexData = nullptr;
+	ASSERT_NO_FATAL_FAILURE(createBuffer(indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &indexBuffer, &indexData));
+	memcpy(indexData, indices.data(), indexSize);
+
+	PipelineState state;
+	state.layout = pipelineLayout;
+	state.renderPass = renderPass;
+	state.vertexShader = vertexModule;
+	state.fragmentShader = fragmentModule;
+	state.topology = topology;
+	state.primitiveRestartEnable = (topology == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP) ? VK_TRUE : VK_FALSE;
+	VkPipeline pipeline = createGraphicsPipeline(state);
+
+	VkClearValue clearValue;
+	clearValue.color.uint32[0] = unwritten;
+
+	struct
+	{
+		uint32_t vertexCount;
+		float offsetY;
+	} pushConstants = { vertexCount, offsetY };
+
+	beginRenderPass(renderPass, framebuffer, { clearValue });
+	driver.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	driver.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0,
+	                               1, &descriptorSet, 0, nullptr);
+	driver.vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pushConstants), &pushConstants);
+	driver.vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+	driver.vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+	endRenderPass();
+
+	pixels = readback(image);
+}
+
+uint32_t VertexDeduplicationTest::totalCount() const
+{
+	uint32_t total = 0;
+	for(uint32_t i = 0; i < vertexCount; i++)
+	{
+		total += countData[i];
+	}
+
+	return total;
+}
+
+TEST_F(VertexDeduplicationTest, TriangleList)
+{
+	std::vector<uint32_t> indices = triangleList();
+	const uint32_t batchCount = (indices.size() / 3 + batchSize - 1) / batchSize;
+	ASSERT_EQ(batchCount, 5u);
+
+	ASSERT_NO_FATAL_FAILURE(draw(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, indices, 0.0f));
+
+	for(uint32_t y = 0; y < height - 2; y++)
+	{
+		for(uint32_t x = 0; x < width; x++)
+		{
+			ASSERT_EQ(pixel(x, y), triangleListPixel(x, y)) << "Pixel " << x << ", " << y;
+		}
+	}
+
+	for(uint32_t i = 0; i < vertexCount; i++)
+	{
+		ASSERT_GE(count(i), 1u) << "Vertex " << i;
+	}
+
+	// Each batch covers four rows of cells. The vertices shared by consecutive
+	// batches are only shaded again by the first batch of the second group.
+	// Up to three more are shaded by each batch to fill the SIMD width.
+	EXPECT_LE(totalCount(), vertexCount + columns + 3 * batchCount);
+}
+
+TEST_F(VertexDeduplicationTest, TriangleStripWithRestart)
+{
+	std::vector<uint32_t> indices;
+	for(uint32_t row = 0; row < rows - 1; row++)
+	{
+		for(uint32_t column = 0; column < columns; column++)
+		{
+			indices.push_back(vertex(column, row));
+			indices.push_back(vertex(column, row + 1));
+		}
+
+		indices.push_back(0xFFFFFFFF);
+	}
+
+	ASSERT_NO_FATAL_FAILURE(draw(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP, indices, 0.0f));
+
+	for(uint32_t y = 0; y < height - 2; y++)
+	{
+		for(uint32_t x = 0; x < width; x++)
+		{
+			ASSERT_EQ(pixel(x, y), triangleStripPixel(x, y)) << "Pixel " << x << ", " << y;
+		}
+	}
+
+	for(uint32_t i = 0; i < vertexCount; i++)
+	{
+		ASSERT_GE(count(i), 1u) << "Vertex " << i;
+	}
+}
+
+TEST_F(VertexDeduplicationTest, LineList)
+{
+	// Horizontal lines through the centers of the even rows of pixels,
+	// between consecutive vertices of each row of the grid.
+	std::vector<uint32_t> indices;
+	for(uint32_t row = 0; row < rows; row++)
+	{
+		for(uint32_t column = 0; column < columns - 1; column++)
+		{
+			indices.push_back(vertex(column, row));
+			indices.push_back(vertex(column + 1, row));
+		}
+	}
+	ASSERT_GT(indices.size() / 2, 2 * batchSize);
+
+	ASSERT_NO_FATAL_FAILURE(draw(VK_PRIMITIVE_TOPOLOGY_LINE_LIST, indices, 0.5f));
+
+	// Only check the pixels away from the ends of the lines.
+	for(uint32_t row = 0; row < rows; row++)
+	{
+		for(uint32_t column = 0; column < columns - 1; column++)
+		{
+			ASSERT_EQ(pixel(2 * column + 1, 2 * row), vertex(column, row)) << "Line " << column << ", " << row;
+		}
+	}
+
+	for(uint32_t i = 0; i < vertexCount; i++)
+	{
+		ASSERT_GE(count(i), 1u) << "Vertex " << i;
+	}
+}
+
+// Batches which don't reuse any vertex use the vertex cache instead. The
+// vertices they shade must not be looked up by the following batches.
+TEST_F(VertexDeduplicationTest, NoReuseFallback)
+{
+	std::vector<uint32_t> grid = triangleList();
+	std::vector<uint32_t> indices;
+
+	// The first batch consists of degenerate triangles, with three distinct
+	// indices which the vertex shader maps to the same grid vertex.
+	for(uint32_t i = 0; i < batchSize; i++)
+	{
+		indices.insert(indices.end(), { i + vertexCount, i + 2 * vertexCount, i + 3 * vertexCount });
+	}
+
+	// The second batch draws the first four rows of cells with indices from
+	// the first batch, so it only reuses its own vertices.
+	for(uint32_t i = 0; i < 3 * batchSize; i++)
+	{
+		ASSERT_LT(grid[i], batchSize);
+		indices.push_back(grid[i] + vertexCount);
+	}
+
+	// The remaining batches draw the rest of the grid.
+	indices.insert(indices.end(), grid.begin() + 3 * batchSize, grid.end());
+
+	ASSERT_NO_FATAL_FAILURE(draw(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, indices, 0.0f));
+
+	for(uint32_t y = 0; y < height - 2; y++)
+	{
+		for(uint32_t x = 0; x < width; x++)
+		{
+			ASSERT_EQ(pixel(x, y), triangleListPixel(x, y)) << "Pixel " << x << ", " << y;
+		}
+	}
+
+	for(uint32_t i = 0; i < vertexCount; i++)
+	{
+		ASSERT_GE(count(i), 1u) << "Vertex " << i;
+	}
+}
@@ -0,0 +1,222 @@
+// Copyright 2022 The SwiftShader Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Tests of instance-rate vertex attributes, whose offset is the product of the
+// instance index and the binding's stride.
+
+#include "RenderTest.hpp"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <cstring>
+
+namespace {
+
+constexpr uint32_t width = 8;
+constexpr uint32_t height = 8;
+
+constexpr uint32_t green = 0xFF00FF00;
+constexpr uint32_t red = 0xFF0000FF;
+
+constexpr uint32_t maxStride = 2048;  // maxVertexInputBindingStride
+
+// Draws a fullscreen triangle with the color of the attribute at location 0.
+const char *vertexShader = R"(
+               OpCapability Shader
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Vertex %main "main" %vertexIndex %inColor %position %outColor
+               OpDecorate %vertexIndex BuiltIn VertexIndex
+               OpDecorate %position BuiltIn Position
+               OpDecorate %inColor Location 0
+               OpDecorate %outColor Location 0
+               OpDecorate %outColor Flat
+       %void = OpTypeVoid
+         %fn = OpTypeFunction %void
+        %int = OpTypeInt 32 1
+      %float = OpTypeFloat 32
+    %v4float = OpTypeVector %float 4
+ %ptr_in_int = OpTypePointer Input %int
+%vertexIndex = OpVariable %ptr_in_int Input
+%ptr_in_v4float = OpTypePointer Input %v4float
+    %inColor = OpVariable %ptr_in_v4float Input
+%ptr_out_v4float = OpTypePointer Output %v4float
+   %position = OpVariable %ptr_out_v4float Output
+   %outColor = OpVariable %ptr_out_v4float Output
+      %int_1 = OpConstant %int 1
+      %int_2 = OpConstant %int 2
+      %int_4 = OpConstant %int 4
+    %float_0 = OpConstant %float 0
+    %float_1 = OpConstant %float 1
+       %main = OpFunction %void None %fn
+      %entry = OpLabel
+         %vi = OpLoad %int %vertexIndex
+       %xbit = OpBitwiseAnd %int %vi %int_1
+         %xi = OpIMul %int %xbit %int_4
+       %ybit = OpBitwiseAnd %int %vi %int_2
+         %yi = OpIMul %int %ybit %int_2
+         %xf = OpConvertSToF %float %xi
+         %yf = OpConvertSToF %float %yi
+          %x = OpFSub %float %xf %float_1
+          %y = OpFSub %float %yf %float_1
+        %pos = OpCompositeConstruct %v4float %x %y %float_0 %float_1
+               OpStore %position %pos
+      %color = OpLoad %v4float %inColor
+               OpStore %outColor %color
+               OpReturn
+               OpFunctionEnd
+)";
+
+const char *fragmentShader = R"(
+               OpCapability Shader
+               OpMemoryModel Logical GLSL450
+               OpEntryPoint Fragment %main "main" %inColor %outColor
+               OpExecutionMode %main OriginUpperLeft
+               OpDecorate %inColor Location 0
+               OpDecorate %inColor Flat
+               OpDecorate %outColor Location 0
+       %void = OpTypeVoid
+         %fn = OpTypeFunction %void
+      %float = OpTypeFloat 32
+    %v4float = OpTypeVector %float 4
+%ptr_in_v4float = OpTypePointer Input %v4float
+    %inColor = OpVariable %ptr_in_v4float Input
+%ptr_out_v4float = OpTypePointer Output %v4float
+   %outColor = OpVariable %ptr_out_v4float Output
+       %main = OpFunction %void None %fn
+      %entry = OpLabel
+      %color = OpLoad %v4float %inColor
+               OpStore %outColor %color
+               OpReturn
+               OpFunctionEnd
+)";
+
+}  // anonymous namespace
+
+// Renders to an 8x8 R8G8B8A8_UNORM color attachment, with an R8G8B8A8_UNORM
+// color attribute read per instance with the largest stride, and robust
+// buffer access enabled.
+class VertexInputTest : public RenderTest
+{
+protected:
+	VertexInputTest()
+	    : RenderTest({ width, height })
+	{
+		enabledFeatures.robustBufferAccess = VK_TRUE;
+	}
+
+	void SetUp() override;
+
+	// Creates a vertex buffer with the given colors, one per stride.
+	void createVertexBuffer(const std::vector<uint32_t> &colors);
+
+	// Records a draw of a single instance.
+	void draw(uint32_t firstInstance);
+
+	VkImage image = VK_NULL_HANDLE;
+	VkImageView imageView = VK_NULL_HANDLE;
+
+	VkBuffer vertexBuffer = VK_NULL_HANDLE;
+
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	VkFramebuffer framebuffer = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+};
+
+void VertexInputTest::SetUp()
+{
+	ASSERT_NO_FATAL_FAILURE(RenderTest::SetUp());
+
+	ASSERT_NO_FATAL_FAILURE(createImage(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+	                                    &image, &imageView));
+
+	renderPass = createRenderPass({ VK_FORMAT_R8G8B8A8_UNORM }, VK_ATTACHMENT_LOAD_OP_CLEAR);
+	framebuffer = createFramebuffer(renderPass, { imageView });
+
+	const VkVertexInputBindingDescription binding = {
+		0,                              // binding
+		maxStride,                      // stride
+		VK_VERTEX_INPUT_RATE_INSTANCE,  // inputRate
+	};
+
+	const VkVertexInputAttributeDescription attribute = {
+		0,                         // location
+		0,                         // binding
+		VK_FORMAT_R8G8B8A8_UNORM,  // format
+		0,                         // offset
+	};
+
+	const VkPipelineVertexInputStateCreateInfo vertexInputState = {
+		VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,  // sType
+		nullptr,                                                    // pNext
+		0,                                                          // flags
+		1,                                                          // vertexBindingDescriptionCount
+		&binding,                                                   // pVertexBindingDescriptions
+		1,                                                          // vertexAttributeDescriptionCount
+		&attribute,                                                 // pVertexAttributeDescriptions
+	};
+
+	PipelineState state;
+	state.layout = createPipelineLayout({});
+	state.renderPass = renderPass;
+	state.vertexShader = createShaderModule(vertexShader);
+	state.fragmentShader = createShaderModule(fragmentShader);
+	state.vertexInputState = &vertexInputState;
+	pipeline = createGraphicsPipeline(state);
+}
+
+void VertexInputTest::createVertexBuffer(const std::vector<uint32_t> &colors)
+{
+	uint8_t *data = nullptr;
+	ASSERT_NO_FATAL_FAILURE(createBuffer(colors.size() * maxStride, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertexBuffer, (void **)&data));
+
+	for(size_t i = 0; i < colors.size(); i++)
+	{
+		memcpy(data + i * maxStride, &colors[i], sizeof(uint32_t));
+	}
+}
+
+void VertexInputTest::draw(uint32_t firstInstance)
+{
+	const VkClearValue clearValue = {};
+	const VkDeviceSize offset = 0;
+
+	beginRenderPass(renderPass, framebuffer, { clearValue });
+	driver.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	driver.vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+	driver.vkCmdDraw(commandBuffer, 3, 1, 0, firstInstance);
+	endRenderPass();
+}
+
+TEST_F(VertexInputTest, LargeInstanceStride)
+{
+	ASSERT_NO_FATAL_FAILURE(createVertexBuffer({ red, red, red, green }));
+	draw(3);
+
+	expectColor(image, green);
+}
+
+// The offset of the instance is 2^32 + 2048, which must not wrap around to the
+// second color of the buffer. It's out of bounds, so the attribute is zero.
+TEST_F(VertexInputTest, InstanceOffsetOverflow)
+{
+	ASSERT_NO_FATAL_FAILURE(createVertexBuffer({ red, red }));
+	draw((1u << 21) + 1);
+
+	const uint32_t *texels = readback(image);
+	for(uint32_t i = 0; i < width * height; i++)
+	{
+		ASSERT_EQ(texels[i] & 0x00FFFFFF, 0u) << "Pixel " << i % width << ", " << i / width;
+	}
+}